@@ -0,0 +1,368 @@
+#include "BenchCorpus.hpp"
+
+#include "ntrak/nspc/NspcCompile.hpp"
+#include "ntrak/nspc/NspcParser.hpp"
+#include "ntrak/nspc/NspcProjectFile.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace ntrak::bench {
+namespace {
+
+constexpr size_t kSpcHeaderSize = 0x100;
+constexpr size_t kSpcAramSize = 0x10000;
+constexpr size_t kSpcImageSize = kSpcHeaderSize + kSpcAramSize + 0x100;
+constexpr size_t kSpcPcOffset = 0x25;
+constexpr size_t kSpcSpOffset = 0x2B;
+constexpr uint16_t kStressEntryPoint = 0x0800;
+
+/// xorshift32; deterministic so every run benchmarks the same songs.
+class StressRng {
+public:
+    explicit StressRng(uint32_t seed) : state_(seed != 0 ? seed : 1u) {}
+
+    uint32_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    uint32_t below(uint32_t bound) { return next() % bound; }
+
+private:
+    uint32_t state_;
+};
+
+void writeWord(std::array<uint8_t, 0x10000>& aram, uint16_t address, uint16_t value) {
+    aram[address] = static_cast<uint8_t>(value & 0xFFu);
+    aram[static_cast<size_t>(address) + 1u] = static_cast<uint8_t>((value >> 8) & 0xFFu);
+}
+
+nspc::NspcEngineConfig stressEngineConfig() {
+    nspc::NspcEngineConfig config{};
+    config.name = "Benchmark stress engine";
+    config.entryPoint = kStressEntryPoint;
+    config.sampleHeaders = 0x0200;
+    config.instrumentHeaders = 0x0300;
+    config.songIndexPointers = 0x0400;
+    config.instrumentEntryBytes = 6;
+    config.reserved = {
+        nspc::NspcReservedRegion{.name = "Direct page", .from = 0x0000, .to = 0x0200},
+        nspc::NspcReservedRegion{.name = "Engine", .from = kStressEntryPoint, .to = kStressEntryPoint + 0x100},
+    };
+    return config;
+}
+
+std::array<uint8_t, 0x10000> stressBaseAram() {
+    std::array<uint8_t, 0x10000> aram{};
+
+    // Two one-block BRR samples.
+    writeWord(aram, 0x0200, 0x0500);
+    writeWord(aram, 0x0202, 0x0500);
+    writeWord(aram, 0x0204, 0x0509);
+    writeWord(aram, 0x0206, 0x0509);
+    aram[0x0500] = 0x01;
+    aram[0x0509] = 0x01;
+
+    // Two instruments.
+    constexpr std::array<uint8_t, 12> kInstruments = {0x00, 0x8F, 0xE0, 0x7F, 0x01, 0x00,
+                                                      0x01, 0x8F, 0xE0, 0x7F, 0x01, 0x00};
+    std::copy(kInstruments.begin(), kInstruments.end(), aram.begin() + 0x0300);
+
+    // One placeholder song (a single empty pattern) that the generator replaces.
+    writeWord(aram, 0x0400, 0x0600);
+    writeWord(aram, 0x0600, 0x0700);
+
+    // The "engine" just spins so the emulator benchmark has a CPU to step.
+    aram[kStressEntryPoint] = 0x2F;  // BRA
+    aram[kStressEntryPoint + 1] = 0xFE;
+    return aram;
+}
+
+nspc::NspcEventEntry makeEntry(nspc::NspcEventId& nextId, nspc::NspcEvent event) {
+    return nspc::NspcEventEntry{.id = nextId++, .event = std::move(event), .originalAddr = std::nullopt};
+}
+
+std::vector<nspc::NspcEvent> makeMotif(StressRng& rng) {
+    std::vector<nspc::NspcEvent> motif;
+    const uint32_t noteCount = 4 + rng.below(10);
+    for (uint32_t i = 0; i < noteCount; ++i) {
+        if (rng.below(3) == 0) {
+            motif.emplace_back(nspc::Duration{.ticks = static_cast<uint8_t>(6 * (1 + rng.below(4))),
+                                              .quantization = static_cast<uint8_t>(rng.below(8)),
+                                              .velocity = static_cast<uint8_t>(rng.below(16))});
+        }
+        switch (rng.below(8)) {
+        case 0:
+            motif.emplace_back(nspc::Rest{});
+            break;
+        case 1:
+            motif.emplace_back(nspc::Tie{});
+            break;
+        case 2:
+            motif.emplace_back(nspc::Vcmd{nspc::VcmdVolume{.volume = static_cast<uint8_t>(0x80 + rng.below(0x80))}});
+            break;
+        case 3:
+            motif.emplace_back(nspc::Vcmd{nspc::VcmdPanning{.panning = static_cast<uint8_t>(rng.below(21))}});
+            break;
+        default:
+            motif.emplace_back(nspc::Note{.pitch = static_cast<uint8_t>(rng.below(0x48))});
+            break;
+        }
+    }
+    return motif;
+}
+
+nspc::NspcSong makeStressSong(const StressSongShape& shape) {
+    StressRng rng(shape.seed);
+    std::vector<std::vector<nspc::NspcEvent>> motifs;
+    for (int i = 0; i < 24; ++i) {
+        motifs.push_back(makeMotif(rng));
+    }
+
+    nspc::NspcSong song = nspc::NspcSong::createEmpty(0);
+    nspc::NspcEventId nextId = 1;
+    auto& tracks = song.tracks();
+    auto& patterns = song.patterns();
+    auto& sequence = song.sequence();
+    tracks.clear();
+    patterns.clear();
+    sequence.clear();
+
+    for (int patternId = 0; patternId < shape.patternCount; ++patternId) {
+        std::array<int, 8> channelTrackIds{};
+        for (int channel = 0; channel < 8; ++channel) {
+            nspc::NspcTrack track{.id = static_cast<int>(tracks.size()), .events = {}, .originalAddr = 0};
+            track.events.push_back(makeEntry(nextId, nspc::Vcmd{nspc::VcmdInst{
+                                                        .instrumentIndex = static_cast<uint8_t>(channel & 1)}}));
+            track.events.push_back(makeEntry(nextId, nspc::Duration{.ticks = 12,
+                                                                    .quantization = std::nullopt,
+                                                                    .velocity = std::nullopt}));
+            for (int m = 0; m < shape.motifsPerTrack; ++m) {
+                const auto& motif = motifs[rng.below(static_cast<uint32_t>(motifs.size()))];
+                for (const auto& event : motif) {
+                    // Occasional transposed notes keep repeats inexact, like hand-written music.
+                    if (const auto* note = std::get_if<nspc::Note>(&event); note != nullptr && rng.below(16) == 0) {
+                        track.events.push_back(makeEntry(
+                            nextId, nspc::Note{.pitch = static_cast<uint8_t>((note->pitch + 1 + rng.below(11)) % 0x48)}));
+                    } else {
+                        track.events.push_back(makeEntry(nextId, event));
+                    }
+                }
+            }
+            track.events.push_back(makeEntry(nextId, nspc::End{}));
+            channelTrackIds[static_cast<size_t>(channel)] = track.id;
+            tracks.push_back(std::move(track));
+        }
+        patterns.push_back(nspc::NspcPattern{.id = patternId, .channelTrackIds = channelTrackIds, .trackTableAddr = 0});
+        sequence.emplace_back(nspc::PlayPattern{.patternId = patternId, .trackTableAddr = 0});
+    }
+    sequence.emplace_back(nspc::EndSequence{});
+    song.setNextEventId(nextId);
+    song.setSongName(shape.name);
+    return song;
+}
+
+std::optional<std::vector<uint8_t>> readFileBytes(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// Index of the song with the most events; that is the one worth timing.
+int largestSongIndex(const nspc::NspcProject& project) {
+    int best = 0;
+    size_t bestEvents = 0;
+    const auto& songs = project.songs();
+    for (size_t i = 0; i < songs.size(); ++i) {
+        size_t events = 0;
+        for (const auto& track : songs[i].tracks()) {
+            events += track.events.size();
+        }
+        if (events > bestEvents) {
+            bestEvents = events;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+std::optional<CorpusEntry> loadSpcEntry(const std::filesystem::path& path, std::vector<std::string>& warnings) {
+    auto bytes = readFileBytes(path);
+    if (!bytes.has_value()) {
+        warnings.push_back(std::format("{}: could not read file", path.string()));
+        return std::nullopt;
+    }
+    auto project = nspc::NspcParser::load(*bytes);
+    if (!project.has_value()) {
+        warnings.push_back(std::format("{}: not a supported N-SPC SPC", path.string()));
+        return std::nullopt;
+    }
+    const int songIndex = largestSongIndex(*project);
+    return CorpusEntry{
+        .name = path.stem().string(),
+        .project = std::move(*project),
+        .songIndex = songIndex,
+        .spcImage = std::move(*bytes),
+    };
+}
+
+std::optional<CorpusEntry> loadProjectEntry(const std::filesystem::path& path, std::vector<std::string>& warnings) {
+    auto overlay = nspc::loadProjectIrFile(path);
+    if (!overlay.has_value()) {
+        warnings.push_back(std::format("{}: {}", path.string(), overlay.error()));
+        return std::nullopt;
+    }
+    if (!overlay->baseSpcPath.has_value()) {
+        warnings.push_back(std::format("{}: project does not name a base SPC", path.string()));
+        return std::nullopt;
+    }
+    std::filesystem::path spcPath = *overlay->baseSpcPath;
+    if (spcPath.is_relative()) {
+        spcPath = path.parent_path() / spcPath;
+    }
+    auto spcBytes = readFileBytes(spcPath);
+    if (!spcBytes.has_value()) {
+        // Base SPCs are rarely redistributable; one copied next to the project stands in for the saved path
+        spcBytes = readFileBytes(path.parent_path() / spcPath.filename());
+    }
+    if (!spcBytes.has_value()) {
+        warnings.push_back(std::format("{}: base SPC '{}' not found (a copy named '{}' next to the project also works)",
+                                       path.string(), spcPath.string(), spcPath.filename().string()));
+        return std::nullopt;
+    }
+    auto project = nspc::NspcParser::load(*spcBytes);
+    if (!project.has_value()) {
+        warnings.push_back(std::format("{}: base SPC is not a supported N-SPC SPC", path.string()));
+        return std::nullopt;
+    }
+    if (auto applied = nspc::applyProjectIrOverlay(*project, *overlay); !applied.has_value()) {
+        warnings.push_back(std::format("{}: {}", path.string(), applied.error()));
+        return std::nullopt;
+    }
+
+    // Bake user instruments and samples into the image, as opening the project in the editor does.
+    if (auto userContent = nspc::buildUserContentUpload(*project); userContent.has_value()) {
+        if (auto patched = nspc::applyUploadToSpcImage(*userContent, *spcBytes); patched.has_value()) {
+            *spcBytes = std::move(*patched);
+        }
+    }
+
+    const int songIndex = largestSongIndex(*project);
+    return CorpusEntry{
+        .name = path.stem().string(),
+        .project = std::move(*project),
+        .songIndex = songIndex,
+        .spcImage = std::move(*spcBytes),
+    };
+}
+
+}  // namespace
+
+nspc::NspcProject makeStressProject(const StressSongShape& shape) {
+    nspc::NspcProject project(stressEngineConfig(), stressBaseAram());
+    project.songs()[0] = makeStressSong(shape);
+    project.setSongContentOrigin(0, nspc::NspcContentOrigin::UserProvided);
+    project.refreshAramUsage();
+    return project;
+}
+
+std::vector<uint8_t> makeSpcImage(const nspc::NspcProject& project) {
+    std::vector<uint8_t> image(kSpcImageSize, 0);
+    constexpr std::string_view kSignature = "SNES-SPC700 Sound File Data v0.30";
+    std::memcpy(image.data(), kSignature.data(), kSignature.size());
+    image[0x21] = 26;
+    image[0x22] = 26;
+    image[0x23] = 26;
+    image[0x24] = 30;
+    image[kSpcPcOffset] = static_cast<uint8_t>(project.engineConfig().entryPoint & 0xFFu);
+    image[kSpcPcOffset + 1] = static_cast<uint8_t>((project.engineConfig().entryPoint >> 8) & 0xFFu);
+    image[kSpcSpOffset] = 0xEF;
+
+    const auto aram = project.aram().all();
+    std::copy(aram.begin(), aram.end(), image.begin() + static_cast<ptrdiff_t>(kSpcHeaderSize));
+    return image;
+}
+
+std::vector<StressSongShape> defaultStressShapes() {
+    return {
+        StressSongShape{.name = "small", .patternCount = 8, .motifsPerTrack = 6},
+        StressSongShape{.name = "medium", .patternCount = 32, .motifsPerTrack = 8},
+        StressSongShape{.name = "large", .patternCount = 64, .motifsPerTrack = 12},
+    };
+}
+
+std::vector<CorpusEntry> buildStressCorpus(const std::vector<StressSongShape>& shapes, std::vector<std::string>& warnings) {
+    std::vector<CorpusEntry> entries;
+    for (const auto& shape : shapes) {
+        nspc::NspcProject project = makeStressProject(shape);
+        std::vector<uint8_t> image = makeSpcImage(project);
+
+        // Compile once so the image (and a re-parse of it) carries the song as the engine sees it.
+        nspc::NspcProject compileProject = project;
+        auto compiled = nspc::buildSongScopedUpload(compileProject, 0);
+        if (!compiled.has_value()) {
+            warnings.push_back(std::format("stress/{}: {}", shape.name, compiled.error()));
+            continue;
+        }
+        auto patched = nspc::applyUploadToSpcImage(compiled->upload, image);
+        if (!patched.has_value()) {
+            warnings.push_back(std::format("stress/{}: {}", shape.name, patched.error()));
+            continue;
+        }
+
+        entries.push_back(CorpusEntry{
+            .name = std::format("stress-{}", shape.name),
+            .project = std::move(project),
+            .songIndex = 0,
+            .spcImage = std::move(*patched),
+        });
+    }
+    return entries;
+}
+
+std::vector<CorpusEntry> loadCorpusDirectory(const std::filesystem::path& directory, std::vector<std::string>& warnings) {
+    std::vector<CorpusEntry> entries;
+    std::error_code error;
+    if (!std::filesystem::is_directory(directory, error)) {
+        warnings.push_back(std::format("{}: corpus directory not found", directory.string()));
+        return entries;
+    }
+
+    std::vector<std::filesystem::path> paths;
+    for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+        if (item.is_regular_file()) {
+            paths.push_back(item.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        std::optional<CorpusEntry> entry;
+        if (extension == ".spc") {
+            entry = loadSpcEntry(path, warnings);
+        } else if (extension == ".ntrakproj" || extension == ".ntrakbin") {
+            entry = loadProjectEntry(path, warnings);
+        }
+        if (entry.has_value()) {
+            entries.push_back(std::move(*entry));
+        }
+    }
+    return entries;
+}
+
+}  // namespace ntrak::bench
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ntrak/nspc/NspcProject.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ntrak::bench {
+
+/// One project the benchmarks run against, with the SPC image its song plays from.
+struct CorpusEntry {
+    std::string name;
+    nspc::NspcProject project;
+    int songIndex = 0;
+    std::vector<uint8_t> spcImage;
+};
+
+/// Shape of a generated stress song. Tracks are stitched together from a small motif library with
+/// occasional mutations, so the optimizer has realistic (partial) repetition to chew on.
+struct StressSongShape {
+    std::string name;
+    int patternCount = 32;
+    int motifsPerTrack = 8;
+    uint32_t seed = 0x6E747261;
+};
+
+/// Synthetic project whose first song is a user-provided stress song of the given shape.
+nspc::NspcProject makeStressProject(const StressSongShape& shape);
+
+/// Minimal SPC file around a project's ARAM: signature, PC at the engine entry point and zeroed
+/// DSP registers.
+std::vector<uint8_t> makeSpcImage(const nspc::NspcProject& project);
+
+/// The small/medium/large stress songs every corpus run starts from.
+std::vector<StressSongShape> defaultStressShapes();
+
+/// Generated stress songs, compiled once into their SPC image so every stage has real input.
+std::vector<CorpusEntry> buildStressCorpus(const std::vector<StressSongShape>& shapes, std::vector<std::string>& warnings);
+
+/// Loads every `.spc`, `.ntrakproj` and `.ntrakbin` in `directory` (non-recursive, sorted by name). Entries that
+/// fail to load are skipped with a warning, e.g. a project whose base SPC is not on disk.
+std::vector<CorpusEntry> loadCorpusDirectory(const std::filesystem::path& directory, std::vector<std::string>& warnings);
+
+}  // namespace ntrak::bench
@@ -0,0 +1,412 @@
+#include "BenchCorpus.hpp"
+
+#include "ntrak/emulation/SpcDsp.hpp"
+#include "ntrak/nspc/BrrCodec.hpp"
+#include "ntrak/nspc/NspcCompile.hpp"
+#include "ntrak/nspc/NspcFlatten.hpp"
+#include "ntrak/nspc/NspcOptimize.hpp"
+#include "ntrak/nspc/NspcPackedEvents.hpp"
+#include "ntrak/nspc/NspcProjectFile.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace ntrak::bench {
+namespace {
+
+constexpr uint32_t kEmulationSamplesPerIteration = 32000;  // One second of output.
+
+size_t songEventCount(const nspc::NspcSong& song) {
+    size_t events = 0;
+    for (const auto& track : song.tracks()) {
+        events += track.events.size();
+    }
+    for (const auto& subroutine : song.subroutines()) {
+        events += subroutine.events.size();
+    }
+    return events;
+}
+
+// Parses the ARAM of the entry's SPC image, where the song is compiled, rather than the project's own ARAM,
+// which for generated songs is only the engine placeholder
+void benchProjectParse(benchmark::State& state, const CorpusEntry& entry) {
+    constexpr size_t kSpcHeaderSize = 0x100;
+    std::array<uint8_t, 0x10000> aram{};
+    if (entry.spcImage.size() < kSpcHeaderSize + aram.size()) {
+        state.SkipWithError("SPC image is too small");
+        return;
+    }
+    std::copy_n(entry.spcImage.begin() + kSpcHeaderSize, aram.size(), aram.begin());
+    for (auto _ : state) {
+        nspc::NspcProject project(entry.project.engineConfig(), aram);
+        benchmark::DoNotOptimize(project.songs().data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(aram.size()));
+}
+
+void benchFlattenSong(benchmark::State& state, const CorpusEntry& entry) {
+    const auto& song = entry.project.songs()[static_cast<size_t>(entry.songIndex)];
+    size_t flattenedEvents = 0;
+    for (auto _ : state) {
+        flattenedEvents = 0;
+        for (const auto& pattern : song.patterns()) {
+            const auto flat = nspc::flattenPattern(song, pattern);
+            for (const auto& channel : flat.channels) {
+                flattenedEvents += channel.events.size();
+            }
+        }
+        benchmark::DoNotOptimize(flattenedEvents);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(flattenedEvents));
+    state.counters["patterns"] = static_cast<double>(song.patterns().size());
+}
+
+// Counts notes across every track and subroutine, read either from the song's event vectors or from packed copies
+// (the form compacted undo records keep), to measure what decoding on access costs.
+void benchScanSongEvents(benchmark::State& state, const CorpusEntry& entry, bool packed) {
+    const auto& song = entry.project.songs()[static_cast<size_t>(entry.songIndex)];
+    std::vector<const std::vector<nspc::NspcEventEntry>*> lists;
+    for (const auto& track : song.tracks()) {
+        lists.push_back(&track.events);
+    }
+    for (const auto& subroutine : song.subroutines()) {
+        lists.push_back(&subroutine.events);
+    }
+    std::vector<nspc::NspcPackedEventList> packedLists;
+    for (const auto* events : lists) {
+        if (auto packedList = nspc::NspcPackedEventList::pack(*events)) {
+            packedLists.push_back(std::move(*packedList));
+        }
+    }
+
+    size_t notes = 0;
+    for (auto _ : state) {
+        notes = 0;
+        const auto countNotes = [&](const auto& events) {
+            for (const auto& event : events) {
+                notes += std::holds_alternative<nspc::Note>(event.event) ? 1 : 0;
+            }
+        };
+        if (packed) {
+            std::ranges::for_each(packedLists, countNotes);
+        } else {
+            for (const auto* events : lists) {
+                countNotes(*events);
+            }
+        }
+        benchmark::DoNotOptimize(notes);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(songEventCount(song)));
+}
+
+void benchOptimizeSong(benchmark::State& state, const CorpusEntry& entry, const nspc::NspcOptimizerOptions& options) {
+    const auto& source = entry.project.songs()[static_cast<size_t>(entry.songIndex)];
+    nspc::NspcOptimizerStats stats{};
+    for (auto _ : state) {
+        state.PauseTiming();
+        nspc::NspcSong song = source;
+        state.ResumeTiming();
+        stats = nspc::optimizeSongSubroutines(song, options);
+        benchmark::DoNotOptimize(song.subroutines().data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(songEventCount(source)));
+    state.counters["bytesBefore"] = stats.bytesBefore;
+    state.counters["bytesAfter"] = stats.bytesAfter;
+    state.counters["subroutines"] = stats.subroutinesCreated;
+    state.counters["samBytes"] = static_cast<double>(stats.peakAutomatonBytes);
+    state.counters["samBuilds"] = stats.automatonBuilds;
+    state.counters["tokens"] = stats.distinctTokens;
+    if (stats.greedyBytesAfter != 0) {
+        state.counters["greedyBytesAfter"] = stats.greedyBytesAfter;
+        state.counters["searchDepth"] = stats.searchDepth;
+    }
+}
+
+// The optimizer is timed on its own, so compile and apply start from the song it would have produced;
+// large songs only fit in ARAM once their repetition has been factored out.
+nspc::NspcProject preOptimizedProject(const CorpusEntry& entry) {
+    nspc::NspcProject project = entry.project;
+    nspc::optimizeSongSubroutines(project.songs()[static_cast<size_t>(entry.songIndex)]);
+    return project;
+}
+
+void benchCompileSong(benchmark::State& state, const CorpusEntry& entry) {
+    const nspc::NspcProject source = preOptimizedProject(entry);
+    nspc::NspcBuildOptions options{};
+    options.optimizeSubroutines = false;
+    nspc::NspcBuildTelemetry telemetry{};
+    for (auto _ : state) {
+        state.PauseTiming();
+        nspc::NspcProject project = source;
+        state.ResumeTiming();
+        auto compiled = nspc::buildSongScopedUpload(project, entry.songIndex, options);
+        if (!compiled.has_value()) {
+            state.SkipWithError(compiled.error().c_str());
+            return;
+        }
+        telemetry = compiled->upload.telemetry;
+        benchmark::DoNotOptimize(compiled->upload.chunks.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * telemetry.emittedBytes());
+    state.counters["emittedBytes"] = telemetry.emittedBytes();
+    state.counters["encodeMs"] = telemetry.stageTime(nspc::NspcBuildStage::Encode);
+    state.counters["allocateMs"] = telemetry.stageTime(nspc::NspcBuildStage::Allocate);
+}
+
+// Optimized rebuild of an unchanged song: everything after the first build is served by the
+// project's optimizer cache, so this should track `compile` rather than `optimize`.
+void benchCompileCachedSong(benchmark::State& state, const CorpusEntry& entry) {
+    nspc::NspcProject source = entry.project;
+    nspc::NspcBuildOptions options{};
+    options.optimizeSubroutines = true;
+    if (auto warmup = nspc::buildSongScopedUpload(source, entry.songIndex, options); !warmup.has_value()) {
+        state.SkipWithError(warmup.error().c_str());
+        return;
+    }
+    nspc::NspcBuildTelemetry telemetry{};
+    for (auto _ : state) {
+        state.PauseTiming();
+        nspc::NspcProject project = source;
+        state.ResumeTiming();
+        auto compiled = nspc::buildSongScopedUpload(project, entry.songIndex, options);
+        if (!compiled.has_value()) {
+            state.SkipWithError(compiled.error().c_str());
+            return;
+        }
+        telemetry = compiled->upload.telemetry;
+        benchmark::DoNotOptimize(compiled->upload.chunks.data());
+    }
+    state.counters["cacheHits"] = telemetry.cacheHits;
+    state.counters["optimizeMs"] = telemetry.stageTime(nspc::NspcBuildStage::Optimize);
+}
+
+void benchApplyUpload(benchmark::State& state, const CorpusEntry& entry) {
+    nspc::NspcProject project = preOptimizedProject(entry);
+    nspc::NspcBuildOptions options{};
+    options.optimizeSubroutines = false;
+    auto compiled = nspc::buildSongScopedUpload(project, entry.songIndex, options);
+    if (!compiled.has_value()) {
+        state.SkipWithError(compiled.error().c_str());
+        return;
+    }
+    for (auto _ : state) {
+        auto image = nspc::applyUploadToSpcImage(compiled->upload, entry.spcImage);
+        benchmark::DoNotOptimize(image);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(entry.spcImage.size()));
+}
+
+void benchEmulation(benchmark::State& state, const CorpusEntry& entry) {
+    auto dsp = std::make_unique<emulation::SpcDsp>();
+    if (!dsp->loadSpcFile(entry.spcImage.data(), static_cast<uint32_t>(entry.spcImage.size()))) {
+        state.SkipWithError("SPC image failed to load");
+        return;
+    }
+    std::vector<int16_t> output(static_cast<size_t>(kEmulationSamplesPerIteration) * 2);
+    for (auto _ : state) {
+        dsp->runForSamples(kEmulationSamplesPerIteration);
+        benchmark::DoNotOptimize(dsp->extractSamples(output.data(), kEmulationSamplesPerIteration));
+    }
+    state.counters["samplesPerSecond"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * kEmulationSamplesPerIteration, benchmark::Counter::kIsRate);
+}
+
+// Every sample is marked user-provided so the file carries the BRR data, as a sample-heavy project's would
+nspc::NspcProject projectWithUserSamples(const CorpusEntry& entry) {
+    nspc::NspcProject project = entry.project;
+    std::vector<int> sampleIds;
+    for (const auto& sample : project.samples()) {
+        sampleIds.push_back(sample.id);
+    }
+    for (const int sampleId : sampleIds) {
+        (void)project.setSampleContentOrigin(sampleId, nspc::NspcContentOrigin::UserProvided);
+    }
+    return project;
+}
+
+std::filesystem::path benchProjectPath(const CorpusEntry& entry, nspc::NspcProjectFileFormat format) {
+    const std::string_view extension = format == nspc::NspcProjectFileFormat::Binary ? "ntrakbin" : "ntrakproj";
+    return std::filesystem::temp_directory_path() / std::format("ntrak-bench-{}.{}", entry.name, extension);
+}
+
+void benchSaveProjectFile(benchmark::State& state, const CorpusEntry& entry, nspc::NspcProjectFileFormat format) {
+    const nspc::NspcProject project = projectWithUserSamples(entry);
+    const auto path = benchProjectPath(entry, format);
+    for (auto _ : state) {
+        auto saved = nspc::saveProjectIrFile(project, path, std::nullopt, false, format);
+        if (!saved.has_value()) {
+            state.SkipWithError(saved.error().c_str());
+            break;
+        }
+    }
+    std::error_code ec;
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(std::filesystem::file_size(path, ec)));
+    std::filesystem::remove(path, ec);
+}
+
+// Deferred loads leave song events encoded; eager ones decode every song as the load did before
+void benchLoadProjectFile(benchmark::State& state, const CorpusEntry& entry, nspc::NspcProjectFileFormat format,
+                          bool deferSongEvents) {
+    const auto path = benchProjectPath(entry, format);
+    if (auto saved = nspc::saveProjectIrFile(projectWithUserSamples(entry), path, std::nullopt, false, format);
+        !saved.has_value()) {
+        state.SkipWithError(saved.error().c_str());
+        return;
+    }
+    for (auto _ : state) {
+        auto loaded = nspc::loadProjectIrFile(path, {.deferSongEvents = deferSongEvents});
+        if (!loaded.has_value()) {
+            state.SkipWithError(loaded.error().c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(loaded->samples.data());
+    }
+    std::error_code ec;
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(std::filesystem::file_size(path, ec)));
+    std::filesystem::remove(path, ec);
+}
+
+void benchBrrEncode(benchmark::State& state) {
+    const auto sampleCount = static_cast<size_t>(state.range(0));
+    std::vector<int16_t> pcm(sampleCount);
+    uint32_t noise = 0x12345678u;
+    for (size_t i = 0; i < sampleCount; ++i) {
+        noise = noise * 1664525u + 1013904223u;
+        const double tone = std::sin(static_cast<double>(i) * 0.05) * 12000.0;
+        pcm[i] = static_cast<int16_t>(tone + static_cast<double>(static_cast<int16_t>(noise >> 16) / 16));
+    }
+    for (auto _ : state) {
+        auto encoded = nspc::encodePcm16ToBrr(pcm);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(sampleCount));
+}
+
+void registerEntryBenchmarks(const CorpusEntry& entry) {
+    const auto name = [&](std::string_view stage) { return std::format("{}/{}", stage, entry.name); };
+    benchmark::RegisterBenchmark(name("parse").c_str(), benchProjectParse, std::cref(entry))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("flatten").c_str(), benchFlattenSong, std::cref(entry))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("scanEvents").c_str(), benchScanSongEvents, std::cref(entry), false)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(name("scanPacked").c_str(), benchScanSongEvents, std::cref(entry), true)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(name("optimize").c_str(), benchOptimizeSong, std::cref(entry), nspc::NspcOptimizerOptions{})
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("optimizeIncremental").c_str(), benchOptimizeSong, std::cref(entry),
+                                 nspc::NspcOptimizerOptions{.incremental = true})
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("optimizeSerial").c_str(), benchOptimizeSong, std::cref(entry),
+                                 nspc::NspcOptimizerOptions{.maxWorkerThreads = 1})
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("optimizeBestSavings").c_str(), benchOptimizeSong, std::cref(entry),
+                                 nspc::NspcOptimizerOptions{.selectBestRealSavings = true})
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("optimizeSearch").c_str(), benchOptimizeSong, std::cref(entry),
+                                 nspc::NspcOptimizerOptions{.searchBudgetMilliseconds = 2000})
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(1);
+    benchmark::RegisterBenchmark(name("compile").c_str(), benchCompileSong, std::cref(entry))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("compileCached").c_str(), benchCompileCachedSong, std::cref(entry))
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("apply").c_str(), benchApplyUpload, std::cref(entry))->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(name("emulate").c_str(), benchEmulation, std::cref(entry))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("saveJson").c_str(), benchSaveProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Json)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("saveBinary").c_str(), benchSaveProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Binary)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("loadJson").c_str(), benchLoadProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Json, true)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("loadBinary").c_str(), benchLoadProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Binary, true)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("loadJsonEager").c_str(), benchLoadProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Json, false)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("loadBinaryEager").c_str(), benchLoadProjectFile, std::cref(entry),
+                                 nspc::NspcProjectFileFormat::Binary, false)
+        ->Unit(benchmark::kMillisecond);
+}
+
+void printUsage() {
+    std::cout << "ntrak_bench [benchmark flags] [--corpus=<dir>]... [--no-stress]\n"
+                 "  --corpus=<dir>  Also benchmark every .spc/.ntrakproj/.ntrakbin in <dir> (repeatable)\n"
+                 "  --no-stress     Skip the generated stress songs\n"
+                 "For regression tracking, add --benchmark_out=<file>.json --benchmark_out_format=json\n";
+}
+
+}  // namespace
+}  // namespace ntrak::bench
+
+int main(int argc, char** argv) {
+    using namespace ntrak::bench;
+
+    benchmark::Initialize(&argc, argv);
+
+    std::vector<std::filesystem::path> corpusDirs;
+    bool includeStress = true;
+    int remaining = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--corpus=")) {
+            corpusDirs.emplace_back(arg.substr(std::string_view("--corpus=").size()));
+        } else if (arg == "--no-stress") {
+            includeStress = false;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        } else {
+            argv[remaining++] = argv[i];
+        }
+    }
+    argc = remaining;
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> warnings;
+    std::vector<CorpusEntry> corpus;
+    if (includeStress) {
+        corpus = buildStressCorpus(defaultStressShapes(), warnings);
+    }
+    for (const auto& dir : corpusDirs) {
+        auto entries = loadCorpusDirectory(dir, warnings);
+        std::move(entries.begin(), entries.end(), std::back_inserter(corpus));
+    }
+    for (const auto& warning : warnings) {
+        std::cerr << "corpus: " << warning << '\n';
+    }
+
+    std::string corpusNames;
+    for (const auto& entry : corpus) {
+        corpusNames += corpusNames.empty() ? entry.name : "," + entry.name;
+        registerEntryBenchmarks(entry);
+    }
+    benchmark::AddCustomContext("ntrak.corpus", corpusNames);
+    benchmark::RegisterBenchmark("brrEncode", benchBrrEncode)->RangeMultiplier(4)->Range(4096, 65536);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
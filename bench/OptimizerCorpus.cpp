@@ -0,0 +1,408 @@
+#include "BenchCorpus.hpp"
+
+#include "ntrak/nspc/NspcOptimize.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace ntrak::bench {
+namespace {
+
+// Runs every song of the corpus through optimizeSongSubroutines once per preset and records output
+// size against wall time, so optimizer changes can be judged on real songs before they ship.
+
+struct RunnerOptions {
+    std::vector<std::filesystem::path> corpusDirs;
+    bool includeStress = true;
+    std::vector<nspc::NspcOptimizerPreset> presets{nspc::NspcOptimizerPreset::Relaxed,
+                                                   nspc::NspcOptimizerPreset::Balanced,
+                                                   nspc::NspcOptimizerPreset::Aggressive};
+    int repeat = 1;
+    std::optional<std::filesystem::path> csvPath;
+    std::optional<std::filesystem::path> jsonPath;
+    std::optional<std::filesystem::path> baselinePath;
+    double timeTolerancePercent = 25.0;
+    bool failOnRegression = false;
+};
+
+struct SongResult {
+    std::string entry;
+    int songIndex = 0;
+    std::string preset;
+    uint32_t bytesBefore = 0;
+    uint32_t bytesAfter = 0;
+    int subroutines = 0;
+    int iterations = 0;
+    double milliseconds = 0.0;  // fastest of `repeat` runs
+};
+
+using ResultKey = std::tuple<std::string, int, std::string>;
+
+ResultKey keyOf(const SongResult& result) {
+    return {result.entry, result.songIndex, result.preset};
+}
+
+void printUsage() {
+    std::cout << "ntrak_optimizer_corpus [options]\n"
+                 "  --corpus=<dir>          Add every .spc/.ntrakproj in <dir> (repeatable)\n"
+                 "  --no-stress             Skip the generated stress songs\n"
+                 "  --presets=<list>        Comma-separated: relaxed,balanced,aggressive,aggressive+\n"
+                 "                          (default relaxed,balanced,aggressive)\n"
+                 "  --repeat=<n>            Time each run n times and keep the fastest (default 1)\n"
+                 "  --csv=<file>            Write results as CSV\n"
+                 "  --json=<file>           Write results as JSON (usable as a later --baseline)\n"
+                 "  --baseline=<file>       Compare against a JSON file from an earlier run\n"
+                 "  --time-tolerance=<pct>  Slowdown reported as a regression (default 25)\n"
+                 "  --fail-on-regression    Exit with 2 when any song got larger or slower\n";
+}
+
+std::optional<nspc::NspcOptimizerPreset> parsePreset(std::string_view name) {
+    for (size_t i = 0; i < nspc::kNspcOptimizerPresetCount; ++i) {
+        const auto preset = static_cast<nspc::NspcOptimizerPreset>(i);
+        const std::string_view presetName = nspc::optimizerPresetName(preset);
+        if (std::ranges::equal(name, presetName, [](unsigned char a, unsigned char b) {
+                return std::tolower(a) == std::tolower(b);
+            })) {
+            return preset;
+        }
+    }
+    return std::nullopt;
+}
+
+// The whole of `text` as a number, or nothing when it has any other characters or is out of range
+template <typename T>
+std::optional<T> parseNumber(std::string_view text) {
+    T value{};
+    const char* end = text.data() + text.size();
+    const auto [parsedEnd, error] = std::from_chars(text.data(), end, value);
+    if (error != std::errc{} || parsedEnd != end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<RunnerOptions> parseArgs(int argc, char** argv) {
+    RunnerOptions options;
+    const auto valueOf = [](std::string_view arg, std::string_view flag) { return arg.substr(flag.size()); };
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--corpus=")) {
+            options.corpusDirs.emplace_back(valueOf(arg, "--corpus="));
+        } else if (arg == "--no-stress") {
+            options.includeStress = false;
+        } else if (arg.starts_with("--presets=")) {
+            options.presets.clear();
+            std::string_view list = valueOf(arg, "--presets=");
+            while (!list.empty()) {
+                const size_t comma = list.find(',');
+                const std::string_view name = list.substr(0, comma);
+                const auto preset = parsePreset(name);
+                if (!preset.has_value()) {
+                    std::cerr << std::format("Unknown preset '{}'\n", name);
+                    return std::nullopt;
+                }
+                options.presets.push_back(*preset);
+                list = (comma == std::string_view::npos) ? std::string_view{} : list.substr(comma + 1);
+            }
+        } else if (arg.starts_with("--repeat=")) {
+            const auto repeat = parseNumber<int>(valueOf(arg, "--repeat="));
+            if (!repeat.has_value()) {
+                std::cerr << std::format("Invalid --repeat value '{}'\n", valueOf(arg, "--repeat="));
+                return std::nullopt;
+            }
+            options.repeat = std::max(1, *repeat);
+        } else if (arg.starts_with("--csv=")) {
+            options.csvPath = std::filesystem::path(valueOf(arg, "--csv="));
+        } else if (arg.starts_with("--json=")) {
+            options.jsonPath = std::filesystem::path(valueOf(arg, "--json="));
+        } else if (arg.starts_with("--baseline=")) {
+            options.baselinePath = std::filesystem::path(valueOf(arg, "--baseline="));
+        } else if (arg.starts_with("--time-tolerance=")) {
+            const auto tolerance = parseNumber<double>(valueOf(arg, "--time-tolerance="));
+            if (!tolerance.has_value() || *tolerance < 0.0) {
+                std::cerr << std::format("Invalid --time-tolerance value '{}'\n", valueOf(arg, "--time-tolerance="));
+                return std::nullopt;
+            }
+            options.timeTolerancePercent = *tolerance;
+        } else if (arg == "--fail-on-regression") {
+            options.failOnRegression = true;
+        } else {
+            std::cerr << std::format("Unknown argument '{}'\n", arg);
+            return std::nullopt;
+        }
+    }
+    if (options.presets.empty()) {
+        std::cerr << "No presets selected\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+std::vector<SongResult> runCorpus(const std::vector<CorpusEntry>& corpus, const RunnerOptions& options) {
+    std::vector<SongResult> results;
+    for (const auto& entry : corpus) {
+        const auto& songs = entry.project.songs();
+        for (size_t songIndex = 0; songIndex < songs.size(); ++songIndex) {
+            if (songs[songIndex].tracks().empty()) {
+                continue;
+            }
+            for (const auto preset : options.presets) {
+                nspc::NspcOptimizerOptions optimizerOptions{};
+                nspc::applyOptimizerPreset(optimizerOptions, preset);
+
+                SongResult result{
+                    .entry = entry.name,
+                    .songIndex = static_cast<int>(songIndex),
+                    .preset = std::string(nspc::optimizerPresetName(preset)),
+                };
+                for (int run = 0; run < options.repeat; ++run) {
+                    nspc::NspcSong song = songs[songIndex];
+                    const auto start = std::chrono::steady_clock::now();
+                    const nspc::NspcOptimizerStats stats = nspc::optimizeSongSubroutines(song, optimizerOptions);
+                    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                    result.bytesBefore = stats.bytesBefore;
+                    result.bytesAfter = stats.bytesAfter;
+                    result.subroutines = stats.subroutinesCreated;
+                    result.iterations = stats.iterations;
+                    result.milliseconds = (run == 0) ? elapsed.count() : std::min(result.milliseconds, elapsed.count());
+                }
+                std::cerr << std::format("{} song {:02X} {}: {} -> {} bytes in {:.1f} ms\n", result.entry,
+                                         result.songIndex, result.preset, result.bytesBefore, result.bytesAfter,
+                                         result.milliseconds);
+                results.push_back(std::move(result));
+            }
+        }
+    }
+    return results;
+}
+
+// RFC 4180: fields holding a separator, quote or line break are quoted, with quotes doubled
+std::string csvField(std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        return std::string(text);
+    }
+    std::string quoted = "\"";
+    for (const char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string resultsToCsv(const std::vector<SongResult>& results) {
+    std::string out = "entry,song,preset,bytesBefore,bytesAfter,subroutines,iterations,milliseconds\n";
+    for (const auto& result : results) {
+        out += std::format("{},{},{},{},{},{},{},{:.3f}\n", csvField(result.entry), result.songIndex,
+                           csvField(result.preset), result.bytesBefore, result.bytesAfter, result.subroutines,
+                           result.iterations, result.milliseconds);
+    }
+    return out;
+}
+
+json resultsToJson(const std::vector<SongResult>& results) {
+    json songs = json::array();
+    for (const auto& result : results) {
+        songs.push_back(json{
+            {"entry", result.entry},
+            {"song", result.songIndex},
+            {"preset", result.preset},
+            {"bytesBefore", result.bytesBefore},
+            {"bytesAfter", result.bytesAfter},
+            {"subroutines", result.subroutines},
+            {"iterations", result.iterations},
+            {"milliseconds", result.milliseconds},
+        });
+    }
+    return json{{"format", "ntrak_optimizer_corpus"}, {"version", 1}, {"results", std::move(songs)}};
+}
+
+std::optional<std::vector<SongResult>> loadBaseline(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << std::format("Failed to open baseline '{}'\n", path.string());
+        return std::nullopt;
+    }
+    json root;
+    try {
+        in >> root;
+    } catch (const std::exception& ex) {
+        std::cerr << std::format("Failed to parse baseline '{}': {}\n", path.string(), ex.what());
+        return std::nullopt;
+    }
+    if (!root.is_object() || root.value("format", "") != "ntrak_optimizer_corpus" || !root.contains("results") ||
+        !root["results"].is_array()) {
+        std::cerr << std::format("'{}' is not an optimizer corpus result file\n", path.string());
+        return std::nullopt;
+    }
+    std::vector<SongResult> results;
+    for (const auto& value : root["results"]) {
+        results.push_back(SongResult{
+            .entry = value.value("entry", ""),
+            .songIndex = value.value("song", 0),
+            .preset = value.value("preset", ""),
+            .bytesBefore = value.value("bytesBefore", 0u),
+            .bytesAfter = value.value("bytesAfter", 0u),
+            .subroutines = value.value("subroutines", 0),
+            .iterations = value.value("iterations", 0),
+            .milliseconds = value.value("milliseconds", 0.0),
+        });
+    }
+    return results;
+}
+
+// Prints per-song changes and per-preset totals; returns whether anything regressed.
+bool printBaselineDiff(const std::vector<SongResult>& baseline, const std::vector<SongResult>& current,
+                       double timeTolerancePercent) {
+    std::map<ResultKey, const SongResult*> baselineByKey;
+    for (const auto& result : baseline) {
+        baselineByKey[keyOf(result)] = &result;
+    }
+
+    struct PresetTotals {
+        int64_t bytesBaseline = 0;
+        int64_t bytesCurrent = 0;
+        double msBaseline = 0.0;
+        double msCurrent = 0.0;
+        int larger = 0;
+        int smaller = 0;
+        int slower = 0;
+        int compared = 0;
+    };
+    std::map<std::string, PresetTotals> totals;
+    bool regressed = false;
+    int unmatched = 0;
+
+    std::cout << "\nChanges against baseline:\n";
+    for (const auto& result : current) {
+        const auto it = baselineByKey.find(keyOf(result));
+        if (it == baselineByKey.end()) {
+            ++unmatched;
+            continue;
+        }
+        const SongResult& before = *it->second;
+        auto& preset = totals[result.preset];
+        ++preset.compared;
+        preset.bytesBaseline += before.bytesAfter;
+        preset.bytesCurrent += result.bytesAfter;
+        preset.msBaseline += before.milliseconds;
+        preset.msCurrent += result.milliseconds;
+
+        const int64_t byteDelta = static_cast<int64_t>(result.bytesAfter) - static_cast<int64_t>(before.bytesAfter);
+        const bool slower =
+            before.milliseconds > 0.0 && result.milliseconds > before.milliseconds * (1.0 + timeTolerancePercent / 100.0);
+        preset.larger += byteDelta > 0 ? 1 : 0;
+        preset.smaller += byteDelta < 0 ? 1 : 0;
+        preset.slower += slower ? 1 : 0;
+        regressed = regressed || byteDelta > 0 || slower;
+        if (byteDelta != 0 || slower) {
+            std::cout << std::format("  {} song {:02X} {}: {} -> {} bytes ({:+}), {:.1f} -> {:.1f} ms{}\n", result.entry,
+                                     result.songIndex, result.preset, before.bytesAfter, result.bytesAfter, byteDelta,
+                                     before.milliseconds, result.milliseconds, slower ? " SLOWER" : "");
+        }
+    }
+
+    std::cout << "\nSummary per preset:\n";
+    for (const auto& [name, preset] : totals) {
+        const double timeRatio = preset.msBaseline > 0.0 ? preset.msCurrent / preset.msBaseline : 1.0;
+        std::cout << std::format("  {:<12} {} songs, bytes {} -> {} ({:+}), time x{:.2f}, {} smaller, {} larger, "
+                                 "{} slower\n",
+                                 name, preset.compared, preset.bytesBaseline, preset.bytesCurrent,
+                                 preset.bytesCurrent - preset.bytesBaseline, timeRatio, preset.smaller, preset.larger,
+                                 preset.slower);
+    }
+    if (unmatched > 0) {
+        std::cout << std::format("  {} result(s) have no baseline entry\n", unmatched);
+    }
+    return regressed;
+}
+
+bool writeTextFile(const std::filesystem::path& path, std::string_view text) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    if (!out.good()) {
+        std::cerr << std::format("Failed to write '{}'\n", path.string());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+}  // namespace ntrak::bench
+
+int main(int argc, char** argv) {
+    using namespace ntrak::bench;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+    }
+    auto options = parseArgs(argc, argv);
+    if (!options.has_value()) {
+        printUsage();
+        return 1;
+    }
+
+    // Same corpus as ntrak_bench: the stress songs and any --corpus directories.
+    std::vector<std::string> warnings;
+    std::vector<CorpusEntry> corpus;
+    if (options->includeStress) {
+        corpus = buildStressCorpus(defaultStressShapes(), warnings);
+    }
+    for (const auto& dir : options->corpusDirs) {
+        auto entries = loadCorpusDirectory(dir, warnings);
+        std::move(entries.begin(), entries.end(), std::back_inserter(corpus));
+    }
+    for (const auto& warning : warnings) {
+        std::cerr << "corpus: " << warning << '\n';
+    }
+
+    const std::vector<SongResult> results = runCorpus(corpus, *options);
+    const std::string csv = resultsToCsv(results);
+    if (options->csvPath.has_value()) {
+        if (!writeTextFile(*options->csvPath, csv)) {
+            return 1;
+        }
+    } else {
+        std::cout << csv;
+    }
+    if (options->jsonPath.has_value() && !writeTextFile(*options->jsonPath, resultsToJson(results).dump(2))) {
+        return 1;
+    }
+
+    if (options->baselinePath.has_value()) {
+        const auto baseline = loadBaseline(*options->baselinePath);
+        if (!baseline.has_value()) {
+            return 1;
+        }
+        const bool regressed = printBaselineDiff(*baseline, results, options->timeTolerancePercent);
+        if (regressed && options->failOnRegression) {
+            return 2;
+        }
+    }
+    return 0;
+}
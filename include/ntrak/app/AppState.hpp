@@ -1,9 +1,11 @@
 #pragma once
 
 #include "ntrak/audio/SpcPlayer.hpp"
+#include "ntrak/nspc/NspcBuildTelemetry.hpp"
 #include "ntrak/nspc/NspcCommandHistory.hpp"
 #include "ntrak/nspc/NspcOptimize.hpp"
 #include "ntrak/nspc/NspcProject.hpp"
+#include "ntrak/nspc/NspcUsageIndex.hpp"
 
 #include <atomic>
 #include <cstdint>
@@ -35,7 +37,9 @@ struct AppState {
     std::optional<std::filesystem::path> sourceSpcPath;
     bool flattenSubroutinesOnLoad = false;
     bool optimizeSubroutinesOnBuild = false;
+    bool shareSubroutinesAcrossSongsOnBuild = false;
     bool compactAramLayoutOnBuild = true;
+    bool saveOptimizerCacheWithProject = false;
     bool lockEngineContent = true;
     nspc::NspcOptimizerOptions optimizerOptions{
         .maxOptimizeIterations = 64,
@@ -44,6 +48,7 @@ struct AppState {
         .singleIterationCallPenaltyBytes = 8,
         .allowSingleIterationCalls = false,
     };
+    std::optional<nspc::NspcBuildTelemetry> lastBuildTelemetry;
     std::unique_ptr<audio::SpcPlayer> spcPlayer;
     int selectedSongIndex = 0;
     int selectedSequenceRow = -1;
@@ -56,6 +61,10 @@ struct AppState {
     // Undo/redo system
     nspc::NspcCommandHistory commandHistory;
 
+    // Where instruments, subroutines and VCMDs are used. Commands keep it current through commandHistory;
+    // anything that replaces songs outside the history rebuilds it.
+    nspc::NspcUsageIndex usageIndex;
+
     // Playback callbacks (wired by ControlPanel, callable from any panel)
     std::function<bool()> playSong;
     std::function<bool()> playFromPattern;
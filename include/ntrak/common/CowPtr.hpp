@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace ntrak::common {
+
+/// Copy-on-write value holder. Copies share the underlying value; the first call to `mut()` on a
+/// shared holder clones it so writes never leak into other copies.
+///
+/// References returned by `mut()` are only valid until the holder is next copied: keep them local
+/// to the edit and re-fetch after taking a snapshot.
+template <typename T>
+class CowPtr {
+public:
+    CowPtr() : ptr_(std::make_shared<T>()) {}
+    CowPtr(T value) : ptr_(std::make_shared<T>(std::move(value))) {}  // NOLINT(google-explicit-constructor)
+
+    // Moves deliberately fall back to copies so a moved-from holder still owns a value.
+    CowPtr(const CowPtr&) = default;
+    CowPtr& operator=(const CowPtr&) = default;
+
+    CowPtr& operator=(T value) {
+        ptr_ = std::make_shared<T>(std::move(value));
+        return *this;
+    }
+
+    const T& operator*() const { return *ptr_; }
+    const T* operator->() const { return ptr_.get(); }
+
+    /// Mutable access; detaches from other copies first if the value is shared.
+    T& mut() {
+        if (ptr_.use_count() > 1) {
+            ptr_ = std::make_shared<T>(*ptr_);
+        }
+        return *ptr_;
+    }
+
+    /// True when both holders currently point at the same storage.
+    bool sharesWith(const CowPtr& other) const { return ptr_ == other.ptr_; }
+
+private:
+    std::shared_ptr<T> ptr_;
+};
+
+}  // namespace ntrak::common
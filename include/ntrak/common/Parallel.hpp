@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace ntrak::common {
+
+/// Returns the number of worker threads to use for CPU-bound batch work (at least 1).
+size_t hardwareWorkerCount();
+
+/// Runs `body(i)` for every i in [0, count) on up to `maxWorkers` threads (0 = hardwareWorkerCount()).
+/// Work items are claimed dynamically, so `body` must only touch state owned by its index.
+/// Blocks until every item has finished. With one worker (or one item) runs inline on the caller.
+void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxWorkers = 0);
+
+}  // namespace ntrak::common
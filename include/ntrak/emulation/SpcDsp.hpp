@@ -114,6 +114,29 @@ private:
     std::span<uint8_t> mem_;
 };
 
+/// Read-only AramView, e.g. over ARAM shared by several project snapshots
+class ConstAramView {
+public:
+    static constexpr size_t kSize = AramView::kSize;
+
+    constexpr ConstAramView(const uint8_t* ptr, size_t size) : mem_(ptr, size) { assert(size == kSize); }
+    ConstAramView(const AramView& view) : mem_(view.all()) {}
+
+    [[nodiscard]] uint8_t read(uint16_t address) const noexcept { return mem_[address]; }
+
+    [[nodiscard]] uint16_t read16(uint16_t address) const noexcept { return mem_[address] | (mem_[address + 1] << 8); }
+
+    [[nodiscard]] std::span<const uint8_t> bytes(uint16_t start, size_t len) const noexcept {
+        assert(start + len <= kSize);
+        return mem_.subspan(start, len);
+    }
+
+    [[nodiscard]] std::span<const uint8_t> all() const noexcept { return mem_; }
+
+private:
+    std::span<const uint8_t> mem_;
+};
+
 /// @brief Main SPC700 + DSP emulation wrapper
 ///
 /// This class wraps the ares-apu SPC700 + DSP core to provide a clean
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ntrak::nspc {
+
+enum class NspcAramRegionKind : uint8_t {
+    Free,
+    Reserved,
+    SongIndexTable,
+    InstrumentTable,
+    SampleDirectory,
+    SampleData,
+    SequenceData,
+    PatternTable,
+    TrackData,
+    SubroutineData,
+};
+
+struct NspcAramRegion {
+    NspcAramRegionKind kind = NspcAramRegionKind::Free;
+    uint16_t from = 0;  // inclusive
+    uint16_t to = 0;    // exclusive
+    int songId = -1;
+    int objectId = -1;
+    std::string label;
+};
+
+/// A run of bytes with one owner, in address order; neighbouring segments have different owners
+struct NspcAramSegment {
+    uint32_t from = 0;  // inclusive
+    uint32_t to = 0;    // exclusive
+    NspcAramRegionKind kind = NspcAramRegionKind::Free;
+};
+
+struct NspcAramUsage {
+    static constexpr uint32_t kTotalAramBytes = 0x10000;
+
+    uint32_t totalBytes = kTotalAramBytes;
+    uint32_t usedBytes = 0;
+    uint32_t freeBytes = 0;
+
+    uint32_t reservedBytes = 0;
+    uint32_t songIndexBytes = 0;
+    uint32_t instrumentBytes = 0;
+    uint32_t sampleDirectoryBytes = 0;
+    uint32_t sampleDataBytes = 0;
+    uint32_t sequenceBytes = 0;
+    uint32_t patternTableBytes = 0;
+    uint32_t trackBytes = 0;
+    uint32_t subroutineBytes = 0;
+
+    std::vector<NspcAramRegion> regions;  // sorted by address
+    std::vector<NspcAramSegment> segments;
+};
+
+/// ARAM ownership as an interval map, so regions can be added and removed without repainting all 64 KiB.
+/// Regions come in sources (e.g. the engine and asset tables, or one song) that are replaced as a whole. Where
+/// regions overlap, a byte belongs to the region of the lowest source, earliest in that source's list: the
+/// result of painting every region in that order onto free bytes only.
+class NspcAramUsageMap {
+public:
+    NspcAramUsageMap();
+
+    void clear();
+    /// Replaces every region of `source`
+    void setSource(uint32_t source, std::vector<NspcAramRegion> regions);
+    void removeSource(uint32_t source);
+
+    [[nodiscard]] uint32_t bytesOwnedBy(NspcAramRegionKind kind) const {
+        return bytes_[static_cast<size_t>(kind)];
+    }
+    /// Interval map entries; a measure of how fragmented ownership is
+    [[nodiscard]] size_t intervalCount() const { return intervals_.size(); }
+
+    /// Totals, ownership segments and every region sorted by address
+    [[nodiscard]] NspcAramUsage usage() const;
+
+private:
+    // source << 32 | region index << 8 | kind; the lowest id covering a byte owns it
+    using CoverId = uint64_t;
+
+    struct Interval {
+        uint32_t to = 0;
+        std::vector<CoverId> cover;  // sorted
+    };
+
+    static constexpr size_t kKindCount = static_cast<size_t>(NspcAramRegionKind::SubroutineData) + 1;
+
+    static NspcAramRegionKind ownerOf(const Interval& interval);
+    std::map<uint32_t, Interval>::iterator splitAt(uint32_t address);
+    void applyCover(CoverId id, uint32_t from, uint32_t to, bool add);
+    void mergeAround(uint32_t from, uint32_t to);
+
+    std::map<uint32_t, Interval> intervals_;  // keyed by start address, tiling [0, kTotalAramBytes)
+    std::array<uint32_t, kKindCount> bytes_{};
+    std::map<uint32_t, std::vector<NspcAramRegion>> sources_;
+};
+
+}  // namespace ntrak::nspc
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ntrak::nspc {
+
+enum class NspcBuildStage : uint8_t {
+    Flatten,
+    Optimize,
+    Encode,
+    Allocate,
+    Patch,
+    ApplyToImage,
+};
+
+inline constexpr size_t kNspcBuildStageCount = 6;
+
+std::string_view buildStageName(NspcBuildStage stage);
+
+/// Structured numbers collected while compiling. Stage times are summed over every song in the
+/// build, so with parallel song preparation they can exceed `totalMilliseconds` (wall time).
+struct NspcBuildTelemetry {
+    double totalMilliseconds = 0.0;
+    std::array<double, kNspcBuildStageCount> stageMilliseconds{};
+
+    // Emitted bytes per object kind.
+    uint32_t songIndexBytes = 0;
+    uint32_t sequenceBytes = 0;
+    uint32_t patternTableBytes = 0;
+    uint32_t trackBytes = 0;
+    uint32_t subroutineBytes = 0;
+    uint32_t instrumentBytes = 0;
+    uint32_t sampleDirectoryBytes = 0;
+    uint32_t sampleDataBytes = 0;
+    uint32_t extensionPatchBytes = 0;
+
+    // Subroutine optimizer.
+    uint32_t songsOptimized = 0;
+    uint32_t optimizerIterations = 0;
+    uint32_t subroutinesCreated = 0;
+    int64_t optimizerBytesSaved = 0;
+    uint32_t sharedSubroutinesReused = 0;     // subroutine copies pointed at another song's upload
+    uint32_t sharedSubroutineBytesSaved = 0;  // bytes those copies would have taken
+
+    // Allocator free space after the last song was placed.
+    uint32_t freeRangeCount = 0;
+    uint32_t freeBytes = 0;
+    uint32_t largestFreeRangeBytes = 0;
+
+    // Reuse of previously computed build results.
+    uint32_t cacheHits = 0;
+    uint32_t cacheMisses = 0;
+
+    double stageTime(NspcBuildStage stage) const { return stageMilliseconds[static_cast<size_t>(stage)]; }
+    void addStageTime(NspcBuildStage stage, double milliseconds) {
+        stageMilliseconds[static_cast<size_t>(stage)] += milliseconds;
+    }
+
+    uint32_t emittedBytes() const;
+
+    /// 0 when all free ARAM is one contiguous range, approaching 1 as it splinters.
+    double fragmentation() const;
+
+    /// Accumulates times, sizes and counters; allocator fields take `other`'s (later) values.
+    void merge(const NspcBuildTelemetry& other);
+};
+
+std::string buildTelemetryToJson(const NspcBuildTelemetry& telemetry, int indent = 2);
+
+}  // namespace ntrak::nspc
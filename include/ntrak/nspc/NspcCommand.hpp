@@ -2,10 +2,14 @@
 
 #include "ntrak/nspc/NspcData.hpp"
 #include "ntrak/nspc/NspcEditor.hpp"
+#include "ntrak/nspc/NspcPackedEvents.hpp"
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ntrak::nspc {
@@ -24,6 +28,15 @@ public:
     /// Get human-readable description for UI
     [[nodiscard]] virtual std::string description() const = 0;
 
+    /// Approximate bytes held for undo/redo (for the history's memory budget)
+    [[nodiscard]] virtual size_t memoryBytes() const { return sizeof(*this); }
+
+    /// Pack undo data into a smaller form; the next execute/undo unpacks it again
+    virtual void compact() {}
+
+    /// Adds what the last execute or undo changed to `changes`. The default marks the whole song changed.
+    virtual void collectChanges(NspcSongChanges& changes) const { changes.all = true; }
+
 protected:
     NspcCommand() = default;
 };
@@ -40,44 +53,94 @@ public:
     bool execute(NspcSong& song) override;
     bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override { return description_; }
+    [[nodiscard]] size_t memoryBytes() const override;
+    void compact() override;
+    void collectChanges(NspcSongChanges& changes) const override;
 
 private:
     std::string description_;
     std::vector<std::unique_ptr<NspcCommand>> commands_;
 };
 
-/// Base class for single-cell edit commands with state capture
+/// Base class for single-cell edit commands. The first execute runs the edit and records only what it
+/// changed; undo and redo replay that record, restoring the song exactly. A replay is refused, leaving the song
+/// untouched, when the song no longer holds what the record expects (it was restructured outside the history).
 class NspcCellCommand : public NspcCommand {
+public:
+    bool execute(NspcSong& song) final;
+    bool undo(NspcSong& song) final;
+    [[nodiscard]] size_t memoryBytes() const final;
+
+    /// Packs the recorded event lists into one NspcPackedEventList; undo/redo unpack them first
+    void compact() final;
+
+    /// Spliced lists, re-created or added/dropped track slots and the edited pattern's track table
+    void collectChanges(NspcSongChanges& changes) const final;
+
 protected:
-    /// Captured state for a single cell/track
-    struct CellState {
-        // Full tracks snapshot for clean restoration (handles track creation/removal)
-        std::vector<NspcTrack> allTracks;
-
-        // Pattern channel track mapping
-        std::optional<std::array<int, 8>> patternChannelTrackIds;
-
-        // Subroutine data for full restoration (edits may modify subroutine events)
-        struct SubroutineSnapshot {
-            int id = -1;
-            std::vector<NspcEventEntry> events;
-        };
-        std::vector<SubroutineSnapshot> subroutineSnapshots;
-
-        // Content origin flag
-        NspcContentOrigin contentOrigin = NspcContentOrigin::UserProvided;
+    /// Events [start, start + removed.size()) of one track or subroutine replaced by `inserted`
+    struct EventSplice {
+        NspcEventOwner owner = NspcEventOwner::Track;
+        size_t ownerIndex = 0;  // index into song.tracks() or song.subroutines()
+        int ownerIdBefore = -1;
+        int ownerIdAfter = -1;
+        size_t start = 0;
+        std::vector<NspcEventEntry> removed;
+        std::vector<NspcEventEntry> inserted;
     };
 
-    NspcEditorLocation location_;
-    CellState beforeState_;
-    CellState afterState_;
-    bool capturedBefore_ = false;
+    /// A track whose id or address changed without being added or removed (a re-created slot)
+    struct TrackHeaderChange {
+        size_t index = 0;
+        int idBefore = -1;
+        int idAfter = -1;
+        uint16_t addrBefore = 0;
+        uint16_t addrAfter = 0;
+    };
 
-    /// Capture the full state of the track at the current location
-    void captureState(NspcSong& song, CellState& state);
+    /// Everything one edit changed
+    struct CellDelta {
+        std::vector<EventSplice> splices;
+        std::vector<TrackHeaderChange> headerChanges;
 
-    /// Restore the captured state
-    void restoreState(NspcSong& song, const CellState& state);
+        // Tracks past the shorter of the two track lists, stored whole (edits grow the list to create tracks)
+        size_t trackCountBefore = 0;
+        size_t trackCountAfter = 0;
+        std::vector<NspcTrack> droppedTracks;  // tracks [trackCountAfter, trackCountBefore) before the edit
+        std::vector<NspcTrack> addedTracks;    // tracks [trackCountBefore, trackCountAfter) after the edit
+
+        std::optional<std::array<int, 8>> patternChannelTrackIdsBefore;
+        std::optional<std::array<int, 8>> patternChannelTrackIdsAfter;
+        bool patternFound = false;
+
+        NspcContentOrigin contentOriginBefore = NspcContentOrigin::UserProvided;
+        NspcContentOrigin contentOriginAfter = NspcContentOrigin::UserProvided;
+    };
+
+    /// Apply the edit to `song` (first execute only)
+    virtual bool applyEdit(NspcSong& song) = 0;
+
+    NspcEditorLocation location_;
+
+private:
+    static void appendSplice(std::vector<EventSplice>& splices, NspcEventOwner owner, size_t ownerIndex,
+                             std::pair<int, int> ownerIds, const std::vector<NspcEventEntry>& before,
+                             const std::vector<NspcEventEntry>& after);
+    void recordDelta(const NspcSong& before, const NspcSong& after);
+    /// True when `song` is in the state the replay starts from (after the edit to undo, before it to redo)
+    [[nodiscard]] bool canReplay(const NspcSong& song, bool forward) const;
+    bool replay(NspcSong& song, bool forward) const;
+    bool expand();
+
+    template <typename Fn>
+    void forEachEventList(Fn&& fn);
+
+    CellDelta delta_;
+    bool recorded_ = false;
+    bool editResult_ = false;
+    NspcPackedEventList packedEvents_;       // every event list, in forEachEventList order, while compacted
+    std::vector<uint32_t> packedListSizes_;
+    bool compacted_ = false;
 };
 
 /// Command for setting a row event (note, tie, rest, percussion)
@@ -85,10 +148,11 @@ class SetRowEventCommand final : public NspcCellCommand {
 public:
     SetRowEventCommand(const NspcEditorLocation& location, const NspcRowEvent& event);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
 
+protected:
+    bool applyEdit(NspcSong& song) override;
+
 private:
     NspcRowEvent event_;
 };
@@ -98,9 +162,10 @@ class DeleteRowEventCommand final : public NspcCellCommand {
 public:
     explicit DeleteRowEventCommand(const NspcEditorLocation& location);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
+
+protected:
+    bool applyEdit(NspcSong& song) override;
 };
 
 /// Command for inserting one tick at a row (shift later events down)
@@ -108,9 +173,10 @@ class InsertTickCommand final : public NspcCellCommand {
 public:
     explicit InsertTickCommand(const NspcEditorLocation& location);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
+
+protected:
+    bool applyEdit(NspcSong& song) override;
 };
 
 /// Command for removing one tick at a row (shift later events up)
@@ -118,9 +184,10 @@ class RemoveTickCommand final : public NspcCellCommand {
 public:
     explicit RemoveTickCommand(const NspcEditorLocation& location);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
+
+protected:
+    bool applyEdit(NspcSong& song) override;
 };
 
 /// Command for setting instrument at a row
@@ -128,10 +195,11 @@ class SetInstrumentCommand final : public NspcCellCommand {
 public:
     SetInstrumentCommand(const NspcEditorLocation& location, std::optional<uint8_t> instrument);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
 
+protected:
+    bool applyEdit(NspcSong& song) override;
+
 private:
     std::optional<uint8_t> instrument_;
 };
@@ -141,10 +209,11 @@ class SetVolumeCommand final : public NspcCellCommand {
 public:
     SetVolumeCommand(const NspcEditorLocation& location, std::optional<uint8_t> volume);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
 
+protected:
+    bool applyEdit(NspcSong& song) override;
+
 private:
     std::optional<uint8_t> volume_;
 };
@@ -154,10 +223,11 @@ class SetQvCommand final : public NspcCellCommand {
 public:
     SetQvCommand(const NspcEditorLocation& location, std::optional<uint8_t> qv);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
 
+protected:
+    bool applyEdit(NspcSong& song) override;
+
 private:
     std::optional<uint8_t> qv_;
 };
@@ -168,13 +238,50 @@ public:
     SetEffectsCommand(const NspcEditorLocation& location, std::vector<Vcmd> effects,
                       bool preserveSubroutineCalls = true);
 
-    bool execute(NspcSong& song) override;
-    bool undo(NspcSong& song) override;
     [[nodiscard]] std::string description() const override;
 
+protected:
+    bool applyEdit(NspcSong& song) override;
+
 private:
     std::vector<Vcmd> effects_;
     bool preserveSubroutineCalls_ = true;
 };
 
+/// Command applying a block of cell edits (a paste, a cleared selection) as one undo step. Every edit must
+/// target the first edit's pattern; edits for any other pattern are dropped. The edits run one at a time through
+/// an NspcEditSession.
+class CellEditsCommand final : public NspcCellCommand {
+public:
+    CellEditsCommand(std::string description, std::vector<NspcCellEdit> edits);
+
+    [[nodiscard]] std::string description() const override { return description_; }
+
+protected:
+    bool applyEdit(NspcSong& song) override;
+
+private:
+    std::string description_;
+    std::vector<NspcCellEdit> edits_;  // released after the first execute; undo/redo replay the delta
+};
+
+/// Command applying an event transform (transpose, instrument remap, volume scale) to a selection or the whole
+/// song as one undo step
+class TransformEventsCommand final : public NspcCellCommand {
+public:
+    TransformEventsCommand(std::string description, NspcEventSelection selection, NspcEventTransform transform,
+                           bool parallel = false);
+
+    [[nodiscard]] std::string description() const override { return description_; }
+
+protected:
+    bool applyEdit(NspcSong& song) override;
+
+private:
+    std::string description_;
+    NspcEventSelection selection_;  // selection and transform are released after the first execute
+    NspcEventTransform transform_;
+    bool parallel_ = false;
+};
+
 }  // namespace ntrak::nspc
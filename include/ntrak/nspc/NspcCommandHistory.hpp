@@ -3,16 +3,24 @@
 #include "ntrak/nspc/NspcCommand.hpp"
 #include "ntrak/nspc/NspcData.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ntrak::nspc {
 
-/// Manages undo/redo history for commands
+/// Manages undo/redo history for commands. Depth is bounded only by a byte budget: commands more than
+/// kUncompactedCommands steps from the current position are compacted, and the oldest are dropped once the
+/// history holds more than maxHistoryBytes().
 class NspcCommandHistory {
 public:
+    static constexpr size_t kDefaultMaxHistoryBytes = 64u * 1024u * 1024u;
+    static constexpr size_t kUncompactedCommands = 8;
+
     NspcCommandHistory();
 
     /// Execute and record a command
@@ -37,20 +45,38 @@ public:
     void clear();
 
     /// Configuration
-    void setMaxHistorySize(size_t size) { maxHistorySize_ = size; }
-    [[nodiscard]] size_t maxHistorySize() const { return maxHistorySize_; }
+    void setMaxHistoryBytes(size_t bytes);
+    [[nodiscard]] size_t maxHistoryBytes() const { return maxHistoryBytes_; }
 
     /// Stats for debugging/UI
     [[nodiscard]] size_t undoStackSize() const { return currentIndex_; }
     [[nodiscard]] size_t redoStackSize() const;
+    [[nodiscard]] size_t historyBytes() const { return historyBytes_; }
+
+    /// Changes every time a command is executed, undone or redone, or the history is cleared, so views can
+    /// skip recomputing anything derived from the song while it stays the same.
+    [[nodiscard]] uint64_t revision() const { return revision_; }
+
+    /// Called after every execute, undo and redo with the song (already stamped, see NspcSong::touch) and
+    /// what the command changed. Changes made outside the history (loading, song add/remove) are not reported.
+    using ChangeListener = std::function<void(const NspcSong&, const NspcSongChanges&)>;
+    size_t subscribe(ChangeListener listener);
+    void unsubscribe(size_t subscription);
 
 private:
     void trimHistory();
     void clearRedoStack();
+    void compactDistantCommands();
+    void compactCommand(size_t index);
+    void publishChanges(NspcSong& song, const NspcCommand& command);
 
     std::vector<std::unique_ptr<NspcCommand>> history_;
     size_t currentIndex_ = 0;  // Points to next undo position
-    size_t maxHistorySize_ = 100;
+    size_t maxHistoryBytes_ = kDefaultMaxHistoryBytes;
+    size_t historyBytes_ = 0;
+    uint64_t revision_ = 0;
+    std::vector<std::pair<size_t, ChangeListener>> listeners_;
+    size_t nextSubscription_ = 1;
 
     // For grouping commands
     std::unique_ptr<NspcCommandGroup> currentGroup_;
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "ntrak/nspc/NspcBuildTelemetry.hpp"
 #include "ntrak/nspc/NspcProject.hpp"
 #include "ntrak/nspc/NspcOptimize.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <expected>
 #include <span>
@@ -20,6 +22,8 @@ struct NspcUploadChunk {
 
 struct NspcUploadList {
     std::vector<NspcUploadChunk> chunks;
+    /// Timings and sizes for the build that produced these chunks.
+    NspcBuildTelemetry telemetry;
 };
 
 struct NspcCompileOutput {
@@ -33,6 +37,15 @@ struct NspcBuildOptions {
     bool applyOptimizedSongToProject = false;
     bool includeEngineExtensions = true;
     bool compactAramLayout = true;
+    /// With optimizeSubroutines, optimize all user songs of a multi-song build together so phrases shared
+    /// between songs become one subroutine, uploaded once and called from every song that uses it.
+    bool shareSubroutinesAcrossSongs = false;
+    /// Reuse the project's optimizer cache for songs optimized before with the same options, and
+    /// remember new results there.
+    bool useOptimizerCache = true;
+    /// Upper bound on threads used for multi-song builds (0 = one per hardware thread).
+    /// Output is identical for every value.
+    size_t maxWorkerThreads = 0;
 };
 
 struct NspcRoundTripReport {
@@ -60,7 +73,10 @@ std::expected<std::vector<uint8_t>, std::string> encodeEventStreamForEngine(
     const std::vector<NspcEventEntry>& events, const std::unordered_map<int, uint16_t>& subroutineAddrById,
     std::vector<std::string>& warnings, const NspcEngineConfig& engine);
 
+/// Writes upload chunks into a copy of an SPC file. When `telemetry` is given, the time spent is
+/// added to its ApplyToImage stage.
 std::expected<std::vector<uint8_t>, std::string> applyUploadToSpcImage(const NspcUploadList& upload,
-                                                                       std::span<const uint8_t> baseSpcFile);
+                                                                       std::span<const uint8_t> baseSpcFile,
+                                                                       NspcBuildTelemetry* telemetry = nullptr);
 
 }  // namespace ntrak::nspc
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ntrak/nspc/NspcProject.hpp"
+#include "ntrak/nspc/NspcUsageIndex.hpp"
 
 #include <map>
 #include <string>
@@ -49,6 +50,9 @@ struct SongPortResult {
 /// Returns sorted unique instrument IDs (VcmdInst.instrumentIndex values) used in the song.
 std::vector<int> findUsedInstrumentIds(const NspcProject& project, int songIndex);
 
+/// Same, answered from a usage index that covers the song instead of rescanning its events.
+std::vector<int> findUsedInstrumentIds(const NspcProject& project, int songIndex, const NspcUsageIndex& index);
+
 /// Build default mappings: Copy all used instruments, appended after target's existing max id.
 std::vector<InstrumentMapping> buildDefaultMappings(const NspcProject& source, const NspcProject& target,
                                                     int sourceSongIndex);
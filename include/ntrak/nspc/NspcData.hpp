@@ -1,11 +1,17 @@
 #pragma once
 
+#include "ntrak/common/CowPtr.hpp"
 #include "ntrak/emulation/SpcDsp.hpp"
 #include "ntrak/nspc/NspcEngine.hpp"
 
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -25,6 +31,7 @@ struct Duration {
     uint8_t ticks;
     std::optional<uint8_t> quantization;
     std::optional<uint8_t> velocity;
+    bool operator==(const Duration&) const = default;
 };
 
 // VCMDS
@@ -32,12 +39,14 @@ struct VcmdInst {
     static constexpr std::string_view name = "Ins";
     static constexpr uint8_t id = 0xE0;
     uint8_t instrumentIndex;
+    bool operator==(const VcmdInst&) const = default;
 };
 
 struct VcmdPanning {
     static constexpr std::string_view name = "Pan";
     static constexpr uint8_t id = 0xE1;
     uint8_t panning;
+    bool operator==(const VcmdPanning&) const = default;
 };
 
 struct VcmdPanFade {
@@ -45,6 +54,7 @@ struct VcmdPanFade {
     static constexpr uint8_t id = 0xE2;
     uint8_t time;
     uint8_t target;
+    bool operator==(const VcmdPanFade&) const = default;
 };
 
 struct VcmdVibratoOn {
@@ -53,17 +63,20 @@ struct VcmdVibratoOn {
     uint8_t delay;
     uint8_t rate;
     uint8_t depth;
+    bool operator==(const VcmdVibratoOn&) const = default;
 };
 
 struct VcmdVibratoOff {
     static constexpr std::string_view name = "VOf";
     static constexpr uint8_t id = 0xE4;
+    bool operator==(const VcmdVibratoOff&) const = default;
 };
 
 struct VcmdGlobalVolume {
     static constexpr std::string_view name = "GVl";
     static constexpr uint8_t id = 0xE5;
     uint8_t volume;
+    bool operator==(const VcmdGlobalVolume&) const = default;
 };
 
 struct VcmdGlobalVolumeFade {
@@ -71,12 +84,14 @@ struct VcmdGlobalVolumeFade {
     static constexpr uint8_t id = 0xE6;
     uint8_t time;
     uint8_t target;
+    bool operator==(const VcmdGlobalVolumeFade&) const = default;
 };
 
 struct VcmdTempo {
     static constexpr std::string_view name = "Tmp";
     static constexpr uint8_t id = 0xE7;
     uint8_t tempo;
+    bool operator==(const VcmdTempo&) const = default;
 };
 
 struct VcmdTempoFade {
@@ -84,18 +99,21 @@ struct VcmdTempoFade {
     static constexpr uint8_t id = 0xE8;
     uint8_t time;
     uint8_t target;
+    bool operator==(const VcmdTempoFade&) const = default;
 };
 
 struct VcmdGlobalTranspose {
     static constexpr std::string_view name = "GTr";
     static constexpr uint8_t id = 0xE9;
     int8_t semitones;
+    bool operator==(const VcmdGlobalTranspose&) const = default;
 };
 
 struct VcmdPerVoiceTranspose {
     static constexpr std::string_view name = "PTr";
     static constexpr uint8_t id = 0xEA;
     int8_t semitones;
+    bool operator==(const VcmdPerVoiceTranspose&) const = default;
 };
 
 struct VcmdTremoloOn {
@@ -104,17 +122,20 @@ struct VcmdTremoloOn {
     uint8_t delay;
     uint8_t rate;
     uint8_t depth;
+    bool operator==(const VcmdTremoloOn&) const = default;
 };
 
 struct VcmdTremoloOff {
     static constexpr std::string_view name = "TOf";
     static constexpr uint8_t id = 0xEC;
+    bool operator==(const VcmdTremoloOff&) const = default;
 };
 
 struct VcmdVolume {
     static constexpr std::string_view name = "Vol";
     static constexpr uint8_t id = 0xED;
     uint8_t volume;
+    bool operator==(const VcmdVolume&) const = default;
 };
 
 struct VcmdVolumeFade {
@@ -122,6 +143,7 @@ struct VcmdVolumeFade {
     static constexpr uint8_t id = 0xEE;
     uint8_t time;
     uint8_t target;
+    bool operator==(const VcmdVolumeFade&) const = default;
 };
 
 struct VcmdSubroutineCall {
@@ -130,12 +152,14 @@ struct VcmdSubroutineCall {
     int subroutineId;
     uint16_t originalAddr;
     uint8_t count;
+    bool operator==(const VcmdSubroutineCall&) const = default;
 };
 
 struct VcmdVibratoFadeIn {
     static constexpr std::string_view name = "Vfi";
     static constexpr uint8_t id = 0xF0;
     uint8_t time;
+    bool operator==(const VcmdVibratoFadeIn&) const = default;
 };
 
 struct VcmdPitchEnvelopeTo {
@@ -144,6 +168,7 @@ struct VcmdPitchEnvelopeTo {
     uint8_t delay;
     uint8_t length;
     uint8_t semitone;
+    bool operator==(const VcmdPitchEnvelopeTo&) const = default;
 };
 
 struct VcmdPitchEnvelopeFrom {
@@ -152,17 +177,20 @@ struct VcmdPitchEnvelopeFrom {
     uint8_t delay;
     uint8_t length;
     uint8_t semitone;
+    bool operator==(const VcmdPitchEnvelopeFrom&) const = default;
 };
 
 struct VcmdPitchEnvelopeOff {
     static constexpr std::string_view name = "PEo";
     static constexpr uint8_t id = 0xF3;
+    bool operator==(const VcmdPitchEnvelopeOff&) const = default;
 };
 
 struct VcmdFineTune {
     static constexpr std::string_view name = "FTn";
     static constexpr uint8_t id = 0xF4;
     int8_t semitones;
+    bool operator==(const VcmdFineTune&) const = default;
 };
 
 struct VcmdEchoOn {
@@ -171,11 +199,13 @@ struct VcmdEchoOn {
     uint8_t channels;
     uint8_t left;
     uint8_t right;
+    bool operator==(const VcmdEchoOn&) const = default;
 };
 
 struct VcmdEchoOff {
     static constexpr std::string_view name = "EOf";
     static constexpr uint8_t id = 0xF6;
+    bool operator==(const VcmdEchoOff&) const = default;
 };
 
 struct VcmdEchoParams {
@@ -184,6 +214,7 @@ struct VcmdEchoParams {
     uint8_t delay;
     uint8_t feedback;
     uint8_t firIndex;
+    bool operator==(const VcmdEchoParams&) const = default;
 };
 
 struct VcmdEchoVolumeFade {
@@ -192,6 +223,7 @@ struct VcmdEchoVolumeFade {
     uint8_t time;
     uint8_t leftTarget;
     uint8_t rightTarget;
+    bool operator==(const VcmdEchoVolumeFade&) const = default;
 };
 
 struct VcmdPitchSlideToNote {
@@ -200,38 +232,45 @@ struct VcmdPitchSlideToNote {
     uint8_t delay;
     uint8_t length;
     uint8_t note;
+    bool operator==(const VcmdPitchSlideToNote&) const = default;
 };
 
 struct VcmdPercussionBaseInstrument {
     static constexpr std::string_view name = "PIn";
     static constexpr uint8_t id = 0xFA;
     uint8_t index;
+    bool operator==(const VcmdPercussionBaseInstrument&) const = default;
 };
 
 struct VcmdNOP {
     static constexpr std::string_view name = "NOP";
     static constexpr uint8_t id = 0xFB;
     uint16_t nopBytes;
+    bool operator==(const VcmdNOP&) const = default;
 };
 
 struct VcmdMuteChannel {
     static constexpr std::string_view name = "MCh";
     static constexpr uint8_t id = 0xFC;
+    bool operator==(const VcmdMuteChannel&) const = default;
 };
 
 struct VcmdFastForwardOn {
     static constexpr std::string_view name = "FFo";
     static constexpr uint8_t id = 0xFD;
+    bool operator==(const VcmdFastForwardOn&) const = default;
 };
 
 struct VcmdFastForwardOff {
     static constexpr std::string_view name = "FFf";
     static constexpr uint8_t id = 0xFE;
+    bool operator==(const VcmdFastForwardOff&) const = default;
 };
 
 struct VcmdUnused {
     static constexpr std::string_view name = "Unu";
     static constexpr uint8_t id = 0xFF;
+    bool operator==(const VcmdUnused&) const = default;
 };
 
 struct VcmdExtension {
@@ -239,6 +278,7 @@ struct VcmdExtension {
     uint8_t id = 0;
     std::array<uint8_t, 4> params{};
     uint8_t paramCount = 0;
+    bool operator==(const VcmdExtension&) const = default;
 };
 
 struct Vcmd {
@@ -249,13 +289,14 @@ struct Vcmd {
                  VcmdEchoOff, VcmdEchoParams, VcmdEchoVolumeFade, VcmdPitchSlideToNote, VcmdPercussionBaseInstrument,
                  VcmdNOP, VcmdMuteChannel, VcmdFastForwardOn, VcmdFastForwardOff, VcmdUnused, VcmdExtension>
         vcmd;
+    bool operator==(const Vcmd&) const = default;
 };
 
 /// Returns the number of parameter bytes for a vcmd command (0xE0-0xFF).
 uint8_t vcmdParamByteCount(uint8_t cmd);
 
 /// Constructs a Vcmd from a raw command ID and parameter bytes.
-/// Returns nullopt for unrecognized or non-constructable IDs (E0, ED, EF, FB).
+/// Returns nullopt for unrecognized or non-constructable IDs (E0, ED, EF, FB, FF).
 std::optional<Vcmd> constructVcmd(uint8_t id, const uint8_t* params);
 std::optional<Vcmd> constructVcmdForEngine(uint8_t id, const uint8_t* params, const NspcEngineConfig& engine);
 
@@ -264,17 +305,26 @@ const char* vcmdNameForId(uint8_t id);
 
 struct Note {
     uint8_t pitch;
+    bool operator==(const Note&) const = default;
+};
+struct Tie {
+    bool operator==(const Tie&) const = default;
+};
+struct Rest {
+    bool operator==(const Rest&) const = default;
 };
-struct Tie {};
-struct Rest {};
 struct Percussion {
     uint8_t index;
+    bool operator==(const Percussion&) const = default;
 };
 struct Subroutine {
     int id;
     uint16_t originalAddr;
+    bool operator==(const Subroutine&) const = default;
+};
+struct End {
+    bool operator==(const End&) const = default;
 };
-struct End {};
 using NspcEvent = std::variant<std::monostate, Duration, Vcmd, Note, Tie, Rest, Percussion, Subroutine, End>;
 
 using NspcEventId = uint64_t;
@@ -291,10 +341,31 @@ struct NspcEventRef {
     NspcEventId eventId = 0;
 };
 
+/// A track or subroutine by its position in song.tracks() / song.subroutines()
+struct NspcEventOwnerSlot {
+    NspcEventOwner owner = NspcEventOwner::Track;
+    size_t index = 0;
+    bool operator==(const NspcEventOwnerSlot&) const = default;
+};
+
+/// Edit stamp: a value from one process-wide counter, taken whenever the stamped data changes. Equal stamps mean
+/// equal content, also across copies of a song, so derived data can be cached against them.
+using NspcRevision = uint64_t;
+NspcRevision newNspcRevision();
+
+/// What one edit changed in a song
+struct NspcSongChanges {
+    bool all = false;  // the editor could not tell; treat everything as changed
+    bool sequence = false;
+    std::vector<int> patternIds;
+    std::vector<NspcEventOwnerSlot> owners;
+};
+
 struct NspcEventEntry {
     NspcEventId id = 0;
     NspcEvent event{};
     std::optional<uint16_t> originalAddr;  // Informational parse-time source address
+    bool operator==(const NspcEventEntry&) const = default;
 };
 
 struct NspcSubroutine {
@@ -366,40 +437,140 @@ struct NspcInstrument {
     NspcContentOrigin contentOrigin = NspcContentOrigin::EngineProvided;
 };
 
+/// Bytes the events take in N-SPC form. Subroutine entries of a flattened view are annotations and count nothing.
+uint32_t encodedEventBytes(const std::vector<NspcEventEntry>& events);
+
+/// Id, address and encodedEventBytes of a track or subroutine
+struct NspcEventListOutline {
+    int id = -1;
+    uint16_t originalAddr = 0;
+    uint32_t encodedBytes = 0;
+};
+
+/// Where a song's tracks and subroutines sit and how large they are, without their events
+struct NspcSongOutline {
+    std::vector<NspcEventListOutline> tracks;
+    std::vector<NspcEventListOutline> subroutines;
+};
+
+/// Encoded events of a track or subroutine that could not be decoded, kept exactly as loaded
+struct NspcUndecodedEvents {
+    NspcEventOwner owner = NspcEventOwner::Track;
+    int id = -1;
+    std::vector<uint8_t> packed;
+    std::optional<uint32_t> encodedBytes;  // from the outline, when it was stored
+};
+
+/// Tracks and subroutines of a song, as produced by a deferred decode
+struct NspcSongBody {
+    common::CowPtr<std::vector<NspcTrack>> tracks;
+    common::CowPtr<std::vector<NspcSubroutine>> subroutines;
+    /// Set when some encoded events could not be decoded; those lists hold no events and keep their bytes in
+    /// `undecoded`
+    std::string error;
+    std::vector<NspcUndecodedEvents> undecoded;
+};
+
+/// A song body kept encoded until first needed. It is decoded once, by whichever thread asks first (others
+/// wait for that result), and shared by every copy of the song it was loaded into.
+class NspcDeferredSongBody {
+public:
+    using Decoder = std::function<NspcSongBody()>;
+
+    /// `outline`, when known up front (e.g. stored in the project file), answers NspcSong::outline() without
+    /// decoding
+    explicit NspcDeferredSongBody(Decoder decoder, std::optional<NspcSongOutline> outline = std::nullopt)
+        : decoder_(std::move(decoder)), outline_(std::move(outline)) {}
+    NspcDeferredSongBody(const NspcDeferredSongBody&) = delete;
+    NspcDeferredSongBody& operator=(const NspcDeferredSongBody&) = delete;
+
+    const NspcSongBody& get();
+    /// Starts decoding on a worker thread, unless already decoded or started
+    void prefetch();
+    [[nodiscard]] bool isDecoded() const { return decoded_.load(std::memory_order_acquire); }
+    [[nodiscard]] const std::optional<NspcSongOutline>& outline() const { return outline_; }
+
+private:
+    std::once_flag once_;
+    Decoder decoder_;
+    std::optional<NspcSongOutline> outline_;
+    NspcSongBody body_;
+    std::atomic<bool> decoded_ = false;
+    std::mutex prefetchMutex_;
+    std::future<void> prefetch_;  // declared last: waits for the worker before the body is destroyed
+};
+
 class NspcSong {
 public:
     /// Default constructor for testing purposes
     NspcSong() = default;
 
-    NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int songIndex);
+    NspcSong(emulation::ConstAramView aram, const NspcEngineConfig& config, int songIndex);
     static NspcSong createEmpty(int songId);
 
-    const std::vector<NspcSequenceOp>& sequence() const { return sequence_; }
+    const std::vector<NspcSequenceOp>& sequence() const { return *sequence_; }
+
+    std::vector<NspcSequenceOp>& sequence() { return sequence_.mut(); }
 
-    std::vector<NspcSequenceOp>& sequence() { return sequence_; }
+    const std::vector<NspcPattern>& patterns() const { return *patterns_; }
 
-    const std::vector<NspcPattern>& patterns() const { return patterns_; }
+    std::vector<NspcPattern>& patterns() { return patterns_.mut(); }
 
-    std::vector<NspcPattern>& patterns() { return patterns_; }
+    const std::vector<NspcTrack>& tracks() const {
+        return deferredBody_ != nullptr ? *deferredBody_->get().tracks : *tracks_;
+    }
 
-    const std::vector<NspcTrack>& tracks() const { return tracks_; }
+    std::vector<NspcTrack>& tracks() {
+        adoptDeferredBody();
+        return tracks_.mut();
+    }
 
-    std::vector<NspcTrack>& tracks() { return tracks_; }
+    const std::vector<NspcSubroutine>& subroutines() const {
+        return deferredBody_ != nullptr ? *deferredBody_->get().subroutines : *subroutines_;
+    }
 
-    const std::vector<NspcSubroutine>& subroutines() const { return subroutines_; }
+    std::vector<NspcSubroutine>& subroutines() {
+        adoptDeferredBody();
+        return subroutines_.mut();
+    }
 
-    std::vector<NspcSubroutine>& subroutines() { return subroutines_; }
+    /// Replaces the tracks and subroutines with `body`, decoded on first access to either. Const access
+    /// reads the shared body; mutable access takes it over first.
+    void deferBody(std::shared_ptr<NspcDeferredSongBody> body) { deferredBody_ = std::move(body); }
+    /// The deferred body until mutable access takes it over, or null; e.g. to prefetch it
+    [[nodiscard]] const std::shared_ptr<NspcDeferredSongBody>& deferredBody() const { return deferredBody_; }
+    /// Taken from the deferred body's outline while it has not been decoded
+    [[nodiscard]] NspcSongOutline outline() const;
+    /// Why some events could not be decoded, or empty; also empty while a deferred body is still encoded
+    [[nodiscard]] const std::string& eventsError() const;
+    /// Lists whose events could not be decoded, as loaded. A save writes these bytes back for any such list that
+    /// still has no events, so a failed decode never replaces the file's data with empty lists.
+    [[nodiscard]] const std::vector<NspcUndecodedEvents>& undecodedEvents() const;
 
     std::optional<int> loopPatternIndex() const { return loopPatternIndex_; }
 
     int songId() const { return songId_; }
-    void setSongId(int songId) { songId_ = songId; }
+    void setSongId(int songId) {
+        songId_ = songId;
+        touchMetadata();
+    }
     const std::string& songName() const { return songName_; }
-    void setSongName(std::string songName) { songName_ = std::move(songName); }
+    void setSongName(std::string songName) {
+        songName_ = std::move(songName);
+        touchMetadata();
+    }
     const std::string& author() const { return author_; }
-    void setAuthor(std::string author) { author_ = std::move(author); }
+    void setAuthor(std::string author) {
+        author_ = std::move(author);
+        touchMetadata();
+    }
     NspcContentOrigin contentOrigin() const { return contentOrigin_; }
-    void setContentOrigin(NspcContentOrigin contentOrigin) { contentOrigin_ = contentOrigin; }
+    void setContentOrigin(NspcContentOrigin contentOrigin) {
+        if (contentOrigin_ != contentOrigin) {
+            contentOrigin_ = contentOrigin;
+            touchMetadata();
+        }
+    }
     bool isUserProvided() const { return contentOrigin_ == NspcContentOrigin::UserProvided; }
     bool isEngineProvided() const { return contentOrigin_ == NspcContentOrigin::EngineProvided; }
 
@@ -413,13 +584,57 @@ public:
     /// when all calls have been resolved.
     void flattenSubroutines();
 
+    /// Edit stamps (see NspcRevision). NspcCommandHistory stamps what each command changed and the song's own
+    /// mutators stamp themselves; code that edits the containers directly calls one of the touch functions.
+    /// Per-item stamps are at least the stamp of the last change to their whole collection.
+    NspcRevision revision() const;
+    NspcRevision sequenceRevision() const { return revisions_->sequence; }
+    NspcRevision patternsRevision() const { return revisions_->patterns.latest; }
+    NspcRevision patternRevision(int patternId) const { return revisions_->patterns.of(patternId); }
+    NspcRevision tracksRevision() const { return revisions_->tracks.latest; }
+    NspcRevision trackRevision(int trackId) const { return revisions_->tracks.of(trackId); }
+    NspcRevision subroutinesRevision() const { return revisions_->subroutines.latest; }
+    NspcRevision subroutineRevision(int subroutineId) const { return revisions_->subroutines.of(subroutineId); }
+    /// Newest stamp of anything a flattened pattern is built from: its track table, its channel tracks and the
+    /// subroutines they may call
+    NspcRevision patternContentRevision(int patternId) const;
+
+    void touch(const NspcSongChanges& changes);
+    void touchAll();
+    void touchSequence();
+    void touchPattern(int patternId);
+    void touchTrack(int trackId);
+    void touchSubroutine(int subroutineId);
+
 private:
-    void parsePattern(emulation::AramView aram, uint16_t patternAddr, int patternIndex);
-    void parseTrack(emulation::AramView aram, uint16_t trackAddr, int trackIndex,
+    // Stamps of one collection: items without their own entry changed last at `base`
+    struct RevisionStamps {
+        NspcRevision base = 0;
+        NspcRevision latest = 0;
+        std::unordered_map<int, NspcRevision> items;
+
+        NspcRevision of(int id) const;
+        void touchAll(NspcRevision revision);
+        void touch(int id, NspcRevision revision);
+    };
+
+    struct Revisions {
+        NspcRevision metadata = newNspcRevision();
+        NspcRevision sequence = metadata;
+        RevisionStamps patterns{.base = metadata, .latest = metadata, .items = {}};
+        RevisionStamps tracks{.base = metadata, .latest = metadata, .items = {}};
+        RevisionStamps subroutines{.base = metadata, .latest = metadata, .items = {}};
+    };
+
+    void touchMetadata();
+    void adoptDeferredBody();
+
+    void parsePattern(emulation::ConstAramView aram, uint16_t patternAddr, int patternIndex);
+    void parseTrack(emulation::ConstAramView aram, uint16_t trackAddr, int trackIndex,
                     std::optional<uint16_t> hardStopExclusive = std::nullopt);
-    std::vector<NspcEventEntry> parseEvents(emulation::AramView aram, uint16_t startAddr, uint16_t& endAddr,
+    std::vector<NspcEventEntry> parseEvents(emulation::ConstAramView aram, uint16_t startAddr, uint16_t& endAddr,
                                             std::optional<uint16_t> hardStopExclusive = std::nullopt);
-    Vcmd parseVcmd(emulation::AramView aram, uint16_t& addr);
+    Vcmd parseVcmd(emulation::ConstAramView aram, uint16_t& addr);
 
     int songId_ = 0;
     std::string songName_;
@@ -427,23 +642,32 @@ private:
     NspcCommandMap commandMap_{};
     std::unordered_map<uint8_t, uint8_t> extensionParamCountById_;
 
-    std::vector<NspcTrack> tracks_;
+    // Bulk song data is copy-on-write: copying a song shares it until one side is edited.
+    common::CowPtr<std::vector<NspcTrack>> tracks_;
     int nextTrackId_ = 0;
 
-    std::vector<NspcSubroutine> subroutines_;
+    common::CowPtr<std::vector<NspcSubroutine>> subroutines_;
     int nextSubroutineId_ = 0;
 
-    std::vector<NspcPattern> patterns_;
+    common::CowPtr<std::vector<NspcPattern>> patterns_;
     int nextPatternId_ = 0;
 
     std::optional<int> loopPatternIndex_;
 
-    std::vector<NspcSequenceOp> sequence_;
+    common::CowPtr<std::vector<NspcSequenceOp>> sequence_;
+
+    // While set, stands in for tracks_ and subroutines_
+    std::shared_ptr<NspcDeferredSongBody> deferredBody_;
+    // Carried over from a deferred body that failed to decode
+    std::string eventsError_;
+    std::shared_ptr<const std::vector<NspcUndecodedEvents>> undecodedEvents_;
 
     std::unordered_map<uint16_t, int> trackAddrToIndex_;
     std::unordered_map<uint16_t, int> subroutineAddrToIndex_;
     NspcEventId nextEventId_ = 1;
     NspcContentOrigin contentOrigin_ = NspcContentOrigin::EngineProvided;
+
+    common::CowPtr<Revisions> revisions_;
 };
 
 template <class... Ts>
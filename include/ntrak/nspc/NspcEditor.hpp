@@ -1,10 +1,15 @@
 #pragma once
 
 #include "ntrak/nspc/NspcData.hpp"
+#include "ntrak/nspc/NspcFlatten.hpp"
 
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <optional>
+#include <span>
 #include <variant>
+#include <vector>
 
 namespace ntrak::nspc {
 
@@ -16,6 +21,27 @@ struct NspcEditorLocation {
 
 using NspcRowEvent = std::variant<Note, Tie, Rest, Percussion>;
 
+/// Rows [startRow, endRow) of one pattern channel
+struct NspcEditorRange {
+    int patternId = -1;
+    int channel = 0;
+    uint32_t startRow = 0;
+    uint32_t endRow = 0;
+};
+
+/// Events a batch transform visits: every event in `ranges`, or every track and subroutine event when
+/// `wholeSong` is set
+struct NspcEventSelection {
+    bool wholeSong = false;
+    std::vector<NspcEditorRange> ranges;
+};
+
+/// Rewrites one event in place and returns true if it changed it. Called for several tracks at once when a
+/// transform runs in parallel, so it must only touch the event it is given.
+using NspcEventTransform = std::function<bool(NspcEvent&)>;
+
+class NspcEditSession;
+
 class NspcEditor final {
 public:
     bool setPatternLength(NspcSong& song, int patternId, uint32_t targetTick);
@@ -39,6 +65,105 @@ public:
                                       uint32_t endRow);
     bool flattenSubroutineOnChannel(NspcSong& song, const NspcEditorLocation& location, int subroutineId);
     bool deleteSubroutine(NspcSong& song, int subroutineId);
+
+    /// Applies `transform` to every selected event without changing timing. Each track and subroutine is
+    /// visited once, however many ranges or patterns read it, and with `parallel` they are processed on worker
+    /// threads.
+    bool transformEvents(NspcSong& song, const NspcEventSelection& selection, const NspcEventTransform& transform,
+                         bool parallel = false);
+
+private:
+    friend class NspcEditSession;
+
+    NspcEditSession* session_ = nullptr;
+};
+
+/// One cell change, matching the per-cell NspcEditor operations
+struct NspcCellEdit {
+    struct RowEvent {
+        NspcRowEvent event;
+    };
+    struct DeleteRowEvent {};
+    struct Instrument {
+        std::optional<uint8_t> instrument;
+    };
+    struct Volume {
+        std::optional<uint8_t> volume;
+    };
+    struct Qv {
+        std::optional<uint8_t> qv;
+    };
+    /// Replaces the row's effect chain, like SetEffectsCommand
+    struct Effects {
+        std::vector<Vcmd> effects;
+        bool preserveSubroutineCalls = true;
+    };
+    using Change = std::variant<RowEvent, DeleteRowEvent, Instrument, Volume, Qv, Effects>;
+
+    NspcEditorLocation location;
+    Change change;
+};
+
+/// Applies a run of cell edits to one song, one edit at a time, through the matching NspcEditor operations.
+/// The edited pattern's flattened channels are kept between edits; an edit invalidates only its own channel and
+/// channels reading the same track or subroutines, which are re-flattened on their next lookup.
+///
+/// This saves re-flattening the whole pattern per edit, not per-edit flattening itself: every edit still
+/// re-flattens the channel it wrote, once or twice (a 64x8 paste of one field is up to ~1000 channel flattens).
+/// Edits are not grouped by owning track or subroutine into one splice pass, and there is no tick-to-event index
+/// kept up to date across edits; results are identical to applying each edit on its own, in order.
+class NspcEditSession {
+public:
+    explicit NspcEditSession(NspcSong& song);
+    NspcEditSession(const NspcEditSession&) = delete;
+    NspcEditSession& operator=(const NspcEditSession&) = delete;
+
+    bool apply(const NspcCellEdit& edit);
+    /// Returns true if any edit changed the song
+    bool apply(std::span<const NspcCellEdit> edits);
+
+    /// Channels flattened so far (for tests and profiling)
+    [[nodiscard]] size_t flattenedChannelCount() const { return flattenedChannels_; }
+
+    /// Lookups the editor makes while applying an edit. The first channel lookup of an edit is served from
+    /// the cache; later ones re-flatten the edited channel, since the edit may have changed it by then.
+    const NspcFlatChannel* flatChannel(const NspcEditorLocation& location);
+    std::optional<uint32_t> patternEndTick(int patternId);
+
+private:
+    struct Owner {
+        NspcEventOwner owner = NspcEventOwner::Track;
+        int id = -1;
+        bool operator==(const Owner&) const = default;
+    };
+
+    struct Channel {
+        bool valid = false;
+        int trackId = -1;
+        bool trackMissing = false;
+        NspcFlatChannel flat;                    // unclipped
+        std::vector<Owner> owners;               // the track and every subroutine it calls
+        std::optional<NspcFlatChannel> clipped;  // flat cut at the pattern end, when that drops anything
+        bool clippedValid = false;
+    };
+
+    const NspcPattern* refresh(int patternId);
+    void reflatten(size_t channelIndex, int trackId);
+    void touch(size_t channelIndex);
+    void invalidateAll();
+    const NspcFlatChannel& clippedChannel(size_t channelIndex);
+    void beforeLookup();
+
+    NspcSong& song_;
+    NspcEditor editor_;
+    int patternId_ = -1;
+    std::array<Channel, 8> channels_{};
+    std::optional<uint32_t> stopTick_;
+    const void* tracksData_ = nullptr;
+    const void* subroutinesData_ = nullptr;
+    int editChannel_ = -1;
+    bool lookedUp_ = false;
+    size_t flattenedChannels_ = 0;
 };
 
 }  // namespace ntrak::nspc
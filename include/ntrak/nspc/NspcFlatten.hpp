@@ -3,7 +3,9 @@
 #include "ntrak/nspc/NspcData.hpp"
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <optional>
 #include <vector>
 
@@ -15,18 +17,131 @@ struct NspcSubroutineFrame {
     NspcEventRef callEvent{};
 };
 
+// Index of a call-stack node in a channel's frame table; kFlatStackTop is the empty stack of the track itself.
+using NspcFlatStackId = uint32_t;
+inline constexpr NspcFlatStackId kFlatStackTop = UINT32_MAX;
+
+struct NspcFlatStackNode {
+    NspcSubroutineFrame frame{};
+    NspcFlatStackId parent = kFlatStackTop;
+    uint16_t depth = 1;
+};
+
+// Read-only view of an interned call stack; back() is the innermost frame.
+class NspcFlatCallStack {
+public:
+    NspcFlatCallStack() = default;
+    NspcFlatCallStack(const std::vector<NspcFlatStackNode>* nodes, NspcFlatStackId id) : nodes_(nodes), id_(id) {}
+
+    [[nodiscard]] bool empty() const { return id_ == kFlatStackTop; }
+    [[nodiscard]] size_t size() const { return empty() ? 0 : (*nodes_)[id_].depth; }
+    [[nodiscard]] const NspcSubroutineFrame& back() const { return (*nodes_)[id_].frame; }
+    // Outermost frame first, matching the order calls were made in.
+    [[nodiscard]] const NspcSubroutineFrame& operator[](size_t index) const;
+    [[nodiscard]] std::vector<NspcSubroutineFrame> frames() const;
+
+private:
+    const std::vector<NspcFlatStackNode>* nodes_ = nullptr;
+    NspcFlatStackId id_ = kFlatStackTop;
+};
+
+// One flattened event as seen through its channel's parallel arrays. The event is a reference into the
+// song (or cache) storage the channel was flattened from, not a copy.
 struct NspcFlatEvent {
     uint32_t tick = 0;
-    NspcEvent event{};
-    NspcEventRef source{};
-    std::vector<NspcSubroutineFrame> subroutineStack;
+    const NspcEvent& event;
+    const NspcEventRef& source;
+    NspcFlatCallStack subroutineStack;
+};
+
+// Flattened events of one channel stored as parallel arrays: ticks, source refs, variant kinds, pointers to
+// the events themselves and call-stack ids into a shared frame table. Iterating yields NspcFlatEvent views,
+// so the list reads like a vector of events while flattening costs a few growing arrays per channel rather
+// than one call-stack vector and variant copy per event.
+//
+// Events point into the storage they were flattened from: for flattenPattern() results that is the song,
+// which must not be modified while the result is in use.
+class NspcFlatEventList {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = NspcFlatEvent;
+        using difference_type = std::ptrdiff_t;
+        using reference = NspcFlatEvent;
+        using pointer = void;
+
+        const_iterator() = default;
+        const_iterator(const NspcFlatEventList* list, size_t index) : list_(list), index_(index) {}
+
+        NspcFlatEvent operator*() const { return (*list_)[index_]; }
+        const_iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++index_;
+            return previous;
+        }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+
+    private:
+        const NspcFlatEventList* list_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    [[nodiscard]] size_t size() const { return ticks_.size(); }
+    [[nodiscard]] bool empty() const { return ticks_.empty(); }
+    [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+    [[nodiscard]] const_iterator end() const { return {this, size()}; }
+    [[nodiscard]] NspcFlatEvent operator[](size_t index) const {
+        return NspcFlatEvent{
+            .tick = ticks_[index],
+            .event = *events_[index],
+            .source = sources_[index],
+            .subroutineStack = callStack(index),
+        };
+    }
+    [[nodiscard]] NspcFlatEvent front() const { return (*this)[0]; }
+    [[nodiscard]] NspcFlatEvent back() const { return (*this)[size() - 1]; }
+
+    // Column accessors for scans that only need one field.
+    [[nodiscard]] uint32_t tick(size_t index) const { return ticks_[index]; }
+    [[nodiscard]] const NspcEvent& event(size_t index) const { return *events_[index]; }
+    [[nodiscard]] size_t kind(size_t index) const { return kinds_[index]; }
+    [[nodiscard]] const NspcEventRef& source(size_t index) const { return sources_[index]; }
+    [[nodiscard]] NspcFlatCallStack callStack(size_t index) const { return {&frames_, stacks_[index]}; }
+    [[nodiscard]] const std::vector<NspcFlatStackNode>& frames() const { return frames_; }
+    // First event at or after `tick`. Ticks never decrease along a channel, so the tick column doubles as
+    // the channel's row index.
+    [[nodiscard]] size_t firstAtOrAfter(uint32_t tick) const;
+
+    void reserve(size_t count);
+    void push(uint32_t tick, const NspcEvent& event, const NspcEventRef& source, NspcFlatStackId stack);
+    NspcFlatStackId pushFrame(NspcFlatStackId parent, const NspcSubroutineFrame& frame);
+    // Points an event at another copy of the same value, e.g. storage that outlives the song.
+    void rebindEvent(size_t index, const NspcEvent& event) { events_[index] = &event; }
+    // Ticks never decrease along a channel, so clipping is a truncation.
+    void eraseAfterTick(uint32_t tick);
+
+private:
+    std::vector<uint32_t> ticks_;
+    std::vector<const NspcEvent*> events_;
+    std::vector<uint8_t> kinds_;
+    std::vector<NspcEventRef> sources_;
+    std::vector<NspcFlatStackId> stacks_;
+    std::vector<NspcFlatStackNode> frames_;
 };
 
 struct NspcFlatChannel {
     int channel = 0;
     int trackId = -1;
     uint32_t totalTicks = 0;
-    std::vector<NspcFlatEvent> events;
+    NspcFlatEventList events;
 };
 
 struct NspcFlatPattern {
@@ -41,6 +156,8 @@ struct NspcFlattenOptions {
     uint32_t maxTicksPerChannel = 0x100000;
     // If true, clip all channel events/ticks to the earliest explicit End tick in the pattern.
     bool clipToEarliestTrackEnd = true;
+
+    bool operator==(const NspcFlattenOptions&) const = default;
 };
 
 NspcFlatPattern flattenPattern(const NspcSong& song, const NspcPattern& pattern,
@@ -49,4 +166,63 @@ NspcFlatPattern flattenPattern(const NspcSong& song, const NspcPattern& pattern,
 std::optional<NspcFlatPattern> flattenPatternById(const NspcSong& song, int patternId,
                                                   const NspcFlattenOptions& options = {});
 
+// Flattens one channel's track without the pattern-wide clip; clipFlatPattern applies it once every
+// channel is in place.
+NspcFlatChannel flattenChannel(const NspcSong& song, int channelIndex, int trackId,
+                               const NspcFlattenOptions& options = {});
+void clipFlatPattern(NspcFlatPattern& flatPattern, const NspcFlattenOptions& options = {});
+// Tick of the channel's own End event (not one inside a subroutine), if it reached one.
+std::optional<uint32_t> flatTrackEndTick(const NspcFlatChannel& channel);
+
+// Holds the last flattened pattern for a view that asks for it every frame. The caller passes a song
+// revision that changes whenever the pattern's inputs may have been edited (the newest of the song's stamps
+// for the pattern, its tracks and the subroutines); while the revision, pattern and options stay the same and
+// the song's track/subroutine counts and the pattern's track assignment are unchanged, flatten() returns the
+// held result without doing any work. Otherwise each channel is compared against the track and subroutine
+// events it was flattened from and only changed channels are flattened again.
+class NspcFlatPatternCache {
+public:
+    const NspcFlatPattern* flatten(const NspcSong& song, int patternId, const NspcFlattenOptions& options,
+                                   uint64_t songRevision);
+
+    // Forces the next flatten() to re-check every channel against the song, e.g. after an edit that did not
+    // go through the command history.
+    void invalidate() { revision_.reset(); }
+
+    // Bumped whenever flatten() produced a different result than the previous call.
+    [[nodiscard]] uint64_t generation() const { return generation_; }
+    [[nodiscard]] size_t flattenedChannelCount() const { return flattenedChannels_; }
+
+private:
+    struct Source {
+        NspcEventOwner owner = NspcEventOwner::Track;
+        int id = -1;
+        std::optional<std::vector<NspcEventEntry>> events;
+    };
+
+    struct Channel {
+        bool valid = false;
+        int trackId = -1;
+        NspcFlatChannel flat;
+        std::vector<Source> sources;
+    };
+
+    bool isUnchanged(const NspcSong& song, const NspcPattern& pattern, const NspcFlattenOptions& options,
+                     uint64_t songRevision) const;
+    static bool sourcesMatch(const NspcSong& song, const Channel& channel);
+    static std::vector<Source> collectSources(const NspcSong& song, const NspcFlatChannel& flat);
+    static void rebindToSources(Channel& channel);
+
+    const NspcSong* song_ = nullptr;
+    int patternId_ = -1;
+    std::optional<uint64_t> revision_;
+    NspcFlattenOptions options_{};
+    size_t trackCount_ = 0;
+    size_t subroutineCount_ = 0;
+    std::array<Channel, 8> channels_{};
+    std::optional<NspcFlatPattern> pattern_;
+    uint64_t generation_ = 0;
+    size_t flattenedChannels_ = 0;
+};
+
 }  // namespace ntrak::nspc
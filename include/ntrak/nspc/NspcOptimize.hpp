@@ -3,6 +3,11 @@
 
 #include "ntrak/nspc/NspcData.hpp"
 
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
 namespace ntrak::nspc {
 
 struct NspcOptimizerOptions {
@@ -11,10 +16,78 @@ struct NspcOptimizerOptions {
     uint32_t maxCandidateBytes = 2048;
     int singleIterationCallPenaltyBytes = 4;
     bool allowSingleIterationCalls = true;
+    // Apply several subroutines per suffix-automaton build, re-scoring the surviving candidates against
+    // the rewritten tracks instead of rebuilding after every extraction.
+    bool incremental = false;
+    // Incremental mode applies a re-scored candidate once its live savings are within this percentage of
+    // the best remaining estimate. 0 keeps the greedy ordering; higher values trade bytes for fewer checks.
+    int incrementalTolerancePercent = 0;
+    // Evaluate candidates until the best real savings is known instead of taking the first profitable one.
+    bool selectBestRealSavings = false;
+    // Threads used to evaluate candidates (0 = one per hardware thread). Output is identical for every value.
+    size_t maxWorkerThreads = 0;
+    // Above zero, spend up to this long on a beam search over extraction orders and keep whichever of
+    // it and the greedy result is smaller.
+    int searchBudgetMilliseconds = 0;
+    int beamWidth = 4;      // states kept per search depth
+    int beamBranching = 3;  // candidates expanded per state
+};
+
+// Named tunings offered by the Build panel and measured by the optimizer corpus runner.
+enum class NspcOptimizerPreset : uint8_t {
+    Relaxed,
+    Balanced,
+    Aggressive,
+    AggressivePlus,  // Aggressive plus a time-boxed beam search
+};
+
+inline constexpr size_t kNspcOptimizerPresetCount = 4;
+
+// Sets the fields a preset covers; incremental mode, best-savings selection and worker threads are
+// left as they were.
+void applyOptimizerPreset(NspcOptimizerOptions& options, NspcOptimizerPreset preset);
+std::string_view optimizerPresetName(NspcOptimizerPreset preset);
+
+struct NspcOptimizerStats {
+    int iterations = 0;       // subroutines applied
+    int automatonBuilds = 0;  // full suffix-automaton rebuilds
+    int subroutinesCreated = 0;
+    uint32_t bytesBefore = 0;  // flattened track bytes
+    uint32_t bytesAfter = 0;   // track + subroutine bytes
+    uint64_t peakAutomatonBytes = 0;  // largest suffix-automaton arena reserved during the run
+    uint32_t greedyBytesAfter = 0;    // greedy baseline when a search budget was set, else 0
+    int searchDepth = 0;              // beam-search depths explored
+    int distinctTokens = 0;           // interned event kinds, i.e. the automaton's alphabet
+};
+
+struct NspcSharedOptimizerSongStats {
+    uint32_t bytesBefore = 0;     // flattened track bytes
+    uint32_t bytesAfter = 0;      // track bytes + subroutines only this song calls
+    int sharedSubroutinesUsed = 0;
+};
+
+struct NspcSharedOptimizerStats {
+    std::vector<NspcSharedOptimizerSongStats> songs;  // parallel to the input songs
+    NspcOptimizerStats combined;                      // the single run over every song's tracks
+    int sharedSubroutines = 0;                        // subroutines called by more than one song
+    uint32_t sharedSubroutineBytes = 0;               // stored once when songs are built together
+    uint32_t bytesBefore = 0;
+    uint32_t bytesAfter = 0;  // every song's tracks + each distinct subroutine once
 };
 
 // Greedy suffix-automaton-based subroutine extraction.
 // Assumes/forces flattened tracks first, then creates a fresh set of subroutines.
-void optimizeSongSubroutines(NspcSong& song, const NspcOptimizerOptions& options = {});
+NspcOptimizerStats optimizeSongSubroutines(NspcSong& song, const NspcOptimizerOptions& options = {});
+
+// optimizeSongSubroutines for a song flattenSubroutines() already ran on, e.g. to key the optimizer cache;
+// skips the second flatten.
+NspcOptimizerStats optimizeFlattenedSongSubroutines(NspcSong& flattenedSong, const NspcOptimizerOptions& options = {});
+
+// Runs the optimizer once over the tracks of all `songs`, so phrases repeated across songs become one
+// subroutine. Each song then keeps its own copy of every subroutine it calls, so it still compiles and
+// plays on its own; builds that upload the songs together (NspcBuildOptions::shareSubroutinesAcrossSongs)
+// store identical copies once.
+NspcSharedOptimizerStats optimizeSharedSubroutines(std::span<NspcSong* const> songs,
+                                                   const NspcOptimizerOptions& options = {});
 
 }  // namespace ntrak::nspc
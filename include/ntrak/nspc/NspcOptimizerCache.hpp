@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ntrak/nspc/NspcData.hpp"
+#include "ntrak/nspc/NspcEngine.hpp"
+#include "ntrak/nspc/NspcOptimize.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ntrak::nspc {
+
+/// Everything the optimizer output depends on, serialized into `input`; entries are found by `hash` and
+/// only returned when their stored input matches byte for byte, so a hash collision is a miss.
+struct NspcOptimizerCacheKey {
+    uint64_t hash = 0;
+    std::vector<uint8_t> input;
+
+    bool operator==(const NspcOptimizerCacheKey&) const = default;
+};
+
+/// Optimizer output for one song: the rewritten events of each track, in track order, and the
+/// subroutines they call.
+struct NspcOptimizerCacheEntry {
+    std::vector<std::vector<NspcEventEntry>> trackEvents;
+    std::vector<NspcSubroutine> subroutines;
+    NspcOptimizerStats stats;
+    std::vector<uint8_t> keyInput;  // input of the key the entry was stored under
+};
+
+/// Results of previous optimizer runs, keyed by `optimizerCacheKey`. Safe to use from several
+/// build threads at once. Holds at most `kMaxEntries` songs; the oldest entry is dropped first.
+class NspcOptimizerCache {
+public:
+    static constexpr size_t kMaxEntries = 64;
+
+    std::optional<NspcOptimizerCacheEntry> find(const NspcOptimizerCacheKey& key) const;
+    /// Sets the entry's keyInput from `key`
+    void store(const NspcOptimizerCacheKey& key, NspcOptimizerCacheEntry entry);
+    void clear();
+    size_t size() const;
+
+    /// Entries oldest first with their key hashes, for persisting the cache with a project.
+    std::vector<std::pair<uint64_t, NspcOptimizerCacheEntry>> entries() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, NspcOptimizerCacheEntry> entries_;
+    std::deque<uint64_t> insertionOrder_;
+};
+
+/// Key over everything the optimizer output depends on: the encoded bytes of each flattened track, the
+/// options that shape the search and the engine. Event ids and addresses do not contribute. Returns
+/// nullopt when the song still has subroutine calls or fails to encode.
+std::optional<NspcOptimizerCacheKey> optimizerCacheKey(const NspcSong& flattenedSong,
+                                                       const NspcOptimizerOptions& options,
+                                                       const NspcEngineConfig& engine);
+
+/// Replaces a flattened song's track events and subroutines with a cached result. Fails (and leaves
+/// the song untouched) when the entry's track count does not match.
+bool applyOptimizerCacheEntry(NspcSong& song, const NspcOptimizerCacheEntry& entry);
+
+/// Captures an optimized song as a cache entry.
+NspcOptimizerCacheEntry makeOptimizerCacheEntry(const NspcSong& optimizedSong, const NspcOptimizerStats& stats);
+
+}  // namespace ntrak::nspc
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ntrak/nspc/NspcData.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ntrak::nspc {
+
+/// Compact in-memory form of a track or subroutine event list. Each event is one tag byte (event kind plus
+/// flags) followed by its payload, so typical events take one to three bytes instead of
+/// sizeof(NspcEventEntry); event ids live in a side table of consecutive-id runs. Entries are decoded on
+/// access, and a byte offset is kept every kCheckpointInterval events so indexing does not rescan the list.
+///
+/// Only compacted undo records hold events in this form. Songs, their snapshots and flatten caches keep
+/// NspcTrack/NspcSubroutine vectors, since the editor, flatten and compile paths scan those far more often than
+/// a per-event decode allows.
+class NspcPackedEventList {
+public:
+    static constexpr size_t kCheckpointInterval = 32;
+
+    /// Forward iterator decoding one entry per step
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = NspcEventEntry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const NspcEventEntry*;
+        using reference = const NspcEventEntry&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return entry_; }
+        pointer operator->() const { return &entry_; }
+        const_iterator& operator++();
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+
+    private:
+        friend class NspcPackedEventList;
+        const_iterator(const NspcPackedEventList* list, size_t index, size_t offset);
+
+        const NspcPackedEventList* list_ = nullptr;
+        size_t index_ = 0;
+        size_t nextOffset_ = 0;
+        size_t run_ = 0;
+        NspcEventEntry entry_{};
+    };
+
+    NspcPackedEventList() = default;
+
+    /// Fails for events the byte code cannot reproduce exactly (e.g. a VCMD whose parameters do not decode
+    /// back to the same command); such lists stay unpacked.
+    static std::expected<NspcPackedEventList, std::string> pack(std::span<const NspcEventEntry> entries);
+    [[nodiscard]] std::vector<NspcEventEntry> unpack() const;
+
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    [[nodiscard]] const_iterator begin() const { return const_iterator(this, 0, 0); }
+    [[nodiscard]] const_iterator end() const;
+
+    [[nodiscard]] NspcEventEntry operator[](size_t index) const;
+    [[nodiscard]] NspcEventId id(size_t index) const;
+    [[nodiscard]] std::optional<size_t> indexOf(NspcEventId id) const;
+
+    /// Encoded event bytes, excluding the id table
+    [[nodiscard]] size_t byteSize() const { return bytes_.size(); }
+    [[nodiscard]] size_t memoryBytes() const;
+
+    bool operator==(const NspcPackedEventList&) const = default;
+
+private:
+    // Events [firstIndex, next run's firstIndex) have ids firstId, firstId + 1, ...
+    struct IdRun {
+        size_t firstIndex = 0;
+        NspcEventId firstId = 0;
+        bool operator==(const IdRun&) const = default;
+    };
+
+    size_t decodeAt(size_t offset, NspcEventEntry& entry) const;
+    size_t runFor(size_t index) const;
+
+    std::vector<uint8_t> bytes_;
+    std::vector<uint32_t> checkpoints_;  // byte offset of event i * kCheckpointInterval
+    std::vector<IdRun> idRuns_;
+    size_t size_ = 0;
+};
+
+}  // namespace ntrak::nspc
@@ -1,58 +1,20 @@
 #pragma once
+#include "ntrak/common/CowPtr.hpp"
 #include "ntrak/emulation/SpcDsp.hpp"
+#include "ntrak/nspc/NspcAramUsage.hpp"
 #include "ntrak/nspc/NspcData.hpp"
 #include "ntrak/nspc/NspcEngine.hpp"
+#include "ntrak/nspc/NspcOptimizerCache.hpp"
 
 #include <cstddef>
 #include <memory>
 #include <optional>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace ntrak::nspc {
 
-enum class NspcAramRegionKind : uint8_t {
-    Free,
-    Reserved,
-    SongIndexTable,
-    InstrumentTable,
-    SampleDirectory,
-    SampleData,
-    SequenceData,
-    PatternTable,
-    TrackData,
-    SubroutineData,
-};
-
-struct NspcAramRegion {
-    NspcAramRegionKind kind = NspcAramRegionKind::Free;
-    uint16_t from = 0;  // inclusive
-    uint16_t to = 0;    // exclusive
-    int songId = -1;
-    int objectId = -1;
-    std::string label;
-};
-
-struct NspcAramUsage {
-    static constexpr uint32_t kTotalAramBytes = 0x10000;
-
-    uint32_t totalBytes = kTotalAramBytes;
-    uint32_t usedBytes = 0;
-    uint32_t freeBytes = 0;
-
-    uint32_t reservedBytes = 0;
-    uint32_t songIndexBytes = 0;
-    uint32_t instrumentBytes = 0;
-    uint32_t sampleDirectoryBytes = 0;
-    uint32_t sampleDataBytes = 0;
-    uint32_t sequenceBytes = 0;
-    uint32_t patternTableBytes = 0;
-    uint32_t trackBytes = 0;
-    uint32_t subroutineBytes = 0;
-
-    std::vector<NspcAramRegion> regions;
-};
-
 struct NspcSongAddressLayout {
     uint16_t sequenceAddr = 0;
     std::unordered_map<int, uint16_t> patternAddrById;
@@ -70,21 +32,29 @@ public:
     NspcEngineConfig& engineConfig() { return engineConfig_; }
     const NspcEngineConfig& engineConfig() const { return engineConfig_; }
 
-    emulation::AramView aram() { return emulation::AramView(aram_.data(), aram_.size()); }
+    emulation::AramView aram() { return emulation::AramView(aram_.mut().data(), aram_->size()); }
+
+    /// Read-only: the bytes may be shared with other copies of the project
+    emulation::ConstAramView aram() const { return emulation::ConstAramView(aram_->data(), aram_->size()); }
 
-    emulation::AramView aram() const { return emulation::AramView(const_cast<uint8_t*>(aram_.data()), aram_.size()); }
+    const std::vector<NspcSong>& songs() const { return *songs_; }
 
-    const std::vector<NspcSong>& songs() const { return songs_; }
+    std::vector<NspcSong>& songs() { return songs_.mut(); }
+    /// Starts decoding the events of a song left encoded by a deferred project load, so first opening it does
+    /// not stall; does nothing for songs already decoded or an index out of range
+    void prefetchSong(size_t songIndex) const;
 
-    std::vector<NspcSong>& songs() { return songs_; }
+    const std::vector<NspcInstrument>& instruments() const { return *instruments_; }
+    std::vector<NspcInstrument>& instruments() { return instruments_.mut(); }
 
-    const std::vector<NspcInstrument>& instruments() const { return instruments_; }
-    std::vector<NspcInstrument>& instruments() { return instruments_; }
+    const std::vector<BrrSample>& samples() const { return *samples_; }
+    std::vector<BrrSample>& samples() { return samples_.mut(); }
 
-    const std::vector<BrrSample>& samples() const { return samples_; }
-    std::vector<BrrSample>& samples() { return samples_; }
+    const NspcAramUsage& aramUsage() const { return *aramUsage_; }
 
-    const NspcAramUsage& aramUsage() const { return aramUsage_; }
+    /// Optimizer results reused by builds of unchanged songs. Shared by every copy of the project and logically
+    /// mutable: builds of a const project fill it too, so it is writable through const access.
+    NspcOptimizerCache& optimizerCache() const { return *optimizerCache_; }
 
     std::optional<size_t> addEmptySong();
     std::optional<size_t> duplicateSong(size_t songIndex);
@@ -99,7 +69,18 @@ public:
     const NspcSongAddressLayout* songAddressLayout(int songId) const;
     void setSongAddressLayout(int songId, NspcSongAddressLayout layout);
     void clearSongAddressLayout(int songId);
+
+    /// Edit stamp of the whole project (see NspcRevision): the newest song stamp, or the project's own stamp,
+    /// which song add/remove, address layouts, origins, extensions, touch() and refreshAramUsage() advance.
+    NspcRevision revision() const;
+    /// Marks the project edited after direct changes to instruments, samples or ARAM
+    void touch();
+
+    /// Stamps the project and recollects every ARAM region
     void refreshAramUsage();
+    /// Brings ARAM usage up to date if revision() moved, recollecting only the regions of songs whose stamps
+    /// changed; cheap enough to call every frame
+    void updateAramUsage();
 
 private:
     void parseInstruments();
@@ -107,14 +88,27 @@ private:
     void parseSongs();
     void rebuildAramUsage();
 
+    // Everything below the engine config is copy-on-write, so copying a project (build and
+    // playback snapshots) shares storage and only clones what the copy later edits. Non-const
+    // accessors detach; read-only paths should go through a const reference.
     NspcEngineConfig engineConfig_;
-    std::array<std::uint8_t, 0x10000> aram_;
-
-    std::vector<NspcSong> songs_;
-    std::vector<NspcInstrument> instruments_;
-    std::vector<BrrSample> samples_;
-    NspcAramUsage aramUsage_;
-    std::unordered_map<int, NspcSongAddressLayout> songAddressLayouts_;
+    common::CowPtr<std::array<std::uint8_t, 0x10000>> aram_;
+
+    common::CowPtr<std::vector<NspcSong>> songs_;
+    common::CowPtr<std::vector<NspcInstrument>> instruments_;
+    common::CowPtr<std::vector<BrrSample>> samples_;
+    common::CowPtr<NspcAramUsage> aramUsage_;
+    // Source 0 holds the engine and asset tables, source i + 1 song i. The tables and song layouts are
+    // collected against the project stamp, each song's regions against that song's stamp.
+    common::CowPtr<NspcAramUsageMap> aramUsageMap_;
+    NspcRevision aramTablesRevision_ = 0;
+    std::vector<NspcRevision> aramSongRevisions_;
+    common::CowPtr<std::unordered_map<int, NspcSongAddressLayout>> songAddressLayouts_;
+    NspcRevision revision_ = newNspcRevision();
+    NspcRevision aramUsageRevision_ = 0;
+
+    // Not copy-on-write: entries are keyed by content, so build snapshots fill the editor's cache.
+    std::shared_ptr<NspcOptimizerCache> optimizerCache_ = std::make_shared<NspcOptimizerCache>();
 };
 
 }  // namespace ntrak::nspc
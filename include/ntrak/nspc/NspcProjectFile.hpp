@@ -2,10 +2,14 @@
 
 #include "ntrak/nspc/NspcProject.hpp"
 
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace ntrak::nspc {
@@ -20,13 +24,59 @@ struct NspcProjectIrData {
     std::vector<int> retainedEngineSongIds;
     std::vector<int> retainedEngineInstrumentIds;
     std::vector<int> retainedEngineSampleIds;
+    /// Optimizer results saved with the project, oldest first. Empty when the file has none.
+    std::vector<std::pair<uint64_t, NspcOptimizerCacheEntry>> optimizerCache;
 };
 
+/// Both forms hold the same objects and convert into each other without loss.
+enum class NspcProjectFileFormat : uint8_t {
+    /// One JSON document with packed events and BRR data base64-encoded inline
+    Json,
+    /// Chunked container: a header and chunk table, then one chunk per song and per sample whose metadata is
+    /// CBOR and whose packed events and BRR data are stored raw. Readable in place, e.g. from a mapped file.
+    Binary,
+};
+
+/// With `includeOptimizerCache`, the project's optimizer cache is written too, so the next session's
+/// first optimized build of an unchanged song skips the optimizer.
 std::expected<void, std::string> saveProjectIrFile(const NspcProject& project, const std::filesystem::path& path,
-                                                   std::optional<std::filesystem::path> baseSpcPath = std::nullopt);
+                                                   std::optional<std::filesystem::path> baseSpcPath = std::nullopt,
+                                                   bool includeOptimizerCache = false,
+                                                   NspcProjectFileFormat format = NspcProjectFileFormat::Json);
+
+/// Writes loaded project data back out as is, e.g. to convert a file between formats. `baseSpcPath` is
+/// stored unchanged, so it stays relative to the original file's directory.
+std::expected<void, std::string> saveProjectIrData(const NspcProjectIrData& data, const std::filesystem::path& path,
+                                                   NspcProjectFileFormat format);
+
+struct NspcProjectLoadOptions {
+    /// Keep each song's track and subroutine events encoded until first accessed (see NspcDeferredSongBody),
+    /// so opening a many-song project costs little more than opening one song. Payload shapes are still
+    /// checked, but malformed event bytes are only reported, and dropped, when the song is decoded.
+    bool deferSongEvents = true;
+};
 
-std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::filesystem::path& path);
+/// Reads either format; which one is detected from the file's leading bytes.
+std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::filesystem::path& path,
+                                                                const NspcProjectLoadOptions& options = {});
+
+/// loadProjectIrFile for a file already in memory. Binary payloads are copied out of `bytes` where the
+/// result keeps them (sample data, encoded or unpacked events), so a mapped file can be passed directly.
+std::expected<NspcProjectIrData, std::string> parseProjectIr(std::span<const uint8_t> bytes,
+                                                             const NspcProjectLoadOptions& options = {});
+
+NspcProjectFileFormat detectProjectFileFormat(std::span<const uint8_t> bytes);
+
+/// Binary for the `.ntrakbin` extension, JSON otherwise.
+NspcProjectFileFormat projectFileFormatForPath(const std::filesystem::path& path);
 
 std::expected<void, std::string> applyProjectIrOverlay(NspcProject& project, const NspcProjectIrData& overlay);
 
+/// Compact binary form of an event list (varint ids, one header byte per event), as stored in project files.
+std::expected<std::vector<uint8_t>, std::string> packEventEntries(const std::vector<NspcEventEntry>& entries);
+
+/// Inverse of packEventEntries. `label` prefixes error messages.
+std::expected<std::vector<NspcEventEntry>, std::string> unpackEventEntries(std::span<const uint8_t> bytes,
+                                                                            std::string_view label);
+
 }  // namespace ntrak::nspc
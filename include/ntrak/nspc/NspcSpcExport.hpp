@@ -30,4 +30,17 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     std::optional<uint8_t> triggerPortOverride = std::nullopt,
     NspcBuildOptions buildOptions = {});
 
+/// Build one auto-play SPC per requested song (e.g. a full soundtrack export).
+/// Results are byte-identical to calling buildAutoPlaySpc for each index in order: compilation
+/// runs sequentially, while the per-song emulator warmups run concurrently on up to
+/// `buildOptions.maxWorkerThreads` threads.
+///
+/// @return One result per entry in `songIndices`, in the same order
+std::vector<std::expected<std::vector<uint8_t>, std::string>> buildAutoPlaySpcBatch(
+    NspcProject& project,
+    std::span<const uint8_t> baseSpcImage,
+    std::span<const int> songIndices,
+    std::optional<uint8_t> triggerPortOverride = std::nullopt,
+    NspcBuildOptions buildOptions = {});
+
 }  // namespace ntrak::nspc
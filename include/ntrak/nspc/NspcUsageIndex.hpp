@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ntrak/nspc/NspcData.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace ntrak::nspc {
+
+class NspcProject;
+
+/// One event referencing an indexed value
+struct NspcUsage {
+    int songId = -1;
+    NspcEventRef event;
+};
+
+/// Reverse index from instruments, subroutines and VCMD types to the events that use them, kept per song
+/// and per track/subroutine so an edit only rescans the lists it touched. Queries cost the size of their
+/// result rather than a walk over every event in the project.
+///
+/// Instrument uses are VcmdInst events plus percussion notes, resolved against the last percussion base
+/// instrument earlier in the same track or subroutine (as findUsedInstrumentIds does).
+///
+/// Songs whose body is still deferred (see NspcDeferredSongBody) are not decoded to be indexed; they are
+/// scanned when a query first needs them, so indexing a freshly opened project stays cheap.
+class NspcUsageIndex {
+public:
+    enum class Kind : uint8_t {
+        Instrument,
+        Subroutine,
+        Vcmd,
+    };
+
+    void clear();
+    void rebuild(const NspcProject& project);
+    void rebuildSong(const NspcSong& song);
+    void removeSong(int songId);
+
+    /// Rescans the changed owners plus any slots added or dropped since the song was last indexed; fits
+    /// NspcCommandHistory::subscribe
+    void updateSong(const NspcSong& song, const NspcSongChanges& changes);
+
+    /// Uses sorted by song, owner kind, owner id and event index
+    [[nodiscard]] std::vector<NspcUsage> uses(Kind kind, int value, std::optional<int> songId = std::nullopt) const;
+    [[nodiscard]] size_t useCount(Kind kind, int value, std::optional<int> songId = std::nullopt) const;
+    [[nodiscard]] bool isUsed(Kind kind, int value) const { return useCount(kind, value) != 0; }
+
+    /// Sorted values of `kind` used anywhere in the song
+    [[nodiscard]] std::vector<int> usedValues(Kind kind, int songId) const;
+
+    /// Uses of every instrument playing `sampleId`; the instrument table is read from `project`
+    [[nodiscard]] std::vector<NspcUsage> sampleUses(const NspcProject& project, int sampleId) const;
+    [[nodiscard]] size_t sampleUseCount(const NspcProject& project, int sampleId) const;
+
+private:
+    using Key = uint32_t;
+
+    struct Use {
+        Key key = 0;
+        uint32_t eventIndex = 0;
+        NspcEventId eventId = 0;
+    };
+
+    // Uses of one track or subroutine, sorted by key then event index
+    struct OwnerUses {
+        int ownerId = -1;
+        std::vector<Use> uses;
+    };
+
+    struct SongUses {
+        std::vector<OwnerUses> tracks;
+        std::vector<OwnerUses> subroutines;
+        std::map<Key, uint32_t> counts;
+    };
+
+    // An owner holding `count` uses of a key
+    struct Posting {
+        int songId = -1;
+        NspcEventOwner owner = NspcEventOwner::Track;
+        uint32_t slot = 0;
+        uint32_t count = 0;
+    };
+
+    static Key keyFor(Kind kind, int value);
+    static std::vector<OwnerUses>& ownersOf(SongUses& song, NspcEventOwner owner);
+    static const std::vector<OwnerUses>& ownersOf(const SongUses& song, NspcEventOwner owner);
+
+    // Const so queries can index pending songs; they only fill the mutable members below
+    void indexSong(int songId, const std::vector<NspcTrack>& tracks,
+                   const std::vector<NspcSubroutine>& subroutines) const;
+    void indexPending(std::optional<int> songId) const;
+    void scanOwner(int songId, SongUses& song, NspcEventOwnerSlot slot, int ownerId,
+                   const std::vector<NspcEventEntry>& events) const;
+    void dropOwner(int songId, SongUses& song, NspcEventOwnerSlot slot) const;
+    void appendUses(Key key, std::optional<int> songId, std::vector<NspcUsage>& out) const;
+
+    mutable std::map<int, SongUses> songs_;
+    mutable std::unordered_map<Key, std::vector<Posting>> postings_;
+    mutable std::unordered_map<Key, size_t> totals_;
+    // Songs left undecoded by rebuildSong, indexed by the first query that needs them
+    mutable std::map<int, std::shared_ptr<NspcDeferredSongBody>> pending_;
+};
+
+}  // namespace ntrak::nspc
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "ntrak/nspc/NspcData.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace ntrak::nspc {
+
+inline constexpr uint8_t kFirstVcmdId = 0xE0;
+inline constexpr size_t kVcmdIdCount = 0x100 - kFirstVcmdId;
+inline constexpr size_t kMaxVcmdParamBytes = 4;
+
+using VcmdParamBytes = std::array<uint8_t, kMaxVcmdParamBytes>;
+
+/// Parameter byte layout of a fixed-id VCMD struct. The default handles structs made only of
+/// byte-sized fields, which are written in declaration order; wider fields need a specialization.
+template <typename T>
+struct VcmdParamLayout {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) == 1,
+                  "VCMD structs with multi-byte fields need an explicit VcmdParamLayout");
+
+    static constexpr uint8_t paramCount = std::is_empty_v<T> ? 0 : static_cast<uint8_t>(sizeof(T));
+
+    static constexpr void write(const T& value, uint8_t* out) {
+        if constexpr (paramCount > 0) {
+            const auto bytes = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+            for (size_t i = 0; i < bytes.size(); ++i) {
+                out[i] = bytes[i];
+            }
+        }
+    }
+
+    static constexpr T read(const uint8_t* params) {
+        if constexpr (paramCount == 0) {
+            return T{};
+        } else {
+            std::array<uint8_t, sizeof(T)> bytes{};
+            for (size_t i = 0; i < bytes.size(); ++i) {
+                bytes[i] = params[i];
+            }
+            return std::bit_cast<T>(bytes);
+        }
+    }
+};
+
+/// Call target is stored little-endian; the decoded call has no subroutine id yet (-1).
+template <>
+struct VcmdParamLayout<VcmdSubroutineCall> {
+    static constexpr uint8_t paramCount = 3;
+
+    static constexpr void write(const VcmdSubroutineCall& value, uint8_t* out) {
+        out[0] = static_cast<uint8_t>(value.originalAddr & 0xFFu);
+        out[1] = static_cast<uint8_t>((value.originalAddr >> 8) & 0xFFu);
+        out[2] = value.count;
+    }
+
+    static constexpr VcmdSubroutineCall read(const uint8_t* params) {
+        return VcmdSubroutineCall{
+            .subroutineId = -1,
+            .originalAddr = static_cast<uint16_t>(params[0] | (static_cast<uint16_t>(params[1]) << 8u)),
+            .count = params[2],
+        };
+    }
+};
+
+template <>
+struct VcmdParamLayout<VcmdNOP> {
+    static constexpr uint8_t paramCount = 2;
+
+    static constexpr void write(const VcmdNOP& value, uint8_t* out) {
+        out[0] = static_cast<uint8_t>(value.nopBytes & 0xFFu);
+        out[1] = static_cast<uint8_t>((value.nopBytes >> 8) & 0xFFu);
+    }
+
+    static constexpr VcmdNOP read(const uint8_t* params) {
+        return VcmdNOP{.nopBytes = static_cast<uint16_t>(params[0] | (static_cast<uint16_t>(params[1]) << 8u))};
+    }
+};
+
+/// One row of the built-in VCMD table, indexed by `id - kFirstVcmdId`.
+struct VcmdDescriptor {
+    uint8_t id = 0;
+    std::string_view name;
+    uint8_t paramCount = 0;
+    uint8_t variantIndex = 0;
+    Vcmd (*decode)(const uint8_t* params) = nullptr;
+};
+
+namespace vcmd_detail {
+
+using VcmdVariant = decltype(Vcmd::vcmd);
+inline constexpr size_t kVariantSize = std::variant_size_v<VcmdVariant>;
+inline constexpr size_t kExtensionIndex = kVariantSize - 1;
+static_assert(std::is_same_v<std::variant_alternative_t<kExtensionIndex, VcmdVariant>, VcmdExtension>);
+
+template <typename T>
+inline constexpr bool kHasFixedId = !std::is_same_v<T, std::monostate> && !std::is_same_v<T, VcmdExtension>;
+
+template <typename T>
+Vcmd decodeAs(const uint8_t* params) {
+    return Vcmd{VcmdParamLayout<T>::read(params)};
+}
+
+template <size_t... I>
+constexpr std::array<VcmdDescriptor, kVcmdIdCount> makeDescriptorTable(std::index_sequence<I...>) {
+    std::array<VcmdDescriptor, kVcmdIdCount> table{};
+    (
+        [&] {
+            using T = std::variant_alternative_t<I, VcmdVariant>;
+            if constexpr (kHasFixedId<T>) {
+                table[T::id - kFirstVcmdId] = VcmdDescriptor{
+                    .id = T::id,
+                    .name = T::name,
+                    .paramCount = VcmdParamLayout<T>::paramCount,
+                    .variantIndex = static_cast<uint8_t>(I),
+                    .decode = &decodeAs<T>,
+                };
+            }
+        }(),
+        ...);
+    return table;
+}
+
+template <typename T>
+constexpr uint8_t encodedSizeOf() {
+    if constexpr (kHasFixedId<T>) {
+        return static_cast<uint8_t>(1 + VcmdParamLayout<T>::paramCount);
+    } else {
+        return 0;  // Nothing for monostate; extensions carry their own count.
+    }
+}
+
+template <size_t... I>
+constexpr std::array<uint8_t, kVariantSize> makeEncodedSizeTable(std::index_sequence<I...>) {
+    return {encodedSizeOf<std::variant_alternative_t<I, VcmdVariant>>()...};
+}
+
+}  // namespace vcmd_detail
+
+inline constexpr auto kVcmdDescriptors =
+    vcmd_detail::makeDescriptorTable(std::make_index_sequence<vcmd_detail::kVariantSize>{});
+
+inline constexpr auto kVcmdEncodedSizeByVariantIndex =
+    vcmd_detail::makeEncodedSizeTable(std::make_index_sequence<vcmd_detail::kVariantSize>{});
+
+static_assert(
+    [] {
+        for (size_t i = 0; i < kVcmdIdCount; ++i) {
+            if (kVcmdDescriptors[i].id != kFirstVcmdId + i || kVcmdDescriptors[i].decode == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }(),
+    "every VCMD id from $E0 to $FF needs exactly one Vcmd* struct");
+
+/// Descriptor for a built-in VCMD id, or nullptr below $E0.
+constexpr const VcmdDescriptor* vcmdDescriptor(uint8_t id) {
+    return id >= kFirstVcmdId ? &kVcmdDescriptors[id - kFirstVcmdId] : nullptr;
+}
+
+/// Bytes emitted for a VCMD: the command byte plus its parameters (0 for an empty VCMD).
+constexpr uint32_t vcmdEncodedSize(const Vcmd& cmd) {
+    if (cmd.vcmd.index() == vcmd_detail::kExtensionIndex) {
+        return 1u + std::get<VcmdExtension>(cmd.vcmd).paramCount;
+    }
+    return kVcmdEncodedSizeByVariantIndex[cmd.vcmd.index()];
+}
+
+/// Common (pre-engine-mapping) command id of a VCMD; 0 for an empty VCMD.
+constexpr uint8_t vcmdCommandId(const Vcmd& cmd) {
+    return std::visit(
+        [](const auto& value) -> uint8_t {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::monostate>) {
+                return 0;
+            } else {
+                return value.id;
+            }
+        },
+        cmd.vcmd);
+}
+
+/// Writes the raw parameter bytes of a VCMD and returns how many were written. Subroutine calls
+/// write their original address; callers that relocate calls patch bytes 0-1 themselves.
+constexpr uint8_t writeVcmdParams(const Vcmd& cmd, VcmdParamBytes& out) {
+    return std::visit(
+        [&](const auto& value) -> uint8_t {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::monostate>) {
+                return 0;
+            } else if constexpr (std::is_same_v<T, VcmdExtension>) {
+                out = value.params;
+                return value.paramCount;
+            } else {
+                VcmdParamLayout<T>::write(value, out.data());
+                return VcmdParamLayout<T>::paramCount;
+            }
+        },
+        cmd.vcmd);
+}
+
+/// Builds the built-in VCMD for `id` from its raw parameter bytes. Unlike `constructVcmd`, every id
+/// from $E0 to $FF decodes; subroutine calls come back with subroutineId -1.
+inline std::optional<Vcmd> decodeVcmd(uint8_t id, const uint8_t* params) {
+    const auto* descriptor = vcmdDescriptor(id);
+    if (descriptor == nullptr) {
+        return std::nullopt;
+    }
+    return descriptor->decode(params);
+}
+
+}  // namespace ntrak::nspc
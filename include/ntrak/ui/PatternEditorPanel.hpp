@@ -93,7 +93,9 @@ private:
     using PatternRow = std::array<PatternCell, kChannels>;
 
     std::optional<int> resolveSelectedPatternId(const nspc::NspcSong& song);
-    void rebuildPatternRows(const nspc::NspcSong& song, int patternId);
+    // Pass songMayHaveChanged = false only when every edit since the last call went through the command
+    // history; the per-frame refresh does, so an idle panel neither re-flattens nor rebuilds rows.
+    void rebuildPatternRows(const nspc::NspcSong& song, int patternId, bool songMayHaveChanged = true);
     bool handleKeyboardEditing(nspc::NspcSong& song, int patternId);
     void requestFxEditorOpen(int row, int channel, int effectIndex = -1);
     void openFxEditorForCell(size_t row, int channel, int effectIndex = -1);
@@ -190,7 +192,9 @@ private:
     app::AppState& appState_;
     nspc::NspcEditor editor_{};
     std::vector<PatternRow> rows_;
-    std::optional<nspc::NspcFlatPattern> flatPattern_;
+    nspc::NspcFlatPatternCache flatPatternCache_;
+    const nspc::NspcFlatPattern* flatPattern_ = nullptr;
+    std::optional<uint64_t> rowsGeneration_;
     nspc::NspcFlattenOptions flattenOptions_{};
 
     bool rowsTruncated_ = false;
@@ -70,6 +70,7 @@ private:
     bool saveProjectToPath(const std::filesystem::path& path);
     bool exportUserDataFromDialog();
     bool exportSpcFromDialog();
+    bool exportAllSpcsFromDialog();
     bool openUserGuide();
     void openItImportDialog();
     void drawItImportDialog();
@@ -77,6 +78,7 @@ private:
     bool executeItImportFromWorkbench();
     void drawItImportWarningsModal();
     void setFileStatus(std::string message, bool isError);
+    void reportSongDecodeError();
     void registerPanelVisibilitySettingsHandler();
     void parsePanelVisibilitySettingsLine(const char* line);
     void writePanelVisibilitySettings(ImGuiTextBuffer& outBuffer) const;
@@ -96,6 +98,7 @@ private:
     ExitCallback exitCallback_;
     std::string fileStatus_;
     bool fileStatusIsError_ = false;
+    std::string reportedDecodeError_;
     std::optional<std::filesystem::path> currentProjectPath_;
 
     SongPortDialog songPortDialog_;
@@ -0,0 +1,48 @@
+#include "ntrak/common/Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace ntrak::common {
+
+size_t hardwareWorkerCount() {
+    const unsigned int concurrency = std::thread::hardware_concurrency();
+    return std::max<size_t>(1u, static_cast<size_t>(concurrency));
+}
+
+void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxWorkers) {
+    if (count == 0) {
+        return;
+    }
+
+    const size_t workerLimit = (maxWorkers == 0) ? hardwareWorkerCount() : maxWorkers;
+    const size_t workerCount = std::min(workerLimit, count);
+    if (workerCount <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextIndex{0};
+    auto drain = [&]() {
+        for (size_t i = nextIndex.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = nextIndex.fetch_add(1, std::memory_order_relaxed)) {
+            body(i);
+        }
+    };
+
+    {
+        // The calling thread works too, so only spawn workerCount - 1 helpers.
+        std::vector<std::jthread> helpers;
+        helpers.reserve(workerCount - 1);
+        for (size_t i = 1; i < workerCount; ++i) {
+            helpers.emplace_back(drain);
+        }
+        drain();
+    }
+}
+
+}  // namespace ntrak::common
@@ -0,0 +1,154 @@
+#include "ntrak/nspc/NspcAramUsage.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace ntrak::nspc {
+
+NspcAramUsageMap::NspcAramUsageMap() {
+    clear();
+}
+
+void NspcAramUsageMap::clear() {
+    intervals_.clear();
+    intervals_.emplace(0u, Interval{.to = NspcAramUsage::kTotalAramBytes, .cover = {}});
+    bytes_.fill(0);
+    bytes_[static_cast<size_t>(NspcAramRegionKind::Free)] = NspcAramUsage::kTotalAramBytes;
+    sources_.clear();
+}
+
+void NspcAramUsageMap::setSource(uint32_t source, std::vector<NspcAramRegion> regions) {
+    removeSource(source);
+    if (regions.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+        const CoverId id = (static_cast<CoverId>(source) << 32) | (static_cast<CoverId>(i) << 8) |
+                           static_cast<CoverId>(regions[i].kind);
+        applyCover(id, regions[i].from, regions[i].to, true);
+    }
+    sources_[source] = std::move(regions);
+}
+
+void NspcAramUsageMap::removeSource(uint32_t source) {
+    const auto it = sources_.find(source);
+    if (it == sources_.end()) {
+        return;
+    }
+    const auto& regions = it->second;
+    for (size_t i = 0; i < regions.size(); ++i) {
+        const CoverId id = (static_cast<CoverId>(source) << 32) | (static_cast<CoverId>(i) << 8) |
+                           static_cast<CoverId>(regions[i].kind);
+        applyCover(id, regions[i].from, regions[i].to, false);
+    }
+    sources_.erase(it);
+}
+
+NspcAramUsage NspcAramUsageMap::usage() const {
+    NspcAramUsage usage;
+    usage.totalBytes = NspcAramUsage::kTotalAramBytes;
+    const auto bytes = [&](NspcAramRegionKind kind) { return bytes_[static_cast<size_t>(kind)]; };
+    usage.freeBytes = bytes(NspcAramRegionKind::Free);
+    usage.reservedBytes = bytes(NspcAramRegionKind::Reserved);
+    usage.songIndexBytes = bytes(NspcAramRegionKind::SongIndexTable);
+    usage.instrumentBytes = bytes(NspcAramRegionKind::InstrumentTable);
+    usage.sampleDirectoryBytes = bytes(NspcAramRegionKind::SampleDirectory);
+    usage.sampleDataBytes = bytes(NspcAramRegionKind::SampleData);
+    usage.sequenceBytes = bytes(NspcAramRegionKind::SequenceData);
+    usage.patternTableBytes = bytes(NspcAramRegionKind::PatternTable);
+    usage.trackBytes = bytes(NspcAramRegionKind::TrackData);
+    usage.subroutineBytes = bytes(NspcAramRegionKind::SubroutineData);
+    usage.usedBytes = usage.totalBytes - usage.freeBytes;
+
+    for (const auto& [from, interval] : intervals_) {
+        const NspcAramRegionKind kind = ownerOf(interval);
+        if (!usage.segments.empty() && usage.segments.back().kind == kind) {
+            usage.segments.back().to = interval.to;
+        } else {
+            usage.segments.push_back(NspcAramSegment{.from = from, .to = interval.to, .kind = kind});
+        }
+    }
+
+    size_t regionCount = 0;
+    for (const auto& [source, regions] : sources_) {
+        regionCount += regions.size();
+    }
+    usage.regions.reserve(regionCount);
+    for (const auto& [source, regions] : sources_) {
+        usage.regions.insert(usage.regions.end(), regions.begin(), regions.end());
+    }
+    std::stable_sort(usage.regions.begin(), usage.regions.end(),
+                     [](const NspcAramRegion& lhs, const NspcAramRegion& rhs) {
+                         if (lhs.from != rhs.from) {
+                             return lhs.from < rhs.from;
+                         }
+                         return lhs.to < rhs.to;
+                     });
+    return usage;
+}
+
+NspcAramRegionKind NspcAramUsageMap::ownerOf(const Interval& interval) {
+    if (interval.cover.empty()) {
+        return NspcAramRegionKind::Free;
+    }
+    return static_cast<NspcAramRegionKind>(interval.cover.front() & 0xFF);
+}
+
+std::map<uint32_t, NspcAramUsageMap::Interval>::iterator NspcAramUsageMap::splitAt(uint32_t address) {
+    if (address >= NspcAramUsage::kTotalAramBytes) {
+        return intervals_.end();
+    }
+    auto it = std::prev(intervals_.upper_bound(address));
+    if (it->first == address) {
+        return it;
+    }
+    Interval tail{.to = it->second.to, .cover = it->second.cover};
+    it->second.to = address;
+    return intervals_.emplace_hint(std::next(it), address, std::move(tail));
+}
+
+void NspcAramUsageMap::applyCover(CoverId id, uint32_t from, uint32_t to, bool add) {
+    to = std::min(to, NspcAramUsage::kTotalAramBytes);
+    if (to <= from) {
+        return;
+    }
+
+    auto it = splitAt(from);
+    const auto end = splitAt(to);
+    for (; it != end; ++it) {
+        Interval& interval = it->second;
+        const NspcAramRegionKind before = ownerOf(interval);
+        const auto pos = std::lower_bound(interval.cover.begin(), interval.cover.end(), id);
+        if (add) {
+            interval.cover.insert(pos, id);
+        } else if (pos != interval.cover.end() && *pos == id) {
+            interval.cover.erase(pos);
+        }
+        const NspcAramRegionKind after = ownerOf(interval);
+        if (before != after) {
+            const uint32_t length = interval.to - it->first;
+            bytes_[static_cast<size_t>(before)] -= length;
+            bytes_[static_cast<size_t>(after)] += length;
+        }
+    }
+    mergeAround(from, to);
+}
+
+void NspcAramUsageMap::mergeAround(uint32_t from, uint32_t to) {
+    auto it = intervals_.lower_bound(from);
+    if (it != intervals_.begin()) {
+        --it;
+    }
+    while (it != intervals_.end() && it->first <= to) {
+        const auto next = std::next(it);
+        if (next != intervals_.end() && next->second.cover == it->second.cover) {
+            it->second.to = next->second.to;
+            intervals_.erase(next);
+            continue;
+        }
+        it = next;
+    }
+}
+
+}  // namespace ntrak::nspc
@@ -0,0 +1,113 @@
+#include "ntrak/nspc/NspcBuildTelemetry.hpp"
+
+#include <nlohmann/json.hpp>
+
+namespace ntrak::nspc {
+
+using json = nlohmann::json;
+
+std::string_view buildStageName(NspcBuildStage stage) {
+    switch (stage) {
+    case NspcBuildStage::Flatten:
+        return "flatten";
+    case NspcBuildStage::Optimize:
+        return "optimize";
+    case NspcBuildStage::Encode:
+        return "encode";
+    case NspcBuildStage::Allocate:
+        return "allocate";
+    case NspcBuildStage::Patch:
+        return "patch";
+    case NspcBuildStage::ApplyToImage:
+        return "applyToImage";
+    }
+    return "unknown";
+}
+
+uint32_t NspcBuildTelemetry::emittedBytes() const {
+    return songIndexBytes + sequenceBytes + patternTableBytes + trackBytes + subroutineBytes + instrumentBytes + sampleDirectoryBytes +
+           sampleDataBytes + extensionPatchBytes;
+}
+
+double NspcBuildTelemetry::fragmentation() const {
+    if (freeBytes == 0) {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(largestFreeRangeBytes) / static_cast<double>(freeBytes);
+}
+
+void NspcBuildTelemetry::merge(const NspcBuildTelemetry& other) {
+    totalMilliseconds += other.totalMilliseconds;
+    for (size_t i = 0; i < kNspcBuildStageCount; ++i) {
+        stageMilliseconds[i] += other.stageMilliseconds[i];
+    }
+    songIndexBytes += other.songIndexBytes;
+    sequenceBytes += other.sequenceBytes;
+    patternTableBytes += other.patternTableBytes;
+    trackBytes += other.trackBytes;
+    subroutineBytes += other.subroutineBytes;
+    instrumentBytes += other.instrumentBytes;
+    sampleDirectoryBytes += other.sampleDirectoryBytes;
+    sampleDataBytes += other.sampleDataBytes;
+    extensionPatchBytes += other.extensionPatchBytes;
+    songsOptimized += other.songsOptimized;
+    optimizerIterations += other.optimizerIterations;
+    subroutinesCreated += other.subroutinesCreated;
+    optimizerBytesSaved += other.optimizerBytesSaved;
+    sharedSubroutinesReused += other.sharedSubroutinesReused;
+    sharedSubroutineBytesSaved += other.sharedSubroutineBytesSaved;
+    freeRangeCount = other.freeRangeCount;
+    freeBytes = other.freeBytes;
+    largestFreeRangeBytes = other.largestFreeRangeBytes;
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+}
+
+std::string buildTelemetryToJson(const NspcBuildTelemetry& telemetry, int indent) {
+    json stages = json::object();
+    for (size_t i = 0; i < kNspcBuildStageCount; ++i) {
+        stages[std::string(buildStageName(static_cast<NspcBuildStage>(i)))] = telemetry.stageMilliseconds[i];
+    }
+
+    json root = {
+        {"totalMs", telemetry.totalMilliseconds},
+        {"stageMs", std::move(stages)},
+        {"bytes",
+         {
+             {"songIndex", telemetry.songIndexBytes},
+             {"sequence", telemetry.sequenceBytes},
+             {"patternTable", telemetry.patternTableBytes},
+             {"track", telemetry.trackBytes},
+             {"subroutine", telemetry.subroutineBytes},
+             {"instrument", telemetry.instrumentBytes},
+             {"sampleDirectory", telemetry.sampleDirectoryBytes},
+             {"sampleData", telemetry.sampleDataBytes},
+             {"extensionPatch", telemetry.extensionPatchBytes},
+             {"total", telemetry.emittedBytes()},
+         }},
+        {"optimizer",
+         {
+             {"songs", telemetry.songsOptimized},
+             {"iterations", telemetry.optimizerIterations},
+             {"subroutinesCreated", telemetry.subroutinesCreated},
+             {"bytesSaved", telemetry.optimizerBytesSaved},
+             {"sharedSubroutinesReused", telemetry.sharedSubroutinesReused},
+             {"sharedBytesSaved", telemetry.sharedSubroutineBytesSaved},
+         }},
+        {"allocator",
+         {
+             {"freeRanges", telemetry.freeRangeCount},
+             {"freeBytes", telemetry.freeBytes},
+             {"largestFreeRange", telemetry.largestFreeRangeBytes},
+             {"fragmentation", telemetry.fragmentation()},
+         }},
+        {"cache",
+         {
+             {"hits", telemetry.cacheHits},
+             {"misses", telemetry.cacheMisses},
+         }},
+    };
+    return root.dump(indent);
+}
+
+}  // namespace ntrak::nspc
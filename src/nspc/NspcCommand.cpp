@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <format>
+#include <utility>
 
 namespace ntrak::nspc {
 
@@ -36,88 +37,367 @@ bool NspcCommandGroup::undo(NspcSong& song) {
     return anyUndone;
 }
 
+size_t NspcCommandGroup::memoryBytes() const {
+    size_t bytes = sizeof(*this) + description_.capacity();
+    for (const auto& cmd : commands_) {
+        bytes += cmd->memoryBytes();
+    }
+    return bytes;
+}
+
+void NspcCommandGroup::compact() {
+    for (auto& cmd : commands_) {
+        cmd->compact();
+    }
+}
+
+void NspcCommandGroup::collectChanges(NspcSongChanges& changes) const {
+    for (const auto& cmd : commands_) {
+        cmd->collectChanges(changes);
+    }
+}
+
 // ============================================================================
-// NspcCellCommand - State Capture/Restore
+// NspcCellCommand - Delta Recording/Replay
 // ============================================================================
 
-void NspcCellCommand::captureState(NspcSong& song, CellState& state) {
-    state.contentOrigin = song.contentOrigin();
+namespace {
 
-    // Capture full tracks vector (handles track creation/removal on undo)
-    state.allTracks = song.tracks();
+const NspcPattern* findPattern(const NspcSong& song, int patternId) {
+    const auto& patterns = song.patterns();
+    auto it = std::find_if(patterns.begin(), patterns.end(), [&](const NspcPattern& p) { return p.id == patternId; });
+    return it != patterns.end() ? &*it : nullptr;
+}
 
-    // Find the pattern and capture channel track mapping
-    auto patternIt = std::find_if(song.patterns().begin(), song.patterns().end(),
-                                   [this](const NspcPattern& p) { return p.id == location_.patternId; });
+void spliceEvents(std::vector<NspcEventEntry>& events, size_t start, size_t eraseCount,
+                  const std::vector<NspcEventEntry>& replacement) {
+    const auto at = events.begin() + static_cast<std::ptrdiff_t>(start);
+    events.erase(at, at + static_cast<std::ptrdiff_t>(eraseCount));
+    events.insert(events.begin() + static_cast<std::ptrdiff_t>(start), replacement.begin(), replacement.end());
+}
+
+}  // namespace
 
-    if (patternIt != song.patterns().end()) {
-        state.patternChannelTrackIds = patternIt->channelTrackIds;
+bool NspcCellCommand::execute(NspcSong& song) {
+    if (recorded_) {
+        if (!expand() || !replay(song, true)) {
+            return false;
+        }
+        return editResult_;
     }
 
-    // Capture subroutine state (edits on subroutine rows modify subroutine events directly)
-    state.subroutineSnapshots.clear();
-    for (const auto& sub : song.subroutines()) {
-        state.subroutineSnapshots.push_back(CellState::SubroutineSnapshot{
-            .id = sub.id,
-            .events = sub.events,
-        });
+    // The edit runs on a copy (sharing storage until its first write) and is replayed onto `song`, so `song` keeps
+    // its own storage: references into it that callers hold stay valid instead of ending up in the snapshot.
+    {
+        NspcSong edited = song;
+        editResult_ = applyEdit(edited);
+        recordDelta(song, edited);
+        song.setNextEventId(edited.peekNextEventId());
     }
+    recorded_ = true;
+    return replay(song, true) && editResult_;
 }
 
-void NspcCellCommand::restoreState(NspcSong& song, const CellState& state) {
-    song.setContentOrigin(state.contentOrigin);
+bool NspcCellCommand::undo(NspcSong& song) {
+    if (!recorded_ || !expand()) {
+        return false;
+    }
+    return replay(song, false);
+}
 
-    // Restore full tracks vector (cleans up any tracks created during execute)
-    song.tracks() = state.allTracks;
+size_t NspcCellCommand::memoryBytes() const {
+    size_t bytes = sizeof(*this) + delta_.splices.capacity() * sizeof(EventSplice) +
+                   (delta_.droppedTracks.capacity() + delta_.addedTracks.capacity()) * sizeof(NspcTrack);
+    for (const auto& splice : delta_.splices) {
+        bytes += (splice.removed.capacity() + splice.inserted.capacity()) * sizeof(NspcEventEntry);
+    }
+    for (const auto& track : delta_.droppedTracks) {
+        bytes += track.events.capacity() * sizeof(NspcEventEntry);
+    }
+    for (const auto& track : delta_.addedTracks) {
+        bytes += track.events.capacity() * sizeof(NspcEventEntry);
+    }
+    if (compacted_) {
+        bytes += packedEvents_.memoryBytes() - sizeof(packedEvents_) + packedListSizes_.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
 
-    // Find the pattern and restore channel track mapping
-    auto patternIt = std::find_if(song.patterns().begin(), song.patterns().end(),
-                                   [this](NspcPattern& p) { return p.id == location_.patternId; });
+template <typename Fn>
+void NspcCellCommand::forEachEventList(Fn&& fn) {
+    for (auto& splice : delta_.splices) {
+        fn(splice.removed);
+        fn(splice.inserted);
+    }
+    for (auto& track : delta_.droppedTracks) {
+        fn(track.events);
+    }
+    for (auto& track : delta_.addedTracks) {
+        fn(track.events);
+    }
+}
 
-    if (patternIt != song.patterns().end()) {
-        patternIt->channelTrackIds = state.patternChannelTrackIds;
+void NspcCellCommand::compact() {
+    if (!recorded_ || compacted_) {
+        return;
     }
 
-    // Restore subroutine state
-    for (const auto& snapshot : state.subroutineSnapshots) {
-        auto subIt = std::find_if(song.subroutines().begin(), song.subroutines().end(),
-                                   [&](const NspcSubroutine& s) { return s.id == snapshot.id; });
-        if (subIt != song.subroutines().end()) {
-            subIt->events = snapshot.events;
-        }
+    // Every list goes into one packed stream, so the record carries a single id table and checkpoint list.
+    std::vector<NspcEventEntry> concatenated;
+    std::vector<uint32_t> listSizes;
+    forEachEventList([&](const std::vector<NspcEventEntry>& events) {
+        concatenated.insert(concatenated.end(), events.begin(), events.end());
+        listSizes.push_back(static_cast<uint32_t>(events.size()));
+    });
+    // Only lists that decode back exactly are packed; anything else keeps the record live.
+    auto packed = NspcPackedEventList::pack(concatenated);
+    if (!packed.has_value() || packed->unpack() != concatenated) {
+        return;
     }
+
+    forEachEventList([](std::vector<NspcEventEntry>& events) { std::vector<NspcEventEntry>().swap(events); });
+    packedEvents_ = std::move(*packed);
+    listSizes.shrink_to_fit();
+    packedListSizes_ = std::move(listSizes);
+    compacted_ = true;
 }
 
-// ============================================================================
-// SetRowEventCommand
-// ============================================================================
+void NspcCellCommand::collectChanges(NspcSongChanges& changes) const {
+    if (!recorded_) {
+        changes.all = true;
+        return;
+    }
+    auto& slots = changes.owners;
+    for (const auto& splice : delta_.splices) {
+        slots.push_back(NspcEventOwnerSlot{.owner = splice.owner, .index = splice.ownerIndex});
+    }
+    for (const auto& change : delta_.headerChanges) {
+        slots.push_back(NspcEventOwnerSlot{.owner = NspcEventOwner::Track, .index = change.index});
+    }
+    const size_t common = std::min(delta_.trackCountBefore, delta_.trackCountAfter);
+    for (size_t index = common; index < std::max(delta_.trackCountBefore, delta_.trackCountAfter); ++index) {
+        slots.push_back(NspcEventOwnerSlot{.owner = NspcEventOwner::Track, .index = index});
+    }
+    if (delta_.patternChannelTrackIdsBefore != delta_.patternChannelTrackIdsAfter) {
+        changes.patternIds.push_back(location_.patternId);
+    }
+}
 
-SetRowEventCommand::SetRowEventCommand(const NspcEditorLocation& location, const NspcRowEvent& event)
-    : event_(event) {
-    location_ = location;
+bool NspcCellCommand::expand() {
+    if (!compacted_) {
+        return true;
+    }
+
+    auto it = packedEvents_.begin();
+    size_t next = 0;
+    forEachEventList([&](std::vector<NspcEventEntry>& events) {
+        events.reserve(packedListSizes_[next]);
+        for (uint32_t i = 0; i < packedListSizes_[next]; ++i, ++it) {
+            events.push_back(*it);
+        }
+        ++next;
+    });
+    packedEvents_ = {};
+    packedListSizes_ = {};
+    compacted_ = false;
+    return true;
 }
 
-bool SetRowEventCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
+void NspcCellCommand::appendSplice(std::vector<EventSplice>& splices, NspcEventOwner owner, size_t ownerIndex,
+                                   std::pair<int, int> ownerIds, const std::vector<NspcEventEntry>& before,
+                                   const std::vector<NspcEventEntry>& after) {
+    const size_t shorter = std::min(before.size(), after.size());
+    size_t prefix = 0;
+    while (prefix < shorter && before[prefix] == after[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < shorter - prefix &&
+           before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    if (prefix + suffix == before.size() && prefix + suffix == after.size()) {
+        return;
+    }
+
+    splices.push_back(EventSplice{
+        .owner = owner,
+        .ownerIndex = ownerIndex,
+        .ownerIdBefore = ownerIds.first,
+        .ownerIdAfter = ownerIds.second,
+        .start = prefix,
+        .removed = std::vector<NspcEventEntry>(before.begin() + static_cast<std::ptrdiff_t>(prefix),
+                                               before.end() - static_cast<std::ptrdiff_t>(suffix)),
+        .inserted = std::vector<NspcEventEntry>(after.begin() + static_cast<std::ptrdiff_t>(prefix),
+                                                after.end() - static_cast<std::ptrdiff_t>(suffix)),
+    });
+}
+
+void NspcCellCommand::recordDelta(const NspcSong& before, const NspcSong& after) {
+    delta_ = CellDelta{};
+    delta_.contentOriginBefore = before.contentOrigin();
+    delta_.contentOriginAfter = after.contentOrigin();
+
+    const NspcPattern* patternBefore = findPattern(before, location_.patternId);
+    const NspcPattern* patternAfter = findPattern(after, location_.patternId);
+    if (patternBefore != nullptr && patternAfter != nullptr) {
+        delta_.patternFound = true;
+        delta_.patternChannelTrackIdsBefore = patternBefore->channelTrackIds;
+        delta_.patternChannelTrackIdsAfter = patternAfter->channelTrackIds;
+    }
+
+    // Unwritten storage is still shared with `before`, so untouched lists are skipped without a scan.
+    const auto& tracksBefore = before.tracks();
+    const auto& tracksAfter = after.tracks();
+    delta_.trackCountBefore = tracksBefore.size();
+    delta_.trackCountAfter = tracksAfter.size();
+    if (&tracksBefore != &tracksAfter) {
+        const size_t common = std::min(tracksBefore.size(), tracksAfter.size());
+        for (size_t i = 0; i < common; ++i) {
+            const NspcTrack& trackBefore = tracksBefore[i];
+            const NspcTrack& trackAfter = tracksAfter[i];
+            if (trackBefore.id != trackAfter.id || trackBefore.originalAddr != trackAfter.originalAddr) {
+                delta_.headerChanges.push_back(TrackHeaderChange{
+                    .index = i,
+                    .idBefore = trackBefore.id,
+                    .idAfter = trackAfter.id,
+                    .addrBefore = trackBefore.originalAddr,
+                    .addrAfter = trackAfter.originalAddr,
+                });
+            }
+            appendSplice(delta_.splices, NspcEventOwner::Track, i, {trackBefore.id, trackAfter.id}, trackBefore.events,
+                         trackAfter.events);
+        }
+        delta_.droppedTracks.assign(tracksBefore.begin() + static_cast<std::ptrdiff_t>(common), tracksBefore.end());
+        delta_.addedTracks.assign(tracksAfter.begin() + static_cast<std::ptrdiff_t>(common), tracksAfter.end());
+    }
+
+    // Cell edits only rewrite subroutine events; subroutines are matched by id like the editor does.
+    const auto& subroutinesBefore = before.subroutines();
+    const auto& subroutinesAfter = after.subroutines();
+    if (&subroutinesBefore != &subroutinesAfter) {
+        const size_t common = std::min(subroutinesBefore.size(), subroutinesAfter.size());
+        for (size_t i = 0; i < common; ++i) {
+            if (subroutinesBefore[i].id == subroutinesAfter[i].id) {
+                appendSplice(delta_.splices, NspcEventOwner::Subroutine, i,
+                             {subroutinesBefore[i].id, subroutinesAfter[i].id}, subroutinesBefore[i].events,
+                             subroutinesAfter[i].events);
+            }
+        }
     }
+}
 
-    NspcEditor editor;
-    bool result = editor.setRowEvent(song, location_, event_);
+bool NspcCellCommand::canReplay(const NspcSong& song, bool forward) const {
+    if (delta_.patternFound && delta_.patternChannelTrackIdsBefore != delta_.patternChannelTrackIdsAfter) {
+        const NspcPattern* pattern = findPattern(song, location_.patternId);
+        if (pattern == nullptr || pattern->channelTrackIds != (forward ? delta_.patternChannelTrackIdsBefore
+                                                                        : delta_.patternChannelTrackIdsAfter)) {
+            return false;
+        }
+    }
 
-    if (result) {
-        captureState(song, afterState_);
+    const bool tracksChanged = !delta_.splices.empty() || !delta_.headerChanges.empty() ||
+                               delta_.trackCountBefore != delta_.trackCountAfter;
+    if (!tracksChanged) {
+        return true;
     }
 
-    return result;
+    const auto& tracks = song.tracks();
+    if (tracks.size() != (forward ? delta_.trackCountBefore : delta_.trackCountAfter)) {
+        return false;
+    }
+    const size_t common = std::min(delta_.trackCountBefore, delta_.trackCountAfter);
+    const auto& tailTracks = forward ? delta_.droppedTracks : delta_.addedTracks;
+    for (size_t i = 0; i < tailTracks.size(); ++i) {
+        const NspcTrack& track = tracks[common + i];
+        if (track.id != tailTracks[i].id || track.events != tailTracks[i].events) {
+            return false;
+        }
+    }
+    for (const auto& change : delta_.headerChanges) {
+        if (tracks[change.index].id != (forward ? change.idBefore : change.idAfter)) {
+            return false;
+        }
+    }
+
+    const auto& subroutines = song.subroutines();
+    for (const auto& splice : delta_.splices) {
+        const bool isTrack = splice.owner == NspcEventOwner::Track;
+        if (splice.ownerIndex >= (isTrack ? tracks.size() : subroutines.size())) {
+            return false;
+        }
+        const int ownerId = isTrack ? tracks[splice.ownerIndex].id : subroutines[splice.ownerIndex].id;
+        const auto& events = isTrack ? tracks[splice.ownerIndex].events : subroutines[splice.ownerIndex].events;
+        const auto& expected = forward ? splice.removed : splice.inserted;
+        if (ownerId != (forward ? splice.ownerIdBefore : splice.ownerIdAfter) ||
+            splice.start + expected.size() > events.size() ||
+            !std::equal(expected.begin(), expected.end(), events.begin() + static_cast<std::ptrdiff_t>(splice.start))) {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool SetRowEventCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
+bool NspcCellCommand::replay(NspcSong& song, bool forward) const {
+    if (!canReplay(std::as_const(song), forward)) {
+        return false;
+    }
+
+    song.setContentOrigin(forward ? delta_.contentOriginAfter : delta_.contentOriginBefore);
+
+    if (delta_.patternFound && delta_.patternChannelTrackIdsBefore != delta_.patternChannelTrackIdsAfter) {
+        auto& patterns = song.patterns();
+        auto it = std::find_if(patterns.begin(), patterns.end(),
+                               [this](const NspcPattern& p) { return p.id == location_.patternId; });
+        if (it != patterns.end()) {
+            it->channelTrackIds =
+                forward ? delta_.patternChannelTrackIdsAfter : delta_.patternChannelTrackIdsBefore;
+        }
+    }
+
+    const bool tracksChanged = !delta_.splices.empty() || !delta_.headerChanges.empty() ||
+                               delta_.trackCountBefore != delta_.trackCountAfter;
+    if (!tracksChanged) {
+        return true;
+    }
+
+    auto& tracks = song.tracks();
+    const size_t common = std::min(delta_.trackCountBefore, delta_.trackCountAfter);
+    const auto& tailTracks = forward ? delta_.addedTracks : delta_.droppedTracks;
+    tracks.resize(common);
+    tracks.insert(tracks.end(), tailTracks.begin(), tailTracks.end());
+
+    for (const auto& change : delta_.headerChanges) {
+        tracks[change.index].id = forward ? change.idAfter : change.idBefore;
+        tracks[change.index].originalAddr = forward ? change.addrAfter : change.addrBefore;
+    }
+
+    for (const auto& splice : delta_.splices) {
+        auto& events = splice.owner == NspcEventOwner::Track ? tracks[splice.ownerIndex].events
+                                                             : song.subroutines()[splice.ownerIndex].events;
+        if (forward) {
+            spliceEvents(events, splice.start, splice.removed.size(), splice.inserted);
+        } else {
+            spliceEvents(events, splice.start, splice.inserted.size(), splice.removed);
+        }
+    }
     return true;
 }
 
+// ============================================================================
+// SetRowEventCommand
+// ============================================================================
+
+SetRowEventCommand::SetRowEventCommand(const NspcEditorLocation& location, const NspcRowEvent& event)
+    : event_(event) {
+    location_ = location;
+}
+
+bool SetRowEventCommand::applyEdit(NspcSong& song) {
+    NspcEditor editor;
+    return editor.setRowEvent(song, location_, event_);
+}
+
 std::string SetRowEventCommand::description() const {
     if (std::holds_alternative<Note>(event_)) {
         return "Set Note";
@@ -142,25 +422,9 @@ DeleteRowEventCommand::DeleteRowEventCommand(const NspcEditorLocation& location)
     location_ = location;
 }
 
-bool DeleteRowEventCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool DeleteRowEventCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.deleteRowEvent(song, location_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool DeleteRowEventCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.deleteRowEvent(song, location_);
 }
 
 std::string DeleteRowEventCommand::description() const {
@@ -175,25 +439,9 @@ InsertTickCommand::InsertTickCommand(const NspcEditorLocation& location) {
     location_ = location;
 }
 
-bool InsertTickCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool InsertTickCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.insertTickAtRow(song, location_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool InsertTickCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.insertTickAtRow(song, location_);
 }
 
 std::string InsertTickCommand::description() const {
@@ -208,25 +456,9 @@ RemoveTickCommand::RemoveTickCommand(const NspcEditorLocation& location) {
     location_ = location;
 }
 
-bool RemoveTickCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool RemoveTickCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.removeTickAtRow(song, location_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool RemoveTickCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.removeTickAtRow(song, location_);
 }
 
 std::string RemoveTickCommand::description() const {
@@ -242,25 +474,9 @@ SetInstrumentCommand::SetInstrumentCommand(const NspcEditorLocation& location, s
     location_ = location;
 }
 
-bool SetInstrumentCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool SetInstrumentCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.setInstrumentAtRow(song, location_, instrument_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool SetInstrumentCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.setInstrumentAtRow(song, location_, instrument_);
 }
 
 std::string SetInstrumentCommand::description() const {
@@ -279,25 +495,9 @@ SetVolumeCommand::SetVolumeCommand(const NspcEditorLocation& location, std::opti
     location_ = location;
 }
 
-bool SetVolumeCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool SetVolumeCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.setVolumeAtRow(song, location_, volume_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool SetVolumeCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.setVolumeAtRow(song, location_, volume_);
 }
 
 std::string SetVolumeCommand::description() const {
@@ -316,25 +516,9 @@ SetQvCommand::SetQvCommand(const NspcEditorLocation& location, std::optional<uin
     location_ = location;
 }
 
-bool SetQvCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool SetQvCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
-    bool result = editor.setQvAtRow(song, location_, qv_);
-
-    if (result) {
-        captureState(song, afterState_);
-    }
-
-    return result;
-}
-
-bool SetQvCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
+    return editor.setQvAtRow(song, location_, qv_);
 }
 
 std::string SetQvCommand::description() const {
@@ -354,12 +538,7 @@ SetEffectsCommand::SetEffectsCommand(const NspcEditorLocation& location, std::ve
     location_ = location;
 }
 
-bool SetEffectsCommand::execute(NspcSong& song) {
-    if (!capturedBefore_) {
-        captureState(song, beforeState_);
-        capturedBefore_ = true;
-    }
-
+bool SetEffectsCommand::applyEdit(NspcSong& song) {
     NspcEditor editor;
 
     // Clear existing effects first
@@ -372,18 +551,9 @@ bool SetEffectsCommand::execute(NspcSong& song) {
         result = result || added;  // Success if any operation succeeded
     }
 
-    if (result) {
-        captureState(song, afterState_);
-    }
-
     return result;
 }
 
-bool SetEffectsCommand::undo(NspcSong& song) {
-    restoreState(song, beforeState_);
-    return true;
-}
-
 std::string SetEffectsCommand::description() const {
     if (effects_.empty()) {
         return "Clear Effects";
@@ -394,4 +564,42 @@ std::string SetEffectsCommand::description() const {
     return std::format("Set {} Effects", effects_.size());
 }
 
+// ============================================================================
+// CellEditsCommand
+// ============================================================================
+
+CellEditsCommand::CellEditsCommand(std::string description, std::vector<NspcCellEdit> edits)
+    : description_(std::move(description)), edits_(std::move(edits)) {
+    if (!edits_.empty()) {
+        location_ = edits_.front().location;
+    }
+}
+
+bool CellEditsCommand::applyEdit(NspcSong& song) {
+    // The recorded delta covers one pattern's channel assignments only.
+    std::erase_if(edits_, [this](const NspcCellEdit& edit) { return edit.location.patternId != location_.patternId; });
+
+    NspcEditSession session(song);
+    const bool changed = session.apply(edits_);
+    edits_ = {};
+    return changed;
+}
+
+// ============================================================================
+// TransformEventsCommand
+// ============================================================================
+
+TransformEventsCommand::TransformEventsCommand(std::string description, NspcEventSelection selection,
+                                               NspcEventTransform transform, bool parallel)
+    : description_(std::move(description)), selection_(std::move(selection)), transform_(std::move(transform)),
+      parallel_(parallel) {}
+
+bool TransformEventsCommand::applyEdit(NspcSong& song) {
+    NspcEditor editor;
+    const bool changed = transform_ ? editor.transformEvents(song, selection_, transform_, parallel_) : false;
+    selection_ = {};
+    transform_ = nullptr;
+    return changed;
+}
+
 }  // namespace ntrak::nspc
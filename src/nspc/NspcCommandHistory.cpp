@@ -15,6 +15,8 @@ bool NspcCommandHistory::execute(NspcSong& song, std::unique_ptr<NspcCommand> co
     if (!command->execute(song)) {
         return false;
     }
+    ++revision_;
+    publishChanges(song, *command);
 
     // If we're in a group, add to the group for undo purposes
     if (currentGroup_) {
@@ -27,10 +29,11 @@ bool NspcCommandHistory::execute(NspcSong& song, std::unique_ptr<NspcCommand> co
     clearRedoStack();
 
     // Add to history
+    historyBytes_ += command->memoryBytes();
     history_.push_back(std::move(command));
     currentIndex_ = history_.size();
 
-    // Trim if we exceed max size
+    // Trim if we exceed the byte budget
     trimHistory();
 
     return true;
@@ -50,7 +53,14 @@ bool NspcCommandHistory::undo(NspcSong& song) {
     }
 
     --currentIndex_;
-    return history_[currentIndex_]->undo(song);
+    NspcCommand& command = *history_[currentIndex_];
+    const size_t bytesBefore = command.memoryBytes();
+    const bool result = command.undo(song);
+    ++revision_;
+    publishChanges(song, command);
+    historyBytes_ = historyBytes_ - bytesBefore + command.memoryBytes();
+    compactDistantCommands();
+    return result;
 }
 
 bool NspcCommandHistory::redo(NspcSong& song) {
@@ -58,10 +68,16 @@ bool NspcCommandHistory::redo(NspcSong& song) {
         return false;
     }
 
-    bool result = history_[currentIndex_]->execute(song);
+    NspcCommand& command = *history_[currentIndex_];
+    const size_t bytesBefore = command.memoryBytes();
+    bool result = command.execute(song);
+    ++revision_;
+    publishChanges(song, command);
+    historyBytes_ = historyBytes_ - bytesBefore + command.memoryBytes();
     if (result) {
         ++currentIndex_;
     }
+    compactDistantCommands();
     return result;
 }
 
@@ -99,10 +115,11 @@ void NspcCommandHistory::endGroup() {
         clearRedoStack();
 
         // Add group to history
+        historyBytes_ += currentGroup_->memoryBytes();
         history_.push_back(std::move(currentGroup_));
         currentIndex_ = history_.size();
 
-        // Trim if needed
+        // Trim if we exceed the byte budget
         trimHistory();
     }
 
@@ -112,7 +129,14 @@ void NspcCommandHistory::endGroup() {
 void NspcCommandHistory::clear() {
     history_.clear();
     currentIndex_ = 0;
+    historyBytes_ = 0;
     currentGroup_.reset();
+    ++revision_;
+}
+
+void NspcCommandHistory::setMaxHistoryBytes(size_t bytes) {
+    maxHistoryBytes_ = bytes;
+    trimHistory();
 }
 
 size_t NspcCommandHistory::redoStackSize() const {
@@ -120,18 +144,69 @@ size_t NspcCommandHistory::redoStackSize() const {
 }
 
 void NspcCommandHistory::trimHistory() {
-    if (history_.size() <= maxHistorySize_) {
+    compactDistantCommands();
+
+    // Remove oldest commands, always keeping the newest one undoable
+    size_t toRemove = 0;
+    size_t bytes = historyBytes_;
+    while (bytes > maxHistoryBytes_ && toRemove + 1 < currentIndex_) {
+        bytes -= history_[toRemove]->memoryBytes();
+        ++toRemove;
+    }
+    if (toRemove == 0) {
         return;
     }
 
-    // Remove oldest commands
-    size_t toRemove = history_.size() - maxHistorySize_;
     history_.erase(history_.begin(), history_.begin() + static_cast<std::ptrdiff_t>(toRemove));
-    currentIndex_ = std::min(currentIndex_, history_.size());
+    currentIndex_ -= toRemove;
+    historyBytes_ = bytes;
+}
+
+void NspcCommandHistory::compactDistantCommands() {
+    // Commands near the current position stay live so stepping back and forth costs no decoding. The
+    // position only ever moves one step, so only the command just outside the window on each side can
+    // have become distant; everything beyond was compacted when it crossed.
+    if (currentIndex_ > kUncompactedCommands) {
+        compactCommand(currentIndex_ - 1 - kUncompactedCommands);
+    }
+    compactCommand(currentIndex_ + kUncompactedCommands);
+}
+
+void NspcCommandHistory::compactCommand(size_t index) {
+    if (index >= history_.size()) {
+        return;
+    }
+    NspcCommand& command = *history_[index];
+    const size_t bytesBefore = command.memoryBytes();
+    command.compact();
+    historyBytes_ = historyBytes_ - bytesBefore + command.memoryBytes();
+}
+
+size_t NspcCommandHistory::subscribe(ChangeListener listener) {
+    const size_t subscription = nextSubscription_++;
+    listeners_.emplace_back(subscription, std::move(listener));
+    return subscription;
+}
+
+void NspcCommandHistory::unsubscribe(size_t subscription) {
+    std::erase_if(listeners_, [&](const auto& entry) { return entry.first == subscription; });
+}
+
+void NspcCommandHistory::publishChanges(NspcSong& song, const NspcCommand& command) {
+    NspcSongChanges changes;
+    command.collectChanges(changes);
+    song.touch(changes);
+    for (const auto& [subscription, listener] : listeners_) {
+        (void)subscription;
+        listener(song, changes);
+    }
 }
 
 void NspcCommandHistory::clearRedoStack() {
     if (currentIndex_ < history_.size()) {
+        for (size_t i = currentIndex_; i < history_.size(); ++i) {
+            historyBytes_ -= history_[i]->memoryBytes();
+        }
         history_.erase(history_.begin() + static_cast<std::ptrdiff_t>(currentIndex_), history_.end());
     }
 }
@@ -1,5 +1,7 @@
 #include "NspcCompileShared.hpp"
 
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
 #include <algorithm>
 #include <array>
 #include <functional>
@@ -105,6 +107,15 @@ uint32_t totalRangeBytes(const std::vector<AddressRange>& ranges) {
     return total;
 }
 
+void recordFreeRanges(const std::vector<AddressRange>& freeRanges, NspcBuildTelemetry& telemetry) {
+    telemetry.freeRangeCount = static_cast<uint32_t>(freeRanges.size());
+    telemetry.freeBytes = totalRangeBytes(freeRanges);
+    telemetry.largestFreeRangeBytes = 0;
+    for (const auto& range : freeRanges) {
+        telemetry.largestFreeRangeBytes = std::max(telemetry.largestFreeRangeBytes, range.to - range.from);
+    }
+}
+
 void consumeAllocatedRange(std::vector<AddressRange>& freeRanges, uint32_t start, uint32_t size) {
     const uint32_t end = start + size;
     for (size_t i = 0; i < freeRanges.size(); ++i) {
@@ -171,7 +182,7 @@ std::optional<uint16_t> allocateFromFreeRanges(std::vector<AddressRange>& freeRa
     return std::nullopt;
 }
 
-std::optional<uint16_t> readSongSequencePointer(emulation::AramView aram, const NspcEngineConfig& engine,
+std::optional<uint16_t> readSongSequencePointer(emulation::ConstAramView aram, const NspcEngineConfig& engine,
                                                 size_t songIndex) {
     if (engine.songIndexPointers == 0) {
         return std::nullopt;
@@ -225,68 +236,6 @@ std::expected<void, std::string> encodeVcmd(const Vcmd& cmd, std::vector<uint8_t
 
     std::visit(nspc::overloaded{
                    [&](const std::monostate&) { warnings.push_back("Encountered empty VCMD; skipped"); },
-                   [&](const VcmdInst& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.instrumentIndex);
-                   },
-                   [&](const VcmdPanning& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.panning);
-                   },
-                   [&](const VcmdPanFade& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                       appendU8(out, value.target);
-                   },
-                   [&](const VcmdVibratoOn& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.rate);
-                       appendU8(out, value.depth);
-                   },
-                   [&](const VcmdVibratoOff& value) { encodeValueId(value); },
-                   [&](const VcmdGlobalVolume& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.volume);
-                   },
-                   [&](const VcmdGlobalVolumeFade& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                       appendU8(out, value.target);
-                   },
-                   [&](const VcmdTempo& value) {
-                       encodeValueId(value);
-                       appendU8(out, static_cast<uint8_t>(value.tempo & 0xFF));
-                   },
-                   [&](const VcmdTempoFade& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                       appendU8(out, static_cast<uint8_t>(value.target & 0xFF));
-                   },
-                   [&](const VcmdGlobalTranspose& value) {
-                       encodeValueId(value);
-                       appendU8(out, static_cast<uint8_t>(value.semitones));
-                   },
-                   [&](const VcmdPerVoiceTranspose& value) {
-                       encodeValueId(value);
-                       appendU8(out, static_cast<uint8_t>(value.semitones));
-                   },
-                   [&](const VcmdTremoloOn& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.rate);
-                       appendU8(out, value.depth);
-                   },
-                   [&](const VcmdTremoloOff& value) { encodeValueId(value); },
-                   [&](const VcmdVolume& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.volume);
-                   },
-                   [&](const VcmdVolumeFade& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                       appendU8(out, value.target);
-                   },
                    [&](const VcmdSubroutineCall& value) {
                        encodeValueId(value);
                        uint16_t subroutineAddr = value.originalAddr;
@@ -300,64 +249,6 @@ std::expected<void, std::string> encodeVcmd(const Vcmd& cmd, std::vector<uint8_t
                        appendU16(out, subroutineAddr);
                        appendU8(out, value.count);
                    },
-                   [&](const VcmdVibratoFadeIn& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                   },
-                   [&](const VcmdPitchEnvelopeTo& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.length);
-                       appendU8(out, value.semitone);
-                   },
-                   [&](const VcmdPitchEnvelopeFrom& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.length);
-                       appendU8(out, value.semitone);
-                   },
-                   [&](const VcmdPitchEnvelopeOff& value) { encodeValueId(value); },
-                   [&](const VcmdFineTune& value) {
-                       encodeValueId(value);
-                       appendU8(out, static_cast<uint8_t>(value.semitones));
-                   },
-                   [&](const VcmdEchoOn& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.channels);
-                       appendU8(out, value.left);
-                       appendU8(out, value.right);
-                   },
-                   [&](const VcmdEchoOff& value) { encodeValueId(value); },
-                   [&](const VcmdEchoParams& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.feedback);
-                       appendU8(out, value.firIndex);
-                   },
-                   [&](const VcmdEchoVolumeFade& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.time);
-                       appendU8(out, value.leftTarget);
-                       appendU8(out, value.rightTarget);
-                   },
-                   [&](const VcmdPitchSlideToNote& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.delay);
-                       appendU8(out, value.length);
-                       appendU8(out, value.note);
-                   },
-                   [&](const VcmdPercussionBaseInstrument& value) {
-                       encodeValueId(value);
-                       appendU8(out, value.index);
-                   },
-                   [&](const VcmdNOP& value) {
-                       encodeValueId(value);
-                       appendU16(out, value.nopBytes);
-                   },
-                   [&](const VcmdMuteChannel& value) { encodeValueId(value); },
-                   [&](const VcmdFastForwardOn& value) { encodeValueId(value); },
-                   [&](const VcmdFastForwardOff& value) { encodeValueId(value); },
-                   [&](const VcmdUnused& value) { encodeValueId(value); },
                    [&](const VcmdExtension& value) {
                        const auto extensionParamCount = extensionVcmdParamByteCount(engine, value.id, true);
                        if (!extensionParamCount.has_value()) {
@@ -377,6 +268,12 @@ std::expected<void, std::string> encodeVcmd(const Vcmd& cmd, std::vector<uint8_t
                            appendU8(out, value.params[i]);
                        }
                    },
+                   [&]<typename T>(const T& value) {
+                       encodeValueId(value);
+                       VcmdParamBytes params{};
+                       VcmdParamLayout<T>::write(value, params.data());
+                       out.insert(out.end(), params.begin(), params.begin() + VcmdParamLayout<T>::paramCount);
+                   },
                },
                cmd.vcmd);
 
@@ -478,46 +375,6 @@ std::expected<std::vector<uint8_t>, std::string> encodeEventStream(
     return out;
 }
 
-uint32_t vcmdEncodedSize(const Vcmd& value) {
-    return std::visit(nspc::overloaded{
-                          [](const std::monostate&) { return 0u; },
-                          [](const VcmdInst&) { return 2u; },
-                          [](const VcmdPanning&) { return 2u; },
-                          [](const VcmdPanFade&) { return 3u; },
-                          [](const VcmdVibratoOn&) { return 4u; },
-                          [](const VcmdVibratoOff&) { return 1u; },
-                          [](const VcmdGlobalVolume&) { return 2u; },
-                          [](const VcmdGlobalVolumeFade&) { return 3u; },
-                          [](const VcmdTempo&) { return 2u; },
-                          [](const VcmdTempoFade&) { return 3u; },
-                          [](const VcmdGlobalTranspose&) { return 2u; },
-                          [](const VcmdPerVoiceTranspose&) { return 2u; },
-                          [](const VcmdTremoloOn&) { return 4u; },
-                          [](const VcmdTremoloOff&) { return 1u; },
-                          [](const VcmdVolume&) { return 2u; },
-                          [](const VcmdVolumeFade&) { return 3u; },
-                          [](const VcmdSubroutineCall&) { return 4u; },
-                          [](const VcmdVibratoFadeIn&) { return 2u; },
-                          [](const VcmdPitchEnvelopeTo&) { return 4u; },
-                          [](const VcmdPitchEnvelopeFrom&) { return 4u; },
-                          [](const VcmdPitchEnvelopeOff&) { return 1u; },
-                          [](const VcmdFineTune&) { return 2u; },
-                          [](const VcmdEchoOn&) { return 4u; },
-                          [](const VcmdEchoOff&) { return 1u; },
-                          [](const VcmdEchoParams&) { return 4u; },
-                          [](const VcmdEchoVolumeFade&) { return 4u; },
-                          [](const VcmdPitchSlideToNote&) { return 4u; },
-                          [](const VcmdPercussionBaseInstrument&) { return 2u; },
-                          [](const VcmdNOP&) { return 3u; },
-                          [](const VcmdMuteChannel&) { return 1u; },
-                          [](const VcmdFastForwardOn&) { return 1u; },
-                          [](const VcmdFastForwardOff&) { return 1u; },
-                          [](const VcmdUnused&) { return 1u; },
-                          [](const VcmdExtension& value) { return static_cast<uint32_t>(1u + value.paramCount); },
-                      },
-                      value.vcmd);
-}
-
 uint32_t eventEncodedSize(const NspcEventEntry& entry) {
     return std::visit(nspc::overloaded{
                           [](const std::monostate&) { return 0u; },
@@ -595,8 +452,8 @@ std::vector<uint8_t> buildStreamPointerMask(const std::vector<NspcEventEntry>& e
     return mask;
 }
 
-std::expected<std::vector<uint8_t>, std::string> readAramBytes(emulation::AramView aram, uint16_t address, size_t size,
-                                                               std::string_view label) {
+std::expected<std::vector<uint8_t>, std::string> readAramBytes(emulation::ConstAramView aram, uint16_t address,
+                                                               size_t size, std::string_view label) {
     if (size == 0) {
         return std::vector<uint8_t>{};
     }
@@ -761,7 +618,12 @@ std::expected<std::vector<uint8_t>, std::string> buildUserContentNspcExport(Nspc
 }
 
 std::expected<std::vector<uint8_t>, std::string> applyUploadToSpcImage(const NspcUploadList& upload,
-                                                                       std::span<const uint8_t> baseSpcFile) {
+                                                                       std::span<const uint8_t> baseSpcFile,
+                                                                       NspcBuildTelemetry* telemetry) {
+    std::optional<compile_detail::StageTimer> timer;
+    if (telemetry != nullptr) {
+        timer.emplace(*telemetry, NspcBuildStage::ApplyToImage);
+    }
     if (baseSpcFile.size() < compile_detail::kSpcHeaderSize + compile_detail::kAramSize) {
         return std::unexpected("Base SPC image is too small");
     }
@@ -3,9 +3,11 @@
 #include "ntrak/nspc/NspcCompile.hpp"
 
 #include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <expected>
+#include <map>
 #include <optional>
 #include <span>
 #include <string>
@@ -38,6 +40,59 @@ struct AllocRequest {
     std::string label;
 };
 
+/// Adds the wall time between construction and stop() (or destruction) to one build stage.
+class StageTimer {
+public:
+    StageTimer(NspcBuildTelemetry& telemetry, NspcBuildStage stage)
+        : telemetry_(&telemetry), stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+    ~StageTimer() { stop(); }
+
+    void stop() {
+        if (telemetry_ == nullptr) {
+            return;
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_;
+        telemetry_->addStageTime(stage_, elapsed.count());
+        telemetry_ = nullptr;
+    }
+
+private:
+    NspcBuildTelemetry* telemetry_;
+    NspcBuildStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/// Song-local compile results that do not depend on ARAM allocation state.
+/// Produced independently per song (and so safe to compute in parallel), then emitted in song order.
+struct PreparedSongUpload {
+    NspcSong song;
+    std::unordered_map<int, uint32_t> trackSizeById;
+    std::unordered_map<int, uint32_t> subroutineSizeById;
+    std::vector<std::string> warnings;
+    NspcBuildTelemetry telemetry;
+};
+
+/// Subroutine bodies already placed by earlier songs of one upload, keyed by their encoded bytes.
+/// Only subroutines without calls are pooled, so the bytes alone decide whether a copy can be reused.
+struct SharedSubroutinePool {
+    std::map<std::vector<uint8_t>, uint16_t> addrByBytes;
+};
+
+/// Copies, optimizes and sizes a song without touching the project. Only reads from `project`.
+/// `optimizedSong`, when given, replaces the project's copy and is taken as already optimized.
+std::expected<PreparedSongUpload, std::string> prepareSongScopedUpload(const NspcProject& project, int songIndex,
+                                                                      const NspcBuildOptions& options,
+                                                                      std::optional<NspcSong> optimizedSong = std::nullopt);
+/// Allocates ARAM for a prepared song, encodes it and records its address layout in `project`.
+/// With a `sharedSubroutines` pool, subroutines identical to one an earlier song placed reuse its
+/// address instead of being uploaded again, and the song's own new subroutines join the pool.
+std::expected<NspcCompileOutput, std::string> emitSongScopedUpload(NspcProject& project, int songIndex,
+                                                                   PreparedSongUpload prepared,
+                                                                   const NspcBuildOptions& options,
+                                                                   SharedSubroutinePool* sharedSubroutines = nullptr);
+
 void appendU8(std::vector<uint8_t>& out, uint8_t value);
 void appendU16(std::vector<uint8_t>& out, uint16_t value);
 uint32_t sequenceOpSize(const NspcSequenceOp& op);
@@ -46,9 +101,10 @@ void addClampedRange(std::vector<AddressRange>& ranges, uint32_t from, uint32_t
 void normalizeRanges(std::vector<AddressRange>& ranges);
 std::vector<AddressRange> invertRanges(const std::vector<AddressRange>& blockedRanges);
 uint32_t totalRangeBytes(const std::vector<AddressRange>& ranges);
+void recordFreeRanges(const std::vector<AddressRange>& freeRanges, NspcBuildTelemetry& telemetry);
 std::optional<uint16_t> allocateFromFreeRanges(std::vector<AddressRange>& freeRanges, uint32_t size,
                                                std::optional<uint16_t> preferredAddr);
-std::optional<uint16_t> readSongSequencePointer(emulation::AramView aram, const NspcEngineConfig& engine,
+std::optional<uint16_t> readSongSequencePointer(emulation::ConstAramView aram, const NspcEngineConfig& engine,
                                                 size_t songIndex);
 
 std::expected<std::vector<uint8_t>, std::string> encodeEventStream(
@@ -58,8 +114,8 @@ std::expected<std::vector<uint8_t>, std::string> encodeEventStream(
 std::vector<uint8_t> buildSequencePointerMask(const std::vector<NspcSequenceOp>& sequence, size_t encodedSize);
 std::vector<uint8_t> buildPatternPointerMask(size_t size);
 std::vector<uint8_t> buildStreamPointerMask(const std::vector<NspcEventEntry>& events, size_t encodedSize);
-std::expected<std::vector<uint8_t>, std::string> readAramBytes(emulation::AramView aram, uint16_t address, size_t size,
-                                                               std::string_view label);
+std::expected<std::vector<uint8_t>, std::string> readAramBytes(emulation::ConstAramView aram, uint16_t address,
+                                                               size_t size, std::string_view label);
 void compareBinaryObject(std::string_view label, std::span<const uint8_t> original, std::span<const uint8_t> rebuilt,
                          std::span<const uint8_t> pointerMask, NspcRoundTripReport& report);
 std::vector<NspcUploadChunk> buildEnabledEngineExtensionPatchChunks(const NspcEngineConfig& engine);
@@ -2,24 +2,55 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <format>
 #include <iterator>
+#include <optional>
 #include <unordered_map>
+#include <utility>
 
 namespace ntrak::nspc {
-using namespace compile_detail;
+namespace compile_detail {
+
+namespace {
+
+/// Final bytes of a subroutine that calls nothing, which therefore do not depend on where anything
+/// is placed. Subroutines with calls are never shared.
+std::optional<std::vector<uint8_t>> standaloneSubroutineBytes(const NspcSubroutine& subroutine,
+                                                              const NspcEngineConfig& engine) {
+    for (const auto& entry : subroutine.events) {
+        if (const auto* vcmd = std::get_if<Vcmd>(&entry.event);
+            vcmd != nullptr && std::holds_alternative<VcmdSubroutineCall>(vcmd->vcmd)) {
+            return std::nullopt;
+        }
+    }
+    std::vector<std::string> warnings;
+    auto encoded = encodeEventStream(subroutine.events, {}, warnings, engine);
+    if (!encoded.has_value()) {
+        return std::nullopt;
+    }
+    if (encoded->empty()) {
+        encoded->push_back(0x00);
+    }
+    return std::move(*encoded);
+}
 
-std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject& project, int songIndex,
-                                                                    NspcBuildOptions options) {
-    auto& songs = project.songs();
+}  // namespace
+
+std::expected<PreparedSongUpload, std::string> prepareSongScopedUpload(const NspcProject& project, int songIndex,
+                                                                      const NspcBuildOptions& options,
+                                                                      std::optional<NspcSong> optimizedSong) {
+    const auto& songs = project.songs();
     if (songIndex < 0 || songIndex >= static_cast<int>(songs.size())) {
         return std::unexpected(std::format("Song index {} is out of range", songIndex));
     }
 
     const auto& engine = project.engineConfig();
-    NspcSong song = songs[static_cast<size_t>(songIndex)];
-    const auto& sequence = song.sequence();
-    if (sequence.empty()) {
+    const bool runOptimizer = options.optimizeSubroutines && !optimizedSong.has_value();
+    PreparedSongUpload prepared;
+    prepared.song = optimizedSong.has_value() ? std::move(*optimizedSong) : songs[static_cast<size_t>(songIndex)];
+    NspcSong& song = prepared.song;
+    if (song.sequence().empty()) {
         return std::unexpected("Selected song has an empty sequence");
     }
 
@@ -27,12 +58,105 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         return std::unexpected("Engine config has no song index pointer table");
     }
 
-    if (options.optimizeSubroutines) {
-        nspc::optimizeSongSubroutines(song, options.optimizerOptions);
+    NspcBuildTelemetry& telemetry = prepared.telemetry;
+    if (runOptimizer) {
+        {
+            StageTimer flattenTimer(telemetry, NspcBuildStage::Flatten);
+            song.flattenSubroutines();
+        }
+        StageTimer optimizeTimer(telemetry, NspcBuildStage::Optimize);
+        const std::optional<NspcOptimizerCacheKey> cacheKey =
+            options.useOptimizerCache ? optimizerCacheKey(song, options.optimizerOptions, engine) : std::nullopt;
+        std::optional<NspcOptimizerCacheEntry> cached;
+        if (cacheKey.has_value()) {
+            cached = project.optimizerCache().find(*cacheKey);
+            if (cached.has_value() && !applyOptimizerCacheEntry(song, *cached)) {
+                cached.reset();
+            }
+        }
+        NspcOptimizerStats stats;
+        if (cached.has_value()) {
+            ++telemetry.cacheHits;
+            stats = cached->stats;
+        } else {
+            stats = nspc::optimizeFlattenedSongSubroutines(song, options.optimizerOptions);
+            if (cacheKey.has_value()) {
+                ++telemetry.cacheMisses;
+                project.optimizerCache().store(*cacheKey, makeOptimizerCacheEntry(song, stats));
+            }
+        }
+        optimizeTimer.stop();
+        telemetry.songsOptimized = 1;
+        telemetry.optimizerIterations = static_cast<uint32_t>(stats.iterations);
+        telemetry.subroutinesCreated = static_cast<uint32_t>(stats.subroutinesCreated);
+        telemetry.optimizerBytesSaved = static_cast<int64_t>(stats.bytesBefore) - static_cast<int64_t>(stats.bytesAfter);
+    }
+
+    StageTimer sizingTimer(telemetry, NspcBuildStage::Encode);
+
+    // Encoded sizes do not depend on the final addresses, so the (placeholder) subroutine addresses
+    // only need to be plausible here; real addresses are patched in during emission.
+    const NspcSongAddressLayout* activeLayout = project.songAddressLayout(song.songId());
+    std::unordered_map<int, uint16_t> originalSubroutineAddrById;
+    originalSubroutineAddrById.reserve(song.subroutines().size());
+    for (const auto& subroutine : song.subroutines()) {
+        uint16_t subroutineAddr = subroutine.originalAddr;
+        if (activeLayout) {
+            const auto it = activeLayout->subroutineAddrById.find(subroutine.id);
+            if (it != activeLayout->subroutineAddrById.end() && it->second != 0) {
+                subroutineAddr = it->second;
+            }
+        }
+        originalSubroutineAddrById[subroutine.id] = subroutineAddr;
+    }
+
+    prepared.trackSizeById.reserve(song.tracks().size());
+    for (const auto& track : song.tracks()) {
+        std::vector<std::string> sizingWarnings;
+        auto encoded = encodeEventStream(track.events, originalSubroutineAddrById, sizingWarnings, engine);
+        if (!encoded.has_value()) {
+            return std::unexpected(std::format("Failed to encode track {}: {}", track.id, encoded.error()));
+        }
+        if (encoded->empty()) {
+            prepared.warnings.push_back(std::format("Track {} encoded to 0 bytes; forcing End marker", track.id));
+        }
+        prepared.trackSizeById[track.id] = std::max<uint32_t>(1u, static_cast<uint32_t>(encoded->size()));
+    }
+
+    prepared.subroutineSizeById.reserve(song.subroutines().size());
+    for (const auto& subroutine : song.subroutines()) {
+        std::vector<std::string> sizingWarnings;
+        auto encoded = encodeEventStream(subroutine.events, originalSubroutineAddrById, sizingWarnings, engine);
+        if (!encoded.has_value()) {
+            return std::unexpected(std::format("Failed to encode subroutine {}: {}", subroutine.id, encoded.error()));
+        }
+        if (encoded->empty()) {
+            prepared.warnings.push_back(
+                std::format("Subroutine {} encoded to 0 bytes; forcing End marker", subroutine.id));
+        }
+        prepared.subroutineSizeById[subroutine.id] = std::max<uint32_t>(1u, static_cast<uint32_t>(encoded->size()));
     }
+
+    sizingTimer.stop();
+    return prepared;
+}
+
+std::expected<NspcCompileOutput, std::string> emitSongScopedUpload(NspcProject& project, int songIndex,
+                                                                   PreparedSongUpload prepared,
+                                                                   const NspcBuildOptions& options,
+                                                                   SharedSubroutinePool* sharedSubroutines) {
+    if (songIndex < 0 || songIndex >= static_cast<int>(std::as_const(project).songs().size())) {
+        return std::unexpected(std::format("Song index {} is out of range", songIndex));
+    }
+
+    const auto& engine = project.engineConfig();
+    NspcSong& song = prepared.song;
+    const auto& sequence = song.sequence();
+    const auto& trackSizeById = prepared.trackSizeById;
+    const auto& subroutineSizeById = prepared.subroutineSizeById;
     const bool persistOptimizedSong = options.optimizeSubroutines && options.applyOptimizedSongToProject;
 
-    const auto aram = project.aram();
+    const auto aram = std::as_const(project).aram();
     const uint32_t songIndexEntryAddr32 = static_cast<uint32_t>(engine.songIndexPointers) +
                                           static_cast<uint32_t>(songIndex) * 2u;
     if (songIndexEntryAddr32 + 1u >= kAramSize) {
@@ -56,8 +180,10 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         }
     }
 
-    std::vector<std::string> warnings;
+    std::vector<std::string> warnings = std::move(prepared.warnings);
+    NspcBuildTelemetry telemetry = prepared.telemetry;
 
+    StageTimer allocateTimer(telemetry, NspcBuildStage::Allocate);
     project.refreshAramUsage();
     const auto& aramUsage = project.aramUsage();
 
@@ -77,47 +203,6 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         return std::unexpected("No writable ARAM ranges available for song-scoped upload");
     }
 
-    std::unordered_map<int, uint16_t> originalSubroutineAddrById;
-    originalSubroutineAddrById.reserve(song.subroutines().size());
-    for (const auto& subroutine : song.subroutines()) {
-        uint16_t subroutineAddr = subroutine.originalAddr;
-        if (activeLayout) {
-            const auto it = activeLayout->subroutineAddrById.find(subroutine.id);
-            if (it != activeLayout->subroutineAddrById.end() && it->second != 0) {
-                subroutineAddr = it->second;
-            }
-        }
-        originalSubroutineAddrById[subroutine.id] = subroutineAddr;
-    }
-
-    std::unordered_map<int, uint32_t> trackSizeById;
-    trackSizeById.reserve(song.tracks().size());
-    for (const auto& track : song.tracks()) {
-        std::vector<std::string> sizingWarnings;
-        auto encoded = encodeEventStream(track.events, originalSubroutineAddrById, sizingWarnings, engine);
-        if (!encoded.has_value()) {
-            return std::unexpected(std::format("Failed to encode track {}: {}", track.id, encoded.error()));
-        }
-        if (encoded->empty()) {
-            warnings.push_back(std::format("Track {} encoded to 0 bytes; forcing End marker", track.id));
-        }
-        trackSizeById[track.id] = std::max<uint32_t>(1u, static_cast<uint32_t>(encoded->size()));
-    }
-
-    std::unordered_map<int, uint32_t> subroutineSizeById;
-    subroutineSizeById.reserve(song.subroutines().size());
-    for (const auto& subroutine : song.subroutines()) {
-        std::vector<std::string> sizingWarnings;
-        auto encoded = encodeEventStream(subroutine.events, originalSubroutineAddrById, sizingWarnings, engine);
-        if (!encoded.has_value()) {
-            return std::unexpected(std::format("Failed to encode subroutine {}: {}", subroutine.id, encoded.error()));
-        }
-        if (encoded->empty()) {
-            warnings.push_back(std::format("Subroutine {} encoded to 0 bytes; forcing End marker", subroutine.id));
-        }
-        subroutineSizeById[subroutine.id] = std::max<uint32_t>(1u, static_cast<uint32_t>(encoded->size()));
-    }
-
     uint32_t sequenceSize = 0;
     for (const auto& op : sequence) {
         sequenceSize += sequenceOpSize(op);
@@ -186,7 +271,24 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         });
     }
 
+    // Subroutines whose bytes an earlier song of this upload already placed point at that copy.
+    std::unordered_map<int, uint16_t> reusedSubroutineAddrById;
+    if (sharedSubroutines != nullptr) {
+        for (const auto& subroutine : song.subroutines()) {
+            const auto bytes = standaloneSubroutineBytes(subroutine, engine);
+            if (!bytes.has_value()) {
+                continue;
+            }
+            if (const auto it = sharedSubroutines->addrByBytes.find(*bytes); it != sharedSubroutines->addrByBytes.end()) {
+                reusedSubroutineAddrById[subroutine.id] = it->second;
+            }
+        }
+    }
+
     for (const auto& subroutine : song.subroutines()) {
+        if (reusedSubroutineAddrById.contains(subroutine.id)) {
+            continue;
+        }
         const auto sizeIt = subroutineSizeById.find(subroutine.id);
         if (sizeIt == subroutineSizeById.end()) {
             return std::unexpected(std::format("Missing size estimate for subroutine {}", subroutine.id));
@@ -269,14 +371,22 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
     if (sequenceAddr == 0) {
         return std::unexpected("Failed to allocate sequence address");
     }
+    subroutineAddrById.insert(reusedSubroutineAddrById.begin(), reusedSubroutineAddrById.end());
+    allocateTimer.stop();
+    recordFreeRanges(freeRanges, telemetry);
 
     NspcUploadList upload;
     if (options.includeEngineExtensions) {
+        StageTimer patchTimer(telemetry, NspcBuildStage::Patch);
         auto extensionChunks = buildEnabledEngineExtensionPatchChunks(engine);
+        for (const auto& chunk : extensionChunks) {
+            telemetry.extensionPatchBytes += static_cast<uint32_t>(chunk.bytes.size());
+        }
         upload.chunks.insert(upload.chunks.end(), std::make_move_iterator(extensionChunks.begin()),
                              std::make_move_iterator(extensionChunks.end()));
     }
 
+    StageTimer encodeTimer(telemetry, NspcBuildStage::Encode);
     std::vector<uint32_t> sequenceOffsets(sequence.size(), 0);
     uint32_t sequenceRunningSize = 0;
     for (size_t i = 0; i < sequence.size(); ++i) {
@@ -348,6 +458,7 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         warnings.push_back("Sequence encoded to 0 bytes; inserted End marker");
     }
 
+    telemetry.sequenceBytes += static_cast<uint32_t>(sequenceBytes.size());
     upload.chunks.push_back(NspcUploadChunk{
         .address = sequenceAddr,
         .bytes = std::move(sequenceBytes),
@@ -379,6 +490,7 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
             appendU16(bytes, trackAddr);
         }
 
+        telemetry.patternTableBytes += static_cast<uint32_t>(bytes.size());
         upload.chunks.push_back(NspcUploadChunk{
             .address = patternAddrIt->second,
             .bytes = std::move(bytes),
@@ -401,6 +513,7 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
             warnings.push_back(std::format("Track {} encoded to 0 bytes; inserted End marker", track.id));
         }
 
+        telemetry.trackBytes += static_cast<uint32_t>(encoded->size());
         upload.chunks.push_back(NspcUploadChunk{
             .address = trackAddrIt->second,
             .bytes = std::move(*encoded),
@@ -413,6 +526,11 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
         if (subroutineAddrIt == subroutineAddrById.end()) {
             return std::unexpected(std::format("Subroutine {} was not allocated an address", subroutine.id));
         }
+        if (reusedSubroutineAddrById.contains(subroutine.id)) {
+            ++telemetry.sharedSubroutinesReused;
+            telemetry.sharedSubroutineBytesSaved += subroutineSizeById.at(subroutine.id);
+            continue;
+        }
 
         auto encoded = encodeEventStream(subroutine.events, subroutineAddrById, warnings, engine);
         if (!encoded.has_value()) {
@@ -423,6 +541,12 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
             warnings.push_back(std::format("Subroutine {} encoded to 0 bytes; inserted End marker", subroutine.id));
         }
 
+        telemetry.subroutineBytes += static_cast<uint32_t>(encoded->size());
+        if (sharedSubroutines != nullptr) {
+            if (auto bytes = standaloneSubroutineBytes(subroutine, engine); bytes.has_value()) {
+                sharedSubroutines->addrByBytes.try_emplace(std::move(*bytes), subroutineAddrIt->second);
+            }
+        }
         upload.chunks.push_back(NspcUploadChunk{
             .address = subroutineAddrIt->second,
             .bytes = std::move(*encoded),
@@ -433,6 +557,7 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
     std::vector<uint8_t> songIndexBytes;
     songIndexBytes.reserve(2);
     appendU16(songIndexBytes, sequenceAddr);
+    telemetry.songIndexBytes += static_cast<uint32_t>(songIndexBytes.size());
     upload.chunks.push_back(NspcUploadChunk{
         .address = songIndexEntryAddr,
         .bytes = std::move(songIndexBytes),
@@ -443,6 +568,7 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
     if (auto validated = validateUploadChunkBoundsAndOverlap(upload.chunks, true); !validated.has_value()) {
         return std::unexpected(validated.error());
     }
+    encodeTimer.stop();
 
     NspcSongAddressLayout newLayout;
     newLayout.sequenceAddr = sequenceAddr;
@@ -452,15 +578,36 @@ std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject&
     newLayout.trackSizeById = trackSizeById;
     newLayout.subroutineSizeById = subroutineSizeById;
     if (persistOptimizedSong) {
-        songs[static_cast<size_t>(songIndex)] = song;
+        // The project's song is replaced outside the command history; stamp it so views cached against the old
+        // stamps rebuild.
+        song.touchAll();
+        project.songs()[static_cast<size_t>(songIndex)] = std::move(song);
     }
     project.setSongAddressLayout(songId, std::move(newLayout));
     project.refreshAramUsage();
 
+    upload.telemetry = telemetry;
     return NspcCompileOutput{
         .upload = std::move(upload),
         .warnings = std::move(warnings),
     };
 }
 
+}  // namespace compile_detail
+
+std::expected<NspcCompileOutput, std::string> buildSongScopedUpload(NspcProject& project, int songIndex,
+                                                                    NspcBuildOptions options) {
+    const auto buildStart = std::chrono::steady_clock::now();
+    auto prepared = compile_detail::prepareSongScopedUpload(project, songIndex, options);
+    if (!prepared.has_value()) {
+        return std::unexpected(prepared.error());
+    }
+    auto output = compile_detail::emitSongScopedUpload(project, songIndex, std::move(*prepared), options);
+    if (output.has_value()) {
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - buildStart;
+        output->upload.telemetry.totalMilliseconds = elapsed.count();
+    }
+    return output;
+}
+
 }  // namespace ntrak::nspc
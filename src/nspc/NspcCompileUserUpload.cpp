@@ -1,17 +1,25 @@
 #include "NspcCompileShared.hpp"
 
+#include "ntrak/common/Parallel.hpp"
+
 #include <algorithm>
+#include <chrono>
 #include <format>
 #include <iterator>
 #include <map>
+#include <optional>
 #include <utility>
 
 namespace ntrak::nspc {
 using namespace compile_detail;
 
 std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& project, NspcBuildOptions options) {
+    const auto buildStart = std::chrono::steady_clock::now();
     NspcUploadList upload;
+    NspcBuildTelemetry& telemetry = upload.telemetry;
     bool hasUserContent = false;
+    // Reads go through the const view so a snapshot copy of the project only detaches what is edited.
+    const NspcProject& readOnlyProject = project;
     const auto& engine = project.engineConfig();
     const bool includeEngineExtensions = options.includeEngineExtensions;
     NspcBuildOptions songBuildOptions = options;
@@ -35,7 +43,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
         const std::vector<uint8_t>* data = nullptr;
     };
     std::vector<UserSampleBrrRange> userSampleBrrRanges;
-    userSampleBrrRanges.reserve(project.samples().size());
+    userSampleBrrRanges.reserve(readOnlyProject.samples().size());
 
     if (engine.instrumentHeaders != 0) {
         for (auto& instrument : project.instruments()) {
@@ -51,23 +59,80 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
     }
     project.refreshAramUsage();
 
-    for (size_t songIndex = 0; songIndex < project.songs().size(); ++songIndex) {
-        if (!project.songs()[songIndex].isUserProvided()) {
-            continue;
+    std::vector<int> userSongIndices;
+    for (size_t songIndex = 0; songIndex < readOnlyProject.songs().size(); ++songIndex) {
+        if (readOnlyProject.songs()[songIndex].isUserProvided()) {
+            userSongIndices.push_back(static_cast<int>(songIndex));
+        }
+    }
+
+    // Songs are already spread over the workers; only a lone song's optimizer fans out on its own.
+    if (userSongIndices.size() > 1) {
+        songBuildOptions.optimizerOptions.maxWorkerThreads = 1;
+    }
+
+    // Optimizing the songs as one lets a single subroutine serve every song that repeats its phrase;
+    // the pool below then uploads each such subroutine once.
+    std::vector<std::optional<NspcSong>> sharedOptimizedSongs(userSongIndices.size());
+    std::optional<SharedSubroutinePool> sharedSubroutines;
+    if (options.optimizeSubroutines && options.shareSubroutinesAcrossSongs && userSongIndices.size() > 1) {
+        std::vector<NspcSong> songs;
+        songs.reserve(userSongIndices.size());
+        for (const int songIndex : userSongIndices) {
+            songs.push_back(readOnlyProject.songs()[static_cast<size_t>(songIndex)]);
+        }
+        std::vector<NspcSong*> songPtrs;
+        songPtrs.reserve(songs.size());
+        for (auto& song : songs) {
+            songPtrs.push_back(&song);
         }
 
-        auto songCompile = buildSongScopedUpload(project, static_cast<int>(songIndex), songBuildOptions);
+        StageTimer optimizeTimer(telemetry, NspcBuildStage::Optimize);
+        const NspcSharedOptimizerStats stats = optimizeSharedSubroutines(songPtrs, options.optimizerOptions);
+        optimizeTimer.stop();
+        telemetry.songsOptimized = static_cast<uint32_t>(songs.size());
+        telemetry.optimizerIterations = static_cast<uint32_t>(stats.combined.iterations);
+        telemetry.subroutinesCreated = static_cast<uint32_t>(stats.combined.subroutinesCreated);
+        telemetry.optimizerBytesSaved = static_cast<int64_t>(stats.bytesBefore) - static_cast<int64_t>(stats.bytesAfter);
+
+        for (size_t i = 0; i < songs.size(); ++i) {
+            sharedOptimizedSongs[i] = std::move(songs[i]);
+        }
+        sharedSubroutines.emplace();
+    }
+
+    // Optimize/encode every user song concurrently; allocation below stays in song order so the
+    // resulting layout is identical to compiling the songs one after another.
+    std::vector<std::optional<std::expected<PreparedSongUpload, std::string>>> preparedSongs(userSongIndices.size());
+    common::parallelFor(
+        userSongIndices.size(),
+        [&](size_t i) {
+            preparedSongs[i] = prepareSongScopedUpload(readOnlyProject, userSongIndices[i], songBuildOptions,
+                                                       std::move(sharedOptimizedSongs[i]));
+        },
+        options.maxWorkerThreads);
+
+    for (size_t i = 0; i < userSongIndices.size(); ++i) {
+        const int songIndex = userSongIndices[i];
+        auto& prepared = *preparedSongs[i];
+        if (!prepared.has_value()) {
+            return std::unexpected(std::format("Failed to compile user song {:02X}: {}", songIndex, prepared.error()));
+        }
+
+        auto songCompile = emitSongScopedUpload(project, songIndex, std::move(*prepared), songBuildOptions,
+                                                sharedSubroutines.has_value() ? &*sharedSubroutines : nullptr);
         if (!songCompile.has_value()) {
             return std::unexpected(std::format("Failed to compile user song {:02X}: {}", songIndex, songCompile.error()));
         }
 
         hasUserContent = true;
+        telemetry.merge(songCompile->upload.telemetry);
         auto& songChunks = songCompile->upload.chunks;
         upload.chunks.insert(upload.chunks.end(), std::make_move_iterator(songChunks.begin()),
                              std::make_move_iterator(songChunks.end()));
     }
 
-    for (const auto& instrument : project.instruments()) {
+    for (const auto& instrument : readOnlyProject.instruments()) {
         if (instrument.contentOrigin != NspcContentOrigin::UserProvided) {
             continue;
         }
@@ -97,6 +162,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
             bytes.push_back(instrument.fracPitchMult);
         }
 
+        telemetry.instrumentBytes += static_cast<uint32_t>(bytes.size());
         upload.chunks.push_back(NspcUploadChunk{
             .address = static_cast<uint16_t>(address),
             .bytes = std::move(bytes),
@@ -121,6 +187,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
             percussionBytes.push_back(instrument.basePitchMult);
             percussionBytes.push_back(instrument.percussionNote);
 
+            telemetry.instrumentBytes += static_cast<uint32_t>(percussionBytes.size());
             upload.chunks.push_back(NspcUploadChunk{
                 .address = static_cast<uint16_t>(percussionAddress),
                 .bytes = std::move(percussionBytes),
@@ -130,7 +197,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
         hasUserContent = true;
     }
 
-    for (const auto& sample : project.samples()) {
+    for (const auto& sample : readOnlyProject.samples()) {
         if (sample.contentOrigin != NspcContentOrigin::UserProvided) {
             continue;
         }
@@ -164,6 +231,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
         sampleDirectoryBytes.reserve(4);
         appendU16(sampleDirectoryBytes, sample.originalAddr);
         appendU16(sampleDirectoryBytes, sample.originalLoopAddr);
+        telemetry.sampleDirectoryBytes += static_cast<uint32_t>(sampleDirectoryBytes.size());
         upload.chunks.push_back(NspcUploadChunk{
             .address = static_cast<uint16_t>(directoryAddr),
             .bytes = std::move(sampleDirectoryBytes),
@@ -193,6 +261,7 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
         }
 
         if (!skipBrrUpload) {
+            telemetry.sampleDataBytes += static_cast<uint32_t>(sample.data.size());
             upload.chunks.push_back(NspcUploadChunk{
                 .address = sample.originalAddr,
                 .bytes = sample.data,
@@ -209,7 +278,11 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
     }
 
     if (includeEngineExtensions) {
+        StageTimer patchTimer(telemetry, NspcBuildStage::Patch);
         auto extensionChunks = buildEnabledEngineExtensionPatchChunks(engine);
+        for (const auto& chunk : extensionChunks) {
+            telemetry.extensionPatchBytes += static_cast<uint32_t>(chunk.bytes.size());
+        }
         if (!extensionChunks.empty()) {
             hasUserContent = true;
             upload.chunks.insert(upload.chunks.end(), std::make_move_iterator(extensionChunks.begin()),
@@ -226,6 +299,8 @@ std::expected<NspcUploadList, std::string> buildUserContentUpload(NspcProject& p
         return std::unexpected(validated.error());
     }
 
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - buildStart;
+    telemetry.totalMilliseconds = elapsed.count();
     return upload;
 }
 
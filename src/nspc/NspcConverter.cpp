@@ -1,6 +1,7 @@
 #include "ntrak/nspc/NspcConverter.hpp"
 
 #include "ntrak/nspc/NspcData.hpp"
+#include "ntrak/nspc/NspcEditor.hpp"
 
 #include <algorithm>
 #include <cstdint>
@@ -18,20 +19,6 @@ constexpr uint32_t kMaxSongEntries = 256u;
 
 /// Walk all event entries in every track and subroutine of the song,
 /// calling the callback for each entry.
-template <typename Fn>
-void walkAllEvents(NspcSong& song, Fn callback) {
-    for (auto& track : song.tracks()) {
-        for (auto& entry : track.events) {
-            callback(entry);
-        }
-    }
-    for (auto& sub : song.subroutines()) {
-        for (auto& entry : sub.events) {
-            callback(entry);
-        }
-    }
-}
-
 template <typename Fn>
 void walkAllEventsConst(const NspcSong& song, Fn callback) {
     for (const auto& track : song.tracks()) {
@@ -90,26 +77,6 @@ int findMatchingSampleId(const NspcProject& target, const std::vector<uint8_t>&
     return -1;
 }
 
-void collectUsedInstrumentIdsFromEventStream(const std::vector<NspcEventEntry>& events, std::set<int>& ids) {
-    int percussionBaseId = 0;
-
-    for (const auto& entry : events) {
-        if (const auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
-            std::visit(overloaded{
-                           [&](const VcmdInst& v) { ids.insert(v.instrumentIndex & 0x7F); },
-                           [&](const VcmdPercussionBaseInstrument& v) { percussionBaseId = v.index & 0x7F; },
-                           [](const auto&) {},
-                       },
-                       vcmd->vcmd);
-            continue;
-        }
-
-        if (const auto* percussion = std::get_if<Percussion>(&entry.event)) {
-            ids.insert((percussionBaseId + percussion->index) & 0x7F);
-        }
-    }
-}
-
 std::optional<int> resolveSmwPercussionInstrumentId(const NspcProject& source, uint8_t percussionIndex) {
     const auto& cfg = source.engineConfig();
     if (cfg.engineVersion != "0.0" || cfg.percussionHeaders == 0) {
@@ -235,19 +202,14 @@ std::vector<int> findUsedInstrumentIds(const NspcProject& project, int songIndex
     if (songIndex < 0 || songIndex >= static_cast<int>(project.songs().size())) {
         return {};
     }
+    if (project.engineConfig().engineVersion != "0.0") {
+        NspcUsageIndex index;
+        index.rebuildSong(project.songs()[songIndex]);
+        return findUsedInstrumentIds(project, songIndex, index);
+    }
 
     std::set<int> ids;
     const auto& song = project.songs()[songIndex];
-    const bool isSmwProto = project.engineConfig().engineVersion == "0.0";
-    if (!isSmwProto) {
-        for (const auto& track : song.tracks()) {
-            collectUsedInstrumentIdsFromEventStream(track.events, ids);
-        }
-        for (const auto& subroutine : song.subroutines()) {
-            collectUsedInstrumentIdsFromEventStream(subroutine.events, ids);
-        }
-        return {ids.begin(), ids.end()};
-    }
 
     auto collectSmwStream = [&](const std::vector<NspcEventEntry>& events) {
         for (const auto& entry : events) {
@@ -276,6 +238,17 @@ std::vector<int> findUsedInstrumentIds(const NspcProject& project, int songIndex
     return {ids.begin(), ids.end()};
 }
 
+std::vector<int> findUsedInstrumentIds(const NspcProject& project, int songIndex, const NspcUsageIndex& index) {
+    if (songIndex < 0 || songIndex >= static_cast<int>(project.songs().size())) {
+        return {};
+    }
+    // SMW prototype percussion resolves through the engine's percussion table, which the index does not model.
+    if (project.engineConfig().engineVersion == "0.0") {
+        return findUsedInstrumentIds(project, songIndex);
+    }
+    return index.usedValues(NspcUsageIndex::Kind::Instrument, project.songs()[songIndex].songId());
+}
+
 std::vector<InstrumentMapping> buildDefaultMappings(const NspcProject& source, const NspcProject& target,
                                                     int sourceSongIndex) {
     const auto usedIds = findUsedInstrumentIds(source, sourceSongIndex);
@@ -500,33 +473,38 @@ SongPortResult portSong(const NspcProject& source, NspcProject& target, const So
         convertSmwPercussionToNotes(portedSong, source);
     }
 
-    // Remap instrument references in the copied song
-    walkAllEvents(portedSong, [&](NspcEventEntry& entry) {
-        if (auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
-            std::visit(overloaded{
-                           [&](VcmdInst& v) {
-                               const uint8_t rawId = v.instrumentIndex;
-                               const uint8_t cleanId = rawId & 0x7F;
-                               const uint8_t flag = rawId & 0x80;
-                               if (auto it = result.instrumentRemap.find(cleanId);
-                                   it != result.instrumentRemap.end()) {
-                                   v.instrumentIndex = static_cast<uint8_t>(it->second) | flag;
-                               }
-                           },
-                           [&](VcmdPercussionBaseInstrument& v) {
-                               const uint8_t rawId = v.index;
-                               const uint8_t cleanId = rawId & 0x7F;
-                               const uint8_t flag = rawId & 0x80;
-                               if (auto it = result.instrumentRemap.find(cleanId);
-                                   it != result.instrumentRemap.end()) {
-                                   v.index = static_cast<uint8_t>(it->second) | flag;
-                               }
-                           },
-                           [](auto&) {},
-                       },
-                       vcmd->vcmd);
+    // Remap instrument references in the copied song, one track or subroutine per worker
+    const auto remapInstrument = [&](uint8_t& rawId) {
+        const uint8_t cleanId = rawId & 0x7F;
+        const uint8_t flag = rawId & 0x80;
+        const auto it = result.instrumentRemap.find(cleanId);
+        if (it == result.instrumentRemap.end()) {
+            return false;
         }
-    });
+        const auto remapped = static_cast<uint8_t>(static_cast<uint8_t>(it->second) | flag);
+        const bool changed = remapped != rawId;
+        rawId = remapped;
+        return changed;
+    };
+    NspcEventSelection wholeSongSelection;
+    wholeSongSelection.wholeSong = true;
+    NspcEditor().transformEvents(
+        portedSong, wholeSongSelection,
+        [&](NspcEvent& event) {
+            auto* vcmd = std::get_if<Vcmd>(&event);
+            if (vcmd == nullptr) {
+                return false;
+            }
+            return std::visit(overloaded{
+                                  [&](VcmdInst& v) { return remapInstrument(v.instrumentIndex); },
+                                  [&](VcmdPercussionBaseInstrument& v) { return remapInstrument(v.index); },
+                                  [](auto&) { return false; },
+                              },
+                              vcmd->vcmd);
+        },
+        true);
+    // The percussion rewrite replaces streams wholesale, so mark every part changed for caches keyed on revisions
+    portedSong.touchAll();
 
     portedSong.setContentOrigin(NspcContentOrigin::UserProvided);
 
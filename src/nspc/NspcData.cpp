@@ -1,9 +1,13 @@
 #include "ntrak/nspc/NspcData.hpp"
 
+#include "ntrak/common/Log.hpp"
 #include "ntrak/emulation/SpcDsp.hpp"
 #include "ntrak/nspc/NspcEngine.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <format>
 #include <functional>
 #include <stdexcept>
 #include <unordered_map>
@@ -11,6 +15,110 @@
 
 namespace ntrak::nspc {
 
+NspcRevision newNspcRevision() {
+    static std::atomic<NspcRevision> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+const NspcSongBody& NspcDeferredSongBody::get() {
+    std::call_once(once_, [this] {
+        body_ = decoder_();
+        decoder_ = nullptr;  // drops the encoded payload
+        if (!body_.error.empty()) {
+            common::logInfo(std::format("Song events could not be decoded and will be saved as loaded: {}",
+                                        body_.error));
+        }
+        decoded_.store(true, std::memory_order_release);
+    });
+    return body_;
+}
+
+void NspcDeferredSongBody::prefetch() {
+    std::lock_guard lock(prefetchMutex_);
+    if (isDecoded() || prefetch_.valid()) {
+        return;
+    }
+    prefetch_ = std::async(std::launch::async, [this] { (void)get(); });
+}
+
+namespace {
+
+uint32_t eventSize(const NspcEventEntry& entry) {
+    return std::visit(overloaded{
+                          [](const std::monostate&) { return 0u; },
+                          [](const Duration& value) {
+                              return (value.quantization.has_value() || value.velocity.has_value()) ? 2u : 1u;
+                          },
+                          [](const Vcmd& value) { return vcmdEncodedSize(value); },
+                          [](const Note&) { return 1u; },
+                          [](const Tie&) { return 1u; },
+                          [](const Rest&) { return 1u; },
+                          [](const Percussion&) { return 1u; },
+                          [](const Subroutine&) { return 0u; },  // Annotation-only entry in flattened view.
+                          [](const End&) { return 1u; },
+                      },
+                      entry.event);
+}
+
+}  // namespace
+
+uint32_t encodedEventBytes(const std::vector<NspcEventEntry>& events) {
+    uint32_t size = 0;
+    for (const auto& entry : events) {
+        size += eventSize(entry);
+    }
+    return size;
+}
+
+NspcSongOutline NspcSong::outline() const {
+    if (deferredBody_ != nullptr && !deferredBody_->isDecoded() && deferredBody_->outline().has_value()) {
+        return *deferredBody_->outline();
+    }
+    NspcSongOutline outline;
+    outline.tracks.reserve(tracks().size());
+    for (const auto& track : tracks()) {
+        outline.tracks.push_back(NspcEventListOutline{
+            .id = track.id, .originalAddr = track.originalAddr, .encodedBytes = encodedEventBytes(track.events)});
+    }
+    outline.subroutines.reserve(subroutines().size());
+    for (const auto& subroutine : subroutines()) {
+        outline.subroutines.push_back(NspcEventListOutline{.id = subroutine.id,
+                                                           .originalAddr = subroutine.originalAddr,
+                                                           .encodedBytes = encodedEventBytes(subroutine.events)});
+    }
+    return outline;
+}
+
+void NspcSong::adoptDeferredBody() {
+    if (deferredBody_ == nullptr) {
+        return;
+    }
+    const NspcSongBody& body = deferredBody_->get();
+    tracks_ = body.tracks;
+    subroutines_ = body.subroutines;
+    if (!body.error.empty()) {
+        eventsError_ = body.error;
+        undecodedEvents_ = std::make_shared<const std::vector<NspcUndecodedEvents>>(body.undecoded);
+    }
+    deferredBody_.reset();
+}
+
+const std::string& NspcSong::eventsError() const {
+    static const std::string kNoError;
+    if (deferredBody_ != nullptr) {
+        return deferredBody_->isDecoded() ? deferredBody_->get().error : kNoError;
+    }
+    return eventsError_;
+}
+
+const std::vector<NspcUndecodedEvents>& NspcSong::undecodedEvents() const {
+    static const std::vector<NspcUndecodedEvents> kNone;
+    if (deferredBody_ != nullptr) {
+        return deferredBody_->get().undecoded;
+    }
+    return undecodedEvents_ != nullptr ? *undecodedEvents_ : kNone;
+}
+
 namespace {
 
 NspcEventEntry* resolveEventEntry(std::vector<NspcTrack>& tracks, std::vector<NspcSubroutine>& subroutines,
@@ -128,134 +236,20 @@ bool wouldRecurse(const std::vector<int>& stack, int subroutineId) {
 }  // namespace
 
 uint8_t vcmdParamByteCount(uint8_t cmd) {
-    switch (cmd) {
-    case 0xE0:
-        return 1;
-    case 0xE1:
-        return 1;
-    case 0xE2:
-        return 2;
-    case 0xE3:
-        return 3;
-    case 0xE4:
-        return 0;
-    case 0xE5:
-        return 1;
-    case 0xE6:
-        return 2;
-    case 0xE7:
-        return 1;
-    case 0xE8:
-        return 2;
-    case 0xE9:
-        return 1;
-    case 0xEA:
-        return 1;
-    case 0xEB:
-        return 3;
-    case 0xEC:
-        return 0;
-    case 0xED:
-        return 1;
-    case 0xEE:
-        return 2;
-    case 0xEF:
-        return 3;
-    case 0xF0:
-        return 1;
-    case 0xF1:
-        return 3;
-    case 0xF2:
-        return 3;
-    case 0xF3:
-        return 0;
-    case 0xF4:
-        return 1;
-    case 0xF5:
-        return 3;
-    case 0xF6:
-        return 0;
-    case 0xF7:
-        return 3;
-    case 0xF8:
-        return 3;
-    case 0xF9:
-        return 3;
-    case 0xFA:
-        return 1;
-    case 0xFB:
-        return 2;
-    case 0xFC:
-        return 0;
-    case 0xFD:
-        return 0;
-    case 0xFE:
-        return 0;
-    case 0xFF:
-        return 0;
-    default:
-        return 0;
-    }
+    const auto* descriptor = vcmdDescriptor(cmd);
+    return descriptor != nullptr ? descriptor->paramCount : 0;
 }
 
 std::optional<Vcmd> constructVcmd(uint8_t id, const uint8_t* params) {
     switch (id) {
-    case 0xE1:
-        return Vcmd{VcmdPanning{params[0]}};
-    case 0xE2:
-        return Vcmd{VcmdPanFade{params[0], params[1]}};
-    case 0xE3:
-        return Vcmd{VcmdVibratoOn{params[0], params[1], params[2]}};
-    case 0xE4:
-        return Vcmd{VcmdVibratoOff{}};
-    case 0xE5:
-        return Vcmd{VcmdGlobalVolume{params[0]}};
-    case 0xE6:
-        return Vcmd{VcmdGlobalVolumeFade{params[0], params[1]}};
-    case 0xE7:
-        return Vcmd{VcmdTempo{params[0]}};
-    case 0xE8:
-        return Vcmd{VcmdTempoFade{params[0], params[1]}};
-    case 0xE9:
-        return Vcmd{VcmdGlobalTranspose{static_cast<int8_t>(params[0])}};
-    case 0xEA:
-        return Vcmd{VcmdPerVoiceTranspose{static_cast<int8_t>(params[0])}};
-    case 0xEB:
-        return Vcmd{VcmdTremoloOn{params[0], params[1], params[2]}};
-    case 0xEC:
-        return Vcmd{VcmdTremoloOff{}};
-    case 0xEE:
-        return Vcmd{VcmdVolumeFade{params[0], params[1]}};
-    case 0xF0:
-        return Vcmd{VcmdVibratoFadeIn{params[0]}};
-    case 0xF1:
-        return Vcmd{VcmdPitchEnvelopeTo{params[0], params[1], params[2]}};
-    case 0xF2:
-        return Vcmd{VcmdPitchEnvelopeFrom{params[0], params[1], params[2]}};
-    case 0xF3:
-        return Vcmd{VcmdPitchEnvelopeOff{}};
-    case 0xF4:
-        return Vcmd{VcmdFineTune{static_cast<int8_t>(params[0])}};
-    case 0xF5:
-        return Vcmd{VcmdEchoOn{params[0], params[1], params[2]}};
-    case 0xF6:
-        return Vcmd{VcmdEchoOff{}};
-    case 0xF7:
-        return Vcmd{VcmdEchoParams{params[0], params[1], params[2]}};
-    case 0xF8:
-        return Vcmd{VcmdEchoVolumeFade{params[0], params[1], params[2]}};
-    case 0xF9:
-        return Vcmd{VcmdPitchSlideToNote{params[0], params[1], params[2]}};
-    case 0xFA:
-        return Vcmd{VcmdPercussionBaseInstrument{params[0]}};
-    case 0xFC:
-        return Vcmd{VcmdMuteChannel{}};
-    case 0xFD:
-        return Vcmd{VcmdFastForwardOn{}};
-    case 0xFE:
-        return Vcmd{VcmdFastForwardOff{}};
-    default:
+    case VcmdInst::id:
+    case VcmdVolume::id:
+    case VcmdSubroutineCall::id:
+    case VcmdNOP::id:
+    case VcmdUnused::id:
         return std::nullopt;
+    default:
+        return decodeVcmd(id, params);
     }
 }
 
@@ -274,77 +268,11 @@ std::optional<Vcmd> constructVcmdForEngine(uint8_t id, const uint8_t* params, co
 }
 
 const char* vcmdNameForId(uint8_t id) {
-    switch (id) {
-    case VcmdInst::id:
-        return VcmdInst::name.data();
-    case VcmdPanning::id:
-        return VcmdPanning::name.data();
-    case VcmdPanFade::id:
-        return VcmdPanFade::name.data();
-    case VcmdVibratoOn::id:
-        return VcmdVibratoOn::name.data();
-    case VcmdVibratoOff::id:
-        return VcmdVibratoOff::name.data();
-    case VcmdGlobalVolume::id:
-        return VcmdGlobalVolume::name.data();
-    case VcmdGlobalVolumeFade::id:
-        return VcmdGlobalVolumeFade::name.data();
-    case VcmdTempo::id:
-        return VcmdTempo::name.data();
-    case VcmdTempoFade::id:
-        return VcmdTempoFade::name.data();
-    case VcmdGlobalTranspose::id:
-        return VcmdGlobalTranspose::name.data();
-    case VcmdPerVoiceTranspose::id:
-        return VcmdPerVoiceTranspose::name.data();
-    case VcmdTremoloOn::id:
-        return VcmdTremoloOn::name.data();
-    case VcmdTremoloOff::id:
-        return VcmdTremoloOff::name.data();
-    case VcmdVolume::id:
-        return VcmdVolume::name.data();
-    case VcmdVolumeFade::id:
-        return VcmdVolumeFade::name.data();
-    case VcmdSubroutineCall::id:
-        return VcmdSubroutineCall::name.data();
-    case VcmdVibratoFadeIn::id:
-        return VcmdVibratoFadeIn::name.data();
-    case VcmdPitchEnvelopeTo::id:
-        return VcmdPitchEnvelopeTo::name.data();
-    case VcmdPitchEnvelopeFrom::id:
-        return VcmdPitchEnvelopeFrom::name.data();
-    case VcmdPitchEnvelopeOff::id:
-        return VcmdPitchEnvelopeOff::name.data();
-    case VcmdFineTune::id:
-        return VcmdFineTune::name.data();
-    case VcmdEchoOn::id:
-        return VcmdEchoOn::name.data();
-    case VcmdEchoOff::id:
-        return VcmdEchoOff::name.data();
-    case VcmdEchoParams::id:
-        return VcmdEchoParams::name.data();
-    case VcmdEchoVolumeFade::id:
-        return VcmdEchoVolumeFade::name.data();
-    case VcmdPitchSlideToNote::id:
-        return VcmdPitchSlideToNote::name.data();
-    case VcmdPercussionBaseInstrument::id:
-        return VcmdPercussionBaseInstrument::name.data();
-    case VcmdNOP::id:
-        return VcmdNOP::name.data();
-    case VcmdMuteChannel::id:
-        return VcmdMuteChannel::name.data();
-    case VcmdFastForwardOn::id:
-        return VcmdFastForwardOn::name.data();
-    case VcmdFastForwardOff::id:
-        return VcmdFastForwardOff::name.data();
-    case VcmdUnused::id:
-        return VcmdUnused::name.data();
-    default:
-        return nullptr;
-    }
+    const auto* descriptor = vcmdDescriptor(id);
+    return descriptor != nullptr ? descriptor->name.data() : nullptr;
 }
 
-Vcmd NspcSong::parseVcmd(emulation::AramView aram, uint16_t& addr) {
+Vcmd NspcSong::parseVcmd(emulation::ConstAramView aram, uint16_t& addr) {
     const uint8_t rawCmd = aram.read(addr++);
     const auto mappedCmd = mapReadVcmdId(commandMap_, rawCmd);
     if (!mappedCmd.has_value()) {
@@ -352,137 +280,28 @@ Vcmd NspcSong::parseVcmd(emulation::AramView aram, uint16_t& addr) {
     }
     const uint8_t cmd = *mappedCmd;
 
-    switch (cmd) {
-    case 0xE0:
-        return Vcmd{VcmdInst{.instrumentIndex = aram.read(addr++)}};
-    case 0xE1:
-        return Vcmd{VcmdPanning{aram.read(addr++)}};
-    case 0xE2: {
-        uint8_t time = aram.read(addr++);
-        uint8_t target = aram.read(addr++);
-        return Vcmd{VcmdPanFade{time, target}};
-    }
-    case 0xE3: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t rate = aram.read(addr++);
-        uint8_t depth = aram.read(addr++);
-        return Vcmd{VcmdVibratoOn{delay, rate, depth}};
-    }
-    case 0xE4:
-        return Vcmd{VcmdVibratoOff{}};
-    case 0xE5:
-        return Vcmd{VcmdGlobalVolume{aram.read(addr++)}};
-    case 0xE6: {
-        uint8_t time = aram.read(addr++);
-        uint8_t target = aram.read(addr++);
-        return Vcmd{VcmdGlobalVolumeFade{time, target}};
-    }
-    case 0xE7: {
-        uint8_t tempo = aram.read(addr++);
-        return Vcmd{VcmdTempo{tempo}};
-    }
-    case 0xE8: {
-        uint8_t time = aram.read(addr++);
-        uint8_t target = aram.read(addr++);
-        return Vcmd{VcmdTempoFade{time, target}};
-    }
-    case 0xE9:
-        return Vcmd{VcmdGlobalTranspose{static_cast<int8_t>(aram.read(addr++))}};
-    case 0xEA:
-        return Vcmd{VcmdPerVoiceTranspose{static_cast<int8_t>(aram.read(addr++))}};
-    case 0xEB: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t rate = aram.read(addr++);
-        uint8_t depth = aram.read(addr++);
-        return Vcmd{VcmdTremoloOn{delay, rate, depth}};
-    }
-    case 0xEC:
-        return Vcmd{VcmdTremoloOff{}};
-    case 0xED:
-        return Vcmd{VcmdVolume{aram.read(addr++)}};
-    case 0xEE: {
-        uint8_t time = aram.read(addr++);
-        uint8_t target = aram.read(addr++);
-        return Vcmd{VcmdVolumeFade{time, target}};
-    }
-    case 0xEF: {
-        uint16_t subrAddr = aram.read16(addr);
-        addr += 2;
-        uint8_t count = aram.read(addr++);
-
-        int subrId;
-        if (!subroutineAddrToIndex_.contains(subrAddr)) {
-            subrId = nextSubroutineId_++;
-            subroutineAddrToIndex_[subrAddr] = subrId;
-        } else {
-            subrId = subroutineAddrToIndex_[subrAddr];
-        }
-
-        return Vcmd{VcmdSubroutineCall{subrId, subrAddr, count}};
-    }
-    case 0xF0:
-        return Vcmd{VcmdVibratoFadeIn{aram.read(addr++)}};
-    case 0xF1: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t length = aram.read(addr++);
-        uint8_t semitone = aram.read(addr++);
-        return Vcmd{VcmdPitchEnvelopeTo{delay, length, semitone}};
-    }
-    case 0xF2: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t length = aram.read(addr++);
-        uint8_t semitone = aram.read(addr++);
-        return Vcmd{VcmdPitchEnvelopeFrom{delay, length, semitone}};
-    }
-    case 0xF3:
-        return Vcmd{VcmdPitchEnvelopeOff{}};
-    case 0xF4:
-        return Vcmd{VcmdFineTune{static_cast<int8_t>(aram.read(addr++))}};
-    case 0xF5: {
-        uint8_t channels = aram.read(addr++);
-        uint8_t left = aram.read(addr++);
-        uint8_t right = aram.read(addr++);
-        return Vcmd{VcmdEchoOn{channels, left, right}};
-    }
-    case 0xF6:
-        return Vcmd{VcmdEchoOff{}};
-    case 0xF7: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t feedback = aram.read(addr++);
-        uint8_t firIndex = aram.read(addr++);
-        return Vcmd{VcmdEchoParams{delay, feedback, firIndex}};
-    }
-    case 0xF8: {
-        uint8_t time = aram.read(addr++);
-        uint8_t leftTarget = aram.read(addr++);
-        uint8_t rightTarget = aram.read(addr++);
-        return Vcmd{VcmdEchoVolumeFade{time, leftTarget, rightTarget}};
-    }
-    case 0xF9: {
-        uint8_t delay = aram.read(addr++);
-        uint8_t length = aram.read(addr++);
-        uint8_t note = aram.read(addr++);
-        return Vcmd{VcmdPitchSlideToNote{delay, length, note}};
-    }
-    case 0xFA:
-        return Vcmd{VcmdPercussionBaseInstrument{aram.read(addr++)}};
-    case 0xFB: {
-        uint16_t nopBytes = aram.read16(addr);
-        addr += 2;
-        return Vcmd{VcmdNOP{nopBytes}};
-    }
-    case 0xFC:
-        return Vcmd{VcmdMuteChannel{}};
-    case 0xFD:
-        return Vcmd{VcmdFastForwardOn{}};
-    case 0xFE:
-        return Vcmd{VcmdFastForwardOff{}};
-    default:
+    const auto* descriptor = vcmdDescriptor(cmd);
+    if (descriptor == nullptr || cmd == VcmdUnused::id) {
         throw std::runtime_error("Encountered unsupported VCMD");
     }
+
+    VcmdParamBytes params{};
+    for (uint8_t i = 0; i < descriptor->paramCount; ++i) {
+        params[i] = aram.read(addr++);
+    }
+    Vcmd vcmd = descriptor->decode(params.data());
+
+    if (auto* call = std::get_if<VcmdSubroutineCall>(&vcmd.vcmd)) {
+        const auto [it, inserted] = subroutineAddrToIndex_.try_emplace(call->originalAddr, nextSubroutineId_);
+        if (inserted) {
+            ++nextSubroutineId_;
+        }
+        call->subroutineId = it->second;
+    }
+    return vcmd;
 }
 
-std::vector<NspcEventEntry> NspcSong::parseEvents(emulation::AramView aram, uint16_t startAddr, uint16_t& endAddr,
+std::vector<NspcEventEntry> NspcSong::parseEvents(emulation::ConstAramView aram, uint16_t startAddr, uint16_t& endAddr,
                                                   std::optional<uint16_t> hardStopExclusive) {
     std::vector<NspcEventEntry> events;
     uint16_t addr = startAddr;
@@ -597,14 +416,14 @@ std::vector<NspcEventEntry> NspcSong::parseEvents(emulation::AramView aram, uint
     return events;
 }
 
-void NspcSong::parseTrack(emulation::AramView aram, uint16_t trackAddr, int trackIndex,
+void NspcSong::parseTrack(emulation::ConstAramView aram, uint16_t trackAddr, int trackIndex,
                           std::optional<uint16_t> hardStopExclusive) {
     if (trackAddr == 0) {
         return;
     }
 
     // Check if we've already parsed this track
-    if (static_cast<size_t>(trackIndex) < tracks_.size() && tracks_[trackIndex].originalAddr == trackAddr) {
+    if (static_cast<size_t>(trackIndex) < tracks().size() && tracks()[trackIndex].originalAddr == trackAddr) {
         return;
     }
 
@@ -612,14 +431,14 @@ void NspcSong::parseTrack(emulation::AramView aram, uint16_t trackAddr, int trac
     std::vector<NspcEventEntry> events = parseEvents(aram, trackAddr, endAddr, hardStopExclusive);
 
     // Ensure we have space for this track
-    if (static_cast<size_t>(trackIndex) >= tracks_.size()) {
-        tracks_.resize(trackIndex + 1);
+    if (static_cast<size_t>(trackIndex) >= tracks().size()) {
+        tracks().resize(trackIndex + 1);
     }
 
-    tracks_[trackIndex] = NspcTrack{trackIndex, std::move(events), trackAddr};
+    tracks()[trackIndex] = NspcTrack{trackIndex, std::move(events), trackAddr};
 }
 
-void NspcSong::parsePattern(emulation::AramView aram, uint16_t patternAddr, int patternIndex) {
+void NspcSong::parsePattern(emulation::ConstAramView aram, uint16_t patternAddr, int patternIndex) {
     // Each pattern has 8 track pointers (16 bytes total)
     std::array<int, 8> channelTrackIds{};
 
@@ -643,23 +462,23 @@ void NspcSong::parsePattern(emulation::AramView aram, uint16_t patternAddr, int
     }
 
     // Ensure we have space for this pattern
-    if (static_cast<size_t>(patternIndex) >= patterns_.size()) {
-        patterns_.resize(patternIndex + 1);
+    if (static_cast<size_t>(patternIndex) >= patterns().size()) {
+        patterns().resize(patternIndex + 1);
     }
 
-    patterns_[patternIndex] = NspcPattern{patternIndex, channelTrackIds, patternAddr};
+    patterns()[patternIndex] = NspcPattern{patternIndex, channelTrackIds, patternAddr};
 }
 
 NspcSong NspcSong::createEmpty(int songId) {
     NspcSong song;
     song.songId_ = songId;
     song.contentOrigin_ = NspcContentOrigin::UserProvided;
-    song.sequence_.push_back(PlayPattern{
+    song.sequence().push_back(PlayPattern{
         .patternId = 0,
         .trackTableAddr = 0,
     });
-    song.sequence_.push_back(EndSequence{});
-    song.patterns_.push_back(NspcPattern{
+    song.sequence().push_back(EndSequence{});
+    song.patterns().push_back(NspcPattern{
         .id = 0,
         .channelTrackIds = std::array<int, 8>{-1, -1, -1, -1, -1, -1, -1, -1},
         .trackTableAddr = 0,
@@ -668,7 +487,7 @@ NspcSong NspcSong::createEmpty(int songId) {
     return song;
 }
 
-NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int songIndex)
+NspcSong::NspcSong(emulation::ConstAramView aram, const NspcEngineConfig& config, int songIndex)
     : songId_(songIndex), commandMap_(config.commandMap.value_or(NspcCommandMap{})) {
     for (const auto& extension : config.extensions) {
         if (!extension.enabled) {
@@ -689,18 +508,18 @@ NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int
     std::unordered_map<uint16_t, int> patternAddrToIndex;
 
     // Parse song sequence data
-    sequence_.clear();
+    sequence().clear();
     loopPatternIndex_.reset();
     while (true) {
         const uint16_t opAddr = seqPointer;
-        const int opIndex = static_cast<int>(sequence_.size());
+        const int opIndex = static_cast<int>(sequence().size());
         sequenceAddrToIndex[opAddr] = opIndex;
 
         uint16_t seqWord = aram.read16(seqPointer);
 
         if (seqWord == 0x0000) {
             // End of song
-            sequence_.push_back(EndSequence{});
+            sequence().push_back(EndSequence{});
             break;
         } else if ((seqWord & 0xFF00) == 0x0000) {
             // Special commands when high byte is 0
@@ -713,15 +532,15 @@ NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int
                 if (const auto it = sequenceAddrToIndex.find(jumpAddr); it != sequenceAddrToIndex.end()) {
                     targetIndex = it->second;
                 }
-                sequence_.push_back(JumpTimes{lowByte, SequenceTarget{targetIndex, jumpAddr}});
+                sequence().push_back(JumpTimes{lowByte, SequenceTarget{targetIndex, jumpAddr}});
                 seqPointer += 4;
             } else if (lowByte == 0x80) {
                 // Fast forward on
-                sequence_.push_back(FastForwardOn{});
+                sequence().push_back(FastForwardOn{});
                 seqPointer += 2;
             } else if (lowByte == 0x81) {
                 // Fast forward off
-                sequence_.push_back(FastForwardOff{});
+                sequence().push_back(FastForwardOff{});
                 seqPointer += 2;
             } else if (lowByte >= 0x82) {
                 // Conditional jump (always jump unless fast-forward)
@@ -730,7 +549,7 @@ NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int
                 if (const auto it = sequenceAddrToIndex.find(jumpAddr); it != sequenceAddrToIndex.end()) {
                     targetIndex = it->second;
                 }
-                sequence_.push_back(AlwaysJump{lowByte, SequenceTarget{targetIndex, jumpAddr}});
+                sequence().push_back(AlwaysJump{lowByte, SequenceTarget{targetIndex, jumpAddr}});
                 seqPointer += 4;
             } else {
                 // Unknown, skip
@@ -748,13 +567,13 @@ NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int
                 patternIndex = patternAddrToIndex[patternAddr];
             }
 
-            sequence_.push_back(PlayPattern{patternIndex, patternAddr});
+            sequence().push_back(PlayPattern{patternIndex, patternAddr});
             seqPointer += 2;
         }
     }
 
     // Resolve jump targets now that all sequence row addresses are known.
-    for (auto& op : sequence_) {
+    for (auto& op : sequence()) {
         if (auto* jump = std::get_if<JumpTimes>(&op)) {
             if (const auto it = sequenceAddrToIndex.find(jump->target.addr); it != sequenceAddrToIndex.end()) {
                 jump->target.index = it->second;
@@ -823,17 +642,17 @@ NspcSong::NspcSong(emulation::AramView aram, const NspcEngineConfig& config, int
             uint16_t endAddr;
             std::vector<NspcEventEntry> events = parseEvents(aram, subrAddr, endAddr);
 
-            if (static_cast<size_t>(subrIndex) >= subroutines_.size()) {
-                subroutines_.resize(subrIndex + 1);
+            if (static_cast<size_t>(subrIndex) >= subroutines().size()) {
+                subroutines().resize(subrIndex + 1);
             }
 
-            subroutines_[subrIndex] = NspcSubroutine{subrIndex, std::move(events), subrAddr};
+            subroutines()[subrIndex] = NspcSubroutine{subrIndex, std::move(events), subrAddr};
         }
     }
 }
 
 const NspcEvent* NspcSong::resolveEvent(const NspcEventRef& ref) const {
-    const auto* entry = resolveEventEntry(tracks_, subroutines_, ref);
+    const auto* entry = resolveEventEntry(tracks(), subroutines(), ref);
     if (!entry) {
         return nullptr;
     }
@@ -841,7 +660,7 @@ const NspcEvent* NspcSong::resolveEvent(const NspcEventRef& ref) const {
 }
 
 NspcEvent* NspcSong::resolveEvent(const NspcEventRef& ref) {
-    auto* entry = resolveEventEntry(tracks_, subroutines_, ref);
+    auto* entry = resolveEventEntry(tracks(), subroutines(), ref);
     if (!entry) {
         return nullptr;
     }
@@ -854,18 +673,28 @@ bool NspcSong::replaceEvent(const NspcEventRef& ref, const NspcEvent& replacemen
         return false;
     }
     *event = replacement;
+    if (ref.owner == NspcEventOwner::Track) {
+        touchTrack(ref.ownerId);
+    } else {
+        touchSubroutine(ref.ownerId);
+    }
     return true;
 }
 
 void NspcSong::flattenSubroutines() {
-    if (tracks_.empty()) {
-        subroutines_.clear();
+    const NspcRevision revision = newNspcRevision();
+    auto& revisions = revisions_.mut();
+    revisions.tracks.touchAll(revision);
+    revisions.subroutines.touchAll(revision);
+
+    if (tracks().empty()) {
+        subroutines().clear();
         subroutineAddrToIndex_.clear();
         nextSubroutineId_ = 0;
         return;
     }
 
-    NspcEventId nextId = nextEventIdForSong(tracks_, subroutines_);
+    NspcEventId nextId = nextEventIdForSong(tracks(), subroutines());
     auto cloneWithNewId = [&](const NspcEventEntry& entry) {
         NspcEventEntry clone = entry;
         clone.id = nextId++;
@@ -873,15 +702,15 @@ void NspcSong::flattenSubroutines() {
     };
 
     // Go though all tracks
-    for (auto &track : tracks_) {
+    for (auto &track : tracks()) {
         auto flatEvents = std::vector<NspcEventEntry>{};
         for (const auto &entry : track.events) {
             if (std::holds_alternative<Vcmd>(entry.event) &&
                 std::holds_alternative<VcmdSubroutineCall>(std::get<Vcmd>(entry.event).vcmd)) {
                 const auto &subCall = std::get<VcmdSubroutineCall>(std::get<Vcmd>(entry.event).vcmd);
-                const auto subrIt = std::find_if(subroutines_.begin(), subroutines_.end(),
+                const auto subrIt = std::find_if(subroutines().begin(), subroutines().end(),
                                                  [&](const NspcSubroutine &subr) { return subr.id == subCall.subroutineId; });
-                if (subrIt != subroutines_.end()) {
+                if (subrIt != subroutines().end()) {
                     for(int i = 0; i < subCall.count; ++i) {
                         // Skip the last end event in the subroutine since it's not needed when inlining
                         for (size_t j = 0; j < subrIt->events.size(); ++j) {
@@ -902,11 +731,109 @@ void NspcSong::flattenSubroutines() {
     }
 
     // Clear subroutines since they've been inlined
-    subroutines_.clear();
+    subroutines().clear();
     subroutineAddrToIndex_.clear();
     nextSubroutineId_ = 0;
     nextEventId_ = nextId;
 }
 
+NspcRevision NspcSong::RevisionStamps::of(int id) const {
+    const auto it = items.find(id);
+    return it != items.end() ? std::max(it->second, base) : base;
+}
+
+void NspcSong::RevisionStamps::touchAll(NspcRevision revision) {
+    base = revision;
+    latest = revision;
+    items.clear();
+}
+
+void NspcSong::RevisionStamps::touch(int id, NspcRevision revision) {
+    items[id] = revision;
+    latest = revision;
+}
+
+NspcRevision NspcSong::revision() const {
+    const Revisions& revisions = *revisions_;
+    return std::max({revisions.metadata, revisions.sequence, revisions.patterns.latest, revisions.tracks.latest,
+                     revisions.subroutines.latest});
+}
+
+NspcRevision NspcSong::patternContentRevision(int patternId) const {
+    NspcRevision revision = std::max(patternRevision(patternId), subroutinesRevision());
+    const auto& songPatterns = patterns();
+    const auto it = std::find_if(songPatterns.begin(), songPatterns.end(),
+                                 [patternId](const NspcPattern& pattern) { return pattern.id == patternId; });
+    if (it != songPatterns.end() && it->channelTrackIds.has_value()) {
+        for (const int trackId : *it->channelTrackIds) {
+            if (trackId >= 0) {
+                revision = std::max(revision, trackRevision(trackId));
+            }
+        }
+    }
+    return revision;
+}
+
+void NspcSong::touch(const NspcSongChanges& changes) {
+    if (changes.all) {
+        touchAll();
+        return;
+    }
+
+    // One stamp for the whole edit
+    const NspcRevision revision = newNspcRevision();
+    auto& revisions = revisions_.mut();
+    if (changes.sequence) {
+        revisions.sequence = revision;
+    }
+    for (const int patternId : changes.patternIds) {
+        revisions.patterns.touch(patternId, revision);
+    }
+    // Slots past the end were dropped by the edit: only the collection changed
+    for (const auto& slot : changes.owners) {
+        if (slot.owner == NspcEventOwner::Track) {
+            if (slot.index < std::as_const(*this).tracks().size()) {
+                revisions.tracks.touch(std::as_const(*this).tracks()[slot.index].id, revision);
+            } else {
+                revisions.tracks.latest = revision;
+            }
+        } else if (slot.index < std::as_const(*this).subroutines().size()) {
+            revisions.subroutines.touch(std::as_const(*this).subroutines()[slot.index].id, revision);
+        } else {
+            revisions.subroutines.latest = revision;
+        }
+    }
+}
+
+void NspcSong::touchAll() {
+    const NspcRevision revision = newNspcRevision();
+    auto& revisions = revisions_.mut();
+    revisions.metadata = revision;
+    revisions.sequence = revision;
+    revisions.patterns.touchAll(revision);
+    revisions.tracks.touchAll(revision);
+    revisions.subroutines.touchAll(revision);
+}
+
+void NspcSong::touchSequence() {
+    revisions_.mut().sequence = newNspcRevision();
+}
+
+void NspcSong::touchPattern(int patternId) {
+    revisions_.mut().patterns.touch(patternId, newNspcRevision());
+}
+
+void NspcSong::touchTrack(int trackId) {
+    revisions_.mut().tracks.touch(trackId, newNspcRevision());
+}
+
+void NspcSong::touchSubroutine(int subroutineId) {
+    revisions_.mut().subroutines.touch(subroutineId, newNspcRevision());
+}
+
+void NspcSong::touchMetadata() {
+    revisions_.mut().metadata = newNspcRevision();
+}
+
 
 }  // namespace ntrak::nspc
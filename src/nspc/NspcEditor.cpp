@@ -1,5 +1,6 @@
 #include "ntrak/nspc/NspcEditor.hpp"
 
+#include "ntrak/common/Parallel.hpp"
 #include "ntrak/nspc/NspcFlatten.hpp"
 
 #include <algorithm>
@@ -9,6 +10,8 @@
 #include <optional>
 #include <span>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace ntrak::nspc {
@@ -43,6 +46,22 @@ struct ResolvedRef {
     NspcEventRef ref{};
 };
 
+// A flattened channel, borrowed from the active edit session's cache or owned when there is none.
+class FlatChannelView {
+public:
+    FlatChannelView() = default;
+    explicit FlatChannelView(const NspcFlatChannel* borrowed) : borrowed_(borrowed) {}
+    explicit FlatChannelView(NspcFlatChannel owned) : owned_(std::move(owned)) {}
+
+    [[nodiscard]] bool has_value() const { return borrowed_ != nullptr || owned_.has_value(); }
+    const NspcFlatChannel& operator*() const { return borrowed_ != nullptr ? *borrowed_ : *owned_; }
+    const NspcFlatChannel* operator->() const { return &**this; }
+
+private:
+    const NspcFlatChannel* borrowed_ = nullptr;
+    std::optional<NspcFlatChannel> owned_;
+};
+
 void eraseOrphanDurationBeforeIndex(std::vector<NspcEventEntry>& events, size_t erasedIndex);
 
 uint8_t clampTicks(uint32_t ticks) {
@@ -573,25 +592,29 @@ std::vector<RowSpan> collectRowSpans(const NspcFlatChannel& channel) {
     return spans;
 }
 
-std::optional<NspcFlatChannel> flattenChannel(const NspcSong& song, const NspcEditorLocation& location) {
+FlatChannelView flattenChannel(const NspcSong& song, const NspcEditorLocation& location,
+                               NspcEditSession* session = nullptr) {
     if (location.patternId < 0 || location.channel < 0 || location.channel >= 8) {
-        return std::nullopt;
+        return {};
+    }
+    if (session != nullptr) {
+        return FlatChannelView(session->flatChannel(location));
     }
 
     const auto pattern = findPatternById(song, location.patternId);
     if (!pattern) {
-        return std::nullopt;
+        return {};
     }
     if (!pattern->channelTrackIds.has_value()) {
-        return std::nullopt;
+        return {};
     }
 
     auto flatPattern = flattenPatternById(song, location.patternId);
     if (!flatPattern.has_value()) {
-        return std::nullopt;
+        return {};
     }
 
-    return flatPattern->channels[static_cast<size_t>(location.channel)];
+    return FlatChannelView(std::move(flatPattern->channels[static_cast<size_t>(location.channel)]));
 }
 
 bool channelHasAssignedTrack(const NspcSong& song, const NspcEditorLocation& location) {
@@ -607,7 +630,10 @@ bool channelHasAssignedTrack(const NspcSong& song, const NspcEditorLocation& loc
     return pattern->channelTrackIds.value()[static_cast<size_t>(location.channel)] >= 0;
 }
 
-std::optional<uint32_t> patternEndTick(const NspcSong& song, int patternId) {
+std::optional<uint32_t> patternEndTick(const NspcSong& song, int patternId, NspcEditSession* session = nullptr) {
+    if (session != nullptr) {
+        return session->patternEndTick(patternId);
+    }
     const auto flatPattern = flattenPatternById(song, patternId);
     if (!flatPattern.has_value()) {
         return std::nullopt;
@@ -615,13 +641,14 @@ std::optional<uint32_t> patternEndTick(const NspcSong& song, int patternId) {
     return flatPattern->totalTicks;
 }
 
-bool extendChannelToTick(NspcSong& song, const NspcEditorLocation& location, uint32_t targetTick) {
+bool extendChannelToTick(NspcSong& song, const NspcEditorLocation& location, uint32_t targetTick,
+                         NspcEditSession* session = nullptr) {
     NspcTrack* track = resolveChannelTrack(song, location, true);
     if (!track) {
         return false;
     }
 
-    auto channel = flattenChannel(song, location);
+    auto channel = flattenChannel(song, location, session);
     uint32_t endTick = 0;
     NspcRowEvent fillEvent = Tie{};
     if (channel.has_value()) {
@@ -891,8 +918,9 @@ bool mergeSpanIntoPrevious(NspcSong& song, const RowSpan& previous, const RowSpa
     return true;
 }
 
-bool compactContinuationAtRow(NspcSong& song, const NspcEditorLocation& location) {
-    const auto channel = flattenChannel(song, location);
+bool compactContinuationAtRow(NspcSong& song, const NspcEditorLocation& location,
+                              NspcEditSession* session = nullptr) {
+    const auto channel = flattenChannel(song, location, session);
     if (!channel.has_value()) {
         return false;
     }
@@ -952,10 +980,9 @@ template <typename CommandPredicate>
 std::vector<NspcEventRef> collectCommandRefsAtRow(const NspcFlatChannel& channel, uint32_t row,
                                                   CommandPredicate&& predicate, bool includeSubroutineCalls = false) {
     std::vector<NspcEventRef> refs;
-    for (const auto& flatEvent : channel.events) {
-        if (flatEvent.tick != row) {
-            continue;
-        }
+    const auto& events = channel.events;
+    for (size_t i = events.firstAtOrAfter(row); i < events.size() && events.tick(i) == row; ++i) {
+        const auto flatEvent = events[i];
         if (flatEvent.source.ownerId < 0) {
             continue;
         }
@@ -976,10 +1003,9 @@ std::vector<NspcEventRef> collectCommandRefsAtRow(const NspcFlatChannel& channel
 }
 
 std::optional<NspcEventRef> findAnchorAtRow(const NspcFlatChannel& channel, uint32_t row) {
-    for (const auto& flatEvent : channel.events) {
-        if (flatEvent.tick != row) {
-            continue;
-        }
+    const auto& events = channel.events;
+    for (size_t i = events.firstAtOrAfter(row); i < events.size() && events.tick(i) == row; ++i) {
+        const auto flatEvent = events[i];
         if (flatEvent.source.ownerId < 0) {
             continue;
         }
@@ -994,10 +1020,9 @@ std::optional<NspcEventRef> findAnchorAtRow(const NspcFlatChannel& channel, uint
 }
 
 std::optional<int> findSubroutineCallIdAtRow(const NspcFlatChannel& channel, uint32_t row) {
-    for (const auto& flatEvent : channel.events) {
-        if (flatEvent.tick != row) {
-            continue;
-        }
+    const auto& events = channel.events;
+    for (size_t i = events.firstAtOrAfter(row); i < events.size() && events.tick(i) == row; ++i) {
+        const auto flatEvent = events[i];
         const auto* vcmd = std::get_if<Vcmd>(&flatEvent.event);
         if (!vcmd) {
             continue;
@@ -1202,21 +1227,22 @@ std::optional<std::pair<size_t, size_t>> resolveTrackSliceForRowRange(const Nspc
 
 template <typename CommandPredicate>
 bool editCommandAtRow(NspcSong& song, const NspcEditorLocation& location, std::optional<Vcmd> replacement,
-                      CommandPredicate&& predicate, bool includeSubroutineCalls = false) {
+                      CommandPredicate&& predicate, bool includeSubroutineCalls = false,
+                      NspcEditSession* session = nullptr) {
     const bool hadAssignedTrackBefore = channelHasAssignedTrack(song, location);
     const std::optional<uint32_t> baselineEndTick =
-        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId);
+        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId, session);
     auto maybe_extend_new_track = [&](bool result) -> bool {
         if (!result || hadAssignedTrackBefore || !baselineEndTick.has_value()) {
             return result;
         }
         if (*baselineEndTick > location.row) {
-            (void)extendChannelToTick(song, location, *baselineEndTick);
+            (void)extendChannelToTick(song, location, *baselineEndTick, session);
         }
         return result;
     };
 
-    const auto channel = flattenChannel(song, location);
+    const auto channel = flattenChannel(song, location, session);
     if (!channel.has_value()) {
         return false;
     }
@@ -1226,7 +1252,7 @@ bool editCommandAtRow(NspcSong& song, const NspcEditorLocation& location, std::o
         auto resolved = resolveRefs(song, commandRefs);
         const bool changed = eraseResolvedRefs(std::move(resolved), replacement);
         if (changed && !replacement.has_value()) {
-            return compactContinuationAtRow(song, location) || changed;
+            return compactContinuationAtRow(song, location, session) || changed;
         }
         return changed;
     }
@@ -1507,7 +1533,7 @@ bool NspcEditor::insertTickAtRow(NspcSong& song, const NspcEditorLocation& locat
             restoreDurationStateBeforeNextTimedEvent(events, insertIndex + 1, insertPoint->duration, nextId);
             changed = true;
         } else {
-            changed = extendChannelToTick(song, location, location.row + 1);
+            changed = extendChannelToTick(song, location, location.row + 1, session_);
         }
     }
 
@@ -1578,13 +1604,13 @@ bool NspcEditor::removeTickAtRow(NspcSong& song, const NspcEditorLocation& locat
 bool NspcEditor::setRowEvent(NspcSong& song, const NspcEditorLocation& location, const NspcRowEvent& event) {
     const bool hadAssignedTrackBefore = channelHasAssignedTrack(song, location);
     const std::optional<uint32_t> baselineEndTick =
-        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId);
+        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId, session_);
     auto maybe_extend_new_track = [&](bool result) -> bool {
         if (!result || hadAssignedTrackBefore || !baselineEndTick.has_value()) {
             return result;
         }
         if (*baselineEndTick > location.row) {
-            (void)extendChannelToTick(song, location, *baselineEndTick);
+            (void)extendChannelToTick(song, location, *baselineEndTick, session_);
         }
         return result;
     };
@@ -1600,7 +1626,7 @@ bool NspcEditor::setRowEvent(NspcSong& song, const NspcEditorLocation& location,
         return finalize(false);
     }
 
-    const auto channel = flattenChannel(song, location);
+    const auto channel = flattenChannel(song, location, session_);
     if (!channel.has_value()) {
         return finalize(false);
     }
@@ -1649,7 +1675,7 @@ bool NspcEditor::setRowEvent(NspcSong& song, const NspcEditorLocation& location,
         syncNextEventId(song, nextId);
         const bool changed = maybe_extend_new_track(true);
         if (changed) {
-            (void)compactContinuationAtRow(song, location);
+            (void)compactContinuationAtRow(song, location, session_);
         }
         return finalize(changed);
     }
@@ -1669,7 +1695,7 @@ bool NspcEditor::setRowEvent(NspcSong& song, const NspcEditorLocation& location,
         ownerEvents->at(*streamIndex).event = toEvent(event);
         const bool changed = maybe_extend_new_track(true);
         if (changed) {
-            (void)compactContinuationAtRow(song, location);
+            (void)compactContinuationAtRow(song, location, session_);
         }
         return finalize(changed);
     }
@@ -1699,7 +1725,7 @@ bool NspcEditor::setRowEvent(NspcSong& song, const NspcEditorLocation& location,
     syncNextEventId(song, nextId);
     const bool changed = maybe_extend_new_track(true);
     if (changed) {
-        (void)compactContinuationAtRow(song, location);
+        (void)compactContinuationAtRow(song, location, session_);
     }
     return finalize(changed);
 }
@@ -1712,7 +1738,7 @@ bool NspcEditor::deleteRowEvent(NspcSong& song, const NspcEditorLocation& locati
         return changed;
     };
 
-    const auto channel = flattenChannel(song, location);
+    const auto channel = flattenChannel(song, location, session_);
     if (!channel.has_value()) {
         return finalize(false);
     }
@@ -1777,7 +1803,7 @@ bool NspcEditor::deleteRowEvent(NspcSong& song, const NspcEditorLocation& locati
     targetEvents->at(*targetStreamIndex).event = toEvent(continuationEvent(previous.event));
     NspcEditorLocation compactLocation = location;
     compactLocation.row = target.startTick;
-    (void)compactContinuationAtRow(song, compactLocation);
+    (void)compactContinuationAtRow(song, compactLocation, session_);
     return finalize(true);
 }
 
@@ -1787,7 +1813,7 @@ bool NspcEditor::setInstrumentAtRow(NspcSong& song, const NspcEditorLocation& lo
     if (instrument.has_value()) {
         replacement = Vcmd{VcmdInst{.instrumentIndex = *instrument}};
     }
-    const bool changed = editCommandAtRow(song, location, replacement, isInstrumentCommand);
+    const bool changed = editCommandAtRow(song, location, replacement, isInstrumentCommand, false, session_);
     if (changed) {
         song.setContentOrigin(NspcContentOrigin::UserProvided);
     }
@@ -1799,7 +1825,7 @@ bool NspcEditor::setVolumeAtRow(NspcSong& song, const NspcEditorLocation& locati
     if (volume.has_value()) {
         replacement = Vcmd{VcmdVolume{.volume = *volume}};
     }
-    const bool changed = editCommandAtRow(song, location, replacement, isVolumeCommand);
+    const bool changed = editCommandAtRow(song, location, replacement, isVolumeCommand, false, session_);
     if (changed) {
         song.setContentOrigin(NspcContentOrigin::UserProvided);
     }
@@ -1809,13 +1835,13 @@ bool NspcEditor::setVolumeAtRow(NspcSong& song, const NspcEditorLocation& locati
 bool NspcEditor::setQvAtRow(NspcSong& song, const NspcEditorLocation& location, std::optional<uint8_t> qv) {
     const bool hadAssignedTrackBefore = channelHasAssignedTrack(song, location);
     const std::optional<uint32_t> baselineEndTick =
-        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId);
+        hadAssignedTrackBefore ? std::nullopt : patternEndTick(song, location.patternId, session_);
     auto maybe_extend_new_track = [&](bool result) -> bool {
         if (!result || hadAssignedTrackBefore || !baselineEndTick.has_value()) {
             return result;
         }
         if (*baselineEndTick > location.row) {
-            (void)extendChannelToTick(song, location, *baselineEndTick);
+            (void)extendChannelToTick(song, location, *baselineEndTick, session_);
         }
         return result;
     };
@@ -1827,7 +1853,7 @@ bool NspcEditor::setQvAtRow(NspcSong& song, const NspcEditorLocation& location,
         return changed;
     };
 
-    const auto channel = flattenChannel(song, location);
+    const auto channel = flattenChannel(song, location, session_);
     if (!channel.has_value()) {
         return finalize(false);
     }
@@ -1972,7 +1998,7 @@ bool NspcEditor::setQvAtRow(NspcSong& song, const NspcEditorLocation& location,
 }
 
 bool NspcEditor::setEffectAtRow(NspcSong& song, const NspcEditorLocation& location, const Vcmd& effect) {
-    const bool changed = editCommandAtRow(song, location, effect, isEffectCommand);
+    const bool changed = editCommandAtRow(song, location, effect, isEffectCommand, false, session_);
     if (changed) {
         song.setContentOrigin(NspcContentOrigin::UserProvided);
     }
@@ -1987,7 +2013,7 @@ bool NspcEditor::addEffectAtRow(NspcSong& song, const NspcEditorLocation& locati
         return changed;
     };
 
-    const auto channel = flattenChannel(song, location);
+    const auto channel = flattenChannel(song, location, session_);
     if (!channel.has_value()) {
         return finalize(false);
     }
@@ -2001,12 +2027,12 @@ bool NspcEditor::addEffectAtRow(NspcSong& song, const NspcEditorLocation& locati
         return finalize(appended);
     }
 
-    return finalize(editCommandAtRow(song, location, Vcmd{effect}, isEffectCommand));
+    return finalize(editCommandAtRow(song, location, Vcmd{effect}, isEffectCommand, false, session_));
 }
 
 bool NspcEditor::clearEffectsAtRow(NspcSong& song, const NspcEditorLocation& location, bool preserveSubroutineCalls) {
     const bool changed =
-        editCommandAtRow(song, location, std::nullopt, isEffectCommand, !preserveSubroutineCalls);
+        editCommandAtRow(song, location, std::nullopt, isEffectCommand, !preserveSubroutineCalls, session_);
     if (changed) {
         song.setContentOrigin(NspcContentOrigin::UserProvided);
     }
@@ -2170,4 +2196,341 @@ bool NspcEditor::deleteSubroutine(NspcSong& song, int subroutineId) {
     return finalize(true);
 }
 
+bool NspcEditor::transformEvents(NspcSong& song, const NspcEventSelection& selection,
+                                 const NspcEventTransform& transform, bool parallel) {
+    struct OwnerWork {
+        NspcEventOwner owner = NspcEventOwner::Track;
+        int ownerId = -1;
+        bool allEvents = false;
+        std::vector<size_t> eventIndices;
+        std::vector<NspcEventEntry>* events = nullptr;
+        bool changed = false;
+    };
+
+    std::vector<OwnerWork> work;
+    std::unordered_map<uint64_t, size_t> workByOwner;
+    const auto ownerKey = [](NspcEventOwner owner, int ownerId) {
+        return (static_cast<uint64_t>(owner) << 32) | static_cast<uint32_t>(ownerId);
+    };
+    const auto workFor = [&](NspcEventOwner owner, int ownerId) -> OwnerWork& {
+        const auto [it, added] = workByOwner.try_emplace(ownerKey(owner, ownerId), work.size());
+        if (added) {
+            OwnerWork& newWork = work.emplace_back();
+            newWork.owner = owner;
+            newWork.ownerId = ownerId;
+        }
+        return work[it->second];
+    };
+
+    const NspcSong& view = song;
+    if (selection.wholeSong) {
+        for (const auto& track : view.tracks()) {
+            workFor(NspcEventOwner::Track, track.id).allEvents = true;
+        }
+        for (const auto& subroutine : view.subroutines()) {
+            workFor(NspcEventOwner::Subroutine, subroutine.id).allEvents = true;
+        }
+    } else {
+        // Ranges are resolved to source events up front, so an event reached through several ranges, patterns
+        // or subroutine iterations is still transformed once.
+        std::unordered_map<int, std::optional<NspcFlatPattern>> flatPatterns;
+        for (const auto& range : selection.ranges) {
+            if (range.channel < 0 || range.channel >= 8 || range.startRow >= range.endRow) {
+                continue;
+            }
+            auto [flatIt, inserted] = flatPatterns.try_emplace(range.patternId);
+            if (inserted) {
+                flatIt->second = flattenPatternById(view, range.patternId);
+            }
+            if (!flatIt->second.has_value()) {
+                continue;
+            }
+            const auto& events = flatIt->second->channels[static_cast<size_t>(range.channel)].events;
+            for (size_t i = events.firstAtOrAfter(range.startRow); i < events.size() && events.tick(i) < range.endRow;
+                 ++i) {
+                const NspcEventRef& source = events.source(i);
+                workFor(source.owner, source.ownerId).eventIndices.push_back(source.eventIndex);
+            }
+        }
+        for (auto& item : work) {
+            std::ranges::sort(item.eventIndices);
+            const auto duplicates = std::ranges::unique(item.eventIndices);
+            item.eventIndices.erase(duplicates.begin(), duplicates.end());
+        }
+    }
+    if (work.empty()) {
+        return false;
+    }
+
+    // Only storage that is about to be written is detached from song snapshots.
+    const bool touchesTracks = std::ranges::any_of(work, [](const OwnerWork& item) {
+        return item.owner == NspcEventOwner::Track;
+    });
+    const bool touchesSubroutines = std::ranges::any_of(work, [](const OwnerWork& item) {
+        return item.owner == NspcEventOwner::Subroutine;
+    });
+    const auto bind = [&](NspcEventOwner owner, int ownerId, std::vector<NspcEventEntry>& events) {
+        if (const auto it = workByOwner.find(ownerKey(owner, ownerId)); it != workByOwner.end()) {
+            OwnerWork& item = work[it->second];
+            if (item.events == nullptr) {
+                item.events = &events;
+            }
+        }
+    };
+    if (touchesTracks) {
+        for (auto& track : song.tracks()) {
+            bind(NspcEventOwner::Track, track.id, track.events);
+        }
+    }
+    if (touchesSubroutines) {
+        for (auto& subroutine : song.subroutines()) {
+            bind(NspcEventOwner::Subroutine, subroutine.id, subroutine.events);
+        }
+    }
+
+    common::parallelFor(
+        work.size(),
+        [&](size_t index) {
+            OwnerWork& item = work[index];
+            if (item.events == nullptr) {
+                return;
+            }
+            auto& events = *item.events;
+            bool changed = false;
+            if (item.allEvents) {
+                for (auto& entry : events) {
+                    changed = transform(entry.event) || changed;
+                }
+            } else {
+                for (const size_t eventIndex : item.eventIndices) {
+                    if (eventIndex < events.size()) {
+                        changed = transform(events[eventIndex].event) || changed;
+                    }
+                }
+            }
+            item.changed = changed;
+        },
+        parallel ? 0 : 1);
+
+    bool changed = false;
+    for (const auto& item : work) {
+        if (!item.changed) {
+            continue;
+        }
+        changed = true;
+        if (item.owner == NspcEventOwner::Track) {
+            song.touchTrack(item.ownerId);
+        } else {
+            song.touchSubroutine(item.ownerId);
+        }
+    }
+    if (changed) {
+        song.setContentOrigin(NspcContentOrigin::UserProvided);
+    }
+    return changed;
+}
+
+NspcEditSession::NspcEditSession(NspcSong& song) : song_(song) {
+    editor_.session_ = this;
+}
+
+bool NspcEditSession::apply(const NspcCellEdit& edit) {
+    const NspcEditorLocation& location = edit.location;
+    editChannel_ = location.channel;
+    lookedUp_ = false;
+
+    const bool changed = std::visit(
+        overloaded{
+            [&](const NspcCellEdit::RowEvent& change) { return editor_.setRowEvent(song_, location, change.event); },
+            [&](const NspcCellEdit::DeleteRowEvent&) { return editor_.deleteRowEvent(song_, location); },
+            [&](const NspcCellEdit::Instrument& change) {
+                return editor_.setInstrumentAtRow(song_, location, change.instrument);
+            },
+            [&](const NspcCellEdit::Volume& change) { return editor_.setVolumeAtRow(song_, location, change.volume); },
+            [&](const NspcCellEdit::Qv& change) { return editor_.setQvAtRow(song_, location, change.qv); },
+            [&](const NspcCellEdit::Effects& change) {
+                bool result = editor_.clearEffectsAtRow(song_, location, change.preserveSubroutineCalls);
+                for (const auto& effect : change.effects) {
+                    result = editor_.addEffectAtRow(song_, location, effect) || result;
+                }
+                return result;
+            },
+        },
+        edit.change);
+
+    if (location.patternId == patternId_ && location.channel >= 0 &&
+        location.channel < static_cast<int>(channels_.size())) {
+        touch(static_cast<size_t>(location.channel));
+    } else {
+        invalidateAll();
+    }
+    editChannel_ = -1;
+    lookedUp_ = false;
+    return changed;
+}
+
+bool NspcEditSession::apply(std::span<const NspcCellEdit> edits) {
+    bool changed = false;
+    for (const auto& edit : edits) {
+        changed = apply(edit) || changed;
+    }
+    return changed;
+}
+
+const NspcFlatChannel* NspcEditSession::flatChannel(const NspcEditorLocation& location) {
+    if (location.channel < 0 || location.channel >= static_cast<int>(channels_.size())) {
+        return nullptr;
+    }
+    beforeLookup();
+    lookedUp_ = true;
+    const NspcPattern* pattern = refresh(location.patternId);
+    if (pattern == nullptr || !pattern->channelTrackIds.has_value()) {
+        return nullptr;
+    }
+    return &clippedChannel(static_cast<size_t>(location.channel));
+}
+
+std::optional<uint32_t> NspcEditSession::patternEndTick(int patternId) {
+    beforeLookup();
+    if (refresh(patternId) == nullptr) {
+        return std::nullopt;
+    }
+    if (stopTick_.has_value()) {
+        return stopTick_;
+    }
+    uint32_t total = 0;
+    for (const auto& channel : channels_) {
+        total = std::max(total, channel.flat.totalTicks);
+    }
+    return total;
+}
+
+void NspcEditSession::beforeLookup() {
+    // The edit in progress may already have written to its channel.
+    if (lookedUp_ && editChannel_ >= 0 && editChannel_ < static_cast<int>(channels_.size())) {
+        touch(static_cast<size_t>(editChannel_));
+    }
+}
+
+const NspcPattern* NspcEditSession::refresh(int patternId) {
+    const NspcSong& song = song_;
+    const auto& patterns = song.patterns();
+    const auto patternIt =
+        std::find_if(patterns.begin(), patterns.end(), [patternId](const NspcPattern& p) { return p.id == patternId; });
+    if (patternIt == patterns.end()) {
+        return nullptr;
+    }
+    if (patternId != patternId_) {
+        invalidateAll();
+        patternId_ = patternId;
+    }
+    // Flattened channels point into the track and subroutine storage; a detached or reallocated vector moves
+    // every event.
+    if (song.tracks().data() != tracksData_ || song.subroutines().data() != subroutinesData_) {
+        invalidateAll();
+        tracksData_ = song.tracks().data();
+        subroutinesData_ = song.subroutines().data();
+    }
+
+    bool reflattened = false;
+    for (bool stale = true; stale;) {
+        for (size_t channelIndex = 0; channelIndex < channels_.size(); ++channelIndex) {
+            const int trackId =
+                patternIt->channelTrackIds.has_value() ? patternIt->channelTrackIds.value()[channelIndex] : -1;
+            const Channel& channel = channels_[channelIndex];
+            if (channel.valid && channel.trackId == trackId) {
+                continue;
+            }
+            reflatten(channelIndex, trackId);
+            reflattened = true;
+        }
+        stale = std::ranges::any_of(channels_, [](const Channel& channel) { return !channel.valid; });
+    }
+
+    if (reflattened) {
+        stopTick_.reset();
+        for (auto& channel : channels_) {
+            if (const auto endTick = flatTrackEndTick(channel.flat)) {
+                stopTick_ = stopTick_.has_value() ? std::min(*stopTick_, *endTick) : *endTick;
+            }
+            channel.clippedValid = false;
+        }
+    }
+    return &*patternIt;
+}
+
+void NspcEditSession::reflatten(size_t channelIndex, int trackId) {
+    Channel& channel = channels_[channelIndex];
+    channel.flat = nspc::flattenChannel(song_, static_cast<int>(channelIndex), trackId, NspcFlattenOptions{});
+    channel.owners.clear();
+    channel.owners.push_back(Owner{.owner = NspcEventOwner::Track, .id = trackId});
+    for (const auto& node : channel.flat.events.frames()) {
+        const Owner owner{.owner = NspcEventOwner::Subroutine, .id = node.frame.subroutineId};
+        if (std::ranges::find(channel.owners, owner) == channel.owners.end()) {
+            channel.owners.push_back(owner);
+        }
+    }
+    channel.trackId = trackId;
+    channel.valid = true;
+    channel.clippedValid = false;
+    ++flattenedChannels_;
+
+    // A track that only now exists may already be assigned to another channel, flattened while it was missing.
+    const auto& tracks = std::as_const(song_).tracks();
+    channel.trackMissing =
+        trackId >= 0 && std::ranges::none_of(tracks, [trackId](const NspcTrack& track) { return track.id == trackId; });
+    if (!channel.trackMissing) {
+        for (auto& other : channels_) {
+            if (other.trackMissing && other.trackId == trackId) {
+                other.valid = false;
+            }
+        }
+    }
+}
+
+void NspcEditSession::touch(size_t channelIndex) {
+    const std::vector<Owner>& owners = channels_[channelIndex].owners;
+    for (size_t other = 0; other < channels_.size(); ++other) {
+        if (other == channelIndex) {
+            continue;
+        }
+        const auto& otherOwners = channels_[other].owners;
+        if (std::ranges::any_of(owners, [&](const Owner& owner) {
+                return std::ranges::find(otherOwners, owner) != otherOwners.end();
+            })) {
+            channels_[other].valid = false;
+        }
+    }
+    channels_[channelIndex].valid = false;
+}
+
+void NspcEditSession::invalidateAll() {
+    for (auto& channel : channels_) {
+        channel.valid = false;
+        channel.owners.clear();
+        channel.clippedValid = false;
+    }
+}
+
+const NspcFlatChannel& NspcEditSession::clippedChannel(size_t channelIndex) {
+    Channel& channel = channels_[channelIndex];
+    if (!stopTick_.has_value()) {
+        return channel.flat;
+    }
+    const uint32_t stopTick = *stopTick_;
+    const auto& events = channel.flat.events;
+    const bool runsPastEnd =
+        channel.flat.totalTicks > stopTick || (!events.empty() && events.tick(events.size() - 1) > stopTick);
+    if (!runsPastEnd) {
+        return channel.flat;
+    }
+    if (!channel.clippedValid) {
+        channel.clipped = channel.flat;
+        channel.clipped->events.eraseAfterTick(stopTick);
+        channel.clipped->totalTicks = std::min(channel.clipped->totalTicks, stopTick);
+        channel.clippedValid = true;
+    }
+    return *channel.clipped;
+}
+
 }  // namespace ntrak::nspc
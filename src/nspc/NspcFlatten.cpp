@@ -1,6 +1,7 @@
 #include "ntrak/nspc/NspcFlatten.hpp"
 
 #include <algorithm>
+#include <type_traits>
 
 namespace ntrak::nspc {
 
@@ -12,7 +13,7 @@ struct FlattenState {
     NspcFlatChannel* channel = nullptr;
     uint32_t tick = 0;
     Duration currentDuration{.ticks = 1, .quantization = std::nullopt, .velocity = std::nullopt};
-    std::vector<NspcSubroutineFrame> callStack;
+    NspcFlatStackId callStack = kFlatStackTop;
 };
 
 const std::vector<NspcEventEntry>* resolveEvents(const NspcSong& song, NspcEventOwner owner, int ownerId) {
@@ -50,25 +51,30 @@ bool pushFlatEvent(FlattenState& state, const NspcEventEntry& entry, NspcEventOw
         return false;
     }
 
-    state.channel->events.push_back(NspcFlatEvent{
-        .tick = state.tick,
-        .event = entry.event,
-        .source =
-            NspcEventRef{
-                .owner = owner,
-                .ownerId = ownerId,
-                .eventIndex = eventIndex,
-                .eventId = entry.id,
-            },
-        .subroutineStack = state.callStack,
-    });
+    state.channel->events.push(state.tick, entry.event,
+                               NspcEventRef{
+                                   .owner = owner,
+                                   .ownerId = ownerId,
+                                   .eventIndex = eventIndex,
+                                   .eventId = entry.id,
+                               },
+                               state.callStack);
 
     return true;
 }
 
+size_t callDepth(const FlattenState& state) {
+    return NspcFlatCallStack(&state.channel->events.frames(), state.callStack).size();
+}
+
 bool wouldRecurse(const FlattenState& state, int subroutineId) {
-    return std::any_of(state.callStack.begin(), state.callStack.end(),
-                       [subroutineId](const NspcSubroutineFrame& frame) { return frame.subroutineId == subroutineId; });
+    const auto& frames = state.channel->events.frames();
+    for (NspcFlatStackId id = state.callStack; id != kFlatStackTop; id = frames[id].parent) {
+        if (frames[id].frame.subroutineId == subroutineId) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool flattenStream(FlattenState& state, NspcEventOwner owner, int ownerId) {
@@ -94,7 +100,7 @@ bool flattenStream(FlattenState& state, NspcEventOwner owner, int ownerId) {
                 continue;
             }
 
-            if (state.callStack.size() >= state.options->maxSubroutineDepth) {
+            if (callDepth(state) >= state.options->maxSubroutineDepth) {
                 continue;
             }
             if (wouldRecurse(state, subroutineCall->subroutineId)) {
@@ -102,8 +108,9 @@ bool flattenStream(FlattenState& state, NspcEventOwner owner, int ownerId) {
             }
 
             const int iterations = static_cast<int>(subroutineCall->count);
+            const NspcFlatStackId caller = state.callStack;
             for (int iteration = 0; iteration < iterations; ++iteration) {
-                state.callStack.push_back(NspcSubroutineFrame{
+                state.callStack = state.channel->events.pushFrame(caller, NspcSubroutineFrame{
                     .subroutineId = subroutineCall->subroutineId,
                     .iteration = static_cast<uint8_t>(iteration),
                     .callEvent =
@@ -119,7 +126,7 @@ bool flattenStream(FlattenState& state, NspcEventOwner owner, int ownerId) {
                     return false;
                 }
 
-                state.callStack.pop_back();
+                state.callStack = caller;
             }
             continue;
         }
@@ -145,53 +152,117 @@ bool flattenStream(FlattenState& state, NspcEventOwner owner, int ownerId) {
     return true;
 }
 
-std::optional<uint32_t> findTrackEndTick(const NspcFlatChannel& channel) {
-    for (const auto& event : channel.events) {
-        if (event.source.owner != NspcEventOwner::Track) {
-            continue;
-        }
-        if (std::holds_alternative<End>(event.event)) {
-            return event.tick;
-        }
+template <typename T, size_t I = 0>
+constexpr size_t eventKindOf() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<I, NspcEvent>, T>) {
+        return I;
+    } else {
+        return eventKindOf<T, I + 1>();
     }
-    return std::nullopt;
 }
 
+constexpr size_t kEndKind = eventKindOf<End>();
+
 }  // namespace
 
-NspcFlatPattern flattenPattern(const NspcSong& song, const NspcPattern& pattern, const NspcFlattenOptions& options) {
-    NspcFlatPattern flatPattern{};
-    flatPattern.patternId = pattern.id;
-    std::optional<uint32_t> earliestPatternEndTick;
+const NspcSubroutineFrame& NspcFlatCallStack::operator[](size_t index) const {
+    NspcFlatStackId id = id_;
+    for (size_t depth = size(); depth > index + 1; --depth) {
+        id = (*nodes_)[id].parent;
+    }
+    return (*nodes_)[id].frame;
+}
 
-    for (int channelIndex = 0; channelIndex < 8; ++channelIndex) {
-        auto& flatChannel = flatPattern.channels[static_cast<size_t>(channelIndex)];
-        flatChannel.channel = channelIndex;
+std::vector<NspcSubroutineFrame> NspcFlatCallStack::frames() const {
+    std::vector<NspcSubroutineFrame> frames(size());
+    NspcFlatStackId id = id_;
+    for (size_t i = frames.size(); i > 0; --i) {
+        frames[i - 1] = (*nodes_)[id].frame;
+        id = (*nodes_)[id].parent;
+    }
+    return frames;
+}
 
-        if (!pattern.channelTrackIds.has_value()) {
-            continue;
-        }
+void NspcFlatEventList::reserve(size_t count) {
+    ticks_.reserve(count);
+    events_.reserve(count);
+    kinds_.reserve(count);
+    sources_.reserve(count);
+    stacks_.reserve(count);
+}
 
-        const int trackId = pattern.channelTrackIds.value()[static_cast<size_t>(channelIndex)];
-        flatChannel.trackId = trackId;
-        if (trackId < 0) {
-            continue;
+void NspcFlatEventList::push(uint32_t tick, const NspcEvent& event, const NspcEventRef& source,
+                             NspcFlatStackId stack) {
+    ticks_.push_back(tick);
+    events_.push_back(&event);
+    kinds_.push_back(static_cast<uint8_t>(event.index()));
+    sources_.push_back(source);
+    stacks_.push_back(stack);
+}
+
+NspcFlatStackId NspcFlatEventList::pushFrame(NspcFlatStackId parent, const NspcSubroutineFrame& frame) {
+    const uint16_t depth = parent == kFlatStackTop ? 1 : static_cast<uint16_t>(frames_[parent].depth + 1);
+    frames_.push_back(NspcFlatStackNode{.frame = frame, .parent = parent, .depth = depth});
+    return static_cast<NspcFlatStackId>(frames_.size() - 1);
+}
+
+size_t NspcFlatEventList::firstAtOrAfter(uint32_t tick) const {
+    return static_cast<size_t>(std::lower_bound(ticks_.begin(), ticks_.end(), tick) - ticks_.begin());
+}
+
+void NspcFlatEventList::eraseAfterTick(uint32_t tick) {
+    const auto keep = static_cast<size_t>(std::upper_bound(ticks_.begin(), ticks_.end(), tick) - ticks_.begin());
+    ticks_.resize(keep);
+    events_.resize(keep);
+    kinds_.resize(keep);
+    sources_.resize(keep);
+    stacks_.resize(keep);
+}
+
+std::optional<uint32_t> flatTrackEndTick(const NspcFlatChannel& channel) {
+    const auto& events = channel.events;
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (events.kind(i) == kEndKind && events.source(i).owner == NspcEventOwner::Track) {
+            return events.tick(i);
         }
+    }
+    return std::nullopt;
+}
+
+NspcFlatChannel flattenChannel(const NspcSong& song, int channelIndex, int trackId,
+                               const NspcFlattenOptions& options) {
+    NspcFlatChannel flatChannel{};
+    flatChannel.channel = channelIndex;
+    flatChannel.trackId = trackId;
+    if (trackId < 0) {
+        return flatChannel;
+    }
+
+    // Most tracks flatten to roughly their own length; subroutine calls grow the arrays geometrically.
+    if (const auto* events = resolveEvents(song, NspcEventOwner::Track, trackId)) {
+        flatChannel.events.reserve(std::min<size_t>(events->size(), options.maxEventsPerChannel));
+    }
 
-        FlattenState state{
-            .song = &song,
-            .options = &options,
-            .channel = &flatChannel,
-        };
-        (void)flattenStream(state, NspcEventOwner::Track, trackId);
+    FlattenState state{
+        .song = &song,
+        .options = &options,
+        .channel = &flatChannel,
+    };
+    (void)flattenStream(state, NspcEventOwner::Track, trackId);
+    flatChannel.totalTicks = state.tick;
+    return flatChannel;
+}
 
-        flatChannel.totalTicks = state.tick;
-        if (const auto channelEndTick = findTrackEndTick(flatChannel); channelEndTick.has_value()) {
+void clipFlatPattern(NspcFlatPattern& flatPattern, const NspcFlattenOptions& options) {
+    flatPattern.totalTicks = 0;
+    std::optional<uint32_t> earliestPatternEndTick;
+    for (const auto& channel : flatPattern.channels) {
+        if (const auto channelEndTick = flatTrackEndTick(channel); channelEndTick.has_value()) {
             if (!earliestPatternEndTick.has_value() || *channelEndTick < *earliestPatternEndTick) {
                 earliestPatternEndTick = *channelEndTick;
             }
         } else {
-            flatPattern.totalTicks = std::max(flatPattern.totalTicks, state.tick);
+            flatPattern.totalTicks = std::max(flatPattern.totalTicks, channel.totalTicks);
         }
     }
 
@@ -206,14 +277,25 @@ NspcFlatPattern flattenPattern(const NspcSong& song, const NspcPattern& pattern,
         flatPattern.totalTicks = stopTick;
 
         for (auto& channel : flatPattern.channels) {
-            auto& events = channel.events;
-            events.erase(std::remove_if(events.begin(), events.end(),
-                                        [stopTick](const NspcFlatEvent& event) { return event.tick > stopTick; }),
-                         events.end());
+            channel.events.eraseAfterTick(stopTick);
             channel.totalTicks = std::min(channel.totalTicks, stopTick);
         }
     }
+}
+
+NspcFlatPattern flattenPattern(const NspcSong& song, const NspcPattern& pattern, const NspcFlattenOptions& options) {
+    NspcFlatPattern flatPattern{};
+    flatPattern.patternId = pattern.id;
+
+    for (int channelIndex = 0; channelIndex < 8; ++channelIndex) {
+        const int trackId = pattern.channelTrackIds.has_value()
+                                ? pattern.channelTrackIds.value()[static_cast<size_t>(channelIndex)]
+                                : -1;
+        auto& flatChannel = flatPattern.channels[static_cast<size_t>(channelIndex)];
+        flatChannel = flattenChannel(song, channelIndex, trackId, options);
+    }
 
+    clipFlatPattern(flatPattern, options);
     return flatPattern;
 }
 
@@ -233,4 +315,134 @@ std::optional<NspcFlatPattern> flattenPatternById(const NspcSong& song, int patt
     return flattenPattern(song, *patternIt, options);
 }
 
+const NspcFlatPattern* NspcFlatPatternCache::flatten(const NspcSong& song, int patternId,
+                                                     const NspcFlattenOptions& options, uint64_t songRevision) {
+    const auto& patterns = song.patterns();
+    const auto patternIt = std::find_if(patterns.begin(), patterns.end(),
+                                        [patternId](const NspcPattern& pattern) { return pattern.id == patternId; });
+    if (patternId < 0 || patternIt == patterns.end()) {
+        if (pattern_.has_value()) {
+            pattern_.reset();
+            ++generation_;
+        }
+        revision_.reset();
+        return nullptr;
+    }
+
+    if (pattern_.has_value() && isUnchanged(song, *patternIt, options, songRevision)) {
+        return &*pattern_;
+    }
+
+    // A channel whose track and called subroutines hold the same events flattens to the same result, whatever
+    // song or pattern it was last seen in.
+    bool changed = !pattern_.has_value() || pattern_->patternId != patternId;
+    for (int channelIndex = 0; channelIndex < 8; ++channelIndex) {
+        const int trackId = patternIt->channelTrackIds.has_value()
+                                ? patternIt->channelTrackIds.value()[static_cast<size_t>(channelIndex)]
+                                : -1;
+        auto& channel = channels_[static_cast<size_t>(channelIndex)];
+        if (channel.valid && options_ == options && channel.trackId == trackId && sourcesMatch(song, channel)) {
+            continue;
+        }
+
+        channel.flat = flattenChannel(song, channelIndex, trackId, options);
+        channel.sources = collectSources(song, channel.flat);
+        rebindToSources(channel);
+        channel.trackId = trackId;
+        channel.valid = true;
+        ++flattenedChannels_;
+        changed = true;
+    }
+
+    if (changed) {
+        NspcFlatPattern flatPattern{};
+        flatPattern.patternId = patternId;
+        for (size_t channelIndex = 0; channelIndex < channels_.size(); ++channelIndex) {
+            flatPattern.channels[channelIndex] = channels_[channelIndex].flat;
+        }
+        clipFlatPattern(flatPattern, options);
+        pattern_ = std::move(flatPattern);
+        ++generation_;
+    }
+
+    song_ = &song;
+    patternId_ = patternId;
+    revision_ = songRevision;
+    options_ = options;
+    trackCount_ = song.tracks().size();
+    subroutineCount_ = song.subroutines().size();
+    return &*pattern_;
+}
+
+bool NspcFlatPatternCache::isUnchanged(const NspcSong& song, const NspcPattern& pattern,
+                                       const NspcFlattenOptions& options, uint64_t songRevision) const {
+    if (revision_ != songRevision || song_ != &song || patternId_ != pattern.id || !(options_ == options)) {
+        return false;
+    }
+    if (trackCount_ != song.tracks().size() || subroutineCount_ != song.subroutines().size()) {
+        return false;
+    }
+    for (size_t channelIndex = 0; channelIndex < channels_.size(); ++channelIndex) {
+        const int trackId = pattern.channelTrackIds.has_value() ? pattern.channelTrackIds.value()[channelIndex] : -1;
+        if (channels_[channelIndex].trackId != trackId) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NspcFlatPatternCache::sourcesMatch(const NspcSong& song, const Channel& channel) {
+    return std::all_of(channel.sources.begin(), channel.sources.end(), [&song](const Source& source) {
+        const auto* events = resolveEvents(song, source.owner, source.id);
+        if (events == nullptr) {
+            return !source.events.has_value();
+        }
+        return source.events.has_value() && *source.events == *events;
+    });
+}
+
+void NspcFlatPatternCache::rebindToSources(Channel& channel) {
+    // Held results must survive edits to the song, so their events point at the cache's own copies.
+    auto& events = channel.flat.events;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const auto& ref = events.source(i);
+        const auto source = std::find_if(channel.sources.begin(), channel.sources.end(), [&ref](const Source& s) {
+            return s.owner == ref.owner && s.id == ref.ownerId;
+        });
+        events.rebindEvent(i, (*source->events)[ref.eventIndex].event);
+    }
+}
+
+std::vector<NspcFlatPatternCache::Source> NspcFlatPatternCache::collectSources(const NspcSong& song,
+                                                                               const NspcFlatChannel& flat) {
+    std::vector<Source> sources;
+    const auto addSource = [&](NspcEventOwner owner, int id) {
+        const bool known = std::any_of(sources.begin(), sources.end(), [&](const Source& source) {
+            return source.owner == owner && source.id == id;
+        });
+        if (known) {
+            return;
+        }
+        Source source{.owner = owner, .id = id, .events = std::nullopt};
+        if (const auto* events = resolveEvents(song, owner, id)) {
+            source.events = *events;
+        }
+        sources.push_back(std::move(source));
+    };
+
+    if (flat.trackId < 0) {
+        return sources;
+    }
+    addSource(NspcEventOwner::Track, flat.trackId);
+    // Every call target is a dependency, including ones that do not resolve yet or were skipped for depth.
+    for (const auto& event : flat.events) {
+        if (const auto* vcmd = std::get_if<Vcmd>(&event.event)) {
+            if (const auto* call = std::get_if<VcmdSubroutineCall>(&vcmd->vcmd)) {
+                addSource(NspcEventOwner::Subroutine, call->subroutineId);
+            }
+        }
+    }
+    return sources;
+}
+
 }  // namespace ntrak::nspc
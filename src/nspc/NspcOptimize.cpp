@@ -1,12 +1,19 @@
 // ntrak/nspc/NspcOptimize.cpp
 #include "ntrak/nspc/NspcOptimize.hpp"
 
+#include "ntrak/common/Parallel.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <functional>  // boyer_moore_horspool_searcher
 #include <format>
 #include <limits>
+#include <optional>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace ntrak::nspc {
@@ -18,6 +25,10 @@ namespace {
 constexpr int kDefaultMaxOptimizeIterations = 128;     // rebuild SAM + apply best each pass
 constexpr int kDefaultTopKCandidatesFromSam = 2048;    // how many SAM states we keep per pass
 constexpr uint32_t kDefaultMaxCandidateBytes = 2048;   // avoid extremely large bodies (speed/quality knob)
+constexpr size_t kBestCandidateEvalWindow = 32;        // candidates evaluated per step when picking the best
+constexpr int kDefaultBeamWidth = 4;                   // beam-search states kept per depth
+constexpr int kDefaultBeamBranching = 3;               // children expanded per beam state
+constexpr size_t kBeamEvaluationsPerState = 256;       // candidate evaluations per beam expansion
 
 // Subroutine call encoding cost in your compiler: opcode + u16 addr + u8 count
 constexpr uint32_t kCallBytes = 4;
@@ -33,6 +44,13 @@ struct EffectiveOptimizerOptions {
     uint32_t maxCandidateBytes = kDefaultMaxCandidateBytes;
     int64_t singleIterationCallPenaltyBytes = kDefaultSingleIterationCallPenaltyBytes;
     bool allowSingleIterationCalls = true;
+    bool incremental = false;
+    int64_t incrementalTolerancePercent = 0;
+    bool selectBestRealSavings = false;
+    size_t maxWorkerThreads = 1;
+    int searchBudgetMilliseconds = 0;
+    int beamWidth = kDefaultBeamWidth;
+    int beamBranching = kDefaultBeamBranching;
 };
 
 [[nodiscard]] EffectiveOptimizerOptions makeEffectiveOptions(const NspcOptimizerOptions& options) {
@@ -44,6 +62,14 @@ struct EffectiveOptimizerOptions {
     effective.singleIterationCallPenaltyBytes =
         static_cast<int64_t>(std::clamp(options.singleIterationCallPenaltyBytes, 0, 256));
     effective.allowSingleIterationCalls = options.allowSingleIterationCalls;
+    effective.incremental = options.incremental;
+    effective.incrementalTolerancePercent = std::clamp(options.incrementalTolerancePercent, 0, 100);
+    effective.selectBestRealSavings = options.selectBestRealSavings;
+    effective.searchBudgetMilliseconds = std::clamp(options.searchBudgetMilliseconds, 0, 10 * 60 * 1000);
+    effective.beamWidth = std::clamp(options.beamWidth, 1, 64);
+    effective.beamBranching = std::clamp(options.beamBranching, 1, 16);
+    effective.maxWorkerThreads =
+        options.maxWorkerThreads == 0 ? common::hardwareWorkerCount() : options.maxWorkerThreads;
     return effective;
 }
 
@@ -102,47 +128,6 @@ static bool sliceConsumesDurationTicks(const std::vector<NspcEventEntry>& events
     return false;
 }
 
-static uint32_t vcmdEncodedSize(const Vcmd& value) {
-    return std::visit(
-        nspc::overloaded{
-            [](const std::monostate&) { return 0u; },
-            [](const VcmdInst&) { return 2u; },
-            [](const VcmdPanning&) { return 2u; },
-            [](const VcmdPanFade&) { return 3u; },
-            [](const VcmdVibratoOn&) { return 4u; },
-            [](const VcmdVibratoOff&) { return 1u; },
-            [](const VcmdGlobalVolume&) { return 2u; },
-            [](const VcmdGlobalVolumeFade&) { return 3u; },
-            [](const VcmdTempo&) { return 2u; },
-            [](const VcmdTempoFade&) { return 3u; },
-            [](const VcmdGlobalTranspose&) { return 2u; },
-            [](const VcmdPerVoiceTranspose&) { return 2u; },
-            [](const VcmdTremoloOn&) { return 4u; },
-            [](const VcmdTremoloOff&) { return 1u; },
-            [](const VcmdVolume&) { return 2u; },
-            [](const VcmdVolumeFade&) { return 3u; },
-            [](const VcmdSubroutineCall&) { return 4u; },
-            [](const VcmdVibratoFadeIn&) { return 2u; },
-            [](const VcmdPitchEnvelopeTo&) { return 4u; },
-            [](const VcmdPitchEnvelopeFrom&) { return 4u; },
-            [](const VcmdPitchEnvelopeOff&) { return 1u; },
-            [](const VcmdFineTune&) { return 2u; },
-            [](const VcmdEchoOn&) { return 4u; },
-            [](const VcmdEchoOff&) { return 1u; },
-            [](const VcmdEchoParams&) { return 4u; },
-            [](const VcmdEchoVolumeFade&) { return 4u; },
-            [](const VcmdPitchSlideToNote&) { return 4u; },
-            [](const VcmdPercussionBaseInstrument&) { return 2u; },
-            [](const VcmdNOP&) { return 3u; },
-            [](const VcmdMuteChannel&) { return 1u; },
-            [](const VcmdFastForwardOn&) { return 1u; },
-            [](const VcmdFastForwardOff&) { return 1u; },
-            [](const VcmdUnused&) { return 1u; },
-            [](const VcmdExtension& value) { return static_cast<uint32_t>(1u + value.paramCount); },
-        },
-        value.vcmd);
-}
-
 static uint32_t eventEncodedSize(const NspcEventEntry& entry) {
     return std::visit(
         nspc::overloaded{
@@ -161,6 +146,14 @@ static uint32_t eventEncodedSize(const NspcEventEntry& entry) {
         entry.event);
 }
 
+static uint32_t encodedBytesForEvents(const std::vector<NspcEventEntry>& events) {
+    uint32_t bytes = 0;
+    for (const auto& e : events) {
+        bytes += eventEncodedSize(e);
+    }
+    return bytes;
+}
+
 // Next id: mirror the scan used in your NspcData.cpp internal helper.
 static NspcEventId nextEventIdForSong(const NspcSong& song) {
     NspcEventId next = 1;
@@ -178,180 +171,185 @@ static NspcEventId nextEventIdForSong(const NspcSong& song) {
 }
 
 // -----------------------------
-// Stable-ish 64-bit hashing for semantic token keys
-// We ensure top-bit=0 so we can use top-bit=1 for unique separators.
+// Token interning: semantically equal events (canonicalized like the encoder) share one dense 32-bit
+// token. Keys hold the exact semantic fields rather than a hash of them, so distinct events can never
+// collide. Tokens stay below kSeparatorBit, which marks the unique per-segment separators.
 // -----------------------------
-static uint64_t splitmix64(uint64_t x) {
-    x += 0x9E3779B97F4A7C15ull;
-    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
-    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
-    return x ^ (x >> 31);
-}
+using Token = uint32_t;
+constexpr Token kSeparatorBit = 1u << 31;
 
-static void hashAdd(uint64_t& h, uint64_t v) {
-    // Cheap combine
-    h ^= splitmix64(v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2));
-}
+struct TokenKey {
+    std::array<uint32_t, 10> words{};
+    uint32_t size = 0;
+
+    void add(uint32_t value) { words[size++] = value; }
+    bool operator==(const TokenKey&) const = default;
+};
 
-static uint64_t hashVcmdSemantic(const Vcmd& vc) {
-    uint64_t h = 0xC0DEC0DE12345678ull;
+struct TokenKeyHash {
+    size_t operator()(const TokenKey& key) const {
+        uint64_t h = 0xCBF29CE484222325ull ^ key.size;
+        for (uint32_t i = 0; i < key.size; ++i) {
+            h = (h ^ key.words[i]) * 0x100000001B3ull;
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
 
+static void appendVcmdKey(TokenKey& key, const Vcmd& vc) {
     std::visit(
         nspc::overloaded{
-            [&](const std::monostate&) { hashAdd(h, 0x00); },
+            [&](const std::monostate&) { key.add(0x00); },
 
             [&](const VcmdInst& v) {
-                hashAdd(h, 0xE0);
-                hashAdd(h, v.instrumentIndex);
+                key.add(0xE0);
+                key.add(v.instrumentIndex);
             },
             [&](const VcmdPanning& v) {
-                hashAdd(h, 0xE1);
-                hashAdd(h, v.panning);
+                key.add(0xE1);
+                key.add(v.panning);
             },
             [&](const VcmdPanFade& v) {
-                hashAdd(h, 0xE2);
-                hashAdd(h, v.time);
-                hashAdd(h, v.target);
+                key.add(0xE2);
+                key.add(v.time);
+                key.add(v.target);
             },
             [&](const VcmdVibratoOn& v) {
-                hashAdd(h, 0xE3);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.rate);
-                hashAdd(h, v.depth);
+                key.add(0xE3);
+                key.add(v.delay);
+                key.add(v.rate);
+                key.add(v.depth);
             },
-            [&](const VcmdVibratoOff&) { hashAdd(h, 0xE4); },
+            [&](const VcmdVibratoOff&) { key.add(0xE4); },
 
             [&](const VcmdGlobalVolume& v) {
-                hashAdd(h, 0xE5);
-                hashAdd(h, v.volume);
+                key.add(0xE5);
+                key.add(v.volume);
             },
             [&](const VcmdGlobalVolumeFade& v) {
-                hashAdd(h, 0xE6);
-                hashAdd(h, v.time);
-                hashAdd(h, v.target);
+                key.add(0xE6);
+                key.add(v.time);
+                key.add(v.target);
             },
             [&](const VcmdTempo& v) {
-                hashAdd(h, 0xE7);
-                hashAdd(h, v.tempo);
+                key.add(0xE7);
+                key.add(v.tempo);
             },
             [&](const VcmdTempoFade& v) {
-                hashAdd(h, 0xE8);
-                hashAdd(h, v.time);
-                hashAdd(h, v.target);
+                key.add(0xE8);
+                key.add(v.time);
+                key.add(v.target);
             },
             [&](const VcmdGlobalTranspose& v) {
-                hashAdd(h, 0xE9);
-                hashAdd(h, static_cast<uint8_t>(v.semitones));
+                key.add(0xE9);
+                key.add(static_cast<uint8_t>(v.semitones));
             },
             [&](const VcmdPerVoiceTranspose& v) {
-                hashAdd(h, 0xEA);
-                hashAdd(h, static_cast<uint8_t>(v.semitones));
+                key.add(0xEA);
+                key.add(static_cast<uint8_t>(v.semitones));
             },
             [&](const VcmdTremoloOn& v) {
-                hashAdd(h, 0xEB);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.rate);
-                hashAdd(h, v.depth);
+                key.add(0xEB);
+                key.add(v.delay);
+                key.add(v.rate);
+                key.add(v.depth);
             },
-            [&](const VcmdTremoloOff&) { hashAdd(h, 0xEC); },
+            [&](const VcmdTremoloOff&) { key.add(0xEC); },
 
             [&](const VcmdVolume& v) {
-                hashAdd(h, 0xED);
-                hashAdd(h, v.volume);
+                key.add(0xED);
+                key.add(v.volume);
             },
             [&](const VcmdVolumeFade& v) {
-                hashAdd(h, 0xEE);
-                hashAdd(h, v.time);
-                hashAdd(h, v.target);
+                key.add(0xEE);
+                key.add(v.time);
+                key.add(v.target);
             },
 
-            // Calls are treated as boundaries (we don't want nesting), but keep hashing defined.
+            // Calls are treated as boundaries (we don't want nesting), but keep them keyed.
             [&](const VcmdSubroutineCall& v) {
-                hashAdd(h, 0xEF);
-                hashAdd(h, static_cast<uint64_t>(static_cast<uint32_t>(v.subroutineId)));
-                hashAdd(h, v.count);
+                key.add(0xEF);
+                key.add(static_cast<uint32_t>(v.subroutineId));
+                key.add(v.count);
             },
 
             [&](const VcmdVibratoFadeIn& v) {
-                hashAdd(h, 0xF0);
-                hashAdd(h, v.time);
+                key.add(0xF0);
+                key.add(v.time);
             },
             [&](const VcmdPitchEnvelopeTo& v) {
-                hashAdd(h, 0xF1);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.length);
-                hashAdd(h, v.semitone);
+                key.add(0xF1);
+                key.add(v.delay);
+                key.add(v.length);
+                key.add(v.semitone);
             },
             [&](const VcmdPitchEnvelopeFrom& v) {
-                hashAdd(h, 0xF2);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.length);
-                hashAdd(h, v.semitone);
+                key.add(0xF2);
+                key.add(v.delay);
+                key.add(v.length);
+                key.add(v.semitone);
             },
-            [&](const VcmdPitchEnvelopeOff&) { hashAdd(h, 0xF3); },
+            [&](const VcmdPitchEnvelopeOff&) { key.add(0xF3); },
             [&](const VcmdFineTune& v) {
-                hashAdd(h, 0xF4);
-                hashAdd(h, static_cast<uint8_t>(v.semitones));
+                key.add(0xF4);
+                key.add(static_cast<uint8_t>(v.semitones));
             },
             [&](const VcmdEchoOn& v) {
-                hashAdd(h, 0xF5);
-                hashAdd(h, v.channels);
-                hashAdd(h, v.left);
-                hashAdd(h, v.right);
+                key.add(0xF5);
+                key.add(v.channels);
+                key.add(v.left);
+                key.add(v.right);
             },
-            [&](const VcmdEchoOff&) { hashAdd(h, 0xF6); },
+            [&](const VcmdEchoOff&) { key.add(0xF6); },
             [&](const VcmdEchoParams& v) {
-                hashAdd(h, 0xF7);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.feedback);
-                hashAdd(h, v.firIndex);
+                key.add(0xF7);
+                key.add(v.delay);
+                key.add(v.feedback);
+                key.add(v.firIndex);
             },
             [&](const VcmdEchoVolumeFade& v) {
-                hashAdd(h, 0xF8);
-                hashAdd(h, v.time);
-                hashAdd(h, v.leftTarget);
-                hashAdd(h, v.rightTarget);
+                key.add(0xF8);
+                key.add(v.time);
+                key.add(v.leftTarget);
+                key.add(v.rightTarget);
             },
             [&](const VcmdPitchSlideToNote& v) {
-                hashAdd(h, 0xF9);
-                hashAdd(h, v.delay);
-                hashAdd(h, v.length);
-                hashAdd(h, v.note);
+                key.add(0xF9);
+                key.add(v.delay);
+                key.add(v.length);
+                key.add(v.note);
             },
             [&](const VcmdPercussionBaseInstrument& v) {
-                hashAdd(h, 0xFA);
-                hashAdd(h, v.index);
+                key.add(0xFA);
+                key.add(v.index);
             },
             [&](const VcmdNOP& v) {
-                hashAdd(h, 0xFB);
-                hashAdd(h, v.nopBytes);
+                key.add(0xFB);
+                key.add(v.nopBytes);
             },
-            [&](const VcmdMuteChannel&) { hashAdd(h, 0xFC); },
-            [&](const VcmdFastForwardOn&) { hashAdd(h, 0xFD); },
-            [&](const VcmdFastForwardOff&) { hashAdd(h, 0xFE); },
-            [&](const VcmdUnused&) { hashAdd(h, 0xFF); },
+            [&](const VcmdMuteChannel&) { key.add(0xFC); },
+            [&](const VcmdFastForwardOn&) { key.add(0xFD); },
+            [&](const VcmdFastForwardOff&) { key.add(0xFE); },
+            [&](const VcmdUnused&) { key.add(0xFF); },
             [&](const VcmdExtension& v) {
-                hashAdd(h, 0xF0FF);
-                hashAdd(h, v.id);
-                hashAdd(h, v.paramCount);
-                for (uint8_t i = 0; i < v.paramCount; ++i) {
-                    hashAdd(h, v.params[i]);
+                key.add(0xF0FF);
+                key.add(v.id);
+                key.add(v.paramCount);
+                const size_t paramCount = std::min<size_t>(v.paramCount, v.params.size());
+                for (size_t i = 0; i < paramCount; ++i) {
+                    key.add(v.params[i]);
                 }
             },
         },
         vc.vcmd);
 
-    // Keep top-bit clear (reserved for separators).
-    h &= ~(1ull << 63);
-    return h;
 }
 
-static uint64_t hashEventSemantic(const NspcEventEntry& e) {
-    uint64_t h = 0xBADC0FFEE0DDF00Dull;
-
+static TokenKey makeTokenKey(const NspcEventEntry& e) {
+    TokenKey key;
     std::visit(
         nspc::overloaded{
-            [&](const std::monostate&) { hashAdd(h, 0x00); },
+            [&](const std::monostate&) { key.add(0x00); },
 
             [&](const Duration& v) {
                 // Canonicalize like encoder:
@@ -359,54 +357,79 @@ static uint64_t hashEventSemantic(const NspcEventEntry& e) {
                 if (ticks == 0) {
                     ticks = 1;
                 }
-                hashAdd(h, 0x01);
-                hashAdd(h, ticks);
+                key.add(0x01);
+                key.add(ticks);
 
                 if (v.quantization.has_value() || v.velocity.has_value()) {
                     const uint8_t q = static_cast<uint8_t>(v.quantization.value_or(0) & 0x07);
                     const uint8_t vel = static_cast<uint8_t>(v.velocity.value_or(0) & 0x0F);
-                    hashAdd(h, 0x100);
-                    hashAdd(h, q);
-                    hashAdd(h, vel);
+                    key.add(0x100);
+                    key.add(q);
+                    key.add(vel);
                 } else {
-                    hashAdd(h, 0x101);
+                    key.add(0x101);
                 }
             },
 
             [&](const Vcmd& v) {
-                hashAdd(h, 0x02);
-                hashAdd(h, hashVcmdSemantic(v));
+                key.add(0x02);
+                appendVcmdKey(key, v);
             },
 
             [&](const Note& v) {
-                hashAdd(h, 0x03);
-                hashAdd(h, v.pitch);
+                key.add(0x03);
+                key.add(v.pitch);
             },
-            [&](const Tie&) { hashAdd(h, 0x04); },
-            [&](const Rest&) { hashAdd(h, 0x05); },
+            [&](const Tie&) { key.add(0x04); },
+            [&](const Rest&) { key.add(0x05); },
             [&](const Percussion& v) {
-                hashAdd(h, 0x06);
-                hashAdd(h, v.index);
+                key.add(0x06);
+                key.add(v.index);
             },
 
-            // Not encodable; treat as a hard boundary in tokenization, but hashing defined anyway.
+            // Not encodable; treat as a hard boundary in tokenization, but keyed anyway.
             [&](const Subroutine& v) {
-                hashAdd(h, 0x07);
-                hashAdd(h, static_cast<uint64_t>(static_cast<uint32_t>(v.id)));
-                hashAdd(h, v.originalAddr);
+                key.add(0x07);
+                key.add(static_cast<uint32_t>(v.id));
+                key.add(v.originalAddr);
             },
 
             // IMPORTANT: End must never be inside extracted subroutines.
-            // We never emit End tokens into the SAM domain; hashing defined anyway.
-            [&](const End&) { hashAdd(h, 0x08); },
+            // We never emit End tokens into the SAM domain; keyed anyway.
+            [&](const End&) { key.add(0x08); },
         },
         e.event);
 
-    h = splitmix64(h);
-    h &= ~(1ull << 63);
-    return h;
+    return key;
 }
 
+// One table per optimizer run. Every track event is interned before the search starts (extraction only
+// moves events and adds call/End boundaries, which are never tokens), so passes, beam states and worker
+// threads all share it read-only.
+class TokenInterner {
+public:
+    void internTracks(const std::vector<NspcTrack>& tracks) {
+        for (const auto& track : tracks) {
+            for (const auto& e : track.events) {
+                ids_.try_emplace(makeTokenKey(e), static_cast<Token>(ids_.size()));
+            }
+        }
+    }
+
+    std::optional<Token> find(const NspcEventEntry& e) const {
+        const auto it = ids_.find(makeTokenKey(e));
+        if (it == ids_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    size_t size() const { return ids_.size(); }
+
+private:
+    std::unordered_map<TokenKey, Token, TokenKeyHash> ids_;
+};
+
 // -----------------------------
 // Segment building: exclude End (0x00) from match domain and split at boundaries.
 // Boundaries:
@@ -417,7 +440,7 @@ static uint64_t hashEventSemantic(const NspcEventEntry& e) {
 struct Segment {
     int trackIndex = -1;
     size_t eventStartIndex = 0; // index in track.events corresponding to tokens[0]
-    std::vector<uint64_t> tokens;
+    std::vector<Token> tokens;
     std::vector<uint8_t> sizes;
 };
 
@@ -433,102 +456,138 @@ static void flushSegmentIfNonEmpty(std::vector<Segment>& segs, Segment& current)
     }
 }
 
-static std::vector<Segment> buildSegmentsFromTracks(const std::vector<NspcTrack>& tracks) {
-    std::vector<Segment> segs;
-    segs.reserve(tracks.size() * 2);
+static void appendSegmentsForTrack(std::vector<Segment>& segs, const NspcTrack& t, int ti,
+                                   const TokenInterner& interner) {
+    Segment cur;
+    cur.trackIndex = ti;
+    cur.eventStartIndex = 0;
 
-    for (int ti = 0; ti < static_cast<int>(tracks.size()); ++ti) {
-        const auto& t = tracks[static_cast<size_t>(ti)];
+    bool started = false;
+    size_t segStart = 0;
 
-        Segment cur;
-        cur.trackIndex = ti;
-        cur.eventStartIndex = 0;
+    for (size_t i = 0; i < t.events.size(); ++i) {
+        const auto& e = t.events[i];
 
-        bool started = false;
-        size_t segStart = 0;
+        if (isEndEvent(e)) {
+            // End is a hard stop and must NOT be included in subroutine bodies.
+            flushSegmentIfNonEmpty(segs, cur);
+            break;
+        }
 
-        for (size_t i = 0; i < t.events.size(); ++i) {
-            const auto& e = t.events[i];
+        // Boundary: avoid nesting calls and avoid spanning non-encodable markers. An event missing from
+        // the interner cannot match anything, so it is treated the same way.
+        const std::optional<Token> token =
+            isSubroutineCallEvent(e) || eventEncodedSize(e) == 0 ? std::nullopt : interner.find(e);
+        if (!token.has_value()) {
+            flushSegmentIfNonEmpty(segs, cur);
+            // next segment starts after this boundary event
+            started = false;
+            continue;
+        }
 
-            if (isEndEvent(e)) {
-                // End is a hard stop and must NOT be included in subroutine bodies.
-                flushSegmentIfNonEmpty(segs, cur);
-                break;
-            }
+        if (!started) {
+            started = true;
+            segStart = i;
+            cur.trackIndex = ti;
+            cur.eventStartIndex = segStart;
+            cur.tokens.clear();
+            cur.sizes.clear();
+        }
 
-            // Boundary: avoid nesting calls and avoid spanning non-encodable markers.
-            if (isSubroutineCallEvent(e) || eventEncodedSize(e) == 0) {
-                flushSegmentIfNonEmpty(segs, cur);
-                // next segment starts after this boundary event
-                started = false;
-                continue;
-            }
+        cur.tokens.push_back(*token);
+        cur.sizes.push_back(static_cast<uint8_t>(eventEncodedSize(e)));
+    }
 
-            if (!started) {
-                started = true;
-                segStart = i;
-                cur.trackIndex = ti;
-                cur.eventStartIndex = segStart;
-                cur.tokens.clear();
-                cur.sizes.clear();
-            }
+    flushSegmentIfNonEmpty(segs, cur);
+}
 
-            cur.tokens.push_back(hashEventSemantic(e));
-            cur.sizes.push_back(static_cast<uint8_t>(eventEncodedSize(e)));
-        }
+static std::vector<Segment> buildSegmentsFromTracks(const std::vector<NspcTrack>& tracks,
+                                                    const TokenInterner& interner) {
+    std::vector<Segment> segs;
+    segs.reserve(tracks.size() * 2);
 
-        flushSegmentIfNonEmpty(segs, cur);
+    for (int ti = 0; ti < static_cast<int>(tracks.size()); ++ti) {
+        appendSegmentsForTrack(segs, tracks[static_cast<size_t>(ti)], ti, interner);
     }
 
     return segs;
 }
 
+// Re-tokenizes only the tracks marked in `touched`, keeping every other track's segments (and the
+// track-ordered layout buildSegmentsFromTracks produces).
+static void refreshSegmentsForTracks(std::vector<Segment>& segs, const std::vector<NspcTrack>& tracks,
+                                     const std::vector<bool>& touched, const TokenInterner& interner) {
+    std::vector<Segment> refreshed;
+    refreshed.reserve(segs.size());
+
+    size_t si = 0;
+    for (int ti = 0; ti < static_cast<int>(tracks.size()); ++ti) {
+        const bool rebuild = static_cast<size_t>(ti) < touched.size() && touched[static_cast<size_t>(ti)];
+        while (si < segs.size() && segs[si].trackIndex == ti) {
+            if (!rebuild) {
+                refreshed.push_back(std::move(segs[si]));
+            }
+            ++si;
+        }
+        if (rebuild) {
+            appendSegmentsForTrack(refreshed, tracks[static_cast<size_t>(ti)], ti, interner);
+        }
+    }
+
+    segs = std::move(refreshed);
+}
+
 // -----------------------------
-// Suffix Automaton over uint64_t symbols (event tokens + unique separators)
-// Using vector transitions (small out-degree typical), faster than unordered_map in practice here.
+// Suffix Automaton over interned tokens (plus unique separators)
+// States and transitions live in flat arrays owned by the automaton and reused across optimizer passes,
+// so a pass allocates nothing once the arena has grown to the song's size. Transitions are found through
+// an open-addressed (state, symbol) table; each state also threads its edges into a list so a clone can
+// copy its source's transitions without scanning the table. The root, which every suffix-link walk ends
+// at and which has an edge for nearly every token, is indexed directly by token instead.
 // -----------------------------
-struct SamTrans {
-    uint64_t sym = 0;
-    int next = -1;
-};
-
 struct SamState {
     int link = -1;
     int len = 0;         // max length
     int firstPos = -1;   // end position of one occurrence
     int occ = 0;         // endpos count (after propagation)
-    std::vector<SamTrans> next;
+    int firstEdge = -1;  // head of this state's edge list
 };
 
-static int samFindNext(const SamState& st, uint64_t sym) {
-    for (const auto& tr : st.next) {
-        if (tr.sym == sym) {
-            return tr.next;
-        }
-    }
-    return -1;
-}
-
-static void samSetNext(SamState& st, uint64_t sym, int nxt) {
-    for (auto& tr : st.next) {
-        if (tr.sym == sym) {
-            tr.next = nxt;
-            return;
-        }
-    }
-    st.next.push_back(SamTrans{sym, nxt});
-}
+struct SamEdge {
+    Token sym = 0;
+    int from = -1;
+    int to = -1;
+    int nextEdge = -1;  // next edge leaving `from`
+};
 
 class SuffixAutomaton {
 public:
-    explicit SuffixAutomaton(size_t reserveStates = 0) {
-        states_.reserve(std::max<size_t>(reserveStates, 2));
-        states_.push_back(SamState{}); // state 0
-        states_[0].link = -1;
+    // Clears the automaton for a sequence of `symbolCount` symbols whose tokens are below `tokenCount`,
+    // keeping previously grown storage.
+    void reset(size_t symbolCount, size_t tokenCount) {
+        // A SAM over n symbols has at most 2n-1 states and 3n-4 transitions.
+        const size_t stateBound = std::max<size_t>(symbolCount * 2, 2);
+        states_.clear();
+        states_.reserve(stateBound);
+        edges_.clear();
+        edges_.reserve(std::max<size_t>(symbolCount * 3, 4));
+
+        size_t slotCount = 16;
+        while (slotCount < symbolCount * 4) {
+            slotCount <<= 1;
+        }
+        if (slots_.size() < slotCount) {
+            slots_.resize(slotCount);
+        }
+        std::fill(slots_.begin(), slots_.end(), -1);
+        slotMask_ = slots_.size() - 1;
+        rootNext_.assign(tokenCount, -1);
+
+        states_.push_back(SamState{});  // state 0
         last_ = 0;
     }
 
-    void extend(uint64_t c, int pos) {
+    void extend(Token c, int pos) {
         int cur = static_cast<int>(states_.size());
         states_.push_back(SamState{});
         states_[cur].len = states_[last_].len + 1;
@@ -536,25 +595,30 @@ public:
         states_[cur].occ = 1;
 
         int p = last_;
-        while (p != -1 && samFindNext(states_[p], c) == -1) {
-            samSetNext(states_[p], c, cur);
+        while (p != -1 && findNext(p, c) == -1) {
+            setNext(p, c, cur);
             p = states_[p].link;
         }
 
         if (p == -1) {
             states_[cur].link = 0;
         } else {
-            int q = samFindNext(states_[p], c);
+            int q = findNext(p, c);
             if (states_[p].len + 1 == states_[q].len) {
                 states_[cur].link = q;
             } else {
                 int clone = static_cast<int>(states_.size());
-                states_.push_back(states_[q]); // copy
+                states_.push_back(states_[q]);
                 states_[clone].len = states_[p].len + 1;
                 states_[clone].occ = 0; // clones don't directly represent new endpos
+                states_[clone].firstEdge = -1;
+                for (int e = states_[q].firstEdge; e != -1; e = edges_[static_cast<size_t>(e)].nextEdge) {
+                    const SamEdge edge = edges_[static_cast<size_t>(e)];
+                    addEdge(clone, edge.sym, edge.to);
+                }
 
-                while (p != -1 && samFindNext(states_[p], c) == q) {
-                    samSetNext(states_[p], c, clone);
+                while (p != -1 && findNext(p, c) == q) {
+                    setNext(p, c, clone);
                     p = states_[p].link;
                 }
                 states_[q].link = clone;
@@ -571,22 +635,22 @@ public:
             maxLen = std::max(maxLen, st.len);
         }
 
-        std::vector<int> cnt(static_cast<size_t>(maxLen + 1), 0);
+        countScratch_.assign(static_cast<size_t>(maxLen + 1), 0);
         for (const auto& st : states_) {
-            cnt[static_cast<size_t>(st.len)]++;
+            countScratch_[static_cast<size_t>(st.len)]++;
         }
         for (int i = 1; i <= maxLen; ++i) {
-            cnt[static_cast<size_t>(i)] += cnt[static_cast<size_t>(i - 1)];
+            countScratch_[static_cast<size_t>(i)] += countScratch_[static_cast<size_t>(i - 1)];
         }
 
-        std::vector<int> order(states_.size(), 0);
+        orderScratch_.assign(states_.size(), 0);
         for (int i = static_cast<int>(states_.size()) - 1; i >= 0; --i) {
-            order[static_cast<size_t>(--cnt[static_cast<size_t>(states_[i].len)])] = i;
+            orderScratch_[static_cast<size_t>(--countScratch_[static_cast<size_t>(states_[i].len)])] = i;
         }
 
         // propagate occ in descending len
-        for (int i = static_cast<int>(order.size()) - 1; i > 0; --i) {
-            int v = order[static_cast<size_t>(i)];
+        for (int i = static_cast<int>(orderScratch_.size()) - 1; i > 0; --i) {
+            int v = orderScratch_[static_cast<size_t>(i)];
             int parent = states_[v].link;
             if (parent >= 0) {
                 states_[static_cast<size_t>(parent)].occ += states_[static_cast<size_t>(v)].occ;
@@ -596,8 +660,91 @@ public:
 
     const std::vector<SamState>& states() const { return states_; }
 
+    // Bytes currently reserved by the arena (states, edges, transition table and scratch).
+    size_t memoryBytes() const {
+        return states_.capacity() * sizeof(SamState) + edges_.capacity() * sizeof(SamEdge) +
+               (slots_.capacity() + rootNext_.capacity() + countScratch_.capacity() + orderScratch_.capacity()) *
+                   sizeof(int);
+    }
+
 private:
+    static uint64_t mixKey(int state, Token sym) {
+        uint64_t h = static_cast<uint64_t>(sym) ^
+                     (static_cast<uint64_t>(static_cast<uint32_t>(state)) * 0x9E3779B97F4A7C15ull);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Slot holding the (state, sym) edge, or the empty slot where it would be inserted.
+    size_t findSlot(int state, Token sym) const {
+        size_t slot = static_cast<size_t>(mixKey(state, sym)) & slotMask_;
+        while (true) {
+            const int e = slots_[slot];
+            if (e == -1) {
+                return slot;
+            }
+            const SamEdge& edge = edges_[static_cast<size_t>(e)];
+            if (edge.from == state && edge.sym == sym) {
+                return slot;
+            }
+            slot = (slot + 1) & slotMask_;
+        }
+    }
+
+    bool isRootToken(int state, Token sym) const { return state == 0 && sym < rootNext_.size(); }
+
+    int findNext(int state, Token sym) const {
+        if (isRootToken(state, sym)) {
+            return rootNext_[sym];
+        }
+        const int e = slots_[findSlot(state, sym)];
+        return e == -1 ? -1 : edges_[static_cast<size_t>(e)].to;
+    }
+
+    void setNext(int state, Token sym, int next) {
+        if (isRootToken(state, sym)) {
+            rootNext_[sym] = next;  // Clones copy edge lists of non-root states only, so no edge is needed.
+            return;
+        }
+        const size_t slot = findSlot(state, sym);
+        if (const int e = slots_[slot]; e != -1) {
+            edges_[static_cast<size_t>(e)].to = next;
+            return;
+        }
+        insertEdge(slot, state, sym, next);
+    }
+
+    // Adds an edge known not to exist yet.
+    void addEdge(int state, Token sym, int next) { insertEdge(findSlot(state, sym), state, sym, next); }
+
+    void insertEdge(size_t slot, int state, Token sym, int next) {
+        const int e = static_cast<int>(edges_.size());
+        edges_.push_back(SamEdge{.sym = sym, .from = state, .to = next, .nextEdge = states_[state].firstEdge});
+        states_[state].firstEdge = e;
+        slots_[slot] = e;
+        if (edges_.size() * 2 > slots_.size()) {
+            growTable();
+        }
+    }
+
+    void growTable() {
+        slots_.assign(slots_.size() * 2, -1);
+        slotMask_ = slots_.size() - 1;
+        for (int e = 0; e < static_cast<int>(edges_.size()); ++e) {
+            const SamEdge& edge = edges_[static_cast<size_t>(e)];
+            slots_[findSlot(edge.from, edge.sym)] = e;
+        }
+    }
+
     std::vector<SamState> states_;
+    std::vector<SamEdge> edges_;
+    std::vector<int> slots_;  // edge index per slot, -1 when empty
+    size_t slotMask_ = 0;
+    std::vector<int> rootNext_;  // root transitions by token, -1 when absent
+    std::vector<int> countScratch_;
+    std::vector<int> orderScratch_;
     int last_ = 0;
 };
 
@@ -674,7 +821,7 @@ static bool buildApplyPlansForCandidate(
     const Candidate& cand,
     const std::vector<NspcTrack>& tracks,
     const std::vector<Segment>& segments,
-    const std::vector<uint64_t>& globalSeq,
+    const std::vector<Token>& globalSeq,
     const std::vector<uint32_t>& prefixBytes,
     const std::vector<uint32_t>& prefixSep,
     const EffectiveOptimizerOptions& options,
@@ -682,9 +829,12 @@ static bool buildApplyPlansForCandidate(
     uint32_t& outLenTok,
     uint32_t& outLenBytes,
     uint64_t& outRepresentativeTrack,
-    size_t& outRepresentativeStart)
+    size_t& outRepresentativeStart,
+    uint32_t* outLiveOccurrences = nullptr,
+    int64_t* outRealSavings = nullptr)
 {
     outPlans.clear();
+    uint32_t liveOccurrences = 0;
 
     const int lenTok = cand.lenTok;
     if (lenTok <= 0) {
@@ -734,6 +884,7 @@ static bool buildApplyPlansForCandidate(
 
         auto it = std::search(seg.tokens.begin(), seg.tokens.end(), searcher);
         while (it != seg.tokens.end()) {
+            ++liveOccurrences;
             const size_t pos = static_cast<size_t>(it - seg.tokens.begin());
             const size_t startEventIndex = seg.eventStartIndex + pos;
 
@@ -877,6 +1028,9 @@ static bool buildApplyPlansForCandidate(
         }
     }
 
+    if (outLiveOccurrences) {
+        *outLiveOccurrences = liveOccurrences;
+    }
     if (!haveRep || totalOccurrences < 2) {
         return false;
     }
@@ -895,6 +1049,9 @@ static bool buildApplyPlansForCandidate(
         return false;
     }
 
+    if (outRealSavings) {
+        *outRealSavings = realSavings;
+    }
     outPlans = std::move(plans);
     outLenTok = static_cast<uint32_t>(lenTok);
     outLenBytes = lenBytes;
@@ -1010,7 +1167,7 @@ static bool hasAnySubroutineCalls(const std::vector<NspcTrack>& tracks) {
 
 static void buildGlobalSequenceWithSeparators(
     const std::vector<Segment>& segments,
-    std::vector<uint64_t>& outSeq,
+    std::vector<Token>& outSeq,
     std::vector<uint32_t>& outPrefixBytes,
     std::vector<uint32_t>& outPrefixSep)
 {
@@ -1025,16 +1182,16 @@ static void buildGlobalSequenceWithSeparators(
     std::vector<uint8_t> sizes;
     sizes.reserve(totalTokens);
 
-    // Unique separators: top-bit=1 and unique payload
-    uint64_t sepId = 1;
+    // Unique separators: kSeparatorBit set and unique payload
+    Token sepId = 1;
 
     for (const auto& seg : segments) {
         for (size_t i = 0; i < seg.tokens.size(); ++i) {
             outSeq.push_back(seg.tokens[i]);
             sizes.push_back(seg.sizes[i]);
         }
-        // separator token: unique and top-bit set
-        outSeq.push_back((1ull << 63) | (sepId++));
+        // separator token: unique and kSeparatorBit set
+        outSeq.push_back(kSeparatorBit | (sepId++));
         sizes.push_back(0);
     }
 
@@ -1043,28 +1200,40 @@ static void buildGlobalSequenceWithSeparators(
 
     for (size_t i = 0; i < outSeq.size(); ++i) {
         outPrefixBytes[i + 1] = outPrefixBytes[i] + static_cast<uint32_t>(sizes[i]);
-        outPrefixSep[i + 1] = outPrefixSep[i] + ((outSeq[i] & (1ull << 63)) ? 1u : 0u);
+        outPrefixSep[i + 1] = outPrefixSep[i] + ((outSeq[i] & kSeparatorBit) != 0 ? 1u : 0u);
+    }
+}
+
+static bool candidateOutranks(const Candidate& a, const Candidate& b) {
+    if (a.estSavings != b.estSavings) return a.estSavings > b.estSavings;
+    if (a.lenBytes != b.lenBytes) return a.lenBytes > b.lenBytes;
+    if (a.lenTok != b.lenTok) return a.lenTok > b.lenTok;
+    if (a.occ != b.occ) return a.occ > b.occ;
+    if (a.firstPos != b.firstPos) return a.firstPos < b.firstPos;
+    return a.stateIndex < b.stateIndex;
+}
+
+// Estimated savings (optimistic) with direct repeat counts:
+// calls encode 1..255 iterations, so the lower bound on call count is ceil(occ/255).
+static int64_t estimateCandidateSavings(uint32_t occurrences, uint32_t lenBytes) {
+    const uint32_t optimisticCalls = optimisticMinCallCountForOccurrences(occurrences);
+    if (optimisticCalls == std::numeric_limits<uint32_t>::max()) {
+        return 0;
     }
+    return static_cast<int64_t>(occurrences) * static_cast<int64_t>(lenBytes) -
+           static_cast<int64_t>(optimisticCalls) * static_cast<int64_t>(kCallBytes) -
+           static_cast<int64_t>(lenBytes + kSubTerminatorBytes);
 }
 
 static std::vector<Candidate> collectTopCandidatesFromSam(
     const SuffixAutomaton& sam,
-    const std::vector<uint64_t>& globalSeq,
+    const std::vector<Token>& globalSeq,
     const std::vector<uint32_t>& prefixBytes,
     const std::vector<uint32_t>& prefixSep,
     const EffectiveOptimizerOptions& options)
 {
     (void)globalSeq;
 
-    auto isBetterCandidate = [](const Candidate& a, const Candidate& b) {
-        if (a.estSavings != b.estSavings) return a.estSavings > b.estSavings;
-        if (a.lenBytes != b.lenBytes) return a.lenBytes > b.lenBytes;
-        if (a.lenTok != b.lenTok) return a.lenTok > b.lenTok;
-        if (a.occ != b.occ) return a.occ > b.occ;
-        if (a.firstPos != b.firstPos) return a.firstPos < b.firstPos;
-        return a.stateIndex < b.stateIndex;
-    };
-
     std::vector<Candidate> candidates;
     candidates.reserve(sam.states().size());
 
@@ -1093,16 +1262,7 @@ static std::vector<Candidate> collectTopCandidatesFromSam(
             continue;
         }
 
-        // Estimated savings (optimistic) with direct repeat counts:
-        // calls encode 1..255 iterations, so the lower bound on call count is ceil(occ/255).
-        const uint32_t optimisticCalls = optimisticMinCallCountForOccurrences(static_cast<uint32_t>(st.occ));
-        if (optimisticCalls == std::numeric_limits<uint32_t>::max()) {
-            continue;
-        }
-        const int64_t est = static_cast<int64_t>(st.occ) * static_cast<int64_t>(lenBytes) -
-                            static_cast<int64_t>(optimisticCalls) * static_cast<int64_t>(kCallBytes) -
-                            static_cast<int64_t>(lenBytes + kSubTerminatorBytes);
-
+        const int64_t est = estimateCandidateSavings(static_cast<uint32_t>(st.occ), lenBytes);
         if (est <= 0) {
             continue;
         }
@@ -1120,93 +1280,589 @@ static std::vector<Candidate> collectTopCandidatesFromSam(
 
     if (candidates.size() > static_cast<size_t>(options.topCandidatesFromSam)) {
         auto split = candidates.begin() + options.topCandidatesFromSam;
-        std::nth_element(candidates.begin(), split, candidates.end(), isBetterCandidate);
+        std::nth_element(candidates.begin(), split, candidates.end(), candidateOutranks);
         candidates.resize(static_cast<size_t>(options.topCandidatesFromSam));
     }
 
-    std::sort(candidates.begin(), candidates.end(), isBetterCandidate);
+    std::sort(candidates.begin(), candidates.end(), candidateOutranks);
     return candidates;
 }
 
+struct CandidateEvaluation {
+    bool profitable = false;
+    int64_t realSavings = 0;
+    std::vector<ApplyPlan> plans;
+    uint32_t lenTok = 0;
+    uint32_t lenBytes = 0;
+    uint64_t repTrack = 0;
+    size_t repStart = 0;
+};
+
+static CandidateEvaluation evaluateCandidate(
+    const NspcSong& song,
+    const Candidate& cand,
+    const std::vector<Segment>& segments,
+    const std::vector<Token>& globalSeq,
+    const std::vector<uint32_t>& prefixBytes,
+    const std::vector<uint32_t>& prefixSep,
+    const EffectiveOptimizerOptions& options)
+{
+    CandidateEvaluation eval;
+    eval.profitable = buildApplyPlansForCandidate(
+        cand, song.tracks(), segments, globalSeq, prefixBytes, prefixSep, options,
+        eval.plans, eval.lenTok, eval.lenBytes, eval.repTrack, eval.repStart, nullptr, &eval.realSavings);
+    return eval;
+}
+
+static void applyEvaluation(NspcSong& song, const CandidateEvaluation& eval, bool allowSingleIterationCalls,
+                            NspcEventId& nextId) {
+    applyPlansCreateSubroutineAndRewriteTracks(song, eval.plans, eval.lenTok, eval.repTrack, eval.repStart,
+                                               allowSingleIterationCalls, nextId);
+}
+
+// Greedy pass over the ranked candidates. Candidates are evaluated in windows, each window spread over
+// the worker threads; every evaluation is read-only, so workers only write their own result slot.
+// Default: apply the best-ranked candidate with real positive savings (the lowest index that succeeds,
+// whatever the window size). With selectBestRealSavings: apply the candidate with the highest real
+// savings, stopping once no remaining estimate (an upper bound) can beat it; ties go to the better rank.
+// Either way the choice does not depend on the thread count. Returns the number of subroutines created.
+static int applyBestEvaluatedCandidate(
+    NspcSong& song,
+    const std::vector<Candidate>& candidates,
+    const std::vector<Segment>& segments,
+    const std::vector<Token>& globalSeq,
+    const std::vector<uint32_t>& prefixBytes,
+    const std::vector<uint32_t>& prefixSep,
+    const EffectiveOptimizerOptions& options,
+    NspcEventId& nextId)
+{
+    const size_t workers = options.maxWorkerThreads;
+    // Pick-best pruning is evaluated per window, so its size must not depend on the worker count.
+    const size_t windowSize = options.selectBestRealSavings ? kBestCandidateEvalWindow : workers;
+
+    // Workers only read the song: through a const reference, so no CowPtr::mut() runs concurrently
+    const NspcSong& readOnlySong = std::as_const(song);
+    std::optional<CandidateEvaluation> best;
+    std::vector<CandidateEvaluation> window;
+    for (size_t windowStart = 0; windowStart < candidates.size(); windowStart += windowSize) {
+        if (best.has_value() && candidates[windowStart].estSavings <= best->realSavings) {
+            break;
+        }
+
+        const size_t windowCount = std::min(windowSize, candidates.size() - windowStart);
+        window.assign(windowCount, CandidateEvaluation{});
+        common::parallelFor(
+            windowCount,
+            [&](size_t i) {
+                window[i] = evaluateCandidate(readOnlySong, candidates[windowStart + i], segments, globalSeq,
+                                              prefixBytes, prefixSep, options);
+            },
+            workers);
+
+        for (auto& eval : window) {
+            if (eval.profitable && (!best.has_value() || eval.realSavings > best->realSavings)) {
+                best = std::move(eval);
+                if (!options.selectBestRealSavings) {
+                    break;
+                }
+            }
+        }
+        if (best.has_value() && !options.selectBestRealSavings) {
+            break;
+        }
+    }
+
+    if (!best.has_value()) {
+        return 0;
+    }
+    applyEvaluation(song, *best, options.allowSingleIterationCalls, nextId);
+    return 1;
+}
+
+// Incremental pass: keeps one automaton's candidates alive across several applications. Rewrites
+// only ever replace tokens with call boundaries, so a candidate's occurrence count can only drop and
+// its SAM estimate stays an upper bound. Candidates are re-scored lazily against the live segments
+// (refreshed per touched track) and applied once their live estimate is within the tolerance of the
+// best remaining bound. With zero tolerance this visits candidates in the order a full rebuild would.
+// Returns the number of subroutines created; the caller rebuilds the automaton when the pool runs dry.
+static int applyCandidatesIncrementally(
+    NspcSong& song,
+    const std::vector<Candidate>& candidates,
+    std::vector<Segment>& segments,
+    const std::vector<Token>& globalSeq,
+    const std::vector<uint32_t>& prefixBytes,
+    const std::vector<uint32_t>& prefixSep,
+    const EffectiveOptimizerOptions& options,
+    const TokenInterner& interner,
+    int maxApplications,
+    NspcEventId& nextId)
+{
+    struct PoolEntry {
+        Candidate cand;
+        int scoredAt = -1;  // application count when estSavings was last measured live
+    };
+    // std heap keeps the max at the front; candidateOutranks puts the best candidate first.
+    const auto heapLess = [](const PoolEntry& a, const PoolEntry& b) { return candidateOutranks(b.cand, a.cand); };
+
+    std::vector<PoolEntry> pool;
+    pool.reserve(candidates.size());
+    for (const auto& cand : candidates) {
+        pool.push_back(PoolEntry{.cand = cand});
+    }
+    std::make_heap(pool.begin(), pool.end(), heapLess);
+
+    int applied = 0;
+    std::vector<bool> touched(song.tracks().size(), false);
+    while (!pool.empty() && applied < maxApplications) {
+        std::pop_heap(pool.begin(), pool.end(), heapLess);
+        PoolEntry entry = pool.back();
+        pool.pop_back();
+
+        std::vector<ApplyPlan> plans;
+        uint32_t lenTok = 0;
+        uint32_t lenBytes = 0;
+        uint64_t repTrack = 0;
+        size_t repStart = 0;
+        uint32_t liveOccurrences = 0;
+        int64_t realSavings = 0;
+        if (!buildApplyPlansForCandidate(
+                entry.cand, song.tracks(), segments, globalSeq, prefixBytes, prefixSep, options,
+                plans, lenTok, lenBytes, repTrack, repStart, &liveOccurrences, &realSavings)) {
+            continue;  // Occurrences only shrink from here, so it cannot become profitable again.
+        }
+
+        if (entry.scoredAt != applied) {
+            entry.cand.occ = static_cast<int>(liveOccurrences);
+            entry.cand.estSavings = estimateCandidateSavings(liveOccurrences, lenBytes);
+            entry.scoredAt = applied;
+            if (!pool.empty()) {
+                const int64_t bound = pool.front().cand.estSavings;
+                if (entry.cand.estSavings * 100 < bound * (100 - options.incrementalTolerancePercent)) {
+                    pool.push_back(entry);
+                    std::push_heap(pool.begin(), pool.end(), heapLess);
+                    continue;
+                }
+            }
+        }
+
+        applyPlansCreateSubroutineAndRewriteTracks(
+            song, plans, lenTok, repTrack, repStart, options.allowSingleIterationCalls, nextId);
+        ++applied;
+
+        std::fill(touched.begin(), touched.end(), false);
+        for (const auto& plan : plans) {
+            touched[static_cast<size_t>(plan.trackIndex)] = true;
+        }
+        refreshSegmentsForTracks(segments, song.tracks(), touched, interner);
+    }
+    return applied;
+}
+
+// Everything derived from one suffix-automaton build over a song's current tracks.
+struct CandidateSearch {
+    std::vector<Segment> segments;
+    std::vector<Token> globalSeq;
+    std::vector<uint32_t> prefixBytes;
+    std::vector<uint32_t> prefixSep;
+    std::vector<Candidate> candidates;
+};
+
+// Returns false when the song has nothing left worth extracting.
+static bool buildCandidateSearch(const NspcSong& song, SuffixAutomaton& sam, const TokenInterner& interner,
+                                 const EffectiveOptimizerOptions& options, NspcOptimizerStats& stats,
+                                 CandidateSearch& out) {
+    // Build match domain segments (excluding End and splitting at boundaries)
+    out.segments = buildSegmentsFromTracks(song.tracks(), interner);
+
+    // If nothing meaningful, stop
+    size_t tokenCount = 0;
+    for (const auto& s : out.segments) tokenCount += s.tokens.size();
+    if (tokenCount < 8) {
+        return false;
+    }
+
+    // Build global seq + prefix sums
+    buildGlobalSequenceWithSeparators(out.segments, out.globalSeq, out.prefixBytes, out.prefixSep);
+
+    // Build SAM
+    sam.reset(out.globalSeq.size(), interner.size());
+    for (int i = 0; i < static_cast<int>(out.globalSeq.size()); ++i) {
+        sam.extend(out.globalSeq[static_cast<size_t>(i)], i);
+    }
+    sam.computeOccurrences();
+    ++stats.automatonBuilds;
+    stats.peakAutomatonBytes = std::max<uint64_t>(stats.peakAutomatonBytes, sam.memoryBytes());
+
+    // Candidates
+    out.candidates = collectTopCandidatesFromSam(sam, out.globalSeq, out.prefixBytes, out.prefixSep, options);
+    return !out.candidates.empty();
+}
+
+using OptimizerClock = std::chrono::steady_clock;
+
+// Stops early, between passes, once `deadline` has passed
+static void runGreedy(NspcSong& song, const EffectiveOptimizerOptions& options, const TokenInterner& interner,
+                      NspcOptimizerStats& stats, NspcEventId& nextId, SuffixAutomaton& sam,
+                      OptimizerClock::time_point deadline = OptimizerClock::time_point::max()) {
+    CandidateSearch search;
+    while (stats.iterations < options.maxOptimizeIterations && OptimizerClock::now() < deadline) {
+        if (!buildCandidateSearch(song, sam, interner, options, stats, search)) {
+            break;
+        }
+
+        const int applied =
+            options.incremental
+                ? applyCandidatesIncrementally(song, search.candidates, search.segments, search.globalSeq,
+                                               search.prefixBytes, search.prefixSep, options, interner,
+                                               options.maxOptimizeIterations - stats.iterations, nextId)
+                : applyBestEvaluatedCandidate(song, search.candidates, search.segments, search.globalSeq,
+                                              search.prefixBytes, search.prefixSep, options, nextId);
+        if (applied == 0) {
+            break;
+        }
+        stats.iterations += applied;
+    }
+}
+
+static uint32_t songEncodedBytes(const NspcSong& song) {
+    uint32_t bytes = 0;
+    for (const auto& track : song.tracks()) {
+        bytes += encodedBytesForEvents(track.events);
+    }
+    for (const auto& subroutine : song.subroutines()) {
+        bytes += encodedBytesForEvents(subroutine.events);
+    }
+    return bytes;
+}
+
+struct BeamState {
+    NspcSong song;
+    NspcEventId nextId = 0;
+    uint32_t bytes = 0;
+    int64_t realSavings = 0;  // summed over the applied extractions, so it includes runtime penalties
+    int iterations = 0;
+};
+
+// The `branching` most profitable candidates of one beam state, best real savings first (ties keep the
+// automaton's ranking). Stops after kBeamEvaluationsPerState evaluations.
+static std::vector<CandidateEvaluation> topEvaluationsForState(const BeamState& state,
+                                                               const EffectiveOptimizerOptions& options,
+                                                               const TokenInterner& interner,
+                                                               NspcOptimizerStats& stats) {
+    SuffixAutomaton sam;
+    CandidateSearch search;
+    if (!buildCandidateSearch(state.song, sam, interner, options, stats, search)) {
+        return {};
+    }
+
+    std::vector<CandidateEvaluation> best;
+    const size_t evaluations = std::min(search.candidates.size(), kBeamEvaluationsPerState);
+    for (size_t i = 0; i < evaluations; ++i) {
+        if (best.size() == static_cast<size_t>(options.beamBranching) &&
+            search.candidates[i].estSavings <= best.back().realSavings) {
+            break;  // Estimates only fall from here and bound real savings.
+        }
+        CandidateEvaluation eval = evaluateCandidate(state.song, search.candidates[i], search.segments,
+                                                     search.globalSeq, search.prefixBytes, search.prefixSep, options);
+        if (!eval.profitable) {
+            continue;
+        }
+        const auto at = std::upper_bound(best.begin(), best.end(), eval.realSavings,
+                                         [](int64_t savings, const CandidateEvaluation& e) { return savings > e.realSavings; });
+        best.insert(at, std::move(eval));
+        if (best.size() > static_cast<size_t>(options.beamBranching)) {
+            best.pop_back();
+        }
+    }
+    return best;
+}
+
+// Beam search over extraction orders. Every depth expands each beam state with its most profitable
+// candidates (states in parallel, each on its own automaton) and keeps the states with the highest
+// summed real savings. Runs until no state can extract more or the time budget is spent, then finishes
+// the best unfinished state greedily if time remains. The greedy result is the baseline, so the search never
+// returns a larger song. Every stage checks the deadline between passes, so the budget is overrun by at most
+// one pass.
+static void runBeamSearch(NspcSong& song, const EffectiveOptimizerOptions& options, const TokenInterner& interner,
+                          NspcOptimizerStats& stats, NspcEventId& nextId) {
+    using Clock = OptimizerClock;
+    const auto deadline = Clock::now() + std::chrono::milliseconds(options.searchBudgetMilliseconds);
+
+    NspcOptimizerStats greedyStats;
+    BeamState best{.song = song, .nextId = nextId};
+    {
+        SuffixAutomaton sam;
+        runGreedy(best.song, options, interner, greedyStats, best.nextId, sam, deadline);
+    }
+    best.bytes = songEncodedBytes(best.song);
+    best.iterations = greedyStats.iterations;
+    stats.greedyBytesAfter = best.bytes;
+    stats.automatonBuilds += greedyStats.automatonBuilds;
+    stats.peakAutomatonBytes = greedyStats.peakAutomatonBytes;
+
+    std::vector<BeamState> beam;
+    beam.push_back(BeamState{.song = song, .nextId = nextId, .bytes = songEncodedBytes(song)});
+    while (!beam.empty() && Clock::now() < deadline && beam.front().iterations < options.maxOptimizeIterations) {
+        std::vector<std::vector<CandidateEvaluation>> expansions(beam.size());
+        std::vector<NspcOptimizerStats> expansionStats(beam.size());
+        common::parallelFor(
+            beam.size(),
+            [&](size_t i) { expansions[i] = topEvaluationsForState(beam[i], options, interner, expansionStats[i]); },
+            options.maxWorkerThreads);
+
+        // Children are listed parent by parent, best expansion first, so the stable sort below is deterministic.
+        std::vector<BeamState> children;
+        for (size_t i = 0; i < beam.size(); ++i) {
+            stats.automatonBuilds += expansionStats[i].automatonBuilds;
+            stats.peakAutomatonBytes = std::max(stats.peakAutomatonBytes, expansionStats[i].peakAutomatonBytes);
+            for (const auto& eval : expansions[i]) {
+                BeamState child{.song = beam[i].song,
+                                .nextId = beam[i].nextId,
+                                .realSavings = beam[i].realSavings + eval.realSavings,
+                                .iterations = beam[i].iterations + 1};
+                applyEvaluation(child.song, eval, options.allowSingleIterationCalls, child.nextId);
+                child.bytes = songEncodedBytes(child.song);
+                children.push_back(std::move(child));
+            }
+        }
+        // Rank by the optimizer's own objective. Different extraction orders often converge on the same
+        // song, so children matching a better-ranked one in savings and size are dropped to keep the beam diverse.
+        std::stable_sort(children.begin(), children.end(),
+                         [](const BeamState& a, const BeamState& b) { return a.realSavings > b.realSavings; });
+        std::vector<BeamState> kept;
+        for (auto& child : children) {
+            if (kept.size() == static_cast<size_t>(options.beamWidth)) {
+                break;
+            }
+            const bool duplicate = std::any_of(kept.begin(), kept.end(), [&](const BeamState& other) {
+                return other.realSavings == child.realSavings && other.bytes == child.bytes;
+            });
+            if (!duplicate) {
+                kept.push_back(std::move(child));
+            }
+        }
+        children = std::move(kept);
+
+        ++stats.searchDepth;
+        // Finished states (nothing left to expand) drop out of the beam; keep the best of them.
+        for (size_t i = 0; i < beam.size(); ++i) {
+            if (expansions[i].empty() && beam[i].bytes < best.bytes) {
+                best = std::move(beam[i]);
+            }
+        }
+        beam = std::move(children);
+    }
+
+    if (!beam.empty()) {
+        // Finish with the fast incremental pass rather than a full greedy one; it does nothing once the
+        // budget is spent, leaving the frontier to compete as it is.
+        EffectiveOptimizerOptions finishOptions = options;
+        finishOptions.incremental = true;
+        BeamState& frontier = beam.front();
+        NspcOptimizerStats finishStats{.iterations = frontier.iterations};
+        SuffixAutomaton sam;
+        runGreedy(frontier.song, finishOptions, interner, finishStats, frontier.nextId, sam, deadline);
+        frontier.bytes = songEncodedBytes(frontier.song);
+        frontier.iterations = finishStats.iterations;
+        stats.automatonBuilds += finishStats.automatonBuilds;
+        if (frontier.bytes < best.bytes) {
+            best = std::move(frontier);
+        }
+    }
+
+    song = std::move(best.song);
+    nextId = best.nextId;
+    stats.iterations = best.iterations;
+}
+
 } // namespace
 
 // -----------------------------
 // Public entry point
 // -----------------------------
-void optimizeSongSubroutines(NspcSong& song, const NspcOptimizerOptions& options) {
-    const EffectiveOptimizerOptions effective = makeEffectiveOptions(options);
+void applyOptimizerPreset(NspcOptimizerOptions& options, NspcOptimizerPreset preset) {
+    switch (preset) {
+    case NspcOptimizerPreset::Relaxed:
+        options.maxOptimizeIterations = 64;
+        options.topCandidatesFromSam = 1024;
+        options.maxCandidateBytes = 1536;
+        options.singleIterationCallPenaltyBytes = 16;
+        options.allowSingleIterationCalls = false;
+        options.searchBudgetMilliseconds = 0;
+        break;
+    case NspcOptimizerPreset::Balanced:
+        options.maxOptimizeIterations = 128;
+        options.topCandidatesFromSam = 2048;
+        options.maxCandidateBytes = 2048;
+        options.singleIterationCallPenaltyBytes = 16;
+        options.allowSingleIterationCalls = true;
+        options.searchBudgetMilliseconds = 0;
+        break;
+    case NspcOptimizerPreset::Aggressive:
+    case NspcOptimizerPreset::AggressivePlus:
+        options.maxOptimizeIterations = 512;
+        options.topCandidatesFromSam = 16384;
+        options.maxCandidateBytes = 16384;
+        options.singleIterationCallPenaltyBytes = 8;
+        options.allowSingleIterationCalls = true;
+        options.searchBudgetMilliseconds = (preset == NspcOptimizerPreset::AggressivePlus) ? 10000 : 0;
+        break;
+    }
+}
+
+std::string_view optimizerPresetName(NspcOptimizerPreset preset) {
+    switch (preset) {
+    case NspcOptimizerPreset::Relaxed:
+        return "Relaxed";
+    case NspcOptimizerPreset::Balanced:
+        return "Balanced";
+    case NspcOptimizerPreset::Aggressive:
+        return "Aggressive";
+    case NspcOptimizerPreset::AggressivePlus:
+        return "Aggressive+";
+    }
+    return "Unknown";
+}
 
+NspcOptimizerStats optimizeSongSubroutines(NspcSong& song, const NspcOptimizerOptions& options) {
     // Ensure linear tracks first (no nesting in the extraction stage)
     song.flattenSubroutines();
+    return optimizeFlattenedSongSubroutines(song, options);
+}
+
+NspcOptimizerStats optimizeFlattenedSongSubroutines(NspcSong& song, const NspcOptimizerOptions& options) {
+    const EffectiveOptimizerOptions effective = makeEffectiveOptions(options);
+    NspcOptimizerStats stats;
 
     // If flattening could not remove calls (recursive/missing), don't break the song.
     if (hasAnySubroutineCalls(song.tracks())) {
-        return;
+        return stats;
+    }
+
+    for (const auto& track : song.tracks()) {
+        stats.bytesBefore += encodedBytesForEvents(track.events);
     }
 
     // Start fresh: we are going to create our own optimized set.
     song.subroutines().clear();
 
+    TokenInterner interner;
+    interner.internTracks(song.tracks());
+    stats.distinctTokens = static_cast<int>(interner.size());
+
     NspcEventId nextId = nextEventIdForSong(song);
+    if (effective.searchBudgetMilliseconds > 0) {
+        runBeamSearch(song, effective, interner, stats, nextId);
+    } else {
+        SuffixAutomaton sam;
+        runGreedy(song, effective, interner, stats, nextId, sam);
+    }
+
+    stats.subroutinesCreated = static_cast<int>(song.subroutines().size());
+    for (const auto& track : song.tracks()) {
+        stats.bytesAfter += encodedBytesForEvents(track.events);
+    }
+    for (const auto& subroutine : song.subroutines()) {
+        stats.bytesAfter += encodedBytesForEvents(subroutine.events);
+    }
+    song.touchAll();
+    return stats;
+}
 
-    for (int iter = 0; iter < effective.maxOptimizeIterations; ++iter) {
-        // Build match domain segments (excluding End and splitting at boundaries)
-        const std::vector<Segment> segments = buildSegmentsFromTracks(song.tracks());
+NspcSharedOptimizerStats optimizeSharedSubroutines(std::span<NspcSong* const> songs,
+                                                   const NspcOptimizerOptions& options) {
+    NspcSharedOptimizerStats stats;
+    stats.songs.resize(songs.size());
 
-        // If nothing meaningful, stop
-        size_t tokenCount = 0;
-        for (const auto& s : segments) tokenCount += s.tokens.size();
-        if (tokenCount < 8) {
-            break;
+    // Pool every song's flattened tracks into one song; trackOwner maps pooled tracks back.
+    for (NspcSong* song : songs) {
+        song->flattenSubroutines();
+        if (hasAnySubroutineCalls(song->tracks())) {
+            return stats;  // Same bail-out as optimizeSongSubroutines: never break a song.
         }
+    }
 
-        // Build global seq + prefix sums
-        std::vector<uint64_t> globalSeq;
-        std::vector<uint32_t> prefixBytes;
-        std::vector<uint32_t> prefixSep;
-        buildGlobalSequenceWithSeparators(segments, globalSeq, prefixBytes, prefixSep);
-
-        // Build SAM
-        SuffixAutomaton sam(globalSeq.size() * 2);
-        for (int i = 0; i < static_cast<int>(globalSeq.size()); ++i) {
-            sam.extend(globalSeq[static_cast<size_t>(i)], i);
+    NspcSong pooled;
+    std::vector<size_t> trackOwner;
+    for (size_t i = 0; i < songs.size(); ++i) {
+        NspcSong& song = *songs[i];
+        for (const auto& track : song.tracks()) {
+            stats.songs[i].bytesBefore += encodedBytesForEvents(track.events);
         }
-        sam.computeOccurrences();
+        stats.bytesBefore += stats.songs[i].bytesBefore;
+        song.subroutines().clear();
 
-        // Candidates
-        const std::vector<Candidate> candidates =
-            collectTopCandidatesFromSam(sam, globalSeq, prefixBytes, prefixSep, effective);
-        if (candidates.empty()) {
-            break;
+        for (auto& track : song.tracks()) {
+            pooled.tracks().push_back(std::move(track));
+            trackOwner.push_back(i);
         }
+        song.tracks().clear();
+    }
 
-        bool applied = false;
+    stats.combined = optimizeFlattenedSongSubroutines(pooled, options);
 
-        // Try best-first; apply the first candidate that yields real positive savings after overlap/run handling.
-        for (const auto& cand : candidates) {
-            std::vector<ApplyPlan> plans;
-            uint32_t lenTok = 0;
-            uint32_t lenBytes = 0;
-            uint64_t repTrack = 0;
-            size_t repStart = 0;
+    std::vector<int> callersBySubroutine(pooled.subroutines().size(), 0);
+    std::vector<std::vector<bool>> callsBySong(songs.size(), std::vector<bool>(pooled.subroutines().size(), false));
+    for (size_t t = 0; t < pooled.tracks().size(); ++t) {
+        for (const auto& entry : pooled.tracks()[t].events) {
+            if (const auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
+                if (const auto* call = std::get_if<VcmdSubroutineCall>(&vcmd->vcmd)) {
+                    callsBySong[trackOwner[t]][static_cast<size_t>(call->subroutineId)] = true;
+                }
+            }
+        }
+    }
+    for (const auto& calls : callsBySong) {
+        for (size_t sub = 0; sub < calls.size(); ++sub) {
+            callersBySubroutine[sub] += calls[sub] ? 1 : 0;
+        }
+    }
 
-            if (!buildApplyPlansForCandidate(
-                    cand, song.tracks(), segments, globalSeq, prefixBytes, prefixSep, effective,
-                    plans, lenTok, lenBytes, repTrack, repStart)) {
+    // Hand the tracks back and give each song local copies (ids 0..n-1) of the subroutines it calls.
+    std::vector<std::vector<int>> localIdBySong(songs.size(), std::vector<int>(pooled.subroutines().size(), -1));
+    for (size_t i = 0; i < songs.size(); ++i) {
+        NspcSong& song = *songs[i];
+        for (size_t sub = 0; sub < pooled.subroutines().size(); ++sub) {
+            if (!callsBySong[i][sub]) {
                 continue;
             }
-
-            applyPlansCreateSubroutineAndRewriteTracks(
-                song, plans, lenTok, repTrack, repStart, effective.allowSingleIterationCalls, nextId);
-            applied = true;
-            break;
+            NspcSubroutine copy = pooled.subroutines()[sub];
+            copy.id = static_cast<int>(song.subroutines().size());
+            localIdBySong[i][sub] = copy.id;
+            const uint32_t bytes = encodedBytesForEvents(copy.events);
+            if (callersBySubroutine[sub] > 1) {
+                ++stats.songs[i].sharedSubroutinesUsed;
+            } else {
+                stats.songs[i].bytesAfter += bytes;
+            }
+            song.subroutines().push_back(std::move(copy));
         }
+    }
+    for (size_t t = 0; t < pooled.tracks().size(); ++t) {
+        const size_t owner = trackOwner[t];
+        NspcTrack& track = pooled.tracks()[t];
+        for (auto& entry : track.events) {
+            if (auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
+                if (auto* call = std::get_if<VcmdSubroutineCall>(&vcmd->vcmd)) {
+                    call->subroutineId = localIdBySong[owner][static_cast<size_t>(call->subroutineId)];
+                }
+            }
+        }
+        stats.songs[owner].bytesAfter += encodedBytesForEvents(track.events);
+        songs[owner]->tracks().push_back(std::move(track));
+    }
+    for (NspcSong* song : songs) {
+        song->touchAll();
+    }
 
-        if (!applied) {
-            break;
+    for (size_t sub = 0; sub < pooled.subroutines().size(); ++sub) {
+        if (callersBySubroutine[sub] > 1) {
+            ++stats.sharedSubroutines;
+            stats.sharedSubroutineBytes += encodedBytesForEvents(pooled.subroutines()[sub].events);
         }
     }
+    stats.bytesAfter = stats.combined.bytesAfter;
+    return stats;
 }
 
-
 }  // namespace ntrak::nspc
@@ -0,0 +1,158 @@
+#include "ntrak/nspc/NspcOptimizerCache.hpp"
+
+#include "ntrak/nspc/NspcCompile.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace ntrak::nspc {
+namespace {
+
+constexpr uint64_t kFnvOffsetBasis = 1469598103934665603ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+// Bumped whenever the optimizer can produce different output for the same input, so results cached
+// by an older build (e.g. persisted in a project file) stop matching.
+constexpr uint64_t kOptimizerCacheRevision = 2;
+
+void appendValue(std::vector<uint8_t>& input, uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        input.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void appendString(std::vector<uint8_t>& input, std::string_view text) {
+    appendValue(input, text.size());
+    input.insert(input.end(), text.begin(), text.end());
+}
+
+uint64_t hashInput(std::span<const uint8_t> input) {
+    uint64_t hash = kFnvOffsetBasis;
+    for (const uint8_t byte : input) {
+        hash ^= byte;
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+bool hasSubroutineCall(const std::vector<NspcEventEntry>& events) {
+    for (const auto& entry : events) {
+        if (const auto* vcmd = std::get_if<Vcmd>(&entry.event);
+            vcmd != nullptr && std::holds_alternative<VcmdSubroutineCall>(vcmd->vcmd)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+std::optional<NspcOptimizerCacheEntry> NspcOptimizerCache::find(const NspcOptimizerCacheKey& key) const {
+    std::scoped_lock lock(mutex_);
+    const auto it = entries_.find(key.hash);
+    if (it == entries_.end() || it->second.keyInput != key.input) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void NspcOptimizerCache::store(const NspcOptimizerCacheKey& key, NspcOptimizerCacheEntry entry) {
+    entry.keyInput = key.input;
+    std::scoped_lock lock(mutex_);
+    const auto [it, inserted] = entries_.insert_or_assign(key.hash, std::move(entry));
+    if (!inserted) {
+        return;
+    }
+    insertionOrder_.push_back(key.hash);
+    while (insertionOrder_.size() > kMaxEntries) {
+        entries_.erase(insertionOrder_.front());
+        insertionOrder_.pop_front();
+    }
+}
+
+void NspcOptimizerCache::clear() {
+    std::scoped_lock lock(mutex_);
+    entries_.clear();
+    insertionOrder_.clear();
+}
+
+size_t NspcOptimizerCache::size() const {
+    std::scoped_lock lock(mutex_);
+    return entries_.size();
+}
+
+std::vector<std::pair<uint64_t, NspcOptimizerCacheEntry>> NspcOptimizerCache::entries() const {
+    std::scoped_lock lock(mutex_);
+    std::vector<std::pair<uint64_t, NspcOptimizerCacheEntry>> out;
+    out.reserve(insertionOrder_.size());
+    for (const uint64_t key : insertionOrder_) {
+        out.emplace_back(key, entries_.at(key));
+    }
+    return out;
+}
+
+std::optional<NspcOptimizerCacheKey> optimizerCacheKey(const NspcSong& flattenedSong,
+                                                       const NspcOptimizerOptions& options,
+                                                       const NspcEngineConfig& engine) {
+    NspcOptimizerCacheKey key;
+    std::vector<uint8_t>& input = key.input;
+    appendValue(input, kOptimizerCacheRevision);
+    appendString(input, engine.id);
+    appendString(input, engine.engineVersion);
+    appendString(input, engine.name);
+
+    // maxWorkerThreads is left out: it never changes the result.
+    appendValue(input, static_cast<uint64_t>(options.maxOptimizeIterations));
+    appendValue(input, static_cast<uint64_t>(options.topCandidatesFromSam));
+    appendValue(input, options.maxCandidateBytes);
+    appendValue(input, static_cast<uint64_t>(options.singleIterationCallPenaltyBytes));
+    appendValue(input, options.allowSingleIterationCalls ? 1u : 0u);
+    appendValue(input, options.incremental ? 1u : 0u);
+    appendValue(input, static_cast<uint64_t>(options.incrementalTolerancePercent));
+    appendValue(input, options.selectBestRealSavings ? 1u : 0u);
+    appendValue(input, static_cast<uint64_t>(options.searchBudgetMilliseconds));
+    appendValue(input, static_cast<uint64_t>(options.beamWidth));
+    appendValue(input, static_cast<uint64_t>(options.beamBranching));
+
+    appendValue(input, flattenedSong.tracks().size());
+    for (const auto& track : flattenedSong.tracks()) {
+        if (hasSubroutineCall(track.events)) {
+            return std::nullopt;
+        }
+        std::vector<std::string> warnings;
+        const auto encoded = encodeEventStreamForEngine(track.events, {}, warnings, engine);
+        if (!encoded.has_value()) {
+            return std::nullopt;
+        }
+        appendValue(input, encoded->size());
+        input.insert(input.end(), encoded->begin(), encoded->end());
+    }
+    key.hash = hashInput(input);
+    return key;
+}
+
+bool applyOptimizerCacheEntry(NspcSong& song, const NspcOptimizerCacheEntry& entry) {
+    if (entry.trackEvents.size() != song.tracks().size()) {
+        return false;
+    }
+    for (size_t i = 0; i < entry.trackEvents.size(); ++i) {
+        song.tracks()[i].events = entry.trackEvents[i];
+    }
+    song.subroutines() = entry.subroutines;
+    song.touchAll();
+    return true;
+}
+
+NspcOptimizerCacheEntry makeOptimizerCacheEntry(const NspcSong& optimizedSong, const NspcOptimizerStats& stats) {
+    NspcOptimizerCacheEntry entry;
+    entry.trackEvents.reserve(optimizedSong.tracks().size());
+    for (const auto& track : optimizedSong.tracks()) {
+        entry.trackEvents.push_back(track.events);
+    }
+    entry.subroutines = optimizedSong.subroutines();
+    entry.stats = stats;
+    return entry;
+}
+
+}  // namespace ntrak::nspc
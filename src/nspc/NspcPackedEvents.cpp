@@ -0,0 +1,318 @@
+#include "ntrak/nspc/NspcPackedEvents.hpp"
+
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
+#include <algorithm>
+#include <format>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace ntrak::nspc {
+
+namespace {
+
+// Tag byte: low nibble is the NspcEvent alternative, then per-kind flags.
+constexpr uint8_t kKindMask = 0x0F;
+constexpr uint8_t kHasOriginalAddr = 0x10;
+constexpr uint8_t kDurationHasQuantization = 0x20;
+constexpr uint8_t kDurationHasVelocity = 0x40;
+constexpr uint8_t kVcmdExtension = 0x20;
+constexpr uint8_t kVcmdEmpty = 0x40;
+
+template <typename T, size_t Index = 0>
+constexpr uint8_t eventKind() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<Index, NspcEvent>, T>) {
+        return static_cast<uint8_t>(Index);
+    } else {
+        return eventKind<T, Index + 1>();
+    }
+}
+static_assert(std::variant_size_v<NspcEvent> <= kKindMask + 1);
+
+void appendU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+uint16_t readU16(const uint8_t* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (static_cast<uint16_t>(bytes[1]) << 8));
+}
+
+void appendVarInt(std::vector<uint8_t>& out, int value) {
+    // Zigzag, so the usual small non-negative ids stay one byte.
+    auto raw = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    while (raw >= 0x80) {
+        out.push_back(static_cast<uint8_t>(raw | 0x80));
+        raw >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(raw));
+}
+
+int readVarInt(const uint8_t* bytes, size_t& offset) {
+    uint32_t raw = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = bytes[offset++];
+        raw |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return static_cast<int>((raw >> 1) ^ (~(raw & 1) + 1));
+}
+
+std::expected<void, std::string> appendVcmd(std::vector<uint8_t>& out, uint8_t& tag, const Vcmd& vcmd) {
+    if (std::holds_alternative<std::monostate>(vcmd.vcmd)) {
+        tag |= kVcmdEmpty;
+        return {};
+    }
+    if (const auto* extension = std::get_if<VcmdExtension>(&vcmd.vcmd)) {
+        if (extension->paramCount > extension->params.size()) {
+            return std::unexpected(std::format("extension VCMD ${:02X} has {} params", extension->id,
+                                               extension->paramCount));
+        }
+        tag |= kVcmdExtension;
+        out.push_back(extension->id);
+        out.push_back(extension->paramCount);
+        out.insert(out.end(), extension->params.begin(), extension->params.begin() + extension->paramCount);
+        return {};
+    }
+
+    const uint8_t id = vcmdCommandId(vcmd);
+    const auto* descriptor = vcmdDescriptor(id);
+    VcmdParamBytes params{};
+    const uint8_t paramCount = writeVcmdParams(vcmd, params);
+    if (descriptor == nullptr || descriptor->paramCount != paramCount) {
+        return std::unexpected(std::format("VCMD ${:02X} has no fixed parameter layout", id));
+    }
+    Vcmd decoded = descriptor->decode(params.data());
+    const auto* call = std::get_if<VcmdSubroutineCall>(&vcmd.vcmd);
+    if (call != nullptr) {
+        if (auto* decodedCall = std::get_if<VcmdSubroutineCall>(&decoded.vcmd)) {
+            decodedCall->subroutineId = call->subroutineId;
+        }
+    }
+    if (decoded != vcmd) {
+        return std::unexpected(std::format("VCMD ${:02X} does not round-trip through its parameters", id));
+    }
+
+    out.push_back(id);
+    out.insert(out.end(), params.begin(), params.begin() + paramCount);
+    if (call != nullptr) {
+        appendVarInt(out, call->subroutineId);
+    }
+    return {};
+}
+
+}  // namespace
+
+std::expected<NspcPackedEventList, std::string> NspcPackedEventList::pack(std::span<const NspcEventEntry> entries) {
+    NspcPackedEventList list;
+    list.size_ = entries.size();
+    list.bytes_.reserve(entries.size() * 2);
+    list.checkpoints_.reserve(entries.size() / kCheckpointInterval + 1);
+
+    for (size_t index = 0; index < entries.size(); ++index) {
+        const NspcEventEntry& entry = entries[index];
+        if (index % kCheckpointInterval == 0) {
+            list.checkpoints_.push_back(static_cast<uint32_t>(list.bytes_.size()));
+        }
+        if (list.idRuns_.empty() || list.idRuns_.back().firstId + (index - list.idRuns_.back().firstIndex) != entry.id) {
+            list.idRuns_.push_back(IdRun{.firstIndex = index, .firstId = entry.id});
+        }
+
+        const size_t tagOffset = list.bytes_.size();
+        uint8_t tag = static_cast<uint8_t>(entry.event.index());
+        list.bytes_.push_back(tag);
+        if (entry.originalAddr.has_value()) {
+            tag |= kHasOriginalAddr;
+            appendU16(list.bytes_, *entry.originalAddr);
+        }
+
+        auto& out = list.bytes_;
+        auto encoded = std::visit(
+            overloaded{
+                [](const std::monostate&) -> std::expected<void, std::string> { return {}; },
+                [&](const Duration& value) -> std::expected<void, std::string> {
+                    out.push_back(value.ticks);
+                    if (value.quantization.has_value()) {
+                        tag |= kDurationHasQuantization;
+                        out.push_back(*value.quantization);
+                    }
+                    if (value.velocity.has_value()) {
+                        tag |= kDurationHasVelocity;
+                        out.push_back(*value.velocity);
+                    }
+                    return {};
+                },
+                [&](const Vcmd& value) { return appendVcmd(out, tag, value); },
+                [&](const Note& value) -> std::expected<void, std::string> {
+                    out.push_back(value.pitch);
+                    return {};
+                },
+                [](const Tie&) -> std::expected<void, std::string> { return {}; },
+                [](const Rest&) -> std::expected<void, std::string> { return {}; },
+                [&](const Percussion& value) -> std::expected<void, std::string> {
+                    out.push_back(value.index);
+                    return {};
+                },
+                [&](const Subroutine& value) -> std::expected<void, std::string> {
+                    appendVarInt(out, value.id);
+                    appendU16(out, value.originalAddr);
+                    return {};
+                },
+                [](const End&) -> std::expected<void, std::string> { return {}; },
+            },
+            entry.event);
+        if (!encoded.has_value()) {
+            return std::unexpected(std::format("event {}: {}", index, encoded.error()));
+        }
+        list.bytes_[tagOffset] = tag;
+    }
+
+    list.bytes_.shrink_to_fit();
+    list.idRuns_.shrink_to_fit();
+    return list;
+}
+
+size_t NspcPackedEventList::decodeAt(size_t offset, NspcEventEntry& entry) const {
+    const uint8_t* bytes = bytes_.data();
+    const uint8_t tag = bytes[offset++];
+    entry.originalAddr.reset();
+    if ((tag & kHasOriginalAddr) != 0) {
+        entry.originalAddr = readU16(bytes + offset);
+        offset += 2;
+    }
+
+    switch (tag & kKindMask) {
+    case eventKind<Duration>(): {
+        Duration duration{.ticks = bytes[offset++], .quantization = std::nullopt, .velocity = std::nullopt};
+        if ((tag & kDurationHasQuantization) != 0) {
+            duration.quantization = bytes[offset++];
+        }
+        if ((tag & kDurationHasVelocity) != 0) {
+            duration.velocity = bytes[offset++];
+        }
+        entry.event = duration;
+        break;
+    }
+    case eventKind<Vcmd>(): {
+        if ((tag & kVcmdEmpty) != 0) {
+            entry.event = Vcmd{};
+            break;
+        }
+        if ((tag & kVcmdExtension) != 0) {
+            VcmdExtension extension{.id = bytes[offset], .params = {}, .paramCount = bytes[offset + 1]};
+            offset += 2;
+            std::copy_n(bytes + offset, extension.paramCount, extension.params.begin());
+            offset += extension.paramCount;
+            entry.event = Vcmd{extension};
+            break;
+        }
+        const auto* descriptor = vcmdDescriptor(bytes[offset++]);
+        Vcmd vcmd = descriptor->decode(bytes + offset);
+        offset += descriptor->paramCount;
+        if (auto* call = std::get_if<VcmdSubroutineCall>(&vcmd.vcmd)) {
+            call->subroutineId = readVarInt(bytes, offset);
+        }
+        entry.event = vcmd;
+        break;
+    }
+    case eventKind<Note>():
+        entry.event = Note{.pitch = bytes[offset++]};
+        break;
+    case eventKind<Tie>():
+        entry.event = Tie{};
+        break;
+    case eventKind<Rest>():
+        entry.event = Rest{};
+        break;
+    case eventKind<Percussion>():
+        entry.event = Percussion{.index = bytes[offset++]};
+        break;
+    case eventKind<Subroutine>(): {
+        const int id = readVarInt(bytes, offset);
+        entry.event = Subroutine{.id = id, .originalAddr = readU16(bytes + offset)};
+        offset += 2;
+        break;
+    }
+    case eventKind<End>():
+        entry.event = End{};
+        break;
+    default:
+        entry.event = std::monostate{};
+        break;
+    }
+    return offset;
+}
+
+size_t NspcPackedEventList::runFor(size_t index) const {
+    const auto it = std::upper_bound(idRuns_.begin(), idRuns_.end(), index,
+                                     [](size_t value, const IdRun& run) { return value < run.firstIndex; });
+    return static_cast<size_t>(it - idRuns_.begin()) - 1;
+}
+
+std::vector<NspcEventEntry> NspcPackedEventList::unpack() const {
+    return std::vector<NspcEventEntry>(begin(), end());
+}
+
+NspcPackedEventList::const_iterator NspcPackedEventList::end() const {
+    const_iterator it;
+    it.list_ = this;
+    it.index_ = size_;
+    return it;
+}
+
+NspcEventEntry NspcPackedEventList::operator[](size_t index) const {
+    const size_t checkpoint = index / kCheckpointInterval;
+    size_t offset = checkpoints_[checkpoint];
+    NspcEventEntry entry{};
+    for (size_t i = checkpoint * kCheckpointInterval; i <= index; ++i) {
+        offset = decodeAt(offset, entry);
+    }
+    entry.id = id(index);
+    return entry;
+}
+
+NspcEventId NspcPackedEventList::id(size_t index) const {
+    const IdRun& run = idRuns_[runFor(index)];
+    return run.firstId + (index - run.firstIndex);
+}
+
+std::optional<size_t> NspcPackedEventList::indexOf(NspcEventId id) const {
+    for (size_t run = 0; run < idRuns_.size(); ++run) {
+        const size_t runEnd = run + 1 < idRuns_.size() ? idRuns_[run + 1].firstIndex : size_;
+        const IdRun& current = idRuns_[run];
+        if (id >= current.firstId && id - current.firstId < runEnd - current.firstIndex) {
+            return current.firstIndex + static_cast<size_t>(id - current.firstId);
+        }
+    }
+    return std::nullopt;
+}
+
+size_t NspcPackedEventList::memoryBytes() const {
+    return sizeof(*this) + bytes_.capacity() + checkpoints_.capacity() * sizeof(uint32_t) +
+           idRuns_.capacity() * sizeof(IdRun);
+}
+
+NspcPackedEventList::const_iterator::const_iterator(const NspcPackedEventList* list, size_t index, size_t offset)
+    : list_(list), index_(index), nextOffset_(offset) {
+    if (index_ < list_->size_) {
+        nextOffset_ = list_->decodeAt(nextOffset_, entry_);
+        entry_.id = list_->idRuns_[run_].firstId + (index_ - list_->idRuns_[run_].firstIndex);
+    }
+}
+
+NspcPackedEventList::const_iterator& NspcPackedEventList::const_iterator::operator++() {
+    ++index_;
+    if (index_ < list_->size_) {
+        if (run_ + 1 < list_->idRuns_.size() && list_->idRuns_[run_ + 1].firstIndex == index_) {
+            ++run_;
+        }
+        nextOffset_ = list_->decodeAt(nextOffset_, entry_);
+        entry_.id = list_->idRuns_[run_].firstId + (index_ - list_->idRuns_[run_].firstIndex);
+    }
+    return *this;
+}
+
+}  // namespace ntrak::nspc
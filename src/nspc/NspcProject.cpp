@@ -1,6 +1,7 @@
 #include "ntrak/nspc/NspcProject.hpp"
 
 #include "ntrak/common/Log.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
 
 #include <algorithm>
 #include <array>
@@ -11,6 +12,7 @@
 #include <span>
 #include <string_view>
 #include <unordered_set>
+#include <utility>
 
 namespace ntrak::nspc {
 namespace {
@@ -70,71 +72,6 @@ uint32_t sequenceOpSize(const NspcSequenceOp& op) {
                       op);
 }
 
-uint32_t vcmdSize(const Vcmd& cmd) {
-    return std::visit(overloaded{
-                          [](const std::monostate&) { return 0u; },
-                          [](const VcmdInst&) { return 2u; },
-                          [](const VcmdPanning&) { return 2u; },
-                          [](const VcmdPanFade&) { return 3u; },
-                          [](const VcmdVibratoOn&) { return 4u; },
-                          [](const VcmdVibratoOff&) { return 1u; },
-                          [](const VcmdGlobalVolume&) { return 2u; },
-                          [](const VcmdGlobalVolumeFade&) { return 3u; },
-                          [](const VcmdTempo&) { return 2u; },
-                          [](const VcmdTempoFade&) { return 3u; },
-                          [](const VcmdGlobalTranspose&) { return 2u; },
-                          [](const VcmdPerVoiceTranspose&) { return 2u; },
-                          [](const VcmdTremoloOn&) { return 4u; },
-                          [](const VcmdTremoloOff&) { return 1u; },
-                          [](const VcmdVolume&) { return 2u; },
-                          [](const VcmdVolumeFade&) { return 3u; },
-                          [](const VcmdSubroutineCall&) { return 4u; },
-                          [](const VcmdVibratoFadeIn&) { return 2u; },
-                          [](const VcmdPitchEnvelopeTo&) { return 4u; },
-                          [](const VcmdPitchEnvelopeFrom&) { return 4u; },
-                          [](const VcmdPitchEnvelopeOff&) { return 1u; },
-                          [](const VcmdFineTune&) { return 2u; },
-                          [](const VcmdEchoOn&) { return 4u; },
-                          [](const VcmdEchoOff&) { return 1u; },
-                          [](const VcmdEchoParams&) { return 4u; },
-                          [](const VcmdEchoVolumeFade&) { return 4u; },
-                          [](const VcmdPitchSlideToNote&) { return 4u; },
-                          [](const VcmdPercussionBaseInstrument&) { return 2u; },
-                          [](const VcmdNOP&) { return 3u; },
-                          [](const VcmdMuteChannel&) { return 1u; },
-                          [](const VcmdFastForwardOn&) { return 1u; },
-                          [](const VcmdFastForwardOff&) { return 1u; },
-                          [](const VcmdUnused&) { return 1u; },
-                          [](const VcmdExtension& value) { return static_cast<uint32_t>(1u + value.paramCount); },
-                      },
-                      cmd.vcmd);
-}
-
-uint32_t eventSize(const NspcEventEntry& entry) {
-    return std::visit(overloaded{
-                          [](const std::monostate&) { return 0u; },
-                          [](const Duration& value) {
-                              return (value.quantization.has_value() || value.velocity.has_value()) ? 2u : 1u;
-                          },
-                          [](const Vcmd& value) { return vcmdSize(value); },
-                          [](const Note&) { return 1u; },
-                          [](const Tie&) { return 1u; },
-                          [](const Rest&) { return 1u; },
-                          [](const Percussion&) { return 1u; },
-                          [](const Subroutine&) { return 0u; },  // Annotation-only entry in flattened view.
-                          [](const End&) { return 1u; },
-                      },
-                      entry.event);
-}
-
-uint32_t streamSize(const std::vector<NspcEventEntry>& events) {
-    uint32_t size = 0;
-    for (const auto& entry : events) {
-        size += eventSize(entry);
-    }
-    return std::max<uint32_t>(size, 1u);
-}
-
 void addUsageRegion(std::vector<NspcAramRegion>& regions, NspcAramRegionKind kind, uint32_t from, uint32_t to,
                     std::string label, int songId = -1, int objectId = -1) {
     from = std::min<uint32_t>(from, kAramSize);
@@ -153,16 +90,6 @@ void addUsageRegion(std::vector<NspcAramRegion>& regions, NspcAramRegionKind kin
     });
 }
 
-void paintRegion(std::array<NspcAramRegionKind, NspcAramUsage::kTotalAramBytes>& map, const NspcAramRegion& region) {
-    const uint32_t from = region.from;
-    const uint32_t to = region.to;
-    for (uint32_t addr = from; addr < to; ++addr) {
-        if (map[addr] == NspcAramRegionKind::Free) {
-            map[addr] = region.kind;
-        }
-    }
-}
-
 uint8_t instrumentEntrySize(const NspcEngineConfig& engineConfig) {
     return std::clamp<uint8_t>(engineConfig.instrumentEntryBytes, 5, 6);
 }
@@ -245,7 +172,7 @@ uint32_t resolveLayoutSize(const NspcSongAddressLayout* layout, int objectId, ui
     return fallback;
 }
 
-uint16_t resolveSequenceAddress(const NspcEngineConfig& engineConfig, emulation::AramView aramView, int songId,
+uint16_t resolveSequenceAddress(const NspcEngineConfig& engineConfig, emulation::ConstAramView aramView, int songId,
                                 const NspcSongAddressLayout* layout) {
     if (layout != nullptr && layout->sequenceAddr != 0) {
         return layout->sequenceAddr;
@@ -261,120 +188,84 @@ uint16_t resolveSequenceAddress(const NspcEngineConfig& engineConfig, emulation:
     return aramView.read16(static_cast<uint16_t>(pointerAddr));
 }
 
-void collectSongAramRegions(const NspcProject& project, emulation::AramView aramView, std::vector<NspcAramRegion>& regions) {
+void collectSongAramRegions(const NspcProject& project, emulation::ConstAramView aramView, const NspcSong& song,
+                            std::vector<NspcAramRegion>& regions) {
     const auto& engineConfig = project.engineConfig();
-    for (const auto& song : project.songs()) {
-        const int songId = song.songId();
-        const NspcSongAddressLayout* layout = project.songAddressLayout(songId);
-
-        const uint16_t sequenceAddr = resolveSequenceAddress(engineConfig, aramView, songId, layout);
-        if (sequenceAddr != 0 && sequenceAddr != 0xFFFF) {
-            uint32_t seqSize = 0;
-            for (const auto& op : song.sequence()) {
-                seqSize += sequenceOpSize(op);
-            }
-            addUsageRegion(regions, NspcAramRegionKind::SequenceData, sequenceAddr,
-                           static_cast<uint32_t>(sequenceAddr) + std::max<uint32_t>(seqSize, 1u),
-                           std::format("Song {:02X} Sequence", songId), songId);
-        }
-
-        for (const auto& pattern : song.patterns()) {
-            const uint16_t patternAddr = (layout != nullptr)
-                                             ? resolveLayoutAddress(layout, pattern.id, pattern.trackTableAddr,
-                                                                    layout->patternAddrById)
-                                             : pattern.trackTableAddr;
-            if (patternAddr == 0) {
-                continue;
-            }
-            addUsageRegion(regions, NspcAramRegionKind::PatternTable, patternAddr, static_cast<uint32_t>(patternAddr) + 16u,
-                           std::format("Song {:02X} Pattern {:02X}", songId, pattern.id), songId, pattern.id);
-        }
-
-        for (const auto& track : song.tracks()) {
-            const uint16_t trackAddr = (layout != nullptr)
-                                           ? resolveLayoutAddress(layout, track.id, track.originalAddr,
-                                                                  layout->trackAddrById)
-                                           : track.originalAddr;
-            if (trackAddr == 0) {
-                continue;
-            }
-            const uint32_t size = (layout != nullptr)
-                                      ? resolveLayoutSize(layout, track.id, streamSize(track.events),
-                                                          layout->trackSizeById)
-                                      : streamSize(track.events);
-            addUsageRegion(regions, NspcAramRegionKind::TrackData, trackAddr, static_cast<uint32_t>(trackAddr) + size,
-                           std::format("Song {:02X} Track {:02X}", songId, track.id), songId, track.id);
+    const int songId = song.songId();
+    const NspcSongAddressLayout* layout = project.songAddressLayout(songId);
+
+    const uint16_t sequenceAddr = resolveSequenceAddress(engineConfig, aramView, songId, layout);
+    if (sequenceAddr != 0 && sequenceAddr != 0xFFFF) {
+        uint32_t seqSize = 0;
+        for (const auto& op : song.sequence()) {
+            seqSize += sequenceOpSize(op);
         }
+        addUsageRegion(regions, NspcAramRegionKind::SequenceData, sequenceAddr,
+                       static_cast<uint32_t>(sequenceAddr) + std::max<uint32_t>(seqSize, 1u),
+                       std::format("Song {:02X} Sequence", songId), songId);
+    }
 
-        std::unordered_set<int> seenSubroutineIds;
-        seenSubroutineIds.reserve(song.subroutines().size());
-        for (const auto& subroutine : song.subroutines()) {
-            const uint16_t subroutineAddr = (layout != nullptr)
-                                                ? resolveLayoutAddress(layout, subroutine.id, subroutine.originalAddr,
-                                                                       layout->subroutineAddrById)
-                                                : subroutine.originalAddr;
-            if (subroutineAddr == 0) {
-                continue;
-            }
-            const uint32_t size = (layout != nullptr)
-                                      ? resolveLayoutSize(layout, subroutine.id, streamSize(subroutine.events),
-                                                          layout->subroutineSizeById)
-                                      : streamSize(subroutine.events);
-            seenSubroutineIds.insert(subroutine.id);
-            addUsageRegion(regions, NspcAramRegionKind::SubroutineData, subroutineAddr,
-                           static_cast<uint32_t>(subroutineAddr) + size,
-                           std::format("Song {:02X} Sub {:02X}", songId, subroutine.id), songId, subroutine.id);
+    for (const auto& pattern : song.patterns()) {
+        const uint16_t patternAddr = (layout != nullptr)
+                                         ? resolveLayoutAddress(layout, pattern.id, pattern.trackTableAddr,
+                                                                layout->patternAddrById)
+                                         : pattern.trackTableAddr;
+        if (patternAddr == 0) {
+            continue;
         }
-
-        if (layout == nullptr) {
+        addUsageRegion(regions, NspcAramRegionKind::PatternTable, patternAddr, static_cast<uint32_t>(patternAddr) + 16u,
+                       std::format("Song {:02X} Pattern {:02X}", songId, pattern.id), songId, pattern.id);
+    }
+
+    // The outline keeps a song whose events are still encoded from being decoded just to size its streams
+    const NspcSongOutline outline = song.outline();
+    for (const auto& track : outline.tracks) {
+        const uint16_t trackAddr = (layout != nullptr)
+                                       ? resolveLayoutAddress(layout, track.id, track.originalAddr,
+                                                              layout->trackAddrById)
+                                       : track.originalAddr;
+        if (trackAddr == 0) {
             continue;
         }
-        for (const auto& [subroutineId, subroutineAddr] : layout->subroutineAddrById) {
-            if (subroutineAddr == 0 || seenSubroutineIds.contains(subroutineId)) {
-                continue;
-            }
-            const uint32_t size = resolveLayoutSize(layout, subroutineId, 1u, layout->subroutineSizeById);
-            addUsageRegion(regions, NspcAramRegionKind::SubroutineData, subroutineAddr,
-                           static_cast<uint32_t>(subroutineAddr) + size,
-                           std::format("Song {:02X} Sub {:02X}", songId, subroutineId), songId, subroutineId);
+        const uint32_t streamSize = std::max<uint32_t>(track.encodedBytes, 1u);
+        const uint32_t size = (layout != nullptr)
+                                  ? resolveLayoutSize(layout, track.id, streamSize, layout->trackSizeById)
+                                  : streamSize;
+        addUsageRegion(regions, NspcAramRegionKind::TrackData, trackAddr, static_cast<uint32_t>(trackAddr) + size,
+                       std::format("Song {:02X} Track {:02X}", songId, track.id), songId, track.id);
+    }
+
+    std::unordered_set<int> seenSubroutineIds;
+    seenSubroutineIds.reserve(outline.subroutines.size());
+    for (const auto& subroutine : outline.subroutines) {
+        const uint16_t subroutineAddr = (layout != nullptr)
+                                            ? resolveLayoutAddress(layout, subroutine.id, subroutine.originalAddr,
+                                                                   layout->subroutineAddrById)
+                                            : subroutine.originalAddr;
+        if (subroutineAddr == 0) {
+            continue;
         }
+        const uint32_t streamSize = std::max<uint32_t>(subroutine.encodedBytes, 1u);
+        const uint32_t size = (layout != nullptr)
+                                  ? resolveLayoutSize(layout, subroutine.id, streamSize, layout->subroutineSizeById)
+                                  : streamSize;
+        seenSubroutineIds.insert(subroutine.id);
+        addUsageRegion(regions, NspcAramRegionKind::SubroutineData, subroutineAddr,
+                       static_cast<uint32_t>(subroutineAddr) + size,
+                       std::format("Song {:02X} Sub {:02X}", songId, subroutine.id), songId, subroutine.id);
     }
-}
 
-void tallyAramOwnership(const std::array<NspcAramRegionKind, NspcAramUsage::kTotalAramBytes>& ownership, NspcAramUsage& usage) {
-    for (const auto kind : ownership) {
-        switch (kind) {
-        case NspcAramRegionKind::Free:
-            usage.freeBytes++;
-            break;
-        case NspcAramRegionKind::Reserved:
-            usage.reservedBytes++;
-            break;
-        case NspcAramRegionKind::SongIndexTable:
-            usage.songIndexBytes++;
-            break;
-        case NspcAramRegionKind::InstrumentTable:
-            usage.instrumentBytes++;
-            break;
-        case NspcAramRegionKind::SampleDirectory:
-            usage.sampleDirectoryBytes++;
-            break;
-        case NspcAramRegionKind::SampleData:
-            usage.sampleDataBytes++;
-            break;
-        case NspcAramRegionKind::SequenceData:
-            usage.sequenceBytes++;
-            break;
-        case NspcAramRegionKind::PatternTable:
-            usage.patternTableBytes++;
-            break;
-        case NspcAramRegionKind::TrackData:
-            usage.trackBytes++;
-            break;
-        case NspcAramRegionKind::SubroutineData:
-            usage.subroutineBytes++;
-            break;
+    if (layout == nullptr) {
+        return;
+    }
+    for (const auto& [subroutineId, subroutineAddr] : layout->subroutineAddrById) {
+        if (subroutineAddr == 0 || seenSubroutineIds.contains(subroutineId)) {
+            continue;
         }
+        const uint32_t size = resolveLayoutSize(layout, subroutineId, 1u, layout->subroutineSizeById);
+        addUsageRegion(regions, NspcAramRegionKind::SubroutineData, subroutineAddr,
+                       static_cast<uint32_t>(subroutineAddr) + size,
+                       std::format("Song {:02X} Sub {:02X}", songId, subroutineId), songId, subroutineId);
     }
 }
 
@@ -383,8 +274,8 @@ struct ParsedBrrData {
     uint16_t endExclusive = 0;
 };
 
-std::optional<ParsedBrrData> parseBrrSample(emulation::AramView aram, uint16_t sampleStart, uint32_t maxEndExclusive,
-                                            bool allowExtendedRange = false) {
+std::optional<ParsedBrrData> parseBrrSample(emulation::ConstAramView aram, uint16_t sampleStart,
+                                            uint32_t maxEndExclusive, bool allowExtendedRange = false) {
     if (sampleStart == 0) {
         return std::nullopt;
     }
@@ -467,7 +358,7 @@ NspcContentOrigin defaultContentOrigin(int id, const std::vector<int>& defaultEn
                                                      : NspcContentOrigin::UserProvided;
 }
 
-bool readAramWordSafe(emulation::AramView aram, uint32_t address, uint16_t& outValue) {
+bool readAramWordSafe(emulation::ConstAramView aram, uint32_t address, uint16_t& outValue) {
     if (address + 1u >= kAramSize) {
         return false;
     }
@@ -504,7 +395,7 @@ bool isSmwV00Engine(const NspcEngineConfig& config) {
     return config.engineVersion == "0.0";
 }
 
-void applyPercussionTableNotes(std::vector<NspcInstrument>& instruments, emulation::AramView aramView,
+void applyPercussionTableNotes(std::vector<NspcInstrument>& instruments, emulation::ConstAramView aramView,
                                const NspcEngineConfig& config) {
     if (!isSmwV00Engine(config) || config.percussionHeaders == 0) {
         return;
@@ -562,7 +453,7 @@ void applyPercussionTableNotes(std::vector<NspcInstrument>& instruments, emulati
     }
 }
 
-std::unordered_set<int> collectReferencedSampleIdsFromInstrumentTable(emulation::AramView aram,
+std::unordered_set<int> collectReferencedSampleIdsFromInstrumentTable(emulation::ConstAramView aram,
                                                                       const NspcEngineConfig& config) {
     std::unordered_set<int> referencedIds;
     if (config.instrumentHeaders == 0) {
@@ -648,7 +539,7 @@ bool isLikelyTrackLeadByte(uint8_t byte, const NspcCommandMap& commandMap, const
     return *mappedVcmd != VcmdUnused::id;
 }
 
-bool probeTrackStream(emulation::AramView aram, uint16_t trackAddr, const NspcCommandMap& commandMap,
+bool probeTrackStream(emulation::ConstAramView aram, uint16_t trackAddr, const NspcCommandMap& commandMap,
                       const NspcEngineConfig& engine) {
     uint32_t addr = trackAddr;
     for (uint32_t steps = 0; steps < kTrackProbeLimit && addr < kAramSize; ++steps) {
@@ -706,7 +597,7 @@ bool probeTrackStream(emulation::AramView aram, uint16_t trackAddr, const NspcCo
     return false;
 }
 
-bool findFirstTrackPointer(emulation::AramView aram, uint16_t sequencePtr, std::optional<uint16_t>& outTrackAddr) {
+bool findFirstTrackPointer(emulation::ConstAramView aram, uint16_t sequencePtr, std::optional<uint16_t>& outTrackAddr) {
     uint32_t seqAddr = sequencePtr;
     for (uint32_t steps = 0; steps < kSequenceProbeLimit; ++steps) {
         uint16_t seqWord = 0;
@@ -750,7 +641,7 @@ bool findFirstTrackPointer(emulation::AramView aram, uint16_t sequencePtr, std::
     return false;
 }
 
-bool isLikelySongPointer(emulation::AramView aram, uint16_t sequencePtr, const NspcCommandMap& commandMap,
+bool isLikelySongPointer(emulation::ConstAramView aram, uint16_t sequencePtr, const NspcCommandMap& commandMap,
                          const NspcEngineConfig& engine) {
     if (sequencePtr == 0 || sequencePtr == 0xFFFF) {
         return false;
@@ -800,7 +691,7 @@ void NspcProject::parseInstruments() {
     }
 
     const uint8_t entrySize = std::clamp<uint8_t>(engineConfig_.instrumentEntryBytes, 5, 6);
-    emulation::AramView aramView(aram_.data(), aram_.size());
+    const emulation::ConstAramView aramView = std::as_const(*this).aram();
 
     // Instrument table entries are engine-dependent (5 or 6 bytes):
     // Byte 0: Sample index (bit 7 = noise flag)
@@ -832,7 +723,7 @@ void NspcProject::parseInstruments() {
         }
 
         const uint8_t sampleId = sampleIndex & 0x7F;
-        const bool sampleExists = std::any_of(samples_.begin(), samples_.end(),
+        const bool sampleExists = std::any_of(samples().begin(), samples().end(),
                                               [sampleId](const BrrSample& sample) { return sample.id == sampleId; });
 
         const bool allFF =
@@ -862,11 +753,11 @@ void NspcProject::parseInstruments() {
             inst.contentOrigin = defaultContentOrigin(inst.id, engineConfig_.defaultEngineProvidedInstrumentIds,
                                                       engineConfig_.hasDefaultEngineProvidedInstruments);
 
-            instruments_.push_back(std::move(inst));
+            instruments().push_back(std::move(inst));
         }
     }
 
-    applyPercussionTableNotes(instruments_, aramView, engineConfig_);
+    applyPercussionTableNotes(instruments(), aramView, engineConfig_);
 }
 
 void NspcProject::parseSamples() {
@@ -874,7 +765,7 @@ void NspcProject::parseSamples() {
         return;
     }
 
-    emulation::AramView aramView(aram_.data(), aram_.size());
+    const emulation::ConstAramView aramView = std::as_const(*this).aram();
 
     // Sample directory entries are 4 bytes each:
     // Bytes 0-1: Sample start address (little endian)
@@ -941,7 +832,7 @@ void NspcProject::parseSamples() {
         sample.contentOrigin = defaultContentOrigin(sample.id, engineConfig_.defaultEngineProvidedSampleIds,
                                                     engineConfig_.hasDefaultEngineProvidedSamples);
 
-        samples_.push_back(std::move(sample));
+        samples().push_back(std::move(sample));
         parsedSampleIds.insert(static_cast<int>(entry.entryIndex));
     }
 
@@ -971,11 +862,11 @@ void NspcProject::parseSamples() {
         sample.originalLoopAddr = loopPoint;
         sample.contentOrigin = defaultContentOrigin(sample.id, engineConfig_.defaultEngineProvidedSampleIds,
                                                     engineConfig_.hasDefaultEngineProvidedSamples);
-        samples_.push_back(std::move(sample));
+        samples().push_back(std::move(sample));
         parsedSampleIds.insert(sampleId);
     }
 
-    std::sort(samples_.begin(), samples_.end(), [](const BrrSample& a, const BrrSample& b) { return a.id < b.id; });
+    std::sort(samples().begin(), samples().end(), [](const BrrSample& a, const BrrSample& b) { return a.id < b.id; });
 }
 
 void NspcProject::parseSongs() {
@@ -983,7 +874,7 @@ void NspcProject::parseSongs() {
         return;
     }
 
-    emulation::AramView aramView(aram_.data(), aram_.size());
+    const emulation::ConstAramView aramView = std::as_const(*this).aram();
     std::unordered_set<uint16_t> discoveredPointers;
     const NspcCommandMap commandMap = engineConfig_.commandMap.value_or(NspcCommandMap{});
 
@@ -1025,7 +916,7 @@ void NspcProject::parseSongs() {
             song.setContentOrigin(defaultContentOrigin(song.songId(), engineConfig_.defaultEngineProvidedSongIds,
                                                        engineConfig_.hasDefaultEngineProvidedSongs));
             collectSongPointers(song, seqPtr, discoveredPointers);
-            songs_.push_back(std::move(song));
+            songs().push_back(std::move(song));
         } catch (const std::exception& ex) {
             common::logInfo(std::format("Stopped parsing songs at index {:02X}: {}", i, ex.what()));
             break;
@@ -1034,66 +925,68 @@ void NspcProject::parseSongs() {
 }
 
 std::optional<size_t> NspcProject::addEmptySong() {
-    if (songs_.size() >= kMaxSongEntries) {
+    if (songs().size() >= kMaxSongEntries) {
         return std::nullopt;
     }
 
-    const size_t newSongIndex = songs_.size();
-    songs_.push_back(NspcSong::createEmpty(static_cast<int>(newSongIndex)));
-    songs_.back().setContentOrigin(NspcContentOrigin::UserProvided);
+    const size_t newSongIndex = songs().size();
+    songs().push_back(NspcSong::createEmpty(static_cast<int>(newSongIndex)));
+    songs().back().setContentOrigin(NspcContentOrigin::UserProvided);
     refreshAramUsage();
     return newSongIndex;
 }
 
 std::optional<size_t> NspcProject::duplicateSong(size_t songIndex) {
-    if (songs_.size() >= kMaxSongEntries || songIndex >= songs_.size()) {
+    if (songs().size() >= kMaxSongEntries || songIndex >= songs().size()) {
         return std::nullopt;
     }
 
-    NspcSong duplicate = songs_[songIndex];
+    NspcSong duplicate = songs()[songIndex];
     duplicate.setContentOrigin(NspcContentOrigin::UserProvided);
-    songs_.insert(songs_.begin() + static_cast<std::ptrdiff_t>(songIndex + 1), std::move(duplicate));
-    reindexSongsAndLayouts(songs_, songAddressLayouts_);
+    songs().insert(songs().begin() + static_cast<std::ptrdiff_t>(songIndex + 1), std::move(duplicate));
+    reindexSongsAndLayouts(songs(), songAddressLayouts_.mut());
     refreshAramUsage();
     return songIndex + 1;
 }
 
 bool NspcProject::removeSong(size_t songIndex) {
-    if (songIndex >= songs_.size()) {
+    if (songIndex >= songs().size()) {
         return false;
     }
 
-    songs_.erase(songs_.begin() + static_cast<std::ptrdiff_t>(songIndex));
-    reindexSongsAndLayouts(songs_, songAddressLayouts_);
+    songs().erase(songs().begin() + static_cast<std::ptrdiff_t>(songIndex));
+    reindexSongsAndLayouts(songs(), songAddressLayouts_.mut());
     refreshAramUsage();
     return true;
 }
 
 bool NspcProject::setSongContentOrigin(size_t songIndex, NspcContentOrigin origin) {
-    if (songIndex >= songs_.size()) {
+    if (songIndex >= songs().size()) {
         return false;
     }
-    songs_[songIndex].setContentOrigin(origin);
+    songs()[songIndex].setContentOrigin(origin);
     return true;
 }
 
 bool NspcProject::setInstrumentContentOrigin(int instrumentId, NspcContentOrigin origin) {
-    const auto it = std::find_if(instruments_.begin(), instruments_.end(),
+    const auto it = std::find_if(instruments().begin(), instruments().end(),
                                  [instrumentId](const NspcInstrument& instrument) { return instrument.id == instrumentId; });
-    if (it == instruments_.end()) {
+    if (it == instruments().end()) {
         return false;
     }
     it->contentOrigin = origin;
+    touch();
     return true;
 }
 
 bool NspcProject::setSampleContentOrigin(int sampleId, NspcContentOrigin origin) {
-    const auto it = std::find_if(samples_.begin(), samples_.end(),
+    const auto it = std::find_if(samples().begin(), samples().end(),
                                  [sampleId](const BrrSample& sample) { return sample.id == sampleId; });
-    if (it == samples_.end()) {
+    if (it == samples().end()) {
         return false;
     }
     it->contentOrigin = origin;
+    touch();
     return true;
 }
 
@@ -1106,6 +999,7 @@ bool NspcProject::setEngineExtensionEnabled(std::string_view extensionName, bool
         return false;
     }
     it->enabled = enabled;
+    touch();
     return true;
 }
 
@@ -1131,55 +1025,86 @@ std::vector<std::string> NspcProject::enabledEngineExtensionNames() const {
     return names;
 }
 
+void NspcProject::prefetchSong(size_t songIndex) const {
+    if (songIndex >= songs_->size()) {
+        return;
+    }
+    if (const auto& body = (*songs_)[songIndex].deferredBody(); body != nullptr) {
+        body->prefetch();
+    }
+}
+
 const NspcSongAddressLayout* NspcProject::songAddressLayout(int songId) const {
-    const auto it = songAddressLayouts_.find(songId);
-    if (it == songAddressLayouts_.end()) {
+    const auto it = songAddressLayouts_->find(songId);
+    if (it == songAddressLayouts_->end()) {
         return nullptr;
     }
     return &it->second;
 }
 
 void NspcProject::setSongAddressLayout(int songId, NspcSongAddressLayout layout) {
-    songAddressLayouts_[songId] = std::move(layout);
+    songAddressLayouts_.mut()[songId] = std::move(layout);
+    touch();
 }
 
 void NspcProject::clearSongAddressLayout(int songId) {
-    songAddressLayouts_.erase(songId);
+    if (songAddressLayouts_->contains(songId)) {
+        songAddressLayouts_.mut().erase(songId);
+        touch();
+    }
+}
+
+NspcRevision NspcProject::revision() const {
+    NspcRevision newest = revision_;
+    for (const auto& song : *songs_) {
+        newest = std::max(newest, song.revision());
+    }
+    return newest;
+}
+
+void NspcProject::touch() {
+    revision_ = newNspcRevision();
 }
 
 void NspcProject::refreshAramUsage() {
+    touch();
     rebuildAramUsage();
 }
 
-void NspcProject::rebuildAramUsage() {
-    NspcAramUsage usage;
-    usage.totalBytes = kAramSize;
-
-    std::vector<NspcAramRegion> regions;
-    regions.reserve(engineConfig_.reserved.size() + songs_.size() * 4 + instruments_.size() + samples_.size() * 2 + 8);
-    collectStaticAramRegions(engineConfig_, songs_, instruments_, samples_, regions);
+void NspcProject::updateAramUsage() {
+    if (revision() != aramUsageRevision_) {
+        rebuildAramUsage();
+    }
+}
 
-    emulation::AramView aramView(aram_.data(), aram_.size());
-    collectSongAramRegions(*this, aramView, regions);
+void NspcProject::rebuildAramUsage() {
+    // Read through the const view so refreshing usage never detaches shared ARAM.
+    const emulation::ConstAramView aramView = std::as_const(*this).aram();
+    auto& usageMap = aramUsageMap_.mut();
 
-    std::array<NspcAramRegionKind, NspcAramUsage::kTotalAramBytes> ownership{};
-    ownership.fill(NspcAramRegionKind::Free);
-    for (const auto& region : regions) {
-        paintRegion(ownership, region);
+    const auto& songs = *songs_;
+    if (aramTablesRevision_ != revision_ || aramSongRevisions_.size() != songs.size()) {
+        usageMap.clear();
+        std::vector<NspcAramRegion> regions;
+        regions.reserve(engineConfig_.reserved.size() + instruments_->size() + samples_->size() * 2 + 8);
+        collectStaticAramRegions(engineConfig_, songs, *instruments_, *samples_, regions);
+        usageMap.setSource(0, std::move(regions));
+        aramTablesRevision_ = revision_;
+        aramSongRevisions_.assign(songs.size(), 0);
     }
-    tallyAramOwnership(ownership, usage);
-
-    usage.usedBytes = usage.totalBytes - usage.freeBytes;
 
-    std::sort(regions.begin(), regions.end(), [](const NspcAramRegion& lhs, const NspcAramRegion& rhs) {
-        if (lhs.from != rhs.from) {
-            return lhs.from < rhs.from;
+    for (size_t i = 0; i < songs.size(); ++i) {
+        if (aramSongRevisions_[i] == songs[i].revision()) {
+            continue;
         }
-        return lhs.to < rhs.to;
-    });
-    usage.regions = std::move(regions);
+        std::vector<NspcAramRegion> regions;
+        collectSongAramRegions(*this, aramView, songs[i], regions);
+        usageMap.setSource(static_cast<uint32_t>(i) + 1u, std::move(regions));
+        aramSongRevisions_[i] = songs[i].revision();
+    }
 
-    aramUsage_ = std::move(usage);
+    aramUsage_ = usageMap.usage();
+    aramUsageRevision_ = revision();
 }
 
 }  // namespace ntrak::nspc
@@ -1,16 +1,22 @@
 #include "ntrak/nspc/NspcProjectFile.hpp"
 #include "ntrak/nspc/Base64.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
 
 #include <nlohmann/json.hpp>
 
 #include <algorithm>
 #include <array>
+#include <charconv>
 #include <cstdint>
+#include <filesystem>
 #include <format>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -23,6 +29,8 @@ namespace {
 constexpr std::string_view kProjectFormatTag = "ntrak_project_ir";
 constexpr int kProjectFormatVersion = 4;
 constexpr std::string_view kPackedEventsEncoding = "eventpack_v1";
+constexpr std::string_view kBase64DataEncoding = "base64";
+constexpr std::string_view kRawDataEncoding = "raw";
 constexpr uint8_t kPackedEventsEncodingVersion = 1;
 constexpr uint32_t kAramSize = NspcAramUsage::kTotalAramBytes;
 
@@ -427,7 +435,7 @@ void appendVarInt(std::vector<uint8_t>& out, int64_t value) {
     appendVarUint(out, zigZag);
 }
 
-bool readU16Le(const std::vector<uint8_t>& bytes, size_t& offset, uint16_t& value) {
+bool readU16Le(std::span<const uint8_t> bytes, size_t& offset, uint16_t& value) {
     if (offset + 2u > bytes.size()) {
         return false;
     }
@@ -436,7 +444,7 @@ bool readU16Le(const std::vector<uint8_t>& bytes, size_t& offset, uint16_t& valu
     return true;
 }
 
-bool readVarUint(const std::vector<uint8_t>& bytes, size_t& offset, uint64_t& value) {
+bool readVarUint(std::span<const uint8_t> bytes, size_t& offset, uint64_t& value) {
     value = 0;
     for (int i = 0; i < 10; ++i) {
         if (offset >= bytes.size()) {
@@ -454,7 +462,7 @@ bool readVarUint(const std::vector<uint8_t>& bytes, size_t& offset, uint64_t& va
     return false;
 }
 
-bool readVarInt(const std::vector<uint8_t>& bytes, size_t& offset, int64_t& value) {
+bool readVarInt(std::span<const uint8_t> bytes, size_t& offset, int64_t& value) {
     uint64_t raw = 0;
     if (!readVarUint(bytes, offset, raw)) {
         return false;
@@ -473,176 +481,18 @@ struct RawVcmd {
 };
 
 std::optional<RawVcmd> toRawVcmd(const Vcmd& cmd) {
-    return std::visit(
-        overloaded{
-            [](const std::monostate&) -> std::optional<RawVcmd> { return std::nullopt; },
-            [](const VcmdInst& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdInst::id, .paramCount = 1};
-                raw.params[0] = value.instrumentIndex;
-                return raw;
-            },
-            [](const VcmdPanning& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPanning::id, .paramCount = 1};
-                raw.params[0] = value.panning;
-                return raw;
-            },
-            [](const VcmdPanFade& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPanFade::id, .paramCount = 2};
-                raw.params[0] = value.time;
-                raw.params[1] = value.target;
-                return raw;
-            },
-            [](const VcmdVibratoOn& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdVibratoOn::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.rate;
-                raw.params[2] = value.depth;
-                return raw;
-            },
-            [](const VcmdVibratoOff&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdVibratoOff::id, .paramCount = 0}; },
-            [](const VcmdGlobalVolume& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdGlobalVolume::id, .paramCount = 1};
-                raw.params[0] = value.volume;
-                return raw;
-            },
-            [](const VcmdGlobalVolumeFade& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdGlobalVolumeFade::id, .paramCount = 2};
-                raw.params[0] = value.time;
-                raw.params[1] = value.target;
-                return raw;
-            },
-            [](const VcmdTempo& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdTempo::id, .paramCount = 1};
-                raw.params[0] = value.tempo;
-                return raw;
-            },
-            [](const VcmdTempoFade& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdTempoFade::id, .paramCount = 2};
-                raw.params[0] = value.time;
-                raw.params[1] = value.target;
-                return raw;
-            },
-            [](const VcmdGlobalTranspose& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdGlobalTranspose::id, .paramCount = 1};
-                raw.params[0] = static_cast<uint8_t>(value.semitones);
-                return raw;
-            },
-            [](const VcmdPerVoiceTranspose& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPerVoiceTranspose::id, .paramCount = 1};
-                raw.params[0] = static_cast<uint8_t>(value.semitones);
-                return raw;
-            },
-            [](const VcmdTremoloOn& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdTremoloOn::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.rate;
-                raw.params[2] = value.depth;
-                return raw;
-            },
-            [](const VcmdTremoloOff&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdTremoloOff::id, .paramCount = 0}; },
-            [](const VcmdVolume& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdVolume::id, .paramCount = 1};
-                raw.params[0] = value.volume;
-                return raw;
-            },
-            [](const VcmdVolumeFade& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdVolumeFade::id, .paramCount = 2};
-                raw.params[0] = value.time;
-                raw.params[1] = value.target;
-                return raw;
-            },
-            [](const VcmdSubroutineCall& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdSubroutineCall::id, .paramCount = 3};
-                raw.params[0] = static_cast<uint8_t>(value.originalAddr & 0xFFu);
-                raw.params[1] = static_cast<uint8_t>((value.originalAddr >> 8) & 0xFFu);
-                raw.params[2] = value.count;
-                raw.subroutineId = value.subroutineId;
-                raw.originalAddr = value.originalAddr;
-                return raw;
-            },
-            [](const VcmdVibratoFadeIn& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdVibratoFadeIn::id, .paramCount = 1};
-                raw.params[0] = value.time;
-                return raw;
-            },
-            [](const VcmdPitchEnvelopeTo& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPitchEnvelopeTo::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.length;
-                raw.params[2] = value.semitone;
-                return raw;
-            },
-            [](const VcmdPitchEnvelopeFrom& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPitchEnvelopeFrom::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.length;
-                raw.params[2] = value.semitone;
-                return raw;
-            },
-            [](const VcmdPitchEnvelopeOff&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdPitchEnvelopeOff::id, .paramCount = 0}; },
-            [](const VcmdFineTune& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdFineTune::id, .paramCount = 1};
-                raw.params[0] = static_cast<uint8_t>(value.semitones);
-                return raw;
-            },
-            [](const VcmdEchoOn& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdEchoOn::id, .paramCount = 3};
-                raw.params[0] = value.channels;
-                raw.params[1] = value.left;
-                raw.params[2] = value.right;
-                return raw;
-            },
-            [](const VcmdEchoOff&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdEchoOff::id, .paramCount = 0}; },
-            [](const VcmdEchoParams& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdEchoParams::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.feedback;
-                raw.params[2] = value.firIndex;
-                return raw;
-            },
-            [](const VcmdEchoVolumeFade& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdEchoVolumeFade::id, .paramCount = 3};
-                raw.params[0] = value.time;
-                raw.params[1] = value.leftTarget;
-                raw.params[2] = value.rightTarget;
-                return raw;
-            },
-            [](const VcmdPitchSlideToNote& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPitchSlideToNote::id, .paramCount = 3};
-                raw.params[0] = value.delay;
-                raw.params[1] = value.length;
-                raw.params[2] = value.note;
-                return raw;
-            },
-            [](const VcmdPercussionBaseInstrument& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdPercussionBaseInstrument::id, .paramCount = 1};
-                raw.params[0] = value.index;
-                return raw;
-            },
-            [](const VcmdNOP& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{.id = VcmdNOP::id, .paramCount = 2};
-                raw.params[0] = static_cast<uint8_t>(value.nopBytes & 0xFFu);
-                raw.params[1] = static_cast<uint8_t>((value.nopBytes >> 8) & 0xFFu);
-                return raw;
-            },
-            [](const VcmdMuteChannel&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdMuteChannel::id, .paramCount = 0}; },
-            [](const VcmdFastForwardOn&) -> std::optional<RawVcmd> {
-                return RawVcmd{.id = VcmdFastForwardOn::id, .paramCount = 0};
-            },
-            [](const VcmdFastForwardOff&) -> std::optional<RawVcmd> {
-                return RawVcmd{.id = VcmdFastForwardOff::id, .paramCount = 0};
-            },
-            [](const VcmdUnused&) -> std::optional<RawVcmd> { return RawVcmd{.id = VcmdUnused::id, .paramCount = 0}; },
-            [](const VcmdExtension& value) -> std::optional<RawVcmd> {
-                RawVcmd raw{
-                    .id = value.id,
-                    .params = value.params,
-                    .paramCount = value.paramCount,
-                };
-                return raw;
-            },
-        },
-        cmd.vcmd);
+    if (std::holds_alternative<std::monostate>(cmd.vcmd)) {
+        return std::nullopt;
+    }
+
+    RawVcmd raw;
+    raw.id = vcmdCommandId(cmd);
+    raw.paramCount = writeVcmdParams(cmd, raw.params);
+    if (const auto* call = std::get_if<VcmdSubroutineCall>(&cmd.vcmd)) {
+        raw.subroutineId = call->subroutineId;
+        raw.originalAddr = call->originalAddr;
+    }
+    return raw;
 }
 
 std::expected<Vcmd, std::string> parseVcmd(const json& value) {
@@ -699,12 +549,7 @@ std::expected<Vcmd, std::string> parseVcmd(const json& value) {
         return std::unexpected(std::format("VCMD ${:02X} requires params", id));
     }
 
-    switch (id) {
-    case VcmdInst::id:
-        return Vcmd{VcmdInst{.instrumentIndex = params[0]}};
-    case VcmdVolume::id:
-        return Vcmd{VcmdVolume{.volume = params[0]}};
-    case VcmdSubroutineCall::id: {
+    if (id == VcmdSubroutineCall::id) {
         const int subroutineId = value.value("subroutineId", -1);
         uint16_t originalAddr = static_cast<uint16_t>(params[0] | (static_cast<uint16_t>(params[1]) << 8u));
         if (value.contains("originalAddr")) {
@@ -718,18 +563,9 @@ std::expected<Vcmd, std::string> parseVcmd(const json& value) {
             .count = params[2],
         }};
     }
-    case VcmdNOP::id: {
-        const uint16_t nopBytes = static_cast<uint16_t>(params[0] | (static_cast<uint16_t>(params[1]) << 8u));
-        return Vcmd{VcmdNOP{.nopBytes = nopBytes}};
-    }
-    case VcmdUnused::id:
-        return Vcmd{VcmdUnused{}};
-    default:
-        break;
-    }
 
-    if (const auto constructed = constructVcmd(id, params.data()); constructed.has_value()) {
-        return *constructed;
+    if (const auto decoded = decodeVcmd(id, params.data()); decoded.has_value()) {
+        return *decoded;
     }
     return std::unexpected(std::format("Unsupported VCMD ${:02X} in project file", id));
 }
@@ -750,6 +586,8 @@ PackedEventKind packedEventKindFor(const NspcEvent& event) {
         event);
 }
 
+}  // namespace
+
 std::expected<std::vector<uint8_t>, std::string> packEventEntries(const std::vector<NspcEventEntry>& entries) {
     std::vector<uint8_t> out;
     out.reserve(1u + entries.size() * 8u);
@@ -847,7 +685,7 @@ std::expected<std::vector<uint8_t>, std::string> packEventEntries(const std::vec
     return out;
 }
 
-std::expected<std::vector<NspcEventEntry>, std::string> unpackEventEntries(const std::vector<uint8_t>& bytes,
+std::expected<std::vector<NspcEventEntry>, std::string> unpackEventEntries(std::span<const uint8_t> bytes,
                                                                             std::string_view label) {
     auto fail = [&](std::string_view detail) -> std::unexpected<std::string> {
         return std::unexpected(std::format("{} packed events decode error: {}", label, detail));
@@ -1038,6 +876,8 @@ std::expected<std::vector<NspcEventEntry>, std::string> unpackEventEntries(const
     return out;
 }
 
+namespace {
+
 void resolveLoadedEventId(NspcEventEntry& entry, NspcEventId& generatedId) {
     if (entry.id == 0) {
         entry.id = generatedId++;
@@ -1046,7 +886,168 @@ void resolveLoadedEventId(NspcEventEntry& entry, NspcEventId& generatedId) {
     generatedId = std::max(generatedId, entry.id + 1);
 }
 
-std::expected<json, std::string> serializeSong(const NspcSong& song) {
+// Where byte payloads (packed events, BRR data) go. The JSON form inlines them as base64 strings; the binary form
+// appends them raw to the blob of the chunk being written and stores a {"offset", "size"} reference into it.
+struct PayloadWriter {
+    std::vector<uint8_t>* blob = nullptr;  // null for the JSON form
+
+    [[nodiscard]] json write(std::span<const uint8_t> bytes) const {
+        if (blob == nullptr) {
+            return encodeBase64(bytes);
+        }
+        json reference{{"offset", blob->size()}, {"size", bytes.size()}};
+        blob->insert(blob->end(), bytes.begin(), bytes.end());
+        return reference;
+    }
+};
+
+struct PayloadReader {
+    std::optional<std::span<const uint8_t>> blob;  // empty for the JSON form
+
+    /// Checks the payload's shape without decoding it
+    [[nodiscard]] std::expected<void, std::string> validate(const json& value) const {
+        if (!blob.has_value()) {
+            if (!value.is_string()) {
+                return std::unexpected("must be a base64 string");
+            }
+            return {};
+        }
+        if (!value.is_object() || !value.contains("offset") || !value["offset"].is_number_unsigned() ||
+            !value.contains("size") || !value["size"].is_number_unsigned()) {
+            return std::unexpected("must be a chunk payload reference");
+        }
+        const uint64_t offset = value["offset"].get<uint64_t>();
+        const uint64_t size = value["size"].get<uint64_t>();
+        if (offset > blob->size() || size > blob->size() - offset) {
+            return std::unexpected("references bytes past the end of its chunk");
+        }
+        return {};
+    }
+
+    /// Raw payloads point into the blob; base64 ones are decoded into `scratch`
+    [[nodiscard]] std::expected<std::span<const uint8_t>, std::string> read(const json& value,
+                                                                            std::vector<uint8_t>& scratch) const {
+        if (auto valid = validate(value); !valid.has_value()) {
+            return std::unexpected(valid.error());
+        }
+        if (!blob.has_value()) {
+            auto decoded = decodeBase64(value.get_ref<const std::string&>());
+            if (!decoded.has_value()) {
+                return std::unexpected(std::format("has invalid base64 payload: {}", decoded.error()));
+            }
+            scratch = std::move(*decoded);
+            return std::span<const uint8_t>(scratch);
+        }
+        return blob->subspan(value["offset"].get<size_t>(), value["size"].get<size_t>());
+    }
+};
+
+std::expected<void, std::string> decodePackedEventList(std::span<const uint8_t> packed, std::string_view label,
+                                                       std::vector<NspcEventEntry>& out,
+                                                       NspcEventId& generatedEventId) {
+    auto unpacked = unpackEventEntries(packed, label);
+    if (!unpacked.has_value()) {
+        return std::unexpected(unpacked.error());
+    }
+    out = std::move(*unpacked);
+    for (auto& entry : out) {
+        resolveLoadedEventId(entry, generatedEventId);
+    }
+    return {};
+}
+
+std::expected<void, std::string> decodeEventList(const json& eventsData, std::string_view label,
+                                                 const PayloadReader& payloads, std::vector<NspcEventEntry>& out,
+                                                 NspcEventId& generatedEventId) {
+    std::vector<uint8_t> scratch;
+    auto packed = payloads.read(eventsData, scratch);
+    if (!packed.has_value()) {
+        return std::unexpected(std::format("{} eventsData {}", label, packed.error()));
+    }
+    return decodePackedEventList(*packed, label, out, generatedEventId);
+}
+
+// A song's event lists kept encoded by a deferred load: the tracks and subroutines without their events, and
+// the packed events of every list back to back, tracks first
+struct DeferredEventLists {
+    std::vector<NspcTrack> tracks;
+    std::vector<NspcSubroutine> subroutines;
+    std::vector<uint8_t> packed;
+    std::vector<std::pair<size_t, size_t>> ranges;  // offset and size in `packed` of each list
+    std::optional<NspcSongOutline> outline;
+};
+
+// Lists that fail to decode are left empty and keep their packed bytes, so saving writes them back unchanged
+NspcSongBody decodeDeferredEvents(DeferredEventLists& lists) {
+    NspcSongBody body;
+    size_t failedLists = 0;
+    size_t list = 0;
+    // Ids are assigned in the same order as an eager load
+    NspcEventId generatedEventId = 1;
+    auto decodeLists = [&](auto& owners, NspcEventOwner owner, std::string_view label,
+                           const std::vector<NspcEventListOutline>* outlines) {
+        for (size_t i = 0; i < owners.size(); ++i, ++list) {
+            const auto [offset, size] = lists.ranges[list];
+            const auto packed = std::span<const uint8_t>(lists.packed).subspan(offset, size);
+            auto decoded = decodePackedEventList(packed, label, owners[i].events, generatedEventId);
+            if (decoded.has_value()) {
+                continue;
+            }
+            if (failedLists++ == 0) {
+                body.error = decoded.error();
+            }
+            NspcUndecodedEvents undecoded;
+            undecoded.owner = owner;
+            undecoded.id = owners[i].id;
+            undecoded.packed.assign(packed.begin(), packed.end());
+            if (outlines != nullptr) {
+                undecoded.encodedBytes = (*outlines)[i].encodedBytes;
+            }
+            body.undecoded.push_back(std::move(undecoded));
+        }
+    };
+    decodeLists(lists.tracks, NspcEventOwner::Track, "Track",
+                lists.outline.has_value() ? &lists.outline->tracks : nullptr);
+    decodeLists(lists.subroutines, NspcEventOwner::Subroutine, "Subroutine",
+                lists.outline.has_value() ? &lists.outline->subroutines : nullptr);
+    if (failedLists > 1) {
+        body.error += std::format(" (and {} more event lists)", failedLists - 1);
+    }
+
+    body.tracks = std::move(lists.tracks);
+    body.subroutines = std::move(lists.subroutines);
+    lists.packed = {};
+    lists.ranges = {};
+    return body;
+}
+
+// The stored encodedBytes of every list, or nothing when any is missing (files from before it was written)
+std::optional<NspcSongOutline> readSongOutline(const json& value, const std::vector<NspcTrack>& tracks,
+                                               const std::vector<NspcSubroutine>& subroutines) {
+    NspcSongOutline outline;
+    auto readLists = [&](const char* key, const auto& lists, std::vector<NspcEventListOutline>& out) {
+        if (lists.empty()) {
+            return true;
+        }
+        const json& values = value[key];
+        for (size_t i = 0; i < lists.size(); ++i) {
+            const json& owner = values[i];
+            if (!owner.contains("encodedBytes") || !owner["encodedBytes"].is_number_unsigned()) {
+                return false;
+            }
+            out.push_back(NspcEventListOutline{.id = lists[i].id,
+                                               .originalAddr = lists[i].originalAddr,
+                                               .encodedBytes = owner["encodedBytes"].get<uint32_t>()});
+        }
+        return true;
+    };
+    if (!readLists("tracks", tracks, outline.tracks) || !readLists("subroutines", subroutines, outline.subroutines)) {
+        return std::nullopt;
+    }
+    return outline;
+}
+
+std::expected<json, std::string> serializeSong(const NspcSong& song, const PayloadWriter& payloads) {
     json out{
         {"songId", song.songId()},
         {"contentOrigin", contentOriginToString(song.contentOrigin())},
@@ -1083,18 +1084,39 @@ std::expected<json, std::string> serializeSong(const NspcSong& song) {
     }
     out["patterns"] = std::move(patterns);
 
+    // A list that failed to decode is written back as loaded until it gets events of its own
+    const auto writeEvents = [&](json& ownerJson, NspcEventOwner owner, int id,
+                                 const std::vector<NspcEventEntry>& events) -> std::expected<void, std::string> {
+        ownerJson["eventsEncoding"] = kPackedEventsEncoding;
+        const auto& undecoded = song.undecodedEvents();
+        const auto kept = std::ranges::find_if(
+            undecoded, [&](const NspcUndecodedEvents& item) { return item.owner == owner && item.id == id; });
+        if (events.empty() && kept != undecoded.end()) {
+            if (kept->encodedBytes.has_value()) {
+                ownerJson["encodedBytes"] = *kept->encodedBytes;
+            }
+            ownerJson["eventsData"] = payloads.write(kept->packed);
+            return {};
+        }
+        auto packedEvents = packEventEntries(events);
+        if (!packedEvents.has_value()) {
+            return std::unexpected(packedEvents.error());
+        }
+        ownerJson["encodedBytes"] = encodedEventBytes(events);
+        ownerJson["eventsData"] = payloads.write(*packedEvents);
+        return {};
+    };
+
     json tracks = json::array();
     for (const auto& track : song.tracks()) {
         json trackJson{
             {"id", track.id},
             {"originalAddr", track.originalAddr},
         };
-        auto packedEvents = packEventEntries(track.events);
-        if (!packedEvents.has_value()) {
-            return std::unexpected(std::format("Failed to encode track {} events: {}", track.id, packedEvents.error()));
+        if (auto written = writeEvents(trackJson, NspcEventOwner::Track, track.id, track.events);
+            !written.has_value()) {
+            return std::unexpected(std::format("Failed to encode track {} events: {}", track.id, written.error()));
         }
-        trackJson["eventsEncoding"] = kPackedEventsEncoding;
-        trackJson["eventsData"] = encodeBase64(*packedEvents);
         tracks.push_back(std::move(trackJson));
     }
     out["tracks"] = std::move(tracks);
@@ -1105,13 +1127,11 @@ std::expected<json, std::string> serializeSong(const NspcSong& song) {
             {"id", subroutine.id},
             {"originalAddr", subroutine.originalAddr},
         };
-        auto packedEvents = packEventEntries(subroutine.events);
-        if (!packedEvents.has_value()) {
+        if (auto written = writeEvents(subJson, NspcEventOwner::Subroutine, subroutine.id, subroutine.events);
+            !written.has_value()) {
             return std::unexpected(
-                std::format("Failed to encode subroutine {} events: {}", subroutine.id, packedEvents.error()));
+                std::format("Failed to encode subroutine {} events: {}", subroutine.id, written.error()));
         }
-        subJson["eventsEncoding"] = kPackedEventsEncoding;
-        subJson["eventsData"] = encodeBase64(*packedEvents);
         subroutines.push_back(std::move(subJson));
     }
     out["subroutines"] = std::move(subroutines);
@@ -1119,7 +1139,7 @@ std::expected<json, std::string> serializeSong(const NspcSong& song) {
     return std::move(out);
 }
 
-std::expected<NspcSong, std::string> parseSong(const json& value) {
+std::expected<NspcSong, std::string> parseSong(const json& value, const PayloadReader& payloads, bool deferEvents) {
     if (!value.is_object()) {
         return std::unexpected("Song entry must be an object");
     }
@@ -1194,6 +1214,10 @@ std::expected<NspcSong, std::string> parseSong(const json& value) {
         return {};
     };
 
+    // Deferred lists are read now, so an unreadable payload fails the load like an eager one
+    std::vector<uint8_t> deferredPacked;
+    std::vector<std::pair<size_t, size_t>> deferredRanges;
+    std::vector<uint8_t> deferredScratch;
     auto parseEventList = [&](const json& owner, std::string_view label,
                               std::vector<NspcEventEntry>& out,
                               NspcEventId& generatedEventId) -> std::expected<void, std::string> {
@@ -1202,8 +1226,8 @@ std::expected<NspcSong, std::string> parseSong(const json& value) {
             return std::unexpected(std::format("{} is missing eventsData payload", label));
         }
 
-        if (!owner["eventsData"].is_string()) {
-            return std::unexpected(std::format("{} eventsData must be a base64 string", label));
+        if (auto valid = payloads.validate(owner["eventsData"]); !valid.has_value()) {
+            return std::unexpected(std::format("{} eventsData {}", label, valid.error()));
         }
 
         const std::string encoding = owner.value("eventsEncoding", "");
@@ -1211,20 +1235,16 @@ std::expected<NspcSong, std::string> parseSong(const json& value) {
             return std::unexpected(std::format("{} eventsEncoding must be '{}'", label, kPackedEventsEncoding));
         }
 
-        const std::string encoded = owner["eventsData"].get<std::string>();
-        auto decoded = decodeBase64(encoded);
-        if (!decoded.has_value()) {
-            return std::unexpected(std::format("{} eventsData has invalid base64 payload: {}", label, decoded.error()));
-        }
-        auto unpacked = unpackEventEntries(*decoded, label);
-        if (!unpacked.has_value()) {
-            return std::unexpected(unpacked.error());
-        }
-        out = std::move(*unpacked);
-        for (auto& entry : out) {
-            resolveLoadedEventId(entry, generatedEventId);
+        if (deferEvents) {
+            auto packed = payloads.read(owner["eventsData"], deferredScratch);
+            if (!packed.has_value()) {
+                return std::unexpected(std::format("{} eventsData {}", label, packed.error()));
+            }
+            deferredRanges.emplace_back(deferredPacked.size(), packed->size());
+            deferredPacked.insert(deferredPacked.end(), packed->begin(), packed->end());
+            return {};
         }
-        return {};
+        return decodeEventList(owner["eventsData"], label, payloads, out, generatedEventId);
     };
 
     auto parseTrackSection = [&](std::vector<NspcTrack>& out, NspcEventId& generatedEventId) -> std::expected<void, std::string> {
@@ -1309,6 +1329,17 @@ std::expected<NspcSong, std::string> parseSong(const json& value) {
         return std::unexpected(parsed.error());
     }
 
+    if (!deferredRanges.empty()) {
+        auto deferred = std::make_shared<DeferredEventLists>();
+        deferred->tracks = std::exchange(song.tracks(), {});
+        deferred->subroutines = std::exchange(song.subroutines(), {});
+        deferred->packed = std::move(deferredPacked);
+        deferred->ranges = std::move(deferredRanges);
+        deferred->outline = readSongOutline(value, deferred->tracks, deferred->subroutines);
+        auto outline = deferred->outline;
+        song.deferBody(std::make_shared<NspcDeferredSongBody>(
+            [deferred] { return decodeDeferredEvents(*deferred); }, std::move(outline)));
+    }
     return song;
 }
 
@@ -1366,12 +1397,12 @@ std::expected<NspcInstrument, std::string> parseInstrument(const json& value) {
     return instrument;
 }
 
-json serializeSample(const BrrSample& sample) {
+json serializeSample(const BrrSample& sample, const PayloadWriter& payloads) {
     return json{
         {"id", sample.id},
         {"name", sample.name},
-        {"dataEncoding", "base64"},
-        {"data", encodeBase64(sample.data)},
+        {"dataEncoding", payloads.blob == nullptr ? kBase64DataEncoding : kRawDataEncoding},
+        {"data", payloads.write(sample.data)},
         {"dataSize", sample.data.size()},
         {"originalAddr", sample.originalAddr},
         {"originalLoopAddr", sample.originalLoopAddr},
@@ -1379,7 +1410,7 @@ json serializeSample(const BrrSample& sample) {
     };
 }
 
-std::expected<BrrSample, std::string> parseSample(const json& value) {
+std::expected<BrrSample, std::string> parseSample(const json& value, const PayloadReader& payloads) {
     if (!value.is_object()) {
         return std::unexpected("Sample entry must be an object");
     }
@@ -1402,58 +1433,192 @@ std::expected<BrrSample, std::string> parseSample(const json& value) {
     sample.contentOrigin = parseContentOrigin(value.value("contentOrigin", "user"));
 
     const std::string dataEncoding = value.value("dataEncoding", "");
-    if (dataEncoding != "base64") {
+    const std::string_view expectedEncoding = payloads.blob.has_value() ? kRawDataEncoding : kBase64DataEncoding;
+    if (dataEncoding != expectedEncoding) {
         return std::unexpected(std::format("Sample entry has unsupported dataEncoding '{}'", dataEncoding));
     }
-    if (!value.contains("data") || !value["data"].is_string()) {
-        return std::unexpected("Sample entry has invalid data payload; expected base64 string");
+    if (!value.contains("data")) {
+        return std::unexpected("Sample entry is missing its data payload");
+    }
+    std::vector<uint8_t> scratch;
+    auto data = payloads.read(value["data"], scratch);
+    if (!data.has_value()) {
+        return std::unexpected(std::format("Sample entry data {}", data.error()));
     }
-    const std::string encoded = value["data"].get<std::string>();
-    auto decoded = decodeBase64(encoded);
-    if (!decoded.has_value()) {
-        return std::unexpected(std::format("Sample entry has invalid base64 data: {}", decoded.error()));
+    if (payloads.blob.has_value()) {
+        sample.data.assign(data->begin(), data->end());
+    } else {
+        sample.data = std::move(scratch);
     }
-    sample.data = std::move(*decoded);
     return sample;
 }
 
-}  // namespace
+std::expected<json, std::string> serializePackedEvents(const std::vector<NspcEventEntry>& events,
+                                                       const PayloadWriter& payloads) {
+    auto packedEvents = packEventEntries(events);
+    if (!packedEvents.has_value()) {
+        return std::unexpected(packedEvents.error());
+    }
+    return json{
+        {"eventsEncoding", kPackedEventsEncoding},
+        {"eventsData", payloads.write(*packedEvents)},
+    };
+}
 
-std::expected<void, std::string> saveProjectIrFile(const NspcProject& project, const std::filesystem::path& path,
-                                                   std::optional<std::filesystem::path> baseSpcPath) {
+std::optional<std::vector<NspcEventEntry>> parsePackedEvents(const json& value, NspcEventId& generatedEventId,
+                                                             const PayloadReader& payloads) {
+    if (!value.is_object() || value.value("eventsEncoding", "") != kPackedEventsEncoding ||
+        !value.contains("eventsData")) {
+        return std::nullopt;
+    }
+    std::vector<uint8_t> scratch;
+    auto packed = payloads.read(value["eventsData"], scratch);
+    if (!packed.has_value()) {
+        return std::nullopt;
+    }
+    auto unpacked = unpackEventEntries(*packed, "Optimizer cache");
+    if (!unpacked.has_value()) {
+        return std::nullopt;
+    }
+    for (auto& entry : *unpacked) {
+        resolveLoadedEventId(entry, generatedEventId);
+    }
+    return std::move(*unpacked);
+}
+
+std::expected<json, std::string> serializeOptimizerCacheEntry(uint64_t key, const NspcOptimizerCacheEntry& entry,
+                                                              const PayloadWriter& payloads) {
+    json tracks = json::array();
+    for (const auto& events : entry.trackEvents) {
+        auto packed = serializePackedEvents(events, payloads);
+        if (!packed.has_value()) {
+            return std::unexpected(std::format("Failed to encode cached track events: {}", packed.error()));
+        }
+        tracks.push_back(std::move(*packed));
+    }
+    json subroutines = json::array();
+    for (const auto& subroutine : entry.subroutines) {
+        auto packed = serializePackedEvents(subroutine.events, payloads);
+        if (!packed.has_value()) {
+            return std::unexpected(
+                std::format("Failed to encode cached subroutine {} events: {}", subroutine.id, packed.error()));
+        }
+        (*packed)["id"] = subroutine.id;
+        subroutines.push_back(std::move(*packed));
+    }
+    return json{
+        {"key", std::format("{:016x}", key)},
+        {"keyInput", payloads.write(entry.keyInput)},
+        {"tracks", std::move(tracks)},
+        {"subroutines", std::move(subroutines)},
+        {"stats",
+         {
+             {"iterations", entry.stats.iterations},
+             {"subroutinesCreated", entry.stats.subroutinesCreated},
+             {"bytesBefore", entry.stats.bytesBefore},
+             {"bytesAfter", entry.stats.bytesAfter},
+         }},
+    };
+}
+
+// The cache only saves time, so an entry this build cannot read is dropped instead of failing the load.
+std::optional<std::pair<uint64_t, NspcOptimizerCacheEntry>> parseOptimizerCacheEntry(const json& value,
+                                                                                     const PayloadReader& payloads) {
+    if (!value.is_object() || !value.contains("key") || !value["key"].is_string() || !value.contains("tracks") ||
+        !value["tracks"].is_array() || !value.contains("subroutines") || !value["subroutines"].is_array()) {
+        return std::nullopt;
+    }
+    const std::string keyText = value["key"].get<std::string>();
+    uint64_t key = 0;
+    const auto [keyEnd, keyError] = std::from_chars(keyText.data(), keyText.data() + keyText.size(), key, 16);
+    if (keyError != std::errc{} || keyEnd != keyText.data() + keyText.size()) {
+        return std::nullopt;
+    }
+
+    NspcOptimizerCacheEntry entry;
+    if (!value.contains("keyInput")) {
+        return std::nullopt;
+    }
+    std::vector<uint8_t> scratch;
+    auto keyInput = payloads.read(value["keyInput"], scratch);
+    if (!keyInput.has_value()) {
+        return std::nullopt;
+    }
+    entry.keyInput.assign(keyInput->begin(), keyInput->end());
+    NspcEventId generatedEventId = 1;
+    for (const auto& trackValue : value["tracks"]) {
+        auto events = parsePackedEvents(trackValue, generatedEventId, payloads);
+        if (!events.has_value()) {
+            return std::nullopt;
+        }
+        entry.trackEvents.push_back(std::move(*events));
+    }
+    for (const auto& subValue : value["subroutines"]) {
+        auto events = parsePackedEvents(subValue, generatedEventId, payloads);
+        const auto id = parseInt(subValue.value("id", -1));
+        if (!events.has_value() || !id.has_value() || *id < 0) {
+            return std::nullopt;
+        }
+        entry.subroutines.push_back(NspcSubroutine{.id = *id, .events = std::move(*events), .originalAddr = 0});
+    }
+    if (value.contains("stats") && value["stats"].is_object()) {
+        const auto& stats = value["stats"];
+        entry.stats.iterations = stats.value("iterations", 0);
+        entry.stats.subroutinesCreated = stats.value("subroutinesCreated", 0);
+        entry.stats.bytesBefore = stats.value("bytesBefore", 0u);
+        entry.stats.bytesAfter = stats.value("bytesAfter", 0u);
+    }
+    return std::pair{key, std::move(entry)};
+}
+
+// A project file's contents, borrowed from a live project or from loaded IR data so both save through one path
+struct ProjectIrView {
+    std::string engineName;
+    std::optional<std::string> baseSpcPath;
+    std::optional<std::vector<std::string>> enabledEngineExtensions;
+    std::vector<const NspcSong*> songs;
+    std::vector<const NspcInstrument*> instruments;
+    std::vector<const BrrSample*> samples;
+    std::vector<int> retainedEngineSongIds;
+    std::vector<int> retainedEngineInstrumentIds;
+    std::vector<int> retainedEngineSampleIds;
+    std::optional<std::span<const std::pair<uint64_t, NspcOptimizerCacheEntry>>> optimizerCache;
+};
+
+// Everything but the songs, samples and optimizer cache, which each form may store apart from the root
+json serializeProjectHeader(const ProjectIrView& view) {
     json root{
         {"format", kProjectFormatTag},
         {"version", kProjectFormatVersion},
-        {"engine", project.engineConfig().name},
+        {"engine", view.engineName},
     };
-
-    if (baseSpcPath.has_value() && !baseSpcPath->empty()) {
-        std::filesystem::path storedPath = *baseSpcPath;
-        if (storedPath.is_absolute()) {
-            std::error_code relError;
-            const auto relativePath = std::filesystem::relative(storedPath, path.parent_path(), relError);
-            if (!relError && !relativePath.empty()) {
-                storedPath = relativePath;
-            }
-        }
-        root["baseSpcPath"] = storedPath.generic_string();
+    if (view.baseSpcPath.has_value()) {
+        root["baseSpcPath"] = *view.baseSpcPath;
     }
-    if (!project.engineConfig().extensions.empty()) {
-        root["engineExtensions"] = project.enabledEngineExtensionNames();
+    if (view.enabledEngineExtensions.has_value()) {
+        root["engineExtensions"] = *view.enabledEngineExtensions;
     }
 
+    json instruments = json::array();
+    for (const auto* instrument : view.instruments) {
+        instruments.push_back(serializeInstrument(*instrument));
+    }
+    root["instruments"] = std::move(instruments);
+    root["engineRetained"] = json{
+        {"songs", normalizeIdList(view.retainedEngineSongIds)},
+        {"instruments", normalizeIdList(view.retainedEngineInstrumentIds)},
+        {"samples", normalizeIdList(view.retainedEngineSampleIds)},
+    };
+    return root;
+}
+
+std::expected<void, std::string> writeProjectJson(const ProjectIrView& view, const std::filesystem::path& path) {
+    json root = serializeProjectHeader(view);
+    const PayloadWriter payloads{};
+
     json songs = json::array();
-    std::vector<int> retainedEngineSongIds;
-    retainedEngineSongIds.reserve(project.songs().size());
-    for (const auto& song : project.songs()) {
-        if (song.isEngineProvided()) {
-            retainedEngineSongIds.push_back(song.songId());
-        }
-        const bool hasSongMetadata = !song.songName().empty() || !song.author().empty();
-        if (!song.isUserProvided() && !hasSongMetadata) {
-            continue;
-        }
-        auto serializedSong = serializeSong(song);
+    for (const auto* song : view.songs) {
+        auto serializedSong = serializeSong(*song, payloads);
         if (!serializedSong.has_value()) {
             return std::unexpected(serializedSong.error());
         }
@@ -1461,63 +1626,203 @@ std::expected<void, std::string> saveProjectIrFile(const NspcProject& project, c
     }
     root["songs"] = std::move(songs);
 
-    json instruments = json::array();
-    std::vector<int> retainedEngineInstrumentIds;
-    retainedEngineInstrumentIds.reserve(project.instruments().size());
-    for (const auto& instrument : project.instruments()) {
-        if (instrument.contentOrigin == NspcContentOrigin::EngineProvided) {
-            retainedEngineInstrumentIds.push_back(instrument.id);
-        }
-        if (instrument.contentOrigin != NspcContentOrigin::UserProvided) {
-            continue;
-        }
-        instruments.push_back(serializeInstrument(instrument));
+    json samples = json::array();
+    for (const auto* sample : view.samples) {
+        samples.push_back(serializeSample(*sample, payloads));
     }
-    root["instruments"] = std::move(instruments);
+    root["samples"] = std::move(samples);
 
-    json samples = json::array();
-    std::vector<int> retainedEngineSampleIds;
-    retainedEngineSampleIds.reserve(project.samples().size());
-    for (const auto& sample : project.samples()) {
-        if (sample.contentOrigin == NspcContentOrigin::EngineProvided) {
-            retainedEngineSampleIds.push_back(sample.id);
-        }
-        if (sample.contentOrigin != NspcContentOrigin::UserProvided) {
-            continue;
+    if (view.optimizerCache.has_value()) {
+        json cacheEntries = json::array();
+        for (const auto& [key, entry] : *view.optimizerCache) {
+            auto serializedEntry = serializeOptimizerCacheEntry(key, entry, payloads);
+            if (!serializedEntry.has_value()) {
+                return std::unexpected(serializedEntry.error());
+            }
+            cacheEntries.push_back(std::move(*serializedEntry));
         }
-        samples.push_back(serializeSample(sample));
+        root["optimizerCache"] = std::move(cacheEntries);
     }
-    root["samples"] = std::move(samples);
-    root["engineRetained"] = json{
-        {"songs", normalizeIdList(std::move(retainedEngineSongIds))},
-        {"instruments", normalizeIdList(std::move(retainedEngineInstrumentIds))},
-        {"samples", normalizeIdList(std::move(retainedEngineSampleIds))},
-    };
 
     std::ofstream out(path, std::ios::binary | std::ios::trunc);
     if (!out) {
         return std::unexpected(std::format("Failed to open '{}' for writing", path.string()));
     }
     out << root.dump();
+    out.close();
     if (!out.good()) {
         return std::unexpected(std::format("Failed while writing '{}'", path.string()));
     }
     return {};
 }
 
-std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::filesystem::path& path) {
-    std::ifstream in(path, std::ios::binary);
-    if (!in) {
-        return std::unexpected(std::format("Failed to open '{}'", path.string()));
+// Binary container: a 16-byte header (magic, container version, chunk count) and a table of
+// {tag, offset, size} entries, all little-endian u32, followed by the chunks. Each chunk is a u32 metadata
+// length, the metadata as CBOR (the same objects the JSON form holds) and a blob of raw payload bytes the
+// metadata references by offset. One PROJ chunk holds the header object, then one SONG chunk per song,
+// one SMPL chunk per sample and an optional OPTC chunk holding the optimizer cache entries.
+constexpr std::array<uint8_t, 8> kBinaryMagic{'N', 'T', 'R', 'K', 'P', 'R', 'O', 'J'};
+constexpr uint32_t kBinaryContainerVersion = 1;
+constexpr size_t kBinaryHeaderBytes = 16;
+constexpr size_t kBinaryChunkEntryBytes = 12;
+
+constexpr uint32_t chunkTag(const char (&name)[5]) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(name[0])) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(name[1])) << 8u) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(name[2])) << 16u) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(name[3])) << 24u);
+}
+
+constexpr uint32_t kProjectChunkTag = chunkTag("PROJ");
+constexpr uint32_t kSongChunkTag = chunkTag("SONG");
+constexpr uint32_t kSampleChunkTag = chunkTag("SMPL");
+constexpr uint32_t kOptimizerCacheChunkTag = chunkTag("OPTC");
+
+void appendU32Le(std::vector<uint8_t>& out, uint32_t value) {
+    appendU16Le(out, static_cast<uint16_t>(value & 0xFFFFu));
+    appendU16Le(out, static_cast<uint16_t>(value >> 16u));
+}
+
+bool readU32Le(std::span<const uint8_t> bytes, size_t& offset, uint32_t& value) {
+    uint16_t low = 0;
+    uint16_t high = 0;
+    if (!readU16Le(bytes, offset, low) || !readU16Le(bytes, offset, high)) {
+        return false;
     }
+    value = static_cast<uint32_t>(low) | (static_cast<uint32_t>(high) << 16u);
+    return true;
+}
 
-    json root;
-    try {
-        in >> root;
-    } catch (const std::exception& ex) {
-        return std::unexpected(std::format("Failed to parse project file '{}': {}", path.string(), ex.what()));
+bool hasBinaryMagic(std::span<const uint8_t> bytes) {
+    return bytes.size() >= kBinaryMagic.size() && std::equal(kBinaryMagic.begin(), kBinaryMagic.end(), bytes.begin());
+}
+
+// Streams chunks straight to the file so only one chunk is held in memory; the table is patched in at the end
+class BinaryChunkWriter {
+public:
+    BinaryChunkWriter(std::ofstream& out, size_t chunkCount)
+        : out_(out), nextOffset_(kBinaryHeaderBytes + chunkCount * kBinaryChunkEntryBytes), chunkCount_(chunkCount) {
+        const std::vector<uint8_t> placeholder(static_cast<size_t>(nextOffset_), 0);
+        writeBytes(placeholder);
+    }
+
+    std::expected<void, std::string> write(uint32_t tag, const json& metadata, std::span<const uint8_t> blob) {
+        const std::vector<uint8_t> encoded = json::to_cbor(metadata);
+        const uint64_t size = 4u + encoded.size() + blob.size();
+        if (nextOffset_ + size > std::numeric_limits<uint32_t>::max()) {
+            return std::unexpected("Project is too large for the binary container");
+        }
+        appendU32Le(table_, tag);
+        appendU32Le(table_, static_cast<uint32_t>(nextOffset_));
+        appendU32Le(table_, static_cast<uint32_t>(size));
+
+        std::vector<uint8_t> prefix;
+        appendU32Le(prefix, static_cast<uint32_t>(encoded.size()));
+        writeBytes(prefix);
+        writeBytes(encoded);
+        writeBytes(blob);
+        nextOffset_ += size;
+        return {};
+    }
+
+    void finish() {
+        std::vector<uint8_t> header(kBinaryMagic.begin(), kBinaryMagic.end());
+        appendU32Le(header, kBinaryContainerVersion);
+        appendU32Le(header, static_cast<uint32_t>(chunkCount_));
+        out_.seekp(0);
+        writeBytes(header);
+        writeBytes(table_);
+    }
+
+private:
+    void writeBytes(std::span<const uint8_t> bytes) {
+        out_.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    std::ofstream& out_;
+    uint64_t nextOffset_;
+    size_t chunkCount_;
+    std::vector<uint8_t> table_;
+};
+
+std::expected<void, std::string> writeProjectBinary(const ProjectIrView& view, const std::filesystem::path& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return std::unexpected(std::format("Failed to open '{}' for writing", path.string()));
     }
 
+    const size_t chunkCount =
+        1u + view.songs.size() + view.samples.size() + (view.optimizerCache.has_value() ? 1u : 0u);
+    BinaryChunkWriter writer(out, chunkCount);
+    std::vector<uint8_t> blob;
+    const PayloadWriter payloads{.blob = &blob};
+
+    if (auto written = writer.write(kProjectChunkTag, serializeProjectHeader(view), {}); !written.has_value()) {
+        return written;
+    }
+    for (const auto* song : view.songs) {
+        blob.clear();
+        auto serializedSong = serializeSong(*song, payloads);
+        if (!serializedSong.has_value()) {
+            return std::unexpected(serializedSong.error());
+        }
+        if (auto written = writer.write(kSongChunkTag, *serializedSong, blob); !written.has_value()) {
+            return written;
+        }
+    }
+    for (const auto* sample : view.samples) {
+        blob.clear();
+        const json serializedSample = serializeSample(*sample, payloads);
+        if (auto written = writer.write(kSampleChunkTag, serializedSample, blob); !written.has_value()) {
+            return written;
+        }
+    }
+    if (view.optimizerCache.has_value()) {
+        blob.clear();
+        json cacheEntries = json::array();
+        for (const auto& [key, entry] : *view.optimizerCache) {
+            auto serializedEntry = serializeOptimizerCacheEntry(key, entry, payloads);
+            if (!serializedEntry.has_value()) {
+                return std::unexpected(serializedEntry.error());
+            }
+            cacheEntries.push_back(std::move(*serializedEntry));
+        }
+        if (auto written = writer.write(kOptimizerCacheChunkTag, cacheEntries, blob); !written.has_value()) {
+            return written;
+        }
+    }
+
+    writer.finish();
+    out.close();
+    if (!out.good()) {
+        return std::unexpected(std::format("Failed while writing '{}'", path.string()));
+    }
+    return {};
+}
+
+// Writes a sibling temp file and renames it over `path` only once it is complete, so a save that fails
+// partway leaves the previous file untouched
+std::expected<void, std::string> writeProjectFile(const ProjectIrView& view, const std::filesystem::path& path,
+                                                  NspcProjectFileFormat format) {
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    auto written = format == NspcProjectFileFormat::Binary ? writeProjectBinary(view, tempPath)
+                                                           : writeProjectJson(view, tempPath);
+    std::error_code ec;
+    if (written.has_value()) {
+        std::filesystem::rename(tempPath, path, ec);
+        if (!ec) {
+            return {};
+        }
+        written = std::unexpected(std::format("Failed to replace '{}': {}", path.string(), ec.message()));
+    }
+    if (!std::filesystem::is_directory(tempPath, ec)) {
+        std::filesystem::remove(tempPath, ec);
+    }
+    return written;
+}
+
+std::expected<NspcProjectIrData, std::string> parseProjectHeader(const json& root) {
     if (!root.is_object()) {
         return std::unexpected("Project file root must be an object");
     }
@@ -1553,19 +1858,6 @@ std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::files
         overlay.enabledEngineExtensions = std::move(enabledExtensions);
     }
 
-    if (root.contains("songs")) {
-        if (!root["songs"].is_array()) {
-            return std::unexpected("Project songs payload must be an array");
-        }
-        for (const auto& songValue : root["songs"]) {
-            auto song = parseSong(songValue);
-            if (!song.has_value()) {
-                return std::unexpected(song.error());
-            }
-            overlay.songs.push_back(std::move(*song));
-        }
-    }
-
     if (root.contains("instruments")) {
         if (!root["instruments"].is_array()) {
             return std::unexpected("Project instruments payload must be an array");
@@ -1579,19 +1871,6 @@ std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::files
         }
     }
 
-    if (root.contains("samples")) {
-        if (!root["samples"].is_array()) {
-            return std::unexpected("Project samples payload must be an array");
-        }
-        for (const auto& sampleValue : root["samples"]) {
-            auto sample = parseSample(sampleValue);
-            if (!sample.has_value()) {
-                return std::unexpected(sample.error());
-            }
-            overlay.samples.push_back(std::move(*sample));
-        }
-    }
-
     if (!root.contains("engineRetained")) {
         return std::unexpected("Project file is missing required engineRetained payload");
     }
@@ -1619,7 +1898,295 @@ std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::files
     overlay.retainedEngineSongIds = std::move(*retainedSongIds);
     overlay.retainedEngineInstrumentIds = std::move(*retainedInstrumentIds);
     overlay.retainedEngineSampleIds = std::move(*retainedSampleIds);
+    return overlay;
+}
 
+void parseOptimizerCacheEntries(const json& entries, const PayloadReader& payloads, NspcProjectIrData& overlay) {
+    if (!entries.is_array()) {
+        return;
+    }
+    for (const auto& entryValue : entries) {
+        if (auto entry = parseOptimizerCacheEntry(entryValue, payloads); entry.has_value()) {
+            overlay.optimizerCache.push_back(std::move(*entry));
+        }
+    }
+}
+
+std::expected<NspcProjectIrData, std::string> parseProjectJson(std::span<const uint8_t> bytes,
+                                                               const NspcProjectLoadOptions& options) {
+    json root;
+    try {
+        root = json::parse(bytes.begin(), bytes.end());
+    } catch (const std::exception& ex) {
+        return std::unexpected(std::format("Failed to parse project file: {}", ex.what()));
+    }
+
+    auto overlay = parseProjectHeader(root);
+    if (!overlay.has_value()) {
+        return overlay;
+    }
+    const PayloadReader payloads{};
+
+    if (root.contains("songs")) {
+        if (!root["songs"].is_array()) {
+            return std::unexpected("Project songs payload must be an array");
+        }
+        for (const auto& songValue : root["songs"]) {
+            auto song = parseSong(songValue, payloads, options.deferSongEvents);
+            if (!song.has_value()) {
+                return std::unexpected(song.error());
+            }
+            overlay->songs.push_back(std::move(*song));
+        }
+    }
+
+    if (root.contains("samples")) {
+        if (!root["samples"].is_array()) {
+            return std::unexpected("Project samples payload must be an array");
+        }
+        for (const auto& sampleValue : root["samples"]) {
+            auto sample = parseSample(sampleValue, payloads);
+            if (!sample.has_value()) {
+                return std::unexpected(sample.error());
+            }
+            overlay->samples.push_back(std::move(*sample));
+        }
+    }
+
+    if (root.contains("optimizerCache")) {
+        parseOptimizerCacheEntries(root["optimizerCache"], payloads, *overlay);
+    }
+    return overlay;
+}
+
+struct BinaryChunk {
+    uint32_t tag = 0;
+    std::span<const uint8_t> metadata;
+    std::span<const uint8_t> blob;
+};
+
+std::expected<std::vector<BinaryChunk>, std::string> readBinaryChunkTable(std::span<const uint8_t> bytes) {
+    size_t offset = kBinaryMagic.size();
+    uint32_t version = 0;
+    uint32_t chunkCount = 0;
+    if (!readU32Le(bytes, offset, version) || !readU32Le(bytes, offset, chunkCount)) {
+        return std::unexpected("Binary project file header is truncated");
+    }
+    if (version != kBinaryContainerVersion) {
+        return std::unexpected(std::format("Unsupported binary project container version {} (expected {})", version,
+                                           kBinaryContainerVersion));
+    }
+    if (chunkCount > (bytes.size() - offset) / kBinaryChunkEntryBytes) {
+        return std::unexpected("Binary project chunk table is truncated");
+    }
+
+    std::vector<BinaryChunk> chunks;
+    chunks.reserve(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        uint32_t tag = 0;
+        uint32_t chunkOffset = 0;
+        uint32_t chunkSize = 0;
+        (void)readU32Le(bytes, offset, tag);
+        (void)readU32Le(bytes, offset, chunkOffset);
+        (void)readU32Le(bytes, offset, chunkSize);
+        if (chunkOffset > bytes.size() || chunkSize > bytes.size() - chunkOffset) {
+            return std::unexpected(std::format("Binary project chunk {} lies past the end of the file", i));
+        }
+        const auto body = bytes.subspan(chunkOffset, chunkSize);
+        size_t bodyOffset = 0;
+        uint32_t metadataSize = 0;
+        if (!readU32Le(body, bodyOffset, metadataSize) || metadataSize > body.size() - bodyOffset) {
+            return std::unexpected(std::format("Binary project chunk {} has a truncated metadata block", i));
+        }
+        chunks.push_back(BinaryChunk{
+            .tag = tag,
+            .metadata = body.subspan(bodyOffset, metadataSize),
+            .blob = body.subspan(bodyOffset + metadataSize),
+        });
+    }
+    return chunks;
+}
+
+std::expected<json, std::string> decodeChunkMetadata(const BinaryChunk& chunk) {
+    try {
+        return json::from_cbor(chunk.metadata.begin(), chunk.metadata.end());
+    } catch (const std::exception& ex) {
+        return std::unexpected(std::format("Failed to parse binary project chunk metadata: {}", ex.what()));
+    }
+}
+
+std::expected<NspcProjectIrData, std::string> parseProjectBinary(std::span<const uint8_t> bytes,
+                                                                 const NspcProjectLoadOptions& options) {
+    auto chunks = readBinaryChunkTable(bytes);
+    if (!chunks.has_value()) {
+        return std::unexpected(chunks.error());
+    }
+    const auto projectChunk = std::find_if(chunks->begin(), chunks->end(),
+                                           [](const BinaryChunk& chunk) { return chunk.tag == kProjectChunkTag; });
+    if (projectChunk == chunks->end()) {
+        return std::unexpected("Binary project file is missing its PROJ chunk");
+    }
+    auto root = decodeChunkMetadata(*projectChunk);
+    if (!root.has_value()) {
+        return std::unexpected(root.error());
+    }
+    auto overlay = parseProjectHeader(*root);
+    if (!overlay.has_value()) {
+        return overlay;
+    }
+
+    // Chunks this build does not know are skipped, so later versions can add optional ones
+    for (const auto& chunk : *chunks) {
+        if (chunk.tag != kSongChunkTag && chunk.tag != kSampleChunkTag && chunk.tag != kOptimizerCacheChunkTag) {
+            continue;
+        }
+        auto metadata = decodeChunkMetadata(chunk);
+        if (!metadata.has_value()) {
+            return std::unexpected(metadata.error());
+        }
+        const PayloadReader payloads{.blob = chunk.blob};
+        if (chunk.tag == kSongChunkTag) {
+            auto song = parseSong(*metadata, payloads, options.deferSongEvents);
+            if (!song.has_value()) {
+                return std::unexpected(song.error());
+            }
+            overlay->songs.push_back(std::move(*song));
+        } else if (chunk.tag == kSampleChunkTag) {
+            auto sample = parseSample(*metadata, payloads);
+            if (!sample.has_value()) {
+                return std::unexpected(sample.error());
+            }
+            overlay->samples.push_back(std::move(*sample));
+        } else {
+            parseOptimizerCacheEntries(*metadata, payloads, *overlay);
+        }
+    }
+    return overlay;
+}
+
+}  // namespace
+
+std::expected<void, std::string> saveProjectIrFile(const NspcProject& project, const std::filesystem::path& path,
+                                                   std::optional<std::filesystem::path> baseSpcPath,
+                                                   bool includeOptimizerCache, NspcProjectFileFormat format) {
+    ProjectIrView view{};
+    view.engineName = project.engineConfig().name;
+
+    if (baseSpcPath.has_value() && !baseSpcPath->empty()) {
+        std::filesystem::path storedPath = *baseSpcPath;
+        if (storedPath.is_absolute()) {
+            std::error_code relError;
+            const auto relativePath = std::filesystem::relative(storedPath, path.parent_path(), relError);
+            if (!relError && !relativePath.empty()) {
+                storedPath = relativePath;
+            }
+        }
+        view.baseSpcPath = storedPath.generic_string();
+    }
+    if (!project.engineConfig().extensions.empty()) {
+        view.enabledEngineExtensions = project.enabledEngineExtensionNames();
+    }
+
+    view.retainedEngineSongIds.reserve(project.songs().size());
+    for (const auto& song : project.songs()) {
+        if (song.isEngineProvided()) {
+            view.retainedEngineSongIds.push_back(song.songId());
+        }
+        const bool hasSongMetadata = !song.songName().empty() || !song.author().empty();
+        if (!song.isUserProvided() && !hasSongMetadata) {
+            continue;
+        }
+        view.songs.push_back(&song);
+    }
+
+    view.retainedEngineInstrumentIds.reserve(project.instruments().size());
+    for (const auto& instrument : project.instruments()) {
+        if (instrument.contentOrigin == NspcContentOrigin::EngineProvided) {
+            view.retainedEngineInstrumentIds.push_back(instrument.id);
+        }
+        if (instrument.contentOrigin == NspcContentOrigin::UserProvided) {
+            view.instruments.push_back(&instrument);
+        }
+    }
+
+    view.retainedEngineSampleIds.reserve(project.samples().size());
+    for (const auto& sample : project.samples()) {
+        if (sample.contentOrigin == NspcContentOrigin::EngineProvided) {
+            view.retainedEngineSampleIds.push_back(sample.id);
+        }
+        if (sample.contentOrigin == NspcContentOrigin::UserProvided) {
+            view.samples.push_back(&sample);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, NspcOptimizerCacheEntry>> cacheEntries;
+    if (includeOptimizerCache) {
+        cacheEntries = project.optimizerCache().entries();
+        view.optimizerCache = std::span<const std::pair<uint64_t, NspcOptimizerCacheEntry>>(cacheEntries);
+    }
+
+    return writeProjectFile(view, path, format);
+}
+
+std::expected<void, std::string> saveProjectIrData(const NspcProjectIrData& data, const std::filesystem::path& path,
+                                                   NspcProjectFileFormat format) {
+    ProjectIrView view{};
+    view.engineName = data.engineName;
+    if (data.baseSpcPath.has_value()) {
+        view.baseSpcPath = data.baseSpcPath->generic_string();
+    }
+    view.enabledEngineExtensions = data.enabledEngineExtensions;
+    for (const auto& song : data.songs) {
+        view.songs.push_back(&song);
+    }
+    for (const auto& instrument : data.instruments) {
+        view.instruments.push_back(&instrument);
+    }
+    for (const auto& sample : data.samples) {
+        view.samples.push_back(&sample);
+    }
+    view.retainedEngineSongIds = data.retainedEngineSongIds;
+    view.retainedEngineInstrumentIds = data.retainedEngineInstrumentIds;
+    view.retainedEngineSampleIds = data.retainedEngineSampleIds;
+    if (!data.optimizerCache.empty()) {
+        view.optimizerCache = std::span<const std::pair<uint64_t, NspcOptimizerCacheEntry>>(data.optimizerCache);
+    }
+    return writeProjectFile(view, path, format);
+}
+
+NspcProjectFileFormat detectProjectFileFormat(std::span<const uint8_t> bytes) {
+    return hasBinaryMagic(bytes) ? NspcProjectFileFormat::Binary : NspcProjectFileFormat::Json;
+}
+
+NspcProjectFileFormat projectFileFormatForPath(const std::filesystem::path& path) {
+    return path.extension() == ".ntrakbin" ? NspcProjectFileFormat::Binary : NspcProjectFileFormat::Json;
+}
+
+std::expected<NspcProjectIrData, std::string> parseProjectIr(std::span<const uint8_t> bytes,
+                                                             const NspcProjectLoadOptions& options) {
+    if (detectProjectFileFormat(bytes) == NspcProjectFileFormat::Binary) {
+        return parseProjectBinary(bytes, options);
+    }
+    return parseProjectJson(bytes, options);
+}
+
+std::expected<NspcProjectIrData, std::string> loadProjectIrFile(const std::filesystem::path& path,
+                                                                const NspcProjectLoadOptions& options) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return std::unexpected(std::format("Failed to open '{}'", path.string()));
+    }
+    const auto size = static_cast<size_t>(in.tellg());
+    std::vector<uint8_t> bytes(size);
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(size))) {
+        return std::unexpected(std::format("Failed to read '{}'", path.string()));
+    }
+
+    auto overlay = parseProjectIr(bytes, options);
+    if (!overlay.has_value()) {
+        return std::unexpected(std::format("Failed to load project file '{}': {}", path.string(), overlay.error()));
+    }
     return overlay;
 }
 
@@ -1706,6 +2273,10 @@ std::expected<void, std::string> applyProjectIrOverlay(NspcProject& project, con
     pruneEngineInstruments(project, overlay.retainedEngineInstrumentIds);
     pruneEngineSamples(project, overlay.retainedEngineSampleIds);
 
+    for (const auto& [key, entry] : overlay.optimizerCache) {
+        project.optimizerCache().store(NspcOptimizerCacheKey{.hash = key, .input = entry.keyInput}, entry);
+    }
+
     project.refreshAramUsage();
     return {};
 }
@@ -1,5 +1,6 @@
 #include "ntrak/nspc/NspcSpcExport.hpp"
 
+#include "ntrak/common/Parallel.hpp"
 #include "ntrak/nspc/NspcCompile.hpp"
 #include "ntrak/emulation/SpcDsp.hpp"
 
@@ -46,11 +47,6 @@ void writeSpcTextField(std::vector<uint8_t>& spcData, size_t offset, size_t size
     std::copy_n(value.begin(), static_cast<ptrdiff_t>(copyLen), spcData.begin() + static_cast<ptrdiff_t>(offset));
 }
 
-void applySongId666Tags(std::vector<uint8_t>& spcData, const NspcSong& song) {
-    writeSpcTextField(spcData, kSpcSongTitleOffset, kSpcSongTitleSize, song.songName());
-    writeSpcTextField(spcData, kSpcArtistOffset, kSpcArtistSize, song.author());
-}
-
 bool hasAnyUserProvidedContent(const NspcProject& project) {
     const bool hasUserSongs = std::any_of(project.songs().begin(), project.songs().end(),
                                           [](const NspcSong& song) { return song.isUserProvided(); });
@@ -71,15 +67,17 @@ bool hasAnyUserProvidedContent(const NspcProject& project) {
     });
 }
 
-}  // namespace
-
-std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
-    NspcProject& project,
-    std::span<const uint8_t> baseSpcImage,
-    int songIndex,
-    std::optional<uint8_t> triggerPortOverride,
-    NspcBuildOptions buildOptions) {
-    
+struct AutoPlayRenderJob {
+    std::vector<uint8_t> patchedImage;
+    int songIndex = 0;
+    std::string songName;
+    std::string author;
+};
+
+std::expected<AutoPlayRenderJob, std::string> buildPatchedAutoPlayImage(NspcProject& project,
+                                                                        std::span<const uint8_t> baseSpcImage,
+                                                                        int songIndex,
+                                                                        const NspcBuildOptions& buildOptions) {
     const auto& songs = project.songs();
     if (songIndex < 0 || songIndex >= static_cast<int>(songs.size())) {
         return std::unexpected(std::format("Song index {} is out of range (project has {} songs)", 
@@ -87,7 +85,13 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     }
     const NspcSong& song = songs[static_cast<size_t>(songIndex)];
 
-    std::vector<uint8_t> patchedImage(baseSpcImage.begin(), baseSpcImage.end());
+    AutoPlayRenderJob job{
+        .patchedImage = std::vector<uint8_t>(baseSpcImage.begin(), baseSpcImage.end()),
+        .songIndex = songIndex,
+        .songName = song.songName(),
+        .author = song.author(),
+    };
+    std::vector<uint8_t>& patchedImage = job.patchedImage;
 
     // Keep export compile behavior aligned with playback, but never mutate project content on export.
     NspcBuildOptions options = buildOptions;
@@ -134,6 +138,16 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
         return std::unexpected("Patched SPC image is too small to initialize playback state");
     }
 
+    return job;
+}
+
+/// Runs the engine warmup and song trigger on a private emulator instance.
+/// Only reads `engine`, so several jobs may render concurrently.
+std::expected<std::vector<uint8_t>, std::string> renderAutoPlaySpc(const AutoPlayRenderJob& job,
+                                                                   const NspcEngineConfig& engine,
+                                                                   std::optional<uint8_t> triggerPortOverride) {
+    const std::vector<uint8_t>& patchedImage = job.patchedImage;
+
     // Initialize the emulator with the patched SPC
     emulation::SpcDsp dsp;
     dsp.reset();
@@ -142,7 +156,6 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     }
 
     // Mirror ControlPanel::playSpcImage startup path exactly.
-    const auto& engine = project.engineConfig();
     dsp.setPC(engine.entryPoint);
     dsp.clearSampleBuffer();
     setVoiceVolumesToZero(dsp);
@@ -153,7 +166,7 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     const uint8_t configuredTriggerPort = static_cast<uint8_t>(engine.songTriggerPort & 0x03u);
     const uint8_t triggerPort = triggerPortOverride.value_or(configuredTriggerPort);
     const uint8_t triggerValue =
-        static_cast<uint8_t>((static_cast<uint32_t>(songIndex) + engine.songTriggerOffset) & 0xFFu);
+        static_cast<uint8_t>((static_cast<uint32_t>(job.songIndex) + engine.songTriggerOffset) & 0xFFu);
     dsp.writePort(triggerPort, triggerValue);
 
     // Build output SPC with updated state
@@ -189,7 +202,8 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     output[kSpcYOffset] = dsp.y();
     output[kSpcPsOffset] = dsp.ps();
     output[kSpcSpOffset] = dsp.sp();
-    applySongId666Tags(output, song);
+    writeSpcTextField(output, kSpcSongTitleOffset, kSpcSongTitleSize, job.songName);
+    writeSpcTextField(output, kSpcArtistOffset, kSpcArtistSize, job.author);
 
     // Do not rewrite $F0-$FF from ioState(): ARAM already contains authoritative values.
     // SpcDsp::ioState() is partially synthetic and can clobber valid timer/output state.
@@ -197,4 +211,54 @@ std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
     return output;
 }
 
+}  // namespace
+
+std::expected<std::vector<uint8_t>, std::string> buildAutoPlaySpc(
+    NspcProject& project,
+    std::span<const uint8_t> baseSpcImage,
+    int songIndex,
+    std::optional<uint8_t> triggerPortOverride,
+    NspcBuildOptions buildOptions) {
+    auto job = buildPatchedAutoPlayImage(project, baseSpcImage, songIndex, buildOptions);
+    if (!job.has_value()) {
+        return std::unexpected(job.error());
+    }
+    return renderAutoPlaySpc(*job, project.engineConfig(), triggerPortOverride);
+}
+
+std::vector<std::expected<std::vector<uint8_t>, std::string>> buildAutoPlaySpcBatch(
+    NspcProject& project,
+    std::span<const uint8_t> baseSpcImage,
+    std::span<const int> songIndices,
+    std::optional<uint8_t> triggerPortOverride,
+    NspcBuildOptions buildOptions) {
+    std::vector<std::expected<std::vector<uint8_t>, std::string>> results;
+    results.reserve(songIndices.size());
+
+    // Compilation mutates project layouts, so it stays in request order (matching a loop over
+    // buildAutoPlaySpc). Only the emulator warmups, which dominate the cost, fan out.
+    std::vector<AutoPlayRenderJob> jobs;
+    std::vector<size_t> jobResultIndex;
+    jobs.reserve(songIndices.size());
+    jobResultIndex.reserve(songIndices.size());
+    for (const int songIndex : songIndices) {
+        auto job = buildPatchedAutoPlayImage(project, baseSpcImage, songIndex, buildOptions);
+        if (!job.has_value()) {
+            results.push_back(std::unexpected(job.error()));
+            continue;
+        }
+        jobResultIndex.push_back(results.size());
+        results.push_back(std::vector<uint8_t>{});
+        jobs.push_back(std::move(*job));
+    }
+
+    const NspcEngineConfig& engine = project.engineConfig();
+    common::parallelFor(
+        jobs.size(),
+        [&](size_t i) { results[jobResultIndex[i]] = renderAutoPlaySpc(jobs[i], engine, triggerPortOverride); },
+        buildOptions.maxWorkerThreads);
+
+    return results;
+}
+
 }  // namespace ntrak::nspc
@@ -0,0 +1,313 @@
+#include "ntrak/nspc/NspcUsageIndex.hpp"
+
+#include "ntrak/nspc/NspcProject.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace ntrak::nspc {
+
+namespace {
+
+constexpr uint32_t kKindShift = 24;
+constexpr uint32_t kValueMask = (1u << kKindShift) - 1u;
+
+void sortUses(std::vector<NspcUsage>& uses) {
+    std::sort(uses.begin(), uses.end(), [](const NspcUsage& lhs, const NspcUsage& rhs) {
+        return std::tie(lhs.songId, lhs.event.owner, lhs.event.ownerId, lhs.event.eventIndex) <
+               std::tie(rhs.songId, rhs.event.owner, rhs.event.ownerId, rhs.event.eventIndex);
+    });
+}
+
+}  // namespace
+
+NspcUsageIndex::Key NspcUsageIndex::keyFor(Kind kind, int value) {
+    return (static_cast<uint32_t>(kind) << kKindShift) | (static_cast<uint32_t>(value) & kValueMask);
+}
+
+std::vector<NspcUsageIndex::OwnerUses>& NspcUsageIndex::ownersOf(SongUses& song, NspcEventOwner owner) {
+    return owner == NspcEventOwner::Track ? song.tracks : song.subroutines;
+}
+
+const std::vector<NspcUsageIndex::OwnerUses>& NspcUsageIndex::ownersOf(const SongUses& song, NspcEventOwner owner) {
+    return owner == NspcEventOwner::Track ? song.tracks : song.subroutines;
+}
+
+void NspcUsageIndex::clear() {
+    songs_.clear();
+    postings_.clear();
+    totals_.clear();
+    pending_.clear();
+}
+
+void NspcUsageIndex::rebuild(const NspcProject& project) {
+    clear();
+    for (const auto& song : project.songs()) {
+        rebuildSong(song);
+    }
+}
+
+void NspcUsageIndex::rebuildSong(const NspcSong& song) {
+    const int songId = song.songId();
+    removeSong(songId);
+    if (const auto& body = song.deferredBody(); body != nullptr && !body->isDecoded()) {
+        pending_.emplace(songId, body);
+        return;
+    }
+    indexSong(songId, song.tracks(), song.subroutines());
+}
+
+void NspcUsageIndex::indexSong(int songId, const std::vector<NspcTrack>& tracks,
+                               const std::vector<NspcSubroutine>& subroutines) const {
+    SongUses& uses = songs_[songId];
+    uses.tracks.resize(tracks.size());
+    uses.subroutines.resize(subroutines.size());
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        scanOwner(songId, uses, {.owner = NspcEventOwner::Track, .index = i}, tracks[i].id, tracks[i].events);
+    }
+    for (size_t i = 0; i < subroutines.size(); ++i) {
+        scanOwner(songId, uses, {.owner = NspcEventOwner::Subroutine, .index = i}, subroutines[i].id,
+                  subroutines[i].events);
+    }
+}
+
+void NspcUsageIndex::indexPending(std::optional<int> songId) const {
+    if (songId.has_value()) {
+        const auto it = pending_.find(*songId);
+        if (it == pending_.end()) {
+            return;
+        }
+        const NspcSongBody& body = it->second->get();
+        pending_.erase(it);
+        indexSong(*songId, *body.tracks, *body.subroutines);
+        return;
+    }
+    for (const auto& [id, deferred] : std::exchange(pending_, {})) {
+        const NspcSongBody& body = deferred->get();
+        indexSong(id, *body.tracks, *body.subroutines);
+    }
+}
+
+void NspcUsageIndex::removeSong(int songId) {
+    pending_.erase(songId);
+    const auto it = songs_.find(songId);
+    if (it == songs_.end()) {
+        return;
+    }
+    for (size_t i = 0; i < it->second.tracks.size(); ++i) {
+        dropOwner(songId, it->second, {.owner = NspcEventOwner::Track, .index = i});
+    }
+    for (size_t i = 0; i < it->second.subroutines.size(); ++i) {
+        dropOwner(songId, it->second, {.owner = NspcEventOwner::Subroutine, .index = i});
+    }
+    songs_.erase(it);
+}
+
+void NspcUsageIndex::updateSong(const NspcSong& song, const NspcSongChanges& changes) {
+    const int songId = song.songId();
+    const auto it = songs_.find(songId);
+    if (changes.all || it == songs_.end()) {  // includes songs still pending
+        rebuildSong(song);
+        return;
+    }
+    SongUses& uses = it->second;
+    const auto& tracks = song.tracks();
+    const auto& subroutines = song.subroutines();
+
+    const size_t keptTracks = std::min(uses.tracks.size(), tracks.size());
+    const size_t keptSubroutines = std::min(uses.subroutines.size(), subroutines.size());
+    for (const NspcEventOwnerSlot slot : changes.owners) {
+        const bool isTrack = slot.owner == NspcEventOwner::Track;
+        if (slot.index >= (isTrack ? keptTracks : keptSubroutines)) {
+            continue;  // handled with the added and dropped slots below
+        }
+        dropOwner(songId, uses, slot);
+        if (isTrack) {
+            scanOwner(songId, uses, slot, tracks[slot.index].id, tracks[slot.index].events);
+        } else {
+            scanOwner(songId, uses, slot, subroutines[slot.index].id, subroutines[slot.index].events);
+        }
+    }
+
+    auto resize = [&](NspcEventOwner owner, const auto& lists) {
+        auto& owners = ownersOf(uses, owner);
+        for (size_t i = lists.size(); i < owners.size(); ++i) {
+            dropOwner(songId, uses, {.owner = owner, .index = i});
+        }
+        const size_t previous = owners.size();
+        owners.resize(lists.size());
+        for (size_t i = previous; i < lists.size(); ++i) {
+            scanOwner(songId, uses, {.owner = owner, .index = i}, lists[i].id, lists[i].events);
+        }
+    };
+    resize(NspcEventOwner::Track, tracks);
+    resize(NspcEventOwner::Subroutine, subroutines);
+}
+
+void NspcUsageIndex::scanOwner(int songId, SongUses& song, NspcEventOwnerSlot slot, int ownerId,
+                               const std::vector<NspcEventEntry>& events) const {
+    OwnerUses& record = ownersOf(song, slot.owner)[slot.index];
+    record.ownerId = ownerId;
+    record.uses.clear();
+
+    size_t index = 0;
+    auto add = [&](Kind kind, int value) {
+        record.uses.push_back(
+            Use{.key = keyFor(kind, value), .eventIndex = static_cast<uint32_t>(index), .eventId = events[index].id});
+    };
+    int percussionBaseId = 0;
+    for (; index < events.size(); ++index) {
+        const NspcEvent& event = events[index].event;
+        if (const auto* vcmd = std::get_if<Vcmd>(&event)) {
+            if (std::holds_alternative<std::monostate>(vcmd->vcmd)) {
+                continue;
+            }
+            add(Kind::Vcmd, vcmdCommandId(*vcmd));
+            std::visit(overloaded{
+                           [&](const VcmdInst& v) { add(Kind::Instrument, v.instrumentIndex & 0x7F); },
+                           [&](const VcmdPercussionBaseInstrument& v) { percussionBaseId = v.index & 0x7F; },
+                           [&](const VcmdSubroutineCall& v) {
+                               if (v.subroutineId >= 0) {
+                                   add(Kind::Subroutine, v.subroutineId);
+                               }
+                           },
+                           [](const auto&) {},
+                       },
+                       vcmd->vcmd);
+        } else if (const auto* percussion = std::get_if<Percussion>(&event)) {
+            add(Kind::Instrument, (percussionBaseId + percussion->index) & 0x7F);
+        } else if (const auto* call = std::get_if<Subroutine>(&event); call != nullptr && call->id >= 0) {
+            add(Kind::Subroutine, call->id);
+        }
+    }
+    std::stable_sort(record.uses.begin(), record.uses.end(),
+                     [](const Use& lhs, const Use& rhs) { return lhs.key < rhs.key; });
+
+    for (auto run = record.uses.begin(); run != record.uses.end();) {
+        const Key key = run->key;
+        const auto runEnd = std::find_if(run, record.uses.end(), [key](const Use& use) { return use.key != key; });
+        const auto count = static_cast<uint32_t>(runEnd - run);
+        postings_[key].push_back(
+            Posting{.songId = songId, .owner = slot.owner, .slot = static_cast<uint32_t>(slot.index), .count = count});
+        song.counts[key] += count;
+        totals_[key] += count;
+        run = runEnd;
+    }
+}
+
+void NspcUsageIndex::dropOwner(int songId, SongUses& song, NspcEventOwnerSlot slot) const {
+    OwnerUses& record = ownersOf(song, slot.owner)[slot.index];
+    for (auto run = record.uses.begin(); run != record.uses.end();) {
+        const Key key = run->key;
+        const auto runEnd = std::find_if(run, record.uses.end(), [key](const Use& use) { return use.key != key; });
+        const auto count = static_cast<uint32_t>(runEnd - run);
+        run = runEnd;
+
+        auto& postings = postings_[key];
+        std::erase_if(postings, [&](const Posting& posting) {
+            return posting.songId == songId && posting.owner == slot.owner && posting.slot == slot.index;
+        });
+        if (postings.empty()) {
+            postings_.erase(key);
+        }
+        if ((song.counts[key] -= count) == 0) {
+            song.counts.erase(key);
+        }
+        if ((totals_[key] -= count) == 0) {
+            totals_.erase(key);
+        }
+    }
+    record.uses.clear();
+    record.ownerId = -1;
+}
+
+void NspcUsageIndex::appendUses(Key key, std::optional<int> songId, std::vector<NspcUsage>& out) const {
+    const auto postings = postings_.find(key);
+    if (postings == postings_.end()) {
+        return;
+    }
+    for (const Posting& posting : postings->second) {
+        if (songId.has_value() && posting.songId != *songId) {
+            continue;
+        }
+        const OwnerUses& record = ownersOf(songs_.at(posting.songId), posting.owner)[posting.slot];
+        const auto first = std::lower_bound(record.uses.begin(), record.uses.end(), key,
+                                            [](const Use& use, Key value) { return use.key < value; });
+        for (auto use = first; use != first + posting.count; ++use) {
+            out.push_back(NspcUsage{
+                .songId = posting.songId,
+                .event = NspcEventRef{.owner = posting.owner,
+                                      .ownerId = record.ownerId,
+                                      .eventIndex = use->eventIndex,
+                                      .eventId = use->eventId},
+            });
+        }
+    }
+}
+
+std::vector<NspcUsage> NspcUsageIndex::uses(Kind kind, int value, std::optional<int> songId) const {
+    indexPending(songId);
+    std::vector<NspcUsage> out;
+    appendUses(keyFor(kind, value), songId, out);
+    sortUses(out);
+    return out;
+}
+
+size_t NspcUsageIndex::useCount(Kind kind, int value, std::optional<int> songId) const {
+    indexPending(songId);
+    const Key key = keyFor(kind, value);
+    if (!songId.has_value()) {
+        const auto it = totals_.find(key);
+        return it != totals_.end() ? it->second : 0;
+    }
+    const auto song = songs_.find(*songId);
+    if (song == songs_.end()) {
+        return 0;
+    }
+    const auto it = song->second.counts.find(key);
+    return it != song->second.counts.end() ? it->second : 0;
+}
+
+std::vector<int> NspcUsageIndex::usedValues(Kind kind, int songId) const {
+    indexPending(songId);
+    std::vector<int> values;
+    const auto song = songs_.find(songId);
+    if (song == songs_.end()) {
+        return values;
+    }
+    const auto& counts = song->second.counts;
+    for (auto it = counts.lower_bound(keyFor(kind, 0)); it != counts.end(); ++it) {
+        if ((it->first >> kKindShift) != static_cast<uint32_t>(kind)) {
+            break;
+        }
+        values.push_back(static_cast<int>(it->first & kValueMask));
+    }
+    return values;
+}
+
+std::vector<NspcUsage> NspcUsageIndex::sampleUses(const NspcProject& project, int sampleId) const {
+    indexPending(std::nullopt);
+    std::vector<NspcUsage> out;
+    for (const auto& instrument : project.instruments()) {
+        if (instrument.sampleIndex == sampleId) {
+            appendUses(keyFor(Kind::Instrument, instrument.id), std::nullopt, out);
+        }
+    }
+    sortUses(out);
+    return out;
+}
+
+size_t NspcUsageIndex::sampleUseCount(const NspcProject& project, int sampleId) const {
+    size_t count = 0;
+    for (const auto& instrument : project.instruments()) {
+        if (instrument.sampleIndex == sampleId) {
+            count += useCount(Kind::Instrument, instrument.id);
+        }
+    }
+    return count;
+}
+
+}  // namespace ntrak::nspc
@@ -134,6 +134,7 @@ void printUsage(std::ostream& out, std::string_view programName) {
     out << "                  Defaults: project mode = baseline+flattened+optimized; spc mode = baseline+flat_optimized\n";
     out << "  --emit-spc      Write a patched SPC for each variant with playback state reinitialized\n";
     out << "  --help, -h      Show this help\n";
+    out << "\nEach variant directory also receives telemetry.json (build stage timings, sizes, optimizer stats).\n";
 }
 
 std::expected<std::vector<uint8_t>, std::string> readBinaryFile(const std::filesystem::path& path) {
@@ -1155,8 +1156,9 @@ std::expected<void, std::string> dumpVariant(const VariantContext& context, int
         return std::unexpected(ownersResult.error());
     }
 
+    nspc::NspcBuildTelemetry telemetry = context.compileOutput.upload.telemetry;
     if (options.emitSpc) {
-        const auto patchedSpc = nspc::applyUploadToSpcImage(context.compileOutput.upload, baseSpcData);
+        const auto patchedSpc = nspc::applyUploadToSpcImage(context.compileOutput.upload, baseSpcData, &telemetry);
         if (!patchedSpc.has_value()) {
             return std::unexpected(std::format("Failed to build variant SPC '{}': {}", variantName(context.variant),
                                                patchedSpc.error()));
@@ -1186,6 +1188,11 @@ std::expected<void, std::string> dumpVariant(const VariantContext& context, int
         }
     }
 
+    auto telemetryResult = writeTextFile(variantDir / "telemetry.json", nspc::buildTelemetryToJson(telemetry) + "\n");
+    if (!telemetryResult.has_value()) {
+        return std::unexpected(telemetryResult.error());
+    }
+
     return {};
 }
 
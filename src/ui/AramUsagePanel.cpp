@@ -3,52 +3,22 @@
 #include <imgui.h>
 
 #include <algorithm>
-#include <array>
 #include <cstdint>
 #include <vector>
 
 namespace ntrak::ui {
 namespace {
 
-struct AramBarSegment {
-    uint32_t from = 0;  // inclusive
-    uint32_t to = 0;    // exclusive
-    nspc::NspcAramRegionKind kind = nspc::NspcAramRegionKind::Free;
-};
-
-const AramBarSegment* findSegmentForAddress(const std::vector<AramBarSegment>& segments, uint32_t address) {
-    for (const auto& segment : segments) {
-        if (address >= segment.from && address < segment.to) {
-            return &segment;
-        }
+const nspc::NspcAramSegment* findSegmentForAddress(const std::vector<nspc::NspcAramSegment>& segments,
+                                                   uint32_t address) {
+    const auto it = std::upper_bound(segments.begin(), segments.end(), address,
+                                     [](uint32_t value, const nspc::NspcAramSegment& segment) {
+                                         return value < segment.to;
+                                     });
+    if (it == segments.end() || address < it->from) {
+        return nullptr;
     }
-    return nullptr;
-}
-
-int regionPriority(nspc::NspcAramRegionKind kind) {
-    switch (kind) {
-    case nspc::NspcAramRegionKind::Reserved:
-        return 0;
-    case nspc::NspcAramRegionKind::SongIndexTable:
-        return 1;
-    case nspc::NspcAramRegionKind::InstrumentTable:
-        return 2;
-    case nspc::NspcAramRegionKind::SampleDirectory:
-        return 3;
-    case nspc::NspcAramRegionKind::SampleData:
-        return 4;
-    case nspc::NspcAramRegionKind::SequenceData:
-        return 5;
-    case nspc::NspcAramRegionKind::PatternTable:
-        return 6;
-    case nspc::NspcAramRegionKind::TrackData:
-        return 7;
-    case nspc::NspcAramRegionKind::SubroutineData:
-        return 8;
-    case nspc::NspcAramRegionKind::Free:
-        return 9;
-    }
-    return 9;
+    return &*it;
 }
 
 ImU32 regionColor(nspc::NspcAramRegionKind kind) {
@@ -103,65 +73,6 @@ const char* regionTypeLabel(nspc::NspcAramRegionKind kind) {
     return "Other";
 }
 
-std::vector<AramBarSegment> buildAddressSegments(const nspc::NspcAramUsage& usage) {
-    constexpr uint32_t kMaxBytes = nspc::NspcAramUsage::kTotalAramBytes;
-    const uint32_t totalBytes = std::min<uint32_t>(usage.totalBytes, kMaxBytes);
-    if (totalBytes == 0) {
-        return {};
-    }
-
-    std::array<nspc::NspcAramRegionKind, kMaxBytes> ownership{};
-    ownership.fill(nspc::NspcAramRegionKind::Free);
-
-    std::vector<const nspc::NspcAramRegion*> orderedRegions;
-    orderedRegions.reserve(usage.regions.size());
-    for (const auto& region : usage.regions) {
-        orderedRegions.push_back(&region);
-    }
-
-    std::stable_sort(orderedRegions.begin(), orderedRegions.end(), [](const nspc::NspcAramRegion* lhs,
-                                                                      const nspc::NspcAramRegion* rhs) {
-        return regionPriority(lhs->kind) < regionPriority(rhs->kind);
-    });
-
-    for (const auto* region : orderedRegions) {
-        const uint32_t from = std::min<uint32_t>(region->from, totalBytes);
-        const uint32_t to = std::min<uint32_t>(region->to, totalBytes);
-        for (uint32_t addr = from; addr < to; ++addr) {
-            if (ownership[addr] == nspc::NspcAramRegionKind::Free) {
-                ownership[addr] = region->kind;
-            }
-        }
-    }
-
-    std::vector<AramBarSegment> segments;
-    segments.reserve(64);
-
-    uint32_t segmentStart = 0;
-    nspc::NspcAramRegionKind kind = ownership[0];
-
-    for (uint32_t addr = 1; addr < totalBytes; ++addr) {
-        if (ownership[addr] == kind) {
-            continue;
-        }
-        segments.push_back(AramBarSegment{
-            .from = segmentStart,
-            .to = addr,
-            .kind = kind,
-        });
-        segmentStart = addr;
-        kind = ownership[addr];
-    }
-
-    segments.push_back(AramBarSegment{
-        .from = segmentStart,
-        .to = totalBytes,
-        .kind = kind,
-    });
-
-    return segments;
-}
-
 void drawUsageBar(const nspc::NspcAramUsage& usage) {
     constexpr uint32_t kMaxBytes = nspc::NspcAramUsage::kTotalAramBytes;
     const uint32_t totalBytes = std::min<uint32_t>(usage.totalBytes, kMaxBytes);
@@ -173,7 +84,7 @@ void drawUsageBar(const nspc::NspcAramUsage& usage) {
         return;
     }
 
-    const auto segments = buildAddressSegments(usage);
+    const auto& segments = usage.segments;
 
     const ImVec2 p0 = ImGui::GetCursorScreenPos();
     const ImVec2 p1 = ImVec2(p0.x + width, p0.y + height);
@@ -252,7 +163,7 @@ void AramUsagePanel::draw() {
     }
 
     auto& project = *appState_.project;
-    project.refreshAramUsage();
+    project.updateAramUsage();
     const auto& usage = project.aramUsage();
 
     const uint32_t songDataBytes = usage.sequenceBytes + usage.patternTableBytes + usage.trackBytes +
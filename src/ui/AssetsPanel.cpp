@@ -19,6 +19,7 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 #include <ntrak/app/App.hpp>
 
@@ -216,7 +217,7 @@ void AssetsPanel::syncSourceSpcRange(uint16_t aramAddress, size_t size) {
         return;
     }
 
-    auto aram = appState_.project->aram();
+    const auto aram = std::as_const(*appState_.project).aram();
     const auto src = aram.bytes(aramAddress, size);
     auto dstIt = appState_.sourceSpcData.begin() +
                  static_cast<std::ptrdiff_t>(kSpcHeaderSize + static_cast<size_t>(aramAddress));
@@ -228,7 +229,7 @@ void AssetsPanel::syncProjectAramToPreviewPlayer() {
         return;
     }
 
-    const auto srcAram = appState_.project->aram();
+    const auto srcAram = std::as_const(*appState_.project).aram();
     auto dstAram = appState_.spcPlayer->spcDsp().aram();
     const auto srcAll = srcAram.all();
     auto dstAll = dstAram.all();
@@ -1124,16 +1125,28 @@ void AssetsPanel::drawInstrumentsTab() {
 
     ImGui::SameLine();
     ImGui::BeginDisabled(selectedInstrumentId_ < 0 || selectedInstrumentLocked);
+    const size_t selectedInstrumentUses =
+        selectedInstrumentId_ >= 0
+            ? appState_.usageIndex.useCount(nspc::NspcUsageIndex::Kind::Instrument, selectedInstrumentId_)
+            : 0;
     if (ImGui::Button("Remove")) {
         if (const auto index = findInstrumentIndexById(selectedInstrumentId_); index.has_value()) {
             clearInstrumentEntryInAram(selectedInstrumentId_);
             instruments.erase(instruments.begin() + static_cast<std::ptrdiff_t>(*index));
             project.refreshAramUsage();
-            setStatus(std::format("Removed instrument {:02X}", selectedInstrumentId_));
+            if (selectedInstrumentUses > 0) {
+                setStatus(std::format("Removed instrument {:02X} (still used by {} events)", selectedInstrumentId_,
+                                      selectedInstrumentUses));
+            } else {
+                setStatus(std::format("Removed instrument {:02X}", selectedInstrumentId_));
+            }
             selectedInstrumentId_ = -1;
             appState_.selectedInstrumentId = -1;
         }
     }
+    if (selectedInstrumentUses > 0 && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+        ImGui::SetTooltip("Used by %zu events", selectedInstrumentUses);
+    }
     ImGui::EndDisabled();
 
     ImGui::SameLine();
@@ -1303,6 +1316,8 @@ void AssetsPanel::drawSamplesTab() {
 
     ImGui::SameLine();
     ImGui::BeginDisabled(selectedSampleId_ < 0 || selectedSampleLocked);
+    const size_t selectedSampleUses =
+        selectedSampleId_ >= 0 ? appState_.usageIndex.sampleUseCount(project, selectedSampleId_) : 0;
     if (ImGui::Button("Remove")) {
         if (const auto index = findSampleIndexById(selectedSampleId_); index.has_value()) {
             const auto removed = samples[*index];
@@ -1318,10 +1333,18 @@ void AssetsPanel::drawSamplesTab() {
 
             samples.erase(samples.begin() + static_cast<std::ptrdiff_t>(*index));
             project.refreshAramUsage();
-            setStatus(std::format("Removed sample {:02X}", selectedSampleId_));
+            if (selectedSampleUses > 0) {
+                setStatus(std::format("Removed sample {:02X} (instruments playing it are used by {} events)",
+                                      selectedSampleId_, selectedSampleUses));
+            } else {
+                setStatus(std::format("Removed sample {:02X}", selectedSampleId_));
+            }
             selectedSampleId_ = -1;
         }
     }
+    if (selectedSampleUses > 0 && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+        ImGui::SetTooltip("Instruments playing this sample are used by %zu events", selectedSampleUses);
+    }
     ImGui::EndDisabled();
 
     ImGui::SameLine();
@@ -6,35 +6,13 @@
 
 #include <format>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <utility>
 
 namespace ntrak::ui {
 namespace {
 
-void applyRelaxedOptimizerTuning(nspc::NspcOptimizerOptions& options) {
-    options.maxOptimizeIterations = 64;
-    options.topCandidatesFromSam = 1024;
-    options.maxCandidateBytes = 1536;
-    options.singleIterationCallPenaltyBytes = 16;
-    options.allowSingleIterationCalls = false;
-}
-
-void applyBalancedOptimizerTuning(nspc::NspcOptimizerOptions& options) {
-    options.maxOptimizeIterations = 128;
-    options.topCandidatesFromSam = 2048;
-    options.maxCandidateBytes = 2048;
-    options.singleIterationCallPenaltyBytes = 16;
-    options.allowSingleIterationCalls = true;
-}
-
-void applyAggressiveOptimizerTuning(nspc::NspcOptimizerOptions& options) {
-    options.maxOptimizeIterations = 512;
-    options.topCandidatesFromSam = 16384;
-    options.maxCandidateBytes = 16384;
-    options.singleIterationCallPenaltyBytes = 8;
-    options.allowSingleIterationCalls = true;
-}
-
 std::optional<size_t> selectedSongIndex(const app::AppState& appState) {
     if (!appState.project.has_value()) {
         return std::nullopt;
@@ -56,31 +34,45 @@ void flattenSelectedSong(app::AppState& appState, size_t songIndex) {
     song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
     project.refreshAramUsage();
     appState.commandHistory.clear();
+    appState.usageIndex.rebuildSong(song);
 }
 
-void optimizeSelectedSong(app::AppState& appState, size_t songIndex) {
+nspc::NspcOptimizerStats optimizeSelectedSong(app::AppState& appState, size_t songIndex) {
     auto& project = *appState.project;
     auto& song = project.songs()[songIndex];
-    nspc::optimizeSongSubroutines(song, appState.optimizerOptions);
+    const nspc::NspcOptimizerStats stats = nspc::optimizeSongSubroutines(song, appState.optimizerOptions);
     song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
     project.refreshAramUsage();
     appState.commandHistory.clear();
+    appState.usageIndex.rebuildSong(song);
+    return stats;
 }
 
+// For ARAM refreshes, which rebuild after edits: only Optimize and exports spend the search budget
 [[nodiscard]] nspc::NspcBuildOptions buildOptionsFromAppState(const app::AppState& appState) {
+    nspc::NspcOptimizerOptions optimizerOptions = appState.optimizerOptions;
+    optimizerOptions.searchBudgetMilliseconds = 0;
     return nspc::NspcBuildOptions{
         .optimizeSubroutines = appState.optimizeSubroutinesOnBuild,
-        .optimizerOptions = appState.optimizerOptions,
+        .optimizerOptions = optimizerOptions,
         .applyOptimizedSongToProject = appState.optimizeSubroutinesOnBuild && !appState.flattenSubroutinesOnLoad,
         .includeEngineExtensions = true,
         .compactAramLayout = appState.compactAramLayoutOnBuild,
+        .shareSubroutinesAcrossSongs = appState.shareSubroutinesAcrossSongsOnBuild,
     };
 }
 
 [[nodiscard]] std::pair<std::string, bool> rebuildUserContentForAramStats(app::AppState& appState) {
     auto& project = *appState.project;
-    auto buildResult = nspc::buildUserContentUpload(project, buildOptionsFromAppState(appState));
+    const auto buildOptions = buildOptionsFromAppState(appState);
+    auto buildResult = nspc::buildUserContentUpload(project, buildOptions);
     if (buildResult.has_value()) {
+        if (buildOptions.applyOptimizedSongToProject) {
+            // The build wrote optimized songs back; the undo records describe the songs before that.
+            appState.commandHistory.clear();
+            appState.usageIndex.rebuild(project);
+        }
+        appState.lastBuildTelemetry = buildResult->telemetry;
         return {std::format("Rebuilt user content ({} upload chunk(s))", buildResult->chunks.size()), false};
     }
 
@@ -92,6 +84,43 @@ void optimizeSelectedSong(app::AppState& appState, size_t songIndex) {
     return {std::format("Build failed while refreshing ARAM stats: {}", buildResult.error()), true};
 }
 
+void drawBuildTelemetry(const nspc::NspcBuildTelemetry& telemetry) {
+    ImGui::Text("Total: %.2f ms", telemetry.totalMilliseconds);
+    if (ImGui::BeginTable("##build_stage_times", 2, ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg)) {
+        for (size_t i = 0; i < nspc::kNspcBuildStageCount; ++i) {
+            const auto stage = static_cast<nspc::NspcBuildStage>(i);
+            const std::string_view name = nspc::buildStageName(stage);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(name.data(), name.data() + name.size());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.2f ms", telemetry.stageTime(stage));
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Bytes: %u total", telemetry.emittedBytes());
+    ImGui::TextDisabled("Index %u | Sequence %u | Patterns %u | Tracks %u | Subroutines %u", telemetry.songIndexBytes,
+                        telemetry.sequenceBytes, telemetry.patternTableBytes, telemetry.trackBytes,
+                        telemetry.subroutineBytes);
+    ImGui::TextDisabled("Instruments %u | Sample dir %u | BRR %u | Ext patches %u", telemetry.instrumentBytes,
+                        telemetry.sampleDirectoryBytes, telemetry.sampleDataBytes, telemetry.extensionPatchBytes);
+    ImGui::Text("Optimizer: %u song(s), %u pass(es), %u subroutine(s), %lld bytes saved", telemetry.songsOptimized,
+                telemetry.optimizerIterations, telemetry.subroutinesCreated,
+                static_cast<long long>(telemetry.optimizerBytesSaved));
+    if (telemetry.sharedSubroutinesReused > 0) {
+        ImGui::TextDisabled("Shared: %u subroutine copy(ies) reused across songs, %u bytes saved",
+                            telemetry.sharedSubroutinesReused, telemetry.sharedSubroutineBytesSaved);
+    }
+    ImGui::Text("Free ARAM: %u bytes in %u range(s), largest %u (fragmentation %.1f%%)", telemetry.freeBytes,
+                telemetry.freeRangeCount, telemetry.largestFreeRangeBytes, telemetry.fragmentation() * 100.0);
+    ImGui::Text("Cache: %u hit(s), %u miss(es)", telemetry.cacheHits, telemetry.cacheMisses);
+
+    if (ImGui::Button("Copy as JSON")) {
+        ImGui::SetClipboardText(nspc::buildTelemetryToJson(telemetry).c_str());
+    }
+}
+
 }  // namespace
 
 BuildPanel::BuildPanel(app::AppState& appState) : appState_(appState) {}
@@ -107,6 +136,20 @@ void BuildPanel::draw() {
         ImGui::SetTooltip("When disabled, song build/upload skips subroutine extraction.");
     }
 
+    ImGui::BeginDisabled(!appState_.optimizeSubroutinesOnBuild);
+    ImGui::Checkbox("Share subroutines across songs", &appState_.shareSubroutinesAcrossSongsOnBuild);
+    ImGui::EndDisabled();
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+        ImGui::SetTooltip("Optimize all user songs together so phrases they share are uploaded once.\n"
+                          "Applies to full builds; single-song uploads keep their own copies.");
+    }
+
+    ImGui::Checkbox("Save optimizer cache with project", &appState_.saveOptimizerCacheWithProject);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Store optimized subroutine layouts in the .ntrakproj so unchanged songs skip the\n"
+                          "optimizer on the next session's first build.");
+    }
+
     ImGui::Checkbox("Compact ARAM layout on build", &appState_.compactAramLayoutOnBuild);
     if (ImGui::IsItemHovered()) {
         ImGui::SetTooltip("Pack relocatable song data into tighter ARAM ranges to reduce holes and NSPC upload segments.");
@@ -119,16 +162,17 @@ void BuildPanel::draw() {
 
     if (ImGui::CollapsingHeader("Optimizer Tuning")) {
         ImGui::TextDisabled("Used by both manual Optimize and optional optimize-on-build.");
-        if (ImGui::Button("Relaxed")) {
-            applyRelaxedOptimizerTuning(appState_.optimizerOptions);
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("Balanced")) {
-            applyBalancedOptimizerTuning(appState_.optimizerOptions);
+        for (size_t i = 0; i < nspc::kNspcOptimizerPresetCount; ++i) {
+            const auto preset = static_cast<nspc::NspcOptimizerPreset>(i);
+            if (i > 0) {
+                ImGui::SameLine();
+            }
+            if (ImGui::Button(nspc::optimizerPresetName(preset).data())) {
+                nspc::applyOptimizerPreset(appState_.optimizerOptions, preset);
+            }
         }
-        ImGui::SameLine();
-        if (ImGui::Button("Aggressive")) {
-            applyAggressiveOptimizerTuning(appState_.optimizerOptions);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Aggressive tuning plus a 10 second multi-core search for extra ARAM savings.");
         }
 
         ImGui::Checkbox("Allow single-run calls (count=1)", &appState_.optimizerOptions.allowSingleIterationCalls);
@@ -140,6 +184,21 @@ void BuildPanel::draw() {
         }
         ImGui::SliderInt("Single-run penalty", &appState_.optimizerOptions.singleIterationCallPenaltyBytes, 0, 32);
         ImGui::TextDisabled("Higher penalty reduces one-shot call extraction and runtime dispatch overhead.");
+        ImGui::Checkbox("Incremental passes", &appState_.optimizerOptions.incremental);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Apply several subroutines per candidate search instead of rebuilding after each one.");
+        }
+        ImGui::BeginDisabled(!appState_.optimizerOptions.incremental);
+        ImGui::SliderInt("Incremental tolerance %", &appState_.optimizerOptions.incrementalTolerancePercent, 0, 25);
+        ImGui::EndDisabled();
+        float searchSeconds = static_cast<float>(appState_.optimizerOptions.searchBudgetMilliseconds) / 1000.0f;
+        if (ImGui::SliderFloat("Search budget (s)", &searchSeconds, 0.0f, 60.0f, "%.1f")) {
+            appState_.optimizerOptions.searchBudgetMilliseconds = static_cast<int>(searchSeconds * 1000.0f);
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("0 disables the search. Otherwise Optimize and exports keep the best layout found\n"
+                              "within the budget; Play and ARAM refreshes always use the plain passes.");
+        }
     }
 
     if (appState_.project.has_value()) {
@@ -162,8 +221,13 @@ void BuildPanel::draw() {
         }
         ImGui::SameLine();
         if (ImGui::Button("Optimize") && songIndex.has_value()) {
-            optimizeSelectedSong(appState_, *songIndex);
+            const nspc::NspcOptimizerStats stats = optimizeSelectedSong(appState_, *songIndex);
             auto [status, isError] = rebuildUserContentForAramStats(appState_);
+            if (stats.greedyBytesAfter != 0) {
+                status = std::format("Search saved {} byte(s) over greedy ({} depth(s)). {}",
+                                     static_cast<int64_t>(stats.greedyBytesAfter) - static_cast<int64_t>(stats.bytesAfter),
+                                     stats.searchDepth, status);
+            }
             actionStatus_ = std::move(status);
             actionStatusIsError_ = isError;
         }
@@ -188,6 +252,10 @@ void BuildPanel::draw() {
             }
         }
 
+        if (appState_.lastBuildTelemetry.has_value() && ImGui::CollapsingHeader("Last Build Telemetry")) {
+            drawBuildTelemetry(*appState_.lastBuildTelemetry);
+        }
+
         const auto& extensions = project.engineConfig().extensions;
         if (!extensions.empty()) {
             ImGui::Separator();
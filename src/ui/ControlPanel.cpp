@@ -855,6 +855,8 @@ std::expected<void, std::string> injectPlaybackSetupIntoPattern(nspc::NspcSong&
         prependSetupToTrack(*track, seedDuration, commands, nextId);
     }
 
+    // The playback copy no longer matches the editor's song it was copied from
+    song.touchAll();
     return {};
 }
 
@@ -1076,12 +1078,16 @@ bool hasAnyUserProvidedContent(const nspc::NspcProject& project) {
 }
 
 [[nodiscard]] nspc::NspcBuildOptions buildOptionsFromAppState(const app::AppState& appState) {
+    // Play and its preflight build on the UI thread, so they skip the optimizer's search budget
+    nspc::NspcOptimizerOptions optimizerOptions = appState.optimizerOptions;
+    optimizerOptions.searchBudgetMilliseconds = 0;
     return nspc::NspcBuildOptions{
         .optimizeSubroutines = appState.optimizeSubroutinesOnBuild,
-        .optimizerOptions = appState.optimizerOptions,
+        .optimizerOptions = optimizerOptions,
         .applyOptimizedSongToProject =
             appState.optimizeSubroutinesOnBuild && !appState.flattenSubroutinesOnLoad,
         .compactAramLayout = appState.compactAramLayoutOnBuild,
+        .shareSubroutinesAcrossSongs = appState.shareSubroutinesAcrossSongsOnBuild,
     };
 }
 
@@ -1105,6 +1111,7 @@ struct PatchedSongBuildResult {
     std::vector<std::string> warnings;
     size_t patchCount = 0;
     size_t totalPatchBytes = 0;
+    nspc::NspcBuildTelemetry telemetry;
 };
 
 std::optional<int> selectedSongIndexForPlayback(const app::AppState& appState) {
@@ -1151,9 +1158,11 @@ std::optional<PatchedSongBuildResult> buildPatchedSongForPlayback(nspc::NspcProj
     std::vector<std::string> combinedWarnings;
     size_t patchCount = 0;
     size_t totalPatchBytes = 0;
+    nspc::NspcBuildTelemetry telemetry;
 
     const auto applyUpload = [&](const nspc::NspcUploadList& upload, std::string_view stage) -> bool {
-        auto patched = nspc::applyUploadToSpcImage(upload, patchedImage);
+        telemetry.merge(upload.telemetry);
+        auto patched = nspc::applyUploadToSpcImage(upload, patchedImage, &telemetry);
         if (!patched.has_value()) {
             statusOut = std::format("{} patch failed: {}", stage, patched.error());
             return false;
@@ -1205,6 +1214,7 @@ std::optional<PatchedSongBuildResult> buildPatchedSongForPlayback(nspc::NspcProj
         .warnings = std::move(combinedWarnings),
         .patchCount = patchCount,
         .totalPatchBytes = totalPatchBytes,
+        .telemetry = telemetry,
     };
 }
 
@@ -1306,11 +1316,18 @@ bool ControlPanel::doPlaySong() {
 
     auto patchedBuild =
         buildPatchedSongForPlayback(project, songIndex, buildOptions, appState_.sourceSpcData, status_);
+    if (buildOptions.applyOptimizedSongToProject) {
+        // The song build wrote the optimized song back, even if patching the image failed afterwards. The undo
+        // records describe the song before that rewrite.
+        appState_.commandHistory.clear();
+        appState_.usageIndex.rebuildSong(project.songs()[static_cast<size_t>(songIndex)]);
+    }
     if (!patchedBuild.has_value()) {
         return false;
     }
 
     warnings_ = std::move(patchedBuild->warnings);
+    appState_.lastBuildTelemetry = patchedBuild->telemetry;
     return playSpcImage(
         patchedBuild->spcImage, project.engineConfig().entryPoint, project.engineConfig(), songIndex,
         std::format("Playing song {:02X} | {} patches | {} bytes", songIndex, patchedBuild->patchCount,
@@ -1344,6 +1361,8 @@ bool ControlPanel::doPlayFromPattern() {
             status_ = std::format("Build failed: {}", syncResult.error());
             return false;
         }
+        appState_.commandHistory.clear();
+        appState_.usageIndex.rebuildSong(project.songs()[static_cast<size_t>(songIndex)]);
     }
 
     const int startRow = *playFromSequenceRow;
@@ -1368,6 +1387,7 @@ bool ControlPanel::doPlayFromPattern() {
         return false;
     }
     warnings_ = std::move(patchedBuild->warnings);
+    appState_.lastBuildTelemetry = patchedBuild->telemetry;
 
     const auto patternId =
         patternIdFromSequenceRow(project.songs()[static_cast<size_t>(songIndex)], startRow);
@@ -142,13 +142,19 @@ std::optional<int> PatternEditorPanel::resolveSelectedPatternId(const nspc::Nspc
     return std::nullopt;
 }
 
-void PatternEditorPanel::rebuildPatternRows(const nspc::NspcSong& song, int patternId) {
+void PatternEditorPanel::rebuildPatternRows(const nspc::NspcSong& song, int patternId, bool songMayHaveChanged) {
+    if (songMayHaveChanged) {
+        flatPatternCache_.invalidate();
+    }
+    flatPattern_ = flatPatternCache_.flatten(song, patternId, flattenOptions_, song.patternContentRevision(patternId));
+    if (rowsGeneration_ == flatPatternCache_.generation()) {
+        return;
+    }
+    rowsGeneration_ = flatPatternCache_.generation();
+
     rows_.clear();
-    flatPattern_.reset();
     rowsTruncated_ = false;
-
-    flatPattern_ = nspc::flattenPatternById(song, patternId, flattenOptions_);
-    if (!flatPattern_.has_value()) {
+    if (flatPattern_ == nullptr) {
         return;
     }
 
@@ -497,7 +503,7 @@ void PatternEditorPanel::draw() {
     lastViewedSongIndex_ = appState_.selectedSongIndex;
     lastViewedPatternId_ = *patternId;
 
-    rebuildPatternRows(song, *patternId);
+    rebuildPatternRows(song, *patternId, false);
     if (patternViewChanged && !rows_.empty()) {
         int firstNoteRow = 0;
         bool found = false;
@@ -579,7 +585,7 @@ void PatternEditorPanel::draw() {
         ImGui::TextDisabled("(events may occur on hidden ticks)");
     }
 
-    if (flatPattern_.has_value()) {
+    if (flatPattern_ != nullptr) {
         ImGui::SameLine(0.0f, 16.0f);
         ImGui::TextDisabled("Ticks: %u | Rows: %zu", flatPattern_->totalTicks, visible_row_count());
         ImGui::SameLine(0.0f, 10.0f);
@@ -549,8 +549,8 @@ std::array<int, 256> countUsedInstruments(const nspc::NspcSong& song, std::optio
     return counts;
 }
 
-bool flatPatternHasAnyTimedEvents(const std::optional<nspc::NspcFlatPattern>& flatPattern) {
-    if (!flatPattern.has_value()) {
+bool flatPatternHasAnyTimedEvents(const nspc::NspcFlatPattern* flatPattern) {
+    if (flatPattern == nullptr) {
         return false;
     }
 
@@ -567,6 +567,16 @@ bool flatPatternHasAnyTimedEvents(const std::optional<nspc::NspcFlatPattern>& fl
     return false;
 }
 
+// Heap bytes of a snapshot of tracks or subroutines, for NspcCommand::memoryBytes.
+template <typename Owner>
+size_t snapshotBytes(const std::vector<Owner>& owners) {
+    size_t bytes = owners.capacity() * sizeof(Owner);
+    for (const auto& owner : owners) {
+        bytes += owner.events.capacity() * sizeof(nspc::NspcEventEntry);
+    }
+    return bytes;
+}
+
 class SetPatternLengthCommand final : public nspc::NspcCommand {
 public:
     SetPatternLengthCommand(int patternId, uint32_t targetTick) : patternId_(patternId), targetTick_(targetTick) {}
@@ -601,11 +611,19 @@ public:
         return std::format("Set Pattern Length {}", targetTick_);
     }
 
+    [[nodiscard]] size_t memoryBytes() const override {
+        return sizeof(*this) + beforeState_.bytes() + afterState_.bytes();
+    }
+
 private:
     struct SongState {
         std::vector<nspc::NspcPattern> patterns;
         std::vector<nspc::NspcTrack> tracks;
         nspc::NspcContentOrigin contentOrigin = nspc::NspcContentOrigin::EngineProvided;
+
+        [[nodiscard]] size_t bytes() const {
+            return patterns.capacity() * sizeof(nspc::NspcPattern) + snapshotBytes(tracks);
+        }
     };
 
     static SongState capture(const nspc::NspcSong& song) {
@@ -671,11 +689,17 @@ public:
         return "Remap Song Instruments";
     }
 
+    [[nodiscard]] size_t memoryBytes() const override {
+        return sizeof(*this) + beforeState_.bytes() + afterState_.bytes();
+    }
+
 private:
     struct SongState {
         std::vector<nspc::NspcTrack> tracks;
         std::vector<nspc::NspcSubroutine> subroutines;
         nspc::NspcContentOrigin contentOrigin = nspc::NspcContentOrigin::EngineProvided;
+
+        [[nodiscard]] size_t bytes() const { return snapshotBytes(tracks) + snapshotBytes(subroutines); }
     };
 
     static SongState capture(const nspc::NspcSong& song) {
@@ -756,12 +780,21 @@ public:
         return description_;
     }
 
+    [[nodiscard]] size_t memoryBytes() const override {
+        return sizeof(*this) + description_.capacity() + beforeState_.bytes() + afterState_.bytes();
+    }
+
 private:
     struct SongState {
         std::vector<nspc::NspcPattern> patterns;
         std::vector<nspc::NspcTrack> tracks;
         std::vector<nspc::NspcSubroutine> subroutines;
         nspc::NspcContentOrigin contentOrigin = nspc::NspcContentOrigin::EngineProvided;
+
+        [[nodiscard]] size_t bytes() const {
+            return patterns.capacity() * sizeof(nspc::NspcPattern) + snapshotBytes(tracks) +
+                   snapshotBytes(subroutines);
+        }
     };
 
     static SongState capture(const nspc::NspcSong& song) {
@@ -1919,36 +1952,30 @@ bool PatternEditorPanel::pasteClipboardAtCursor(nspc::NspcSong& song, int patter
         return false;
     }
 
-    // Wrap entire paste operation in a transaction
-    nspc::NspcCommandTransaction txn(appState_.commandHistory, "Paste");
-
     const int baseRow = std::clamp(selectedRow_, 0, static_cast<int>(rows_.size()) - 1);
     const int baseFlatCol = std::clamp(selectedChannel_ * kEditItems + selectedItem_, 0, kChannels * kEditItems - 1);
-    bool updated = false;
+    std::vector<nspc::NspcCellEdit> edits;
+    edits.reserve(clipboardCells_.size());
     std::vector<uint8_t> pastedRowEventFlags(rows_.size() * static_cast<size_t>(kChannels), 0);
     auto row_channel_index = [&](int row, int channel) -> size_t {
         return static_cast<size_t>(row) * static_cast<size_t>(kChannels) + static_cast<size_t>(channel);
     };
     auto ensure_row_anchor = [&](const nspc::NspcEditorLocation& location, int row, int channel) {
         if (row < 0 || row >= static_cast<int>(rows_.size())) {
-            return false;
+            return;
         }
         if (channel < 0 || channel >= kChannels) {
-            return false;
+            return;
         }
 
         const bool hasVisibleRowEvent = rows_[static_cast<size_t>(row)][static_cast<size_t>(channel)].note != "...";
         const bool rowEventAlreadyPasted = pastedRowEventFlags[row_channel_index(row, channel)] != 0;
         if (hasVisibleRowEvent || rowEventAlreadyPasted) {
-            return true;
+            return;
         }
 
-        auto cmd = std::make_unique<nspc::SetRowEventCommand>(location, nspc::Tie{});
-        const bool anchorInserted = appState_.commandHistory.execute(song, std::move(cmd));
-        if (anchorInserted) {
-            pastedRowEventFlags[row_channel_index(row, channel)] = 1;
-        }
-        return anchorInserted;
+        edits.push_back({.location = location, .change = nspc::NspcCellEdit::RowEvent{nspc::Tie{}}});
+        pastedRowEventFlags[row_channel_index(row, channel)] = 1;
     };
 
     for (const auto& clip : clipboardCells_) {
@@ -1972,41 +1999,31 @@ bool PatternEditorPanel::pasteClipboardAtCursor(nspc::NspcSong& song, int patter
         switch (targetItem) {
         case 0:
             if (clip.rowEvent.has_value()) {
-                auto cmd = std::make_unique<nspc::SetRowEventCommand>(location, *clip.rowEvent);
-                updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                edits.push_back({.location = location, .change = nspc::NspcCellEdit::RowEvent{*clip.rowEvent}});
                 pastedRowEventFlags[row_channel_index(targetRow, targetChannel)] = 1;
             }
             break;
         case 1:
             if (clip.byteValue.has_value()) {
-                (void)ensure_row_anchor(location, targetRow, targetChannel);
-            }
-            {
-                auto cmd = std::make_unique<nspc::SetInstrumentCommand>(location, clip.byteValue);
-                updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                ensure_row_anchor(location, targetRow, targetChannel);
             }
+            edits.push_back({.location = location, .change = nspc::NspcCellEdit::Instrument{clip.byteValue}});
             break;
         case 2:
             if (clip.byteValue.has_value()) {
-                (void)ensure_row_anchor(location, targetRow, targetChannel);
-            }
-            {
-                auto cmd = std::make_unique<nspc::SetVolumeCommand>(location, clip.byteValue);
-                updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                ensure_row_anchor(location, targetRow, targetChannel);
             }
+            edits.push_back({.location = location, .change = nspc::NspcCellEdit::Volume{clip.byteValue}});
             break;
         case 3:
             if (clip.byteValue.has_value()) {
-                (void)ensure_row_anchor(location, targetRow, targetChannel);
-            }
-            {
-                auto cmd = std::make_unique<nspc::SetQvCommand>(location, clip.byteValue);
-                updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                ensure_row_anchor(location, targetRow, targetChannel);
             }
+            edits.push_back({.location = location, .change = nspc::NspcCellEdit::Qv{clip.byteValue}});
             break;
         case 4: {
             if (!clip.effects.empty()) {
-                (void)ensure_row_anchor(location, targetRow, targetChannel);
+                ensure_row_anchor(location, targetRow, targetChannel);
             }
             // Build effects list from clipboard
             std::vector<nspc::Vcmd> newEffects;
@@ -2016,9 +2033,8 @@ bool PatternEditorPanel::pasteClipboardAtCursor(nspc::NspcSong& song, int patter
                     newEffects.push_back(*vcmd);
                 }
             }
-            auto cmd = std::make_unique<nspc::SetEffectsCommand>(location, std::move(newEffects));
-            bool fieldUpdated = appState_.commandHistory.execute(song, std::move(cmd));
-            updated = fieldUpdated || updated;
+            edits.push_back(
+                {.location = location, .change = nspc::NspcCellEdit::Effects{.effects = std::move(newEffects)}});
             break;
         }
         default:
@@ -2026,8 +2042,12 @@ bool PatternEditorPanel::pasteClipboardAtCursor(nspc::NspcSong& song, int patter
         }
     }
 
-    txn.commit();
-    return updated;
+    if (edits.empty()) {
+        return false;
+    }
+    // One command for the whole block: a single undo step, and each pasted cell re-flattens only the channel it
+    // writes rather than the whole pattern.
+    return appState_.commandHistory.execute(song, std::make_unique<nspc::CellEditsCommand>("Paste", std::move(edits)));
 }
 
 bool PatternEditorPanel::clearSelectedCells(nspc::NspcSong& song, int patternId) {
@@ -2043,10 +2063,7 @@ bool PatternEditorPanel::clearSelectedCells(nspc::NspcSong& song, int patternId)
         return false;
     }
 
-    // Wrap entire clear operation in a transaction
-    nspc::NspcCommandTransaction txn(appState_.commandHistory, "Delete Selection");
-
-    bool updated = false;
+    std::vector<nspc::NspcCellEdit> edits;
     for (int row = 0; row < static_cast<int>(rows_.size()); ++row) {
         for (int channel = 0; channel < kChannels; ++channel) {
             for (int item = 0; item < kEditItems; ++item) {
@@ -2059,39 +2076,32 @@ bool PatternEditorPanel::clearSelectedCells(nspc::NspcSong& song, int patternId)
                     .row = static_cast<uint32_t>(row),
                 };
                 switch (item) {
-                case 0: {
-                    auto cmd = std::make_unique<nspc::DeleteRowEventCommand>(location);
-                    updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                case 0:
+                    edits.push_back({.location = location, .change = nspc::NspcCellEdit::DeleteRowEvent{}});
                     break;
-                }
-                case 1: {
-                    auto cmd = std::make_unique<nspc::SetInstrumentCommand>(location, std::nullopt);
-                    updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                case 1:
+                    edits.push_back({.location = location, .change = nspc::NspcCellEdit::Instrument{std::nullopt}});
                     break;
-                }
-                case 2: {
-                    auto cmd = std::make_unique<nspc::SetVolumeCommand>(location, std::nullopt);
-                    updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                case 2:
+                    edits.push_back({.location = location, .change = nspc::NspcCellEdit::Volume{std::nullopt}});
                     break;
-                }
-                case 3: {
-                    auto cmd = std::make_unique<nspc::SetQvCommand>(location, std::nullopt);
-                    updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                case 3:
+                    edits.push_back({.location = location, .change = nspc::NspcCellEdit::Qv{std::nullopt}});
                     break;
-                }
-                case 4: {
-                    auto cmd = std::make_unique<nspc::SetEffectsCommand>(location, std::vector<nspc::Vcmd>{});
-                    updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                case 4:
+                    edits.push_back({.location = location, .change = nspc::NspcCellEdit::Effects{}});
                     break;
-                }
                 default:
                     break;
                 }
             }
         }
     }
-    txn.commit();
-    return updated;
+    if (edits.empty()) {
+        return false;
+    }
+    return appState_.commandHistory.execute(
+        song, std::make_unique<nspc::CellEditsCommand>("Delete Selection", std::move(edits)));
 }
 
 void PatternEditorPanel::clampSelectionToRows() {
@@ -2193,7 +2203,7 @@ std::optional<uint8_t> PatternEditorPanel::effectiveInstrumentAtRow(int channel,
     if (channel < 0 || channel >= kChannels) {
         return std::nullopt;
     }
-    if (!flatPattern_.has_value()) {
+    if (flatPattern_ == nullptr) {
         return std::nullopt;
     }
 
@@ -2259,7 +2269,7 @@ void PatternEditorPanel::syncProjectAramToPreviewPlayer() {
         return;
     }
 
-    const auto srcAram = appState_.project->aram();
+    const auto srcAram = std::as_const(*appState_.project).aram();
     auto dstAram = appState_.spcPlayer->spcDsp().aram();
     const auto srcAll = srcAram.all();
     auto dstAll = dstAram.all();
@@ -2869,38 +2879,48 @@ bool PatternEditorPanel::transposeSelectedCells(nspc::NspcSong& song, int patter
         return false;
     }
 
-    // Wrap entire transpose operation in a transaction
-    nspc::NspcCommandTransaction txn(appState_.commandHistory,
-        std::format("Transpose {}{} semitones", semitones > 0 ? "+" : "", semitones));
-
-    bool updated = false;
+    // Selected note cells become row ranges per channel; the transform then rewrites each source event once,
+    // as a single undo step.
+    nspc::NspcEventSelection selection;
     const int step = std::max(ticksPerRow_, kMinTicksPerRow);
-    for (int row = 0; row < static_cast<int>(rows_.size()); row += step) {
-        for (int channel = 0; channel < kChannels; ++channel) {
+    for (int channel = 0; channel < kChannels; ++channel) {
+        for (int row = 0; row < static_cast<int>(rows_.size()); row += step) {
             if (!isCellSelected(row, channel, 0)) {
                 continue;
             }
-
-            const auto& cell = rows_[static_cast<size_t>(row)][static_cast<size_t>(channel)];
-            auto rowEvent = parseRowEventFromCell(cell);
-            if (!rowEvent.has_value()) {
-                continue;
-            }
-
-            if (const auto* note = std::get_if<nspc::Note>(&*rowEvent)) {
-                const int newPitch = std::clamp(static_cast<int>(note->pitch) + semitones, 0, 0x47);
-                nspc::NspcEditorLocation location{
+            const auto endRow = static_cast<uint32_t>(std::min(row + step, static_cast<int>(rows_.size())));
+            auto& ranges = selection.ranges;
+            if (!ranges.empty() && ranges.back().channel == channel &&
+                ranges.back().endRow == static_cast<uint32_t>(row)) {
+                ranges.back().endRow = endRow;
+            } else {
+                ranges.push_back(nspc::NspcEditorRange{
                     .patternId = patternId,
                     .channel = channel,
-                    .row = static_cast<uint32_t>(row),
-                };
-                auto cmd = std::make_unique<nspc::SetRowEventCommand>(location, nspc::Note{static_cast<uint8_t>(newPitch)});
-                updated = appState_.commandHistory.execute(song, std::move(cmd)) || updated;
+                    .startRow = static_cast<uint32_t>(row),
+                    .endRow = endRow,
+                });
             }
         }
     }
-    txn.commit();
-    return updated;
+    if (selection.ranges.empty()) {
+        return false;
+    }
+
+    auto transpose = [semitones](nspc::NspcEvent& event) {
+        auto* note = std::get_if<nspc::Note>(&event);
+        if (note == nullptr) {
+            return false;
+        }
+        const auto newPitch = static_cast<uint8_t>(std::clamp(static_cast<int>(note->pitch) + semitones, 0, 0x47));
+        const bool changed = newPitch != note->pitch;
+        note->pitch = newPitch;
+        return changed;
+    };
+    return appState_.commandHistory.execute(
+        song, std::make_unique<nspc::TransformEventsCommand>(
+                  std::format("Transpose {}{} semitones", semitones > 0 ? "+" : "", semitones), std::move(selection),
+                  std::move(transpose)));
 }
 
 bool PatternEditorPanel::setInstrumentOnSelection(nspc::NspcSong& song, int patternId, uint8_t instrument) {
@@ -125,6 +125,7 @@ void ProjectPanel::draw() {
     ImGui::BeginDisabled(!canAddMoreSongs);
     if (ImGui::Button("Add")) {
         if (const auto addedSongIndex = project.addEmptySong(); addedSongIndex.has_value()) {
+            appState_.usageIndex.rebuildSong(songs[*addedSongIndex]);
             selectSongForEditing(static_cast<int>(*addedSongIndex));
         }
     }
@@ -138,6 +139,7 @@ void ProjectPanel::draw() {
     if (ImGui::Button("Duplicate")) {
         const auto duplicatedSongIndex = project.duplicateSong(static_cast<size_t>(appState_.selectedSongIndex));
         if (duplicatedSongIndex.has_value()) {
+            appState_.usageIndex.rebuild(project);  // later songs were renumbered
             selectSongForEditing(static_cast<int>(*duplicatedSongIndex));
         }
     }
@@ -191,6 +193,7 @@ void ProjectPanel::draw() {
         if (ImGui::Button("Remove")) {
             const size_t removedIndex = static_cast<size_t>(appState_.selectedSongIndex);
             if (project.removeSong(removedIndex)) {
+                appState_.usageIndex.rebuild(project);
                 if (songs.empty()) {
                     selectSongForEditing(-1);
                 } else {
@@ -14,76 +14,31 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 namespace ntrak::ui {
 
 namespace {
 constexpr uint32_t kDefaultNewPatternEndTick = 127;
 
-uint64_t mixHash(uint64_t hash, uint64_t value) {
-    constexpr uint64_t kFnvPrime = 1099511628211ULL;
-    hash ^= value;
-    hash *= kFnvPrime;
-    return hash;
+// Sequence and pattern edits here bypass the command history, so they stamp the song themselves
+nspc::NspcRevision sequenceEditorRevision(const nspc::NspcSong& song) {
+    return std::max(song.sequenceRevision(), song.patternsRevision());
 }
 
-uint64_t hashSequenceOp(const nspc::NspcSequenceOp& op) {
-    return std::visit(
-        nspc::overloaded{
-            [](const nspc::PlayPattern& value) -> uint64_t {
-                uint64_t hash = 1469598103934665603ULL;
-                hash = mixHash(hash, 1);
-                hash = mixHash(hash, static_cast<uint64_t>(static_cast<uint32_t>(value.patternId)));
-                hash = mixHash(hash, value.trackTableAddr);
-                return hash;
-            },
-            [](const nspc::JumpTimes& value) -> uint64_t {
-                uint64_t hash = 1469598103934665603ULL;
-                hash = mixHash(hash, 2);
-                hash = mixHash(hash, value.count);
-                hash = mixHash(hash, value.target.index.has_value() ? 1 : 0);
-                hash = mixHash(hash, static_cast<uint64_t>(value.target.index.value_or(-1) + 1));
-                hash = mixHash(hash, value.target.addr);
-                return hash;
-            },
-            [](const nspc::AlwaysJump& value) -> uint64_t {
-                uint64_t hash = 1469598103934665603ULL;
-                hash = mixHash(hash, 3);
-                hash = mixHash(hash, value.opcode);
-                hash = mixHash(hash, value.target.index.has_value() ? 1 : 0);
-                hash = mixHash(hash, static_cast<uint64_t>(value.target.index.value_or(-1) + 1));
-                hash = mixHash(hash, value.target.addr);
-                return hash;
-            },
-            [](const nspc::FastForwardOn&) -> uint64_t { return 0xFF01ULL; },
-            [](const nspc::FastForwardOff&) -> uint64_t { return 0xFF02ULL; },
-            [](const nspc::EndSequence&) -> uint64_t { return 0xFF03ULL; },
-        },
-        op);
-}
-
-uint64_t sequenceEditorSongFingerprint(const nspc::NspcSong& song) {
-    uint64_t hash = 1469598103934665603ULL;
-    hash = mixHash(hash, static_cast<uint64_t>(song.songId() + 1));
-
-    for (const auto& op : song.sequence()) {
-        hash = mixHash(hash, hashSequenceOp(op));
+void touchPatternAndTracks(nspc::NspcSong& song, int patternId) {
+    song.touchPattern(patternId);
+    const auto& patterns = std::as_const(song).patterns();
+    const auto it = std::find_if(patterns.begin(), patterns.end(),
+                                 [patternId](const nspc::NspcPattern& pattern) { return pattern.id == patternId; });
+    if (it == patterns.end() || !it->channelTrackIds.has_value()) {
+        return;
     }
-    hash = mixHash(hash, 0xABCD0001ULL);
-
-    for (const auto& pattern : song.patterns()) {
-        hash = mixHash(hash, static_cast<uint64_t>(static_cast<uint32_t>(pattern.id)));
-        hash = mixHash(hash, pattern.trackTableAddr);
-        if (pattern.channelTrackIds.has_value()) {
-            hash = mixHash(hash, 1);
-            for (const int trackId : *pattern.channelTrackIds) {
-                hash = mixHash(hash, static_cast<uint64_t>(trackId + 1));
-            }
-        } else {
-            hash = mixHash(hash, 0);
+    for (const int trackId : *it->channelTrackIds) {
+        if (trackId >= 0) {
+            song.touchTrack(trackId);
         }
     }
-    return hash;
 }
 
 std::optional<uint32_t> templatePatternEndTick(const nspc::NspcSong& song, std::optional<int> patternId) {
@@ -163,6 +118,7 @@ nspc::NspcPattern& SequenceEditorPanel::ensurePatternExists(nspc::NspcSong& song
     });
     nspc::NspcEditor editor;
     (void)editor.setPatternLength(song, patternId, desiredEndTick);
+    touchPatternAndTracks(song, patternId);
     return patterns.back();
 }
 
@@ -219,6 +175,7 @@ int SequenceEditorPanel::duplicatePattern(nspc::NspcSong& song, int sourcePatter
         .channelTrackIds = newChannelTrackIds,
         .trackTableAddr = 0,
     });
+    touchPatternAndTracks(song, newPatternId);
     song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
     return newPatternId;
 }
@@ -248,6 +205,7 @@ int SequenceEditorPanel::createNewPattern(nspc::NspcSong& song) {
         templatePatternEndTick(song, appState_.selectedPatternId).value_or(kDefaultNewPatternEndTick);
     nspc::NspcEditor editor;
     (void)editor.setPatternLength(song, newPatternId, desiredEndTick);
+    touchPatternAndTracks(song, newPatternId);
     song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
     return newPatternId;
 }
@@ -260,6 +218,7 @@ void SequenceEditorPanel::insertPlayPatternOp(nspc::NspcSong& song, int patternI
                                                     .patternId = pattern.id,
                                                     .trackTableAddr = pattern.trackTableAddr,
                                                 });
+    song.touchSequence();
     selectedRow() = insertIndex;
     appState_.selectedPatternId = pattern.id;
     song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
@@ -419,6 +378,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
         auto& pattern = ensurePatternExists(song, value);
         play->patternId = pattern.id;
         play->trackTableAddr = pattern.trackTableAddr;
+        song.touchSequence();
         appState_.selectedPatternId = pattern.id;
         insertPatternId_ = pattern.id;
         return;
@@ -439,6 +399,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
             return;
         }
         pattern->channelTrackIds.value()[static_cast<size_t>(selectedChannel())] = std::clamp(value, 0, 0xFF);
+        song.touchPattern(pattern->id);
         return;
     }
     case GridEditField::JumpCount: {
@@ -447,6 +408,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
             return;
         }
         jump->count = static_cast<uint8_t>(std::clamp(value, 1, 0x7F));
+        song.touchSequence();
         return;
     }
     case GridEditField::JumpTarget: {
@@ -456,6 +418,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
         }
         jump->target.index = std::clamp(value, 0, 0xFF);
         jump->target.addr = 0;
+        song.touchSequence();
         return;
     }
     case GridEditField::AlwaysOpcode: {
@@ -464,6 +427,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
             return;
         }
         always->opcode = static_cast<uint8_t>(std::clamp(value, 0x82, 0xFF));
+        song.touchSequence();
         return;
     }
     case GridEditField::AlwaysTarget: {
@@ -473,6 +437,7 @@ void SequenceEditorPanel::applyHexEdit(nspc::NspcSong& song, int value) {
         }
         always->target.index = std::clamp(value, 0, 0xFF);
         always->target.addr = 0;
+        song.touchSequence();
         return;
     }
     case GridEditField::None:
@@ -524,6 +489,7 @@ void SequenceEditorPanel::handleInlineHexEditing(nspc::NspcSong& song, bool song
         }
         if (selectedChannel() >= 0 && selectedChannel() < kChannels) {
             pattern->channelTrackIds.value()[static_cast<size_t>(selectedChannel())] = -1;
+            song.touchPattern(pattern->id);
         }
         return;
     }
@@ -553,6 +519,7 @@ void SequenceEditorPanel::drawHeader(nspc::NspcSong& song, bool songLocked) {
     auto& sequence = song.sequence();
     if (sequence.empty()) {
         sequence.push_back(nspc::EndSequence{});
+        song.touchSequence();
     }
 
     auto patternIds = collectPatternIds(song);
@@ -659,6 +626,7 @@ void SequenceEditorPanel::drawHeader(nspc::NspcSong& song, bool songLocked) {
             const nspc::NspcSequenceOp newOp = buildInsertOperation(song);
             const int insertIndex = std::clamp(defaultInsertIndex(song), 0, static_cast<int>(sequence.size()));
             sequence.insert(sequence.begin() + insertIndex, newOp);
+            song.touchSequence();
             selectedRow() = insertIndex;
             song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
             syncSelectedPatternFromRow(song);
@@ -674,6 +642,7 @@ void SequenceEditorPanel::drawHeader(nspc::NspcSong& song, bool songLocked) {
     if (ImGui::Button("Del", ImVec2(kButtonWidthMedium, 0.0f))) {
         if (hasSelection) {
             sequence.erase(sequence.begin() + selectedRow());
+            song.touchSequence();
             if (sequence.empty()) {
                 selectedRow() = -1;
             } else {
@@ -690,6 +659,7 @@ void SequenceEditorPanel::drawHeader(nspc::NspcSong& song, bool songLocked) {
     if (ImGui::Button("Up", ImVec2(kButtonWidthSmall, 0.0f))) {
         if (canMoveUp) {
             std::swap(sequence[static_cast<size_t>(selectedRow())], sequence[static_cast<size_t>(selectedRow() - 1)]);
+            song.touchSequence();
             --selectedRow();
         }
     }
@@ -703,6 +673,7 @@ void SequenceEditorPanel::drawHeader(nspc::NspcSong& song, bool songLocked) {
     if (ImGui::Button("Dn", ImVec2(kButtonWidthSmall, 0.0f))) {
         if (canMoveDown) {
             std::swap(sequence[static_cast<size_t>(selectedRow())], sequence[static_cast<size_t>(selectedRow() + 1)]);
+            song.touchSequence();
             ++selectedRow();
         }
     }
@@ -890,6 +861,7 @@ void SequenceEditorPanel::drawSequenceTable(nspc::NspcSong& song, bool songLocke
                     targetOp = nspc::EndSequence{};
                     break;
                 }
+                song.touchSequence();
                 gridEditField_ = GridEditField::None;
                 hexInput_.clear();
                 syncSelectedPatternFromRow(song);
@@ -1014,6 +986,7 @@ void SequenceEditorPanel::draw() {
     const bool songLocked = appState_.lockEngineContent && song.isEngineProvided();
     if (song.sequence().empty()) {
         song.sequence().push_back(nspc::EndSequence{});
+        song.touchSequence();
         selectedRow() = 0;
     }
 
@@ -1026,7 +999,7 @@ void SequenceEditorPanel::draw() {
     if (!appState_.playback.followPlayback || !appState_.playback.hooksInstalled.load(std::memory_order_relaxed)) {
         lastPlaybackScrollRow_ = -1;
     }
-    const uint64_t songFingerprintBefore = sequenceEditorSongFingerprint(song);
+    const nspc::NspcRevision songRevisionBefore = sequenceEditorRevision(song);
 
     if (songLocked) {
         ImGui::TextDisabled("Selected song is engine-owned and locked from edits.");
@@ -1034,7 +1007,7 @@ void SequenceEditorPanel::draw() {
     drawHeader(song, songLocked);
     drawSequenceTable(song, songLocked);
     handleInlineHexEditing(song, songLocked);
-    if (sequenceEditorSongFingerprint(song) != songFingerprintBefore) {
+    if (sequenceEditorRevision(song) != songRevisionBefore) {
         song.setContentOrigin(nspc::NspcContentOrigin::UserProvided);
     }
 }
@@ -583,7 +583,7 @@ void SongPortDialog::rebuildMappings() {
         return;
     }
 
-    usedInstrumentIds_ = nspc::findUsedInstrumentIds(*appState_.project, sourceSongIndex_);
+    usedInstrumentIds_ = nspc::findUsedInstrumentIds(*appState_.project, sourceSongIndex_, appState_.usageIndex);
 
     if (targetProject_.has_value()) {
         instrumentMappings_ = nspc::buildDefaultMappings(*appState_.project, *targetProject_, sourceSongIndex_);
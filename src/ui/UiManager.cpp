@@ -19,6 +19,7 @@
 #include <nfd.hpp>
 #include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ntrak::ui {
@@ -253,6 +254,7 @@ void maybeFlattenSubroutinesOnLoad(app::AppState& appState, nspc::NspcProject& p
             appState.optimizeSubroutinesOnBuild && !appState.flattenSubroutinesOnLoad,
         .includeEngineExtensions = true,
         .compactAramLayout = appState.compactAramLayoutOnBuild,
+        .shareSubroutinesAcrossSongs = appState.shareSubroutinesAcrossSongsOnBuild,
     };
 }
 
@@ -266,6 +268,7 @@ void installLoadedProject(app::AppState& appState, nspc::NspcProject project, st
 
     // Clear undo/redo history on project change
     appState.commandHistory.clear();
+    appState.usageIndex.rebuild(*appState.project);
 
     if (appState.spcPlayer && !appState.sourceSpcData.empty()) {
         appState.spcPlayer->stop();
@@ -274,6 +277,17 @@ void installLoadedProject(app::AppState& appState, nspc::NspcProject project, st
     }
 }
 
+// Starts decoding the selected song and the one after it, the likeliest next pick, if a deferred project load
+// left them encoded; a no-op once both are decoded
+void prefetchLikelySongs(const app::AppState& appState) {
+    if (!appState.project.has_value() || appState.selectedSongIndex < 0) {
+        return;
+    }
+    const auto selected = static_cast<size_t>(appState.selectedSongIndex);
+    appState.project->prefetchSong(selected);
+    appState.project->prefetchSong(selected + 1);
+}
+
 }  // namespace
 
 UiManager::UiManager(app::AppState& appState) : appState_(appState), songPortDialog_(appState) {
@@ -293,6 +307,10 @@ UiManager::UiManager(app::AppState& appState) : appState_(appState), songPortDia
         installProject(std::move(project), std::move(spcData), std::move(spcPath));
     };
 
+    (void)appState_.commandHistory.subscribe([this](const nspc::NspcSong& song, const nspc::NspcSongChanges& changes) {
+        appState_.usageIndex.updateSong(song, changes);
+    });
+
     // Wire undo/redo callbacks
     appState_.undo = [this]() {
         if (!appState_.project.has_value()) {
@@ -331,6 +349,8 @@ Panel* UiManager::panel(const std::string& title) {
 
 void UiManager::draw() {
     handleGlobalShortcuts();
+    prefetchLikelySongs(appState_);
+    reportSongDecodeError();
     drawTitleBar();
     drawDockspace();
     drawPanelWindows();
@@ -344,6 +364,26 @@ void UiManager::setFileStatus(std::string message, bool isError) {
     fileStatusIsError_ = isError;
 }
 
+// Once the selected song has been decoded, reports events a deferred project load could not read
+void UiManager::reportSongDecodeError() {
+    if (!appState_.project.has_value() || appState_.selectedSongIndex < 0) {
+        return;
+    }
+    const auto& songs = std::as_const(*appState_.project).songs();
+    const auto selected = static_cast<size_t>(appState_.selectedSongIndex);
+    if (selected >= songs.size()) {
+        return;
+    }
+    const std::string& error = songs[selected].eventsError();
+    if (error.empty() || error == reportedDecodeError_) {
+        return;
+    }
+    reportedDecodeError_ = error;
+    setFileStatus(std::format("Song {:02X} has unreadable events, left empty and saved unchanged: {}",
+                              songs[selected].songId(), error),
+                  true);
+}
+
 void UiManager::registerPanelVisibilitySettingsHandler() {
     ImGuiContext* context = ImGui::GetCurrentContext();
     if (context == nullptr) {
@@ -632,6 +672,7 @@ bool UiManager::executeItImportFromWorkbench() {
     auto [project, report] = std::move(*importResult);
     appState_.project = std::move(project);
     appState_.commandHistory.clear();
+    appState_.usageIndex.rebuild(*appState_.project);
     resetPlaybackTracking(appState_.playback);
     selectFirstPlayableRow(appState_, targetSongIndex);
 
@@ -912,7 +953,7 @@ void UiManager::drawItImportDialog() {
 
 bool UiManager::openProjectFromDialog() {
     NFD::UniquePath projectPath;
-    nfdfilteritem_t projectFilters[1] = {{"ntrak Project", "ntrakproj"}};
+    nfdfilteritem_t projectFilters[1] = {{"ntrak Project", "ntrakproj,ntrakbin"}};
     const nfdresult_t projectDialogResult = NFD::OpenDialog(projectPath, projectFilters, 1);
     if (projectDialogResult == NFD_CANCEL) {
         return false;
@@ -992,7 +1033,9 @@ bool UiManager::openProjectFromDialog() {
 
     bool rememberedBaseSpc = false;
     if (promptedForBaseSpc && !overlayData->baseSpcPath.has_value()) {
-        auto rememberResult = nspc::saveProjectIrFile(*appState_.project, overlayPath, appState_.sourceSpcPath);
+        auto rememberResult = nspc::saveProjectIrFile(*appState_.project, overlayPath, appState_.sourceSpcPath,
+                                                      appState_.saveOptimizerCacheWithProject,
+                                                      nspc::projectFileFormatForPath(overlayPath));
         rememberedBaseSpc = rememberResult.has_value();
     }
 
@@ -1036,7 +1079,9 @@ bool UiManager::saveProjectToPath(const std::filesystem::path& path) {
         }
     }
 
-    auto saveResult = nspc::saveProjectIrFile(*appState_.project, path, appState_.sourceSpcPath);
+    auto saveResult = nspc::saveProjectIrFile(*appState_.project, path, appState_.sourceSpcPath,
+                                              appState_.saveOptimizerCacheWithProject,
+                                              nspc::projectFileFormatForPath(path));
     if (!saveResult.has_value()) {
         setFileStatus(std::format("Save failed: {}", saveResult.error()), true);
         return false;
@@ -1064,8 +1109,8 @@ bool UiManager::saveProjectAsFromDialog() {
     }
 
     NFD::UniquePath outPath;
-    nfdfilteritem_t filters[1] = {{"ntrak Project", "ntrakproj"}};
-    const nfdresult_t result = NFD::SaveDialog(outPath, filters, 1, nullptr, defaultName.c_str());
+    nfdfilteritem_t filters[2] = {{"ntrak Project", "ntrakproj"}, {"ntrak Binary Project", "ntrakbin"}};
+    const nfdresult_t result = NFD::SaveDialog(outPath, filters, 2, nullptr, defaultName.c_str());
     if (result == NFD_CANCEL) {
         return false;
     }
@@ -1113,7 +1158,13 @@ bool UiManager::exportUserDataFromDialog() {
     }
 
     const std::filesystem::path path = outPath.get();
-    auto exportData = nspc::buildUserContentNspcExport(*appState_.project, buildOptionsFromAppState(appState_));
+    const auto buildOptions = buildOptionsFromAppState(appState_);
+    auto exportData = nspc::buildUserContentNspcExport(*appState_.project, buildOptions);
+    if (exportData.has_value() && buildOptions.applyOptimizedSongToProject) {
+        // The build wrote optimized songs back; the undo records describe the songs before that.
+        appState_.commandHistory.clear();
+        appState_.usageIndex.rebuild(*appState_.project);
+    }
     if (!exportData.has_value()) {
         setFileStatus(std::format("Export failed: {}", exportData.error()), true);
         return false;
@@ -1184,6 +1235,66 @@ bool UiManager::exportSpcFromDialog() {
     return true;
 }
 
+bool UiManager::exportAllSpcsFromDialog() {
+    if (!appState_.project.has_value()) {
+        setFileStatus("No project loaded", true);
+        return false;
+    }
+
+    if (appState_.sourceSpcData.empty()) {
+        setFileStatus("No base SPC file available for export", true);
+        return false;
+    }
+
+    const size_t songCount = appState_.project->songs().size();
+    if (songCount == 0) {
+        setFileStatus("Project has no songs to export", true);
+        return false;
+    }
+
+    NFD::UniquePath outDir;
+    const nfdresult_t result = NFD::PickFolder(outDir);
+    if (result == NFD_CANCEL) {
+        return false;
+    }
+    if (result == NFD_ERROR) {
+        setFileStatus(std::format("File dialog error: {}", NFD::GetError() ? NFD::GetError() : "unknown"), true);
+        return false;
+    }
+
+    std::string stem = "song";
+    if (currentProjectPath_.has_value() && !currentProjectPath_->stem().string().empty()) {
+        stem = currentProjectPath_->stem().string();
+    }
+
+    std::vector<int> songIndices(songCount);
+    for (size_t i = 0; i < songCount; ++i) {
+        songIndices[i] = static_cast<int>(i);
+    }
+
+    const std::filesystem::path directory = outDir.get();
+    auto spcFiles = nspc::buildAutoPlaySpcBatch(*appState_.project, appState_.sourceSpcData, songIndices,
+                                                std::nullopt, buildOptionsFromAppState(appState_));
+
+    size_t exportedCount = 0;
+    for (size_t i = 0; i < spcFiles.size(); ++i) {
+        if (!spcFiles[i].has_value()) {
+            setFileStatus(std::format("SPC export failed for song {:02d}: {}", i, spcFiles[i].error()), true);
+            return false;
+        }
+        const std::filesystem::path path = directory / std::format("{}_{:02d}.spc", stem, i);
+        auto writeResult = writeBinaryFile(path, *spcFiles[i]);
+        if (!writeResult.has_value()) {
+            setFileStatus(writeResult.error(), true);
+            return false;
+        }
+        ++exportedCount;
+    }
+
+    setFileStatus(std::format("Exported {} SPC files to '{}'", exportedCount, directory.string()), false);
+    return true;
+}
+
 void UiManager::installProject(nspc::NspcProject project, std::vector<uint8_t> sourceSpcData,
                                std::optional<std::filesystem::path> sourceSpcPath) {
     maybeFlattenSubroutinesOnLoad(appState_, project);
@@ -1291,6 +1402,10 @@ void UiManager::drawTitleBar() {
                 (void)exportSpcFromDialog();
             }
 
+            if (ImGui::MenuItem("Export All Songs as SPC...")) {
+                (void)exportAllSpcsFromDialog();
+            }
+
             if (ImGui::MenuItem("Port Song to Engine...")) {
                 songPortDialog_.open();
             }
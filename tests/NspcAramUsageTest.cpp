@@ -0,0 +1,150 @@
+#include "ntrak/nspc/NspcAramUsage.hpp"
+#include "ntrak/nspc/NspcProject.hpp"
+#include "NspcTestHelpers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+using test_helpers::writeWord;
+
+std::vector<NspcAramRegion> makeRandomRegions(std::mt19937& rng, size_t count) {
+    std::vector<NspcAramRegion> regions;
+    for (size_t i = 0; i < count; ++i) {
+        const auto from = static_cast<uint16_t>(rng() % 0xFF00);
+        const auto kind = static_cast<NspcAramRegionKind>(1 + rng() % 9);
+        regions.push_back(NspcAramRegion{
+            .kind = kind,
+            .from = from,
+            .to = static_cast<uint16_t>(from + 1 + rng() % 0xC0),
+            .songId = -1,
+            .objectId = static_cast<int>(i),
+            .label = {},
+        });
+    }
+    return regions;
+}
+
+// Paints every region onto free bytes only, lowest source first
+std::array<NspcAramRegionKind, NspcAramUsage::kTotalAramBytes>
+paintSources(const std::map<uint32_t, std::vector<NspcAramRegion>>& sources) {
+    std::array<NspcAramRegionKind, NspcAramUsage::kTotalAramBytes> ownership{};
+    ownership.fill(NspcAramRegionKind::Free);
+    for (const auto& [source, regions] : sources) {
+        for (const auto& region : regions) {
+            for (uint32_t addr = region.from; addr < region.to; ++addr) {
+                if (ownership[addr] == NspcAramRegionKind::Free) {
+                    ownership[addr] = region.kind;
+                }
+            }
+        }
+    }
+    return ownership;
+}
+
+void expectMatchesPaint(const NspcAramUsageMap& map, const std::map<uint32_t, std::vector<NspcAramRegion>>& sources) {
+    const auto ownership = paintSources(sources);
+    std::array<uint32_t, 10> expectedBytes{};
+    for (const auto kind : ownership) {
+        ++expectedBytes[static_cast<size_t>(kind)];
+    }
+    for (size_t kind = 0; kind < expectedBytes.size(); ++kind) {
+        EXPECT_EQ(map.bytesOwnedBy(static_cast<NspcAramRegionKind>(kind)), expectedBytes[kind]) << "kind " << kind;
+    }
+
+    const NspcAramUsage usage = map.usage();
+    EXPECT_EQ(usage.freeBytes, expectedBytes[0]);
+    EXPECT_EQ(usage.usedBytes, NspcAramUsage::kTotalAramBytes - expectedBytes[0]);
+    ASSERT_FALSE(usage.segments.empty());
+    EXPECT_EQ(usage.segments.front().from, 0u);
+    EXPECT_EQ(usage.segments.back().to, NspcAramUsage::kTotalAramBytes);
+    for (size_t i = 0; i < usage.segments.size(); ++i) {
+        const auto& segment = usage.segments[i];
+        if (i > 0) {
+            ASSERT_EQ(segment.from, usage.segments[i - 1].to);
+            ASSERT_NE(segment.kind, usage.segments[i - 1].kind);
+        }
+        for (uint32_t addr = segment.from; addr < segment.to; ++addr) {
+            ASSERT_EQ(ownership[addr], segment.kind) << "address " << addr;
+        }
+    }
+}
+
+}  // namespace
+
+// Replacing and removing sources in any order must leave the same ownership as painting what remains.
+TEST(NspcAramUsageTest, MapMatchesPaintingThroughSourceChanges) {
+    std::mt19937 rng(48);
+    NspcAramUsageMap map;
+    std::map<uint32_t, std::vector<NspcAramRegion>> sources;
+
+    for (int step = 0; step < 60; ++step) {
+        const auto source = static_cast<uint32_t>(rng() % 6);
+        if (rng() % 4 == 0) {
+            map.removeSource(source);
+            sources.erase(source);
+        } else {
+            auto regions = makeRandomRegions(rng, 1 + rng() % 40);
+            sources[source] = regions;
+            map.setSource(source, std::move(regions));
+        }
+        ASSERT_NO_FATAL_FAILURE(expectMatchesPaint(map, sources)) << "step " << step;
+    }
+
+    for (const auto& [source, regions] : sources) {
+        map.removeSource(source);
+    }
+    EXPECT_EQ(map.bytesOwnedBy(NspcAramRegionKind::Free), NspcAramUsage::kTotalAramBytes);
+    EXPECT_EQ(map.intervalCount(), 1u);
+}
+
+// A song edit recollects that song's regions only and ends where a full refresh would.
+TEST(NspcAramUsageTest, ProjectUpdateMatchesFullRefreshAfterSongEdit) {
+    NspcEngineConfig config{};
+    config.name = "ARAM usage test";
+    config.songIndexPointers = 0x0200;
+    std::array<std::uint8_t, 0x10000> aram{};
+    writeWord(aram, 0x0200, 0x0300);
+    writeWord(aram, 0x0202, 0x0000);
+    writeWord(aram, 0x0300, 0x0400);
+    writeWord(aram, 0x0302, 0x0000);
+    NspcProject project(config, std::move(aram));
+    ASSERT_EQ(project.songs().size(), 1u);
+    const uint32_t sequenceBytesBefore = project.aramUsage().sequenceBytes;
+
+    NspcSong& song = project.songs()[0];
+    song.sequence().insert(song.sequence().begin(), song.sequence().front());
+    song.touchSequence();
+    project.updateAramUsage();
+    EXPECT_GT(project.aramUsage().sequenceBytes, sequenceBytesBefore);
+
+    NspcProject refreshed = project;
+    refreshed.refreshAramUsage();
+    const auto& updated = project.aramUsage();
+    const auto& expected = refreshed.aramUsage();
+    EXPECT_EQ(updated.freeBytes, expected.freeBytes);
+    EXPECT_EQ(updated.sequenceBytes, expected.sequenceBytes);
+    EXPECT_EQ(updated.patternTableBytes, expected.patternTableBytes);
+    EXPECT_EQ(updated.songIndexBytes, expected.songIndexBytes);
+    ASSERT_EQ(updated.regions.size(), expected.regions.size());
+    for (size_t i = 0; i < expected.regions.size(); ++i) {
+        EXPECT_EQ(updated.regions[i].from, expected.regions[i].from);
+        EXPECT_EQ(updated.regions[i].to, expected.regions[i].to);
+        EXPECT_EQ(updated.regions[i].label, expected.regions[i].label);
+    }
+
+    // Nothing changed since, so there is nothing to recollect
+    const auto* usageBefore = &project.aramUsage();
+    project.updateAramUsage();
+    EXPECT_EQ(&project.aramUsage(), usageBefore);
+}
+
+}  // namespace ntrak::nspc
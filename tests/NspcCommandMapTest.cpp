@@ -350,11 +350,15 @@ TEST(NspcCommandMapTest, BuildSongScopedUploadOnlyPersistsOptimizedSubroutinesWh
     EXPECT_FALSE(hasAnyTrackSubroutineCall(project.songs().front()));
 
     buildOptions.applyOptimizedSongToProject = true;
+    const int patternId = project.songs().front().patterns().front().id;
+    const NspcRevision revisionBefore = project.songs().front().patternContentRevision(patternId);
     auto compileWithPersist = buildSongScopedUpload(project, 0, buildOptions);
     ASSERT_TRUE(compileWithPersist.has_value()) << compileWithPersist.error();
 
     EXPECT_FALSE(project.songs().front().subroutines().empty());
     EXPECT_TRUE(hasAnyTrackSubroutineCall(project.songs().front()));
+    // The written-back song is stamped, so cached views of its patterns rebuild.
+    EXPECT_GT(project.songs().front().patternContentRevision(patternId), revisionBefore);
 }
 
 }  // namespace ntrak::nspc
@@ -0,0 +1,483 @@
+#include "ntrak/nspc/NspcCommand.hpp"
+#include "ntrak/nspc/NspcCommandHistory.hpp"
+#include "ntrak/nspc/NspcOptimize.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+NspcTrack makeTrack(int id, NspcEventId& nextId, const std::vector<NspcEvent>& events) {
+    NspcTrack track{.id = id, .events = {}, .originalAddr = static_cast<uint16_t>(0x1000 + id * 0x100)};
+    for (const auto& event : events) {
+        track.events.push_back(NspcEventEntry{.id = nextId++, .event = event, .originalAddr = std::nullopt});
+    }
+    track.events.push_back(NspcEventEntry{.id = nextId++, .event = End{}, .originalAddr = std::nullopt});
+    return track;
+}
+
+// Two patterns sharing track 1, a track calling a subroutine, and unassigned channels that edits can fill.
+NspcSong buildEditableSong() {
+    NspcSong song;
+    NspcEventId nextId = 1;
+    const std::vector<NspcEvent> melody = {
+        Duration{.ticks = 4}, Note{.pitch = 24}, Note{.pitch = 28}, Duration{.ticks = 8}, Rest{}, Note{.pitch = 31},
+        Tie{},
+    };
+    song.tracks().push_back(makeTrack(0, nextId, melody));
+    song.tracks().push_back(makeTrack(1, nextId, {Duration{.ticks = 2}, Note{.pitch = 12}, Note{.pitch = 14},
+                                                  Duration{.ticks = 6}, Note{.pitch = 16}}));
+    song.tracks().push_back(makeTrack(2, nextId, {Vcmd{VcmdSubroutineCall{.subroutineId = 0, .originalAddr = 0x3000,
+                                                                          .count = 2}}}));
+
+    NspcTrack body = makeTrack(0, nextId, {Duration{.ticks = 3}, Note{.pitch = 40}, Note{.pitch = 42}});
+    song.subroutines().push_back(NspcSubroutine{.id = 0, .events = std::move(body.events), .originalAddr = 0x3000});
+
+    song.patterns().push_back(NspcPattern{.id = 0, .channelTrackIds = std::array<int, 8>{0, 1, 2, -1, -1, -1, -1, -1},
+                                          .trackTableAddr = 0x2000});
+    song.patterns().push_back(NspcPattern{.id = 1, .channelTrackIds = std::array<int, 8>{1, -1, -1, -1, -1, -1, -1, -1},
+                                          .trackTableAddr = 0x2010});
+    return song;
+}
+
+void expectSameSong(const NspcSong& actual, const NspcSong& expected) {
+    ASSERT_EQ(actual.tracks().size(), expected.tracks().size());
+    for (size_t i = 0; i < expected.tracks().size(); ++i) {
+        EXPECT_EQ(actual.tracks()[i].id, expected.tracks()[i].id) << "track " << i;
+        EXPECT_EQ(actual.tracks()[i].originalAddr, expected.tracks()[i].originalAddr) << "track " << i;
+        EXPECT_TRUE(actual.tracks()[i].events == expected.tracks()[i].events) << "track " << i;
+    }
+    ASSERT_EQ(actual.subroutines().size(), expected.subroutines().size());
+    for (size_t i = 0; i < expected.subroutines().size(); ++i) {
+        EXPECT_TRUE(actual.subroutines()[i].events == expected.subroutines()[i].events) << "subroutine " << i;
+    }
+    ASSERT_EQ(actual.patterns().size(), expected.patterns().size());
+    for (size_t i = 0; i < expected.patterns().size(); ++i) {
+        EXPECT_EQ(actual.patterns()[i].channelTrackIds, expected.patterns()[i].channelTrackIds) << "pattern " << i;
+    }
+    EXPECT_EQ(actual.contentOrigin(), expected.contentOrigin());
+}
+
+std::unique_ptr<NspcCommand> makeRandomCommand(std::mt19937& rng) {
+    const NspcEditorLocation location{
+        .patternId = static_cast<int>(rng() % 2),
+        .channel = static_cast<int>(rng() % 5),
+        .row = static_cast<uint32_t>(rng() % 40),
+    };
+    const auto value = static_cast<uint8_t>(rng() % 0x40);
+    switch (rng() % 8) {
+    case 0:
+        return std::make_unique<SetRowEventCommand>(location, Note{.pitch = value});
+    case 1:
+        return std::make_unique<SetRowEventCommand>(location, (rng() % 2) != 0 ? NspcRowEvent{Rest{}} : Tie{});
+    case 2:
+        return std::make_unique<DeleteRowEventCommand>(location);
+    case 3:
+        return std::make_unique<InsertTickCommand>(location);
+    case 4:
+        return std::make_unique<RemoveTickCommand>(location);
+    case 5:
+        return std::make_unique<SetInstrumentCommand>(location, (rng() % 3) != 0 ? std::optional<uint8_t>(value)
+                                                                                 : std::nullopt);
+    case 6:
+        return std::make_unique<SetVolumeCommand>(location, value);
+    default:
+        return std::make_unique<SetEffectsCommand>(location, std::vector<Vcmd>{Vcmd{VcmdPanning{.panning = value}}});
+    }
+}
+
+NspcCellEdit makeRandomCellEdit(std::mt19937& rng, int patternId) {
+    const NspcEditorLocation location{
+        .patternId = patternId,
+        .channel = static_cast<int>(rng() % 5),
+        .row = static_cast<uint32_t>(rng() % 40),
+    };
+    const auto value = static_cast<uint8_t>(rng() % 0x40);
+    switch (rng() % 6) {
+    case 0:
+        return {.location = location, .change = NspcCellEdit::RowEvent{Note{.pitch = value}}};
+    case 1:
+        return {.location = location, .change = NspcCellEdit::RowEvent{Tie{}}};
+    case 2:
+        return {.location = location, .change = NspcCellEdit::DeleteRowEvent{}};
+    case 3:
+        return {.location = location, .change = NspcCellEdit::Instrument{value}};
+    case 4:
+        return {.location = location, .change = NspcCellEdit::Volume{std::nullopt}};
+    default:
+        return {.location = location,
+                .change = NspcCellEdit::Effects{.effects = {Vcmd{VcmdPanning{.panning = value}}}}};
+    }
+}
+
+}  // namespace
+
+// Undo and redo must land on exactly the song a full before/after snapshot would have restored, including
+// for commands the history has compacted.
+TEST(NspcCommandTest, RecordedEditsRestoreSnapshotsExactly) {
+    std::mt19937 rng(1234);
+    NspcSong song = buildEditableSong();
+    song.setContentOrigin(NspcContentOrigin::EngineProvided);
+    NspcCommandHistory history;
+
+    std::vector<NspcSong> snapshots{song};
+    for (int step = 0; step < 400; ++step) {
+        const NspcSong before = song;
+        if (!history.execute(song, makeRandomCommand(rng))) {
+            expectSameSong(song, before);
+            continue;
+        }
+        const NspcSong after = song;
+        snapshots.push_back(after);
+
+        ASSERT_TRUE(history.undo(song));
+        expectSameSong(song, before);
+        ASSERT_TRUE(history.redo(song));
+        expectSameSong(song, after);
+    }
+    ASSERT_GT(snapshots.size(), 100u);
+
+    // Walk the whole history back and forward again.
+    for (size_t i = snapshots.size() - 1; i > 0; --i) {
+        ASSERT_TRUE(history.undo(song));
+        expectSameSong(song, snapshots[i - 1]);
+    }
+    EXPECT_FALSE(history.canUndo());
+    for (size_t i = 1; i < snapshots.size(); ++i) {
+        ASSERT_TRUE(history.redo(song));
+        expectSameSong(song, snapshots[i]);
+    }
+}
+
+TEST(NspcCommandTest, CellEditRecordsOnlyTheChangedEvents) {
+    NspcSong song = buildEditableSong();
+    NspcEventId nextId = 1000;
+    std::vector<NspcEvent> longMelody;
+    for (int i = 0; i < 2000; ++i) {
+        longMelody.push_back(Duration{.ticks = 1});
+        longMelody.push_back(Note{.pitch = static_cast<uint8_t>(i % 48)});
+    }
+    song.tracks()[0] = makeTrack(0, nextId, longMelody);
+
+    SetRowEventCommand command(NspcEditorLocation{.patternId = 0, .channel = 0, .row = 1000}, Note{.pitch = 47});
+    ASSERT_TRUE(command.execute(song));
+    // A few events around the edited row, not the 4000-event track.
+    EXPECT_LE(command.memoryBytes(), sizeof(command) + 32 * sizeof(NspcEventEntry));
+}
+
+TEST(NspcCommandTest, SongCopyIsUnchangedByLaterEditsToTheSong) {
+    NspcSong song = buildEditableSong();
+    const NspcSong copy = song;
+    const NspcSong original = song;
+
+    song.tracks()[0].events.front().event = Duration{.ticks = 9};
+    SetRowEventCommand command(NspcEditorLocation{.patternId = 0, .channel = 1, .row = 0}, Rest{});
+    ASSERT_TRUE(command.execute(song));
+
+    expectSameSong(copy, original);
+}
+
+TEST(NspcCommandTest, ExecuteEditsTheSongsOwnStorage) {
+    NspcSong song = buildEditableSong();
+    std::vector<NspcTrack>& tracks = song.tracks();
+    const std::vector<NspcEventEntry> eventsBefore = tracks[0].events;
+
+    // The command snapshots the song internally; a reference taken before must still be the live tracks.
+    SetRowEventCommand command(NspcEditorLocation{.patternId = 0, .channel = 0, .row = 0}, Note{.pitch = 5});
+    ASSERT_TRUE(command.execute(song));
+    EXPECT_EQ(&tracks, &std::as_const(song).tracks());
+    EXPECT_FALSE(tracks[0].events == eventsBefore);
+
+    tracks[0].events.front().event = Duration{.ticks = 9};
+    EXPECT_TRUE(std::as_const(song).tracks()[0].events.front().event == NspcEvent{Duration{.ticks = 9}});
+    ASSERT_TRUE(command.undo(song));
+    EXPECT_EQ(&tracks, &std::as_const(song).tracks());
+}
+
+TEST(NspcCommandTest, UndoAfterOptimizedWriteBackIsRefused) {
+    NspcSong song = buildEditableSong();
+    NspcEventId nextId = 5000;
+    std::vector<NspcEvent> repeated;
+    for (int i = 0; i < 8; ++i) {
+        repeated.insert(repeated.end(), {Duration{.ticks = 4}, Note{.pitch = 24}, Note{.pitch = 28}, Note{.pitch = 31},
+                                         Rest{}});
+    }
+    song.tracks()[0] = makeTrack(0, nextId, repeated);
+    song.setNextEventId(nextId);
+
+    NspcCommandHistory history;
+    ASSERT_TRUE(history.execute(
+        song, std::make_unique<SetRowEventCommand>(NspcEditorLocation{.patternId = 0, .channel = 0, .row = 12},
+                                                   Note{.pitch = 40})));
+
+    // A build that persists its optimized song replaces the project's copy behind the history's back.
+    NspcSong optimized = song;
+    optimizeSongSubroutines(optimized);
+    ASSERT_LT(std::as_const(optimized).tracks()[0].events.size(), std::as_const(song).tracks()[0].events.size());
+    song = optimized;
+
+    EXPECT_FALSE(history.undo(song));
+    expectSameSong(song, optimized);
+}
+
+TEST(NspcCommandTest, CompactedCommandShrinksAndStillUndoes) {
+    NspcSong song = buildEditableSong();
+    const NspcSong original = song;
+    InsertTickCommand command(NspcEditorLocation{.patternId = 0, .channel = 0, .row = 0});
+    ASSERT_TRUE(command.execute(song));
+    const NspcSong edited = song;
+
+    const size_t liveBytes = command.memoryBytes();
+    command.compact();
+    EXPECT_LT(command.memoryBytes(), liveBytes);
+
+    ASSERT_TRUE(command.undo(song));
+    expectSameSong(song, original);
+    command.compact();
+    ASSERT_TRUE(command.execute(song));
+    expectSameSong(song, edited);
+}
+
+TEST(NspcCommandTest, HistoryDropsOldestCommandsOverByteBudget) {
+    std::mt19937 rng(99);
+    NspcSong song = buildEditableSong();
+    NspcCommandHistory history;
+
+    int executed = 0;
+    while (executed < 300) {
+        executed += history.execute(song, makeRandomCommand(rng)) ? 1 : 0;
+    }
+    EXPECT_EQ(history.undoStackSize(), 300u);
+    const size_t fullBytes = history.historyBytes();
+    EXPECT_GT(fullBytes, 0u);
+
+    history.setMaxHistoryBytes(fullBytes / 4);
+    EXPECT_LE(history.historyBytes(), fullBytes / 4);
+    EXPECT_LT(history.undoStackSize(), 300u);
+    EXPECT_GT(history.undoStackSize(), 0u);
+
+    // Everything kept is still undoable, decoding compacted commands on the way.
+    while (history.canUndo()) {
+        ASSERT_TRUE(history.undo(song));
+    }
+}
+
+TEST(NspcCommandTest, EditSessionMatchesSequentialEdits) {
+    std::mt19937 rng(77);
+    for (int round = 0; round < 20; ++round) {
+        const NspcSong original = buildEditableSong();
+        std::vector<NspcCellEdit> edits;
+        for (int i = 0; i < 60; ++i) {
+            edits.push_back(makeRandomCellEdit(rng, round % 2));
+        }
+
+        NspcSong expected = original;
+        NspcEditor editor;
+        for (const auto& edit : edits) {
+            const auto& location = edit.location;
+            std::visit(
+                overloaded{
+                    [&](const NspcCellEdit::RowEvent& change) { editor.setRowEvent(expected, location, change.event); },
+                    [&](const NspcCellEdit::DeleteRowEvent&) { editor.deleteRowEvent(expected, location); },
+                    [&](const NspcCellEdit::Instrument& change) {
+                        editor.setInstrumentAtRow(expected, location, change.instrument);
+                    },
+                    [&](const NspcCellEdit::Volume& change) { editor.setVolumeAtRow(expected, location, change.volume); },
+                    [&](const NspcCellEdit::Qv& change) { editor.setQvAtRow(expected, location, change.qv); },
+                    [&](const NspcCellEdit::Effects& change) {
+                        editor.clearEffectsAtRow(expected, location, change.preserveSubroutineCalls);
+                        for (const auto& effect : change.effects) {
+                            editor.addEffectAtRow(expected, location, effect);
+                        }
+                    },
+                },
+                edit.change);
+        }
+
+        NspcSong actual = original;
+        NspcEditSession session(actual);
+        session.apply(edits);
+        expectSameSong(actual, expected);
+        // Sequential edits flatten all eight channels several times per edit.
+        EXPECT_LT(session.flattenedChannelCount(), edits.size() * 4) << "round " << round;
+    }
+}
+
+TEST(NspcCommandTest, EditSessionBlockPasteFlattensAboutOneChannelPerEdit) {
+    NspcSong song = buildEditableSong();
+    std::vector<NspcCellEdit> edits;
+    for (uint32_t row = 0; row < 16; ++row) {
+        for (int channel = 0; channel < 2; ++channel) {
+            NspcCellEdit edit;
+            edit.location = NspcEditorLocation{.patternId = 0, .channel = channel, .row = row};
+            edit.change = NspcCellEdit::RowEvent{Note{.pitch = static_cast<uint8_t>(row)}};
+            edits.push_back(edit);
+            edit.change = NspcCellEdit::Instrument{static_cast<uint8_t>(channel)};
+            edits.push_back(edit);
+        }
+    }
+
+    NspcEditSession session(song);
+    session.apply(edits);
+    // Edits still apply one at a time: the pattern is flattened once up front, then each edit re-flattens
+    // the channel it wrote (twice when the editor looks it up again after writing).
+    EXPECT_LE(session.flattenedChannelCount(), 8 + edits.size() * 2);
+}
+
+TEST(NspcCommandTest, CellEditsCommandIsOneUndoStep) {
+    std::mt19937 rng(5);
+    NspcSong song = buildEditableSong();
+    const NspcSong original = song;
+    std::vector<NspcCellEdit> edits;
+    for (int i = 0; i < 30; ++i) {
+        edits.push_back(makeRandomCellEdit(rng, 0));
+    }
+    // Edits for another pattern are dropped.
+    edits.push_back(makeRandomCellEdit(rng, 1));
+
+    NspcCommandHistory history;
+    ASSERT_TRUE(history.execute(song, std::make_unique<CellEditsCommand>("Paste", edits)));
+    EXPECT_EQ(history.undoStackSize(), 1u);
+    EXPECT_EQ(history.undoDescription(), std::optional<std::string>("Paste"));
+    const NspcSong edited = song;
+
+    NspcSong expected = original;
+    edits.pop_back();
+    NspcEditSession(expected).apply(edits);
+    expectSameSong(edited, expected);
+
+    ASSERT_TRUE(history.undo(song));
+    expectSameSong(song, original);
+    ASSERT_TRUE(history.redo(song));
+    expectSameSong(song, edited);
+}
+
+TEST(NspcCommandTest, TransformEventsIsOneUndoStepAcrossTheSong) {
+    NspcSong song = buildEditableSong();
+    const NspcSong original = song;
+    const auto transpose = [](NspcEvent& event) {
+        auto* note = std::get_if<Note>(&event);
+        if (note == nullptr) {
+            return false;
+        }
+        note->pitch = static_cast<uint8_t>(note->pitch + 2);
+        return true;
+    };
+
+    NspcCommandHistory history;
+    ASSERT_TRUE(history.execute(
+        song, std::make_unique<TransformEventsCommand>("Transpose", NspcEventSelection{.wholeSong = true}, transpose,
+                                                       true)));
+    EXPECT_EQ(history.undoStackSize(), 1u);
+    EXPECT_EQ(std::get<Note>(song.tracks()[0].events[1].event).pitch, 26);
+    EXPECT_EQ(std::get<Note>(song.subroutines()[0].events[1].event).pitch, 42);
+
+    NspcSong serial = original;
+    NspcEditor().transformEvents(serial, NspcEventSelection{.wholeSong = true}, transpose, false);
+    expectSameSong(song, serial);
+
+    ASSERT_TRUE(history.undo(song));
+    expectSameSong(song, original);
+}
+
+TEST(NspcCommandTest, TransformEventsVisitsSharedEventsOnce) {
+    NspcSong song = buildEditableSong();
+    int visited = 0;
+    const auto transpose = [&visited](NspcEvent& event) {
+        auto* note = std::get_if<Note>(&event);
+        if (note == nullptr) {
+            return false;
+        }
+        ++visited;
+        note->pitch = static_cast<uint8_t>(note->pitch + 1);
+        return true;
+    };
+
+    // Channel 2 plays the subroutine twice, and both patterns play track 1.
+    NspcEventSelection selection;
+    selection.ranges.push_back(NspcEditorRange{.patternId = 0, .channel = 2, .startRow = 0, .endRow = 1000});
+    selection.ranges.push_back(NspcEditorRange{.patternId = 0, .channel = 1, .startRow = 0, .endRow = 1000});
+    selection.ranges.push_back(NspcEditorRange{.patternId = 1, .channel = 0, .startRow = 0, .endRow = 1000});
+    ASSERT_TRUE(NspcEditor().transformEvents(song, selection, transpose));
+
+    EXPECT_EQ(visited, 5);
+    EXPECT_EQ(std::get<Note>(song.subroutines()[0].events[1].event).pitch, 41);
+    EXPECT_EQ(std::get<Note>(song.tracks()[1].events[1].event).pitch, 13);
+    EXPECT_EQ(std::get<Note>(song.tracks()[0].events[1].event).pitch, 24);
+
+    // A range covers only the rows it names: track 1 starts with two 2-tick notes.
+    visited = 0;
+    selection.ranges = {NspcEditorRange{.patternId = 1, .channel = 0, .startRow = 2, .endRow = 4}};
+    ASSERT_TRUE(NspcEditor().transformEvents(song, selection, transpose));
+    EXPECT_EQ(visited, 1);
+    EXPECT_EQ(std::get<Note>(song.tracks()[1].events[1].event).pitch, 13);
+    EXPECT_EQ(std::get<Note>(song.tracks()[1].events[2].event).pitch, 16);
+}
+
+// Each execute, undo and redo stamps only what the command changed, then notifies subscribers.
+TEST(NspcCommandTest, HistoryStampsChangedDataAndNotifiesSubscribers) {
+    NspcSong song = buildEditableSong();
+    const NspcSong copy = song;
+    EXPECT_EQ(copy.revision(), song.revision());
+
+    NspcCommandHistory history;
+    int notifications = 0;
+    NspcSongChanges lastChanges;
+    const size_t subscription = history.subscribe([&](const NspcSong&, const NspcSongChanges& changes) {
+        ++notifications;
+        lastChanges = changes;
+    });
+
+    const NspcRevision songBefore = song.revision();
+    const NspcRevision track0Before = song.trackRevision(0);
+    const NspcRevision track1Before = song.trackRevision(1);
+    const NspcRevision subroutinesBefore = song.subroutinesRevision();
+    const NspcRevision sequenceBefore = song.sequenceRevision();
+    ASSERT_TRUE(history.execute(song, std::make_unique<SetRowEventCommand>(
+                                          NspcEditorLocation{.patternId = 0, .channel = 0, .row = 0},
+                                          Note{.pitch = 50})));
+    EXPECT_EQ(notifications, 1);
+    EXPECT_FALSE(lastChanges.all);
+    EXPECT_GT(song.revision(), songBefore);
+    EXPECT_GT(song.trackRevision(0), track0Before);
+    EXPECT_EQ(song.trackRevision(1), track1Before);
+    EXPECT_EQ(song.subroutinesRevision(), subroutinesBefore);
+    EXPECT_EQ(song.sequenceRevision(), sequenceBefore);
+    EXPECT_EQ(copy.trackRevision(0), track0Before);
+
+    // Undo gets a new stamp rather than the old one back
+    const NspcRevision editedStamp = song.trackRevision(0);
+    ASSERT_TRUE(history.undo(song));
+    EXPECT_EQ(notifications, 2);
+    EXPECT_GT(song.trackRevision(0), editedStamp);
+
+    // Filling an unassigned channel creates a track and changes the pattern's track table
+    const NspcRevision pattern1Before = song.patternRevision(1);
+    ASSERT_TRUE(history.execute(song, std::make_unique<SetRowEventCommand>(
+                                          NspcEditorLocation{.patternId = 0, .channel = 4, .row = 0},
+                                          Note{.pitch = 30})));
+    ASSERT_EQ(lastChanges.patternIds, std::vector<int>{0});
+    EXPECT_EQ(song.patternRevision(0), song.revision());
+    EXPECT_EQ(song.patternRevision(1), pattern1Before);
+
+    history.unsubscribe(subscription);
+    ASSERT_TRUE(history.undo(song));
+    EXPECT_EQ(notifications, 3);
+
+    // Whole-song mutators stamp themselves
+    NspcSong flattened = song;
+    flattened.flattenSubroutines();
+    EXPECT_GT(flattened.subroutinesRevision(), song.subroutinesRevision());
+    EXPECT_EQ(flattened.trackRevision(1), flattened.subroutinesRevision());
+    EXPECT_EQ(flattened.sequenceRevision(), song.sequenceRevision());
+}
+
+}  // namespace ntrak::nspc
@@ -1,17 +1,22 @@
 #include "ntrak/nspc/NspcCompile.hpp"
 #include "ntrak/nspc/NspcProject.hpp"
+#include "ntrak/nspc/NspcSpcExport.hpp"
 
 #include "NspcTestHelpers.hpp"
 
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <string>
+#include <vector>
 
 namespace ntrak::nspc {
 namespace {
 
 using test_helpers::buildProjectWithTwoSongsTwoAssets;
+using test_helpers::fillWithRepeatedPhrase;
 
 NspcEngineConfig baseConfig() {
     NspcEngineConfig config{};
@@ -120,5 +125,120 @@ TEST(NspcCompileUserUploadTest, BuildUserContentUploadIncludesEnabledEngineExten
     EXPECT_EQ(extChunkCount, 1);
 }
 
+TEST(NspcCompileUserUploadTest, BuildUserContentUploadIsIdenticalAcrossWorkerCounts) {
+    NspcProject serialProject = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    markAllUserProvided(serialProject);
+    NspcProject parallelProject = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    markAllUserProvided(parallelProject);
+
+    NspcBuildOptions serialOptions{};
+    serialOptions.maxWorkerThreads = 1;
+    NspcBuildOptions parallelOptions{};
+    parallelOptions.maxWorkerThreads = 4;
+
+    auto serial = buildUserContentUpload(serialProject, serialOptions);
+    ASSERT_TRUE(serial.has_value()) << serial.error();
+    auto parallel = buildUserContentUpload(parallelProject, parallelOptions);
+    ASSERT_TRUE(parallel.has_value()) << parallel.error();
+
+    ASSERT_EQ(serial->chunks.size(), parallel->chunks.size());
+    for (size_t i = 0; i < serial->chunks.size(); ++i) {
+        EXPECT_EQ(serial->chunks[i].address, parallel->chunks[i].address);
+        EXPECT_EQ(serial->chunks[i].bytes, parallel->chunks[i].bytes);
+        EXPECT_EQ(serial->chunks[i].label, parallel->chunks[i].label);
+    }
+}
+
+TEST(NspcCompileUserUploadTest, BuildAutoPlaySpcBatchMatchesSequentialExport) {
+    NspcProject sequentialProject = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    NspcProject batchProject = buildProjectWithTwoSongsTwoAssets(baseConfig());
+
+    constexpr char kSignature[] = "SNES-SPC700 Sound File Data v0.30";
+    std::vector<uint8_t> baseSpc(0x10200, 0);
+    std::memcpy(baseSpc.data(), kSignature, sizeof(kSignature) - 1);
+    const auto aram = sequentialProject.aram().all();
+    std::copy(aram.begin(), aram.end(), baseSpc.begin() + 0x100);
+
+    const std::array<int, 2> songIndices{0, 1};
+    std::vector<std::vector<uint8_t>> sequential;
+    for (const int songIndex : songIndices) {
+        auto spc = buildAutoPlaySpc(sequentialProject, baseSpc, songIndex);
+        ASSERT_TRUE(spc.has_value()) << spc.error();
+        sequential.push_back(std::move(*spc));
+    }
+
+    NspcBuildOptions options{};
+    options.maxWorkerThreads = 2;
+    auto batch = buildAutoPlaySpcBatch(batchProject, baseSpc, songIndices, std::nullopt, options);
+    ASSERT_EQ(batch.size(), sequential.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ASSERT_TRUE(batch[i].has_value()) << batch[i].error();
+        EXPECT_EQ(*batch[i], sequential[i]);
+    }
+}
+
+TEST(NspcCompileUserUploadTest, SharedSubroutinesAreUploadedOnceAcrossSongs) {
+    const auto buildProject = [] {
+        NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+        markAllUserProvided(project);
+        // Both songs repeat the same phrase twice on their only track.
+        for (auto& song : project.songs()) {
+            fillWithRepeatedPhrase(song);
+        }
+        return project;
+    };
+
+    NspcProject separateProject = buildProject();
+    NspcProject sharedProject = buildProject();
+    NspcBuildOptions options{};
+    options.optimizeSubroutines = true;
+    auto separate = buildUserContentUpload(separateProject, options);
+    ASSERT_TRUE(separate.has_value()) << separate.error();
+    options.shareSubroutinesAcrossSongs = true;
+    auto shared = buildUserContentUpload(sharedProject, options);
+    ASSERT_TRUE(shared.has_value()) << shared.error();
+
+    EXPECT_EQ(separate->telemetry.sharedSubroutinesReused, 0u);
+    EXPECT_GT(shared->telemetry.sharedSubroutinesReused, 0u);
+    EXPECT_LT(shared->telemetry.subroutineBytes, separate->telemetry.subroutineBytes);
+    EXPECT_LT(shared->telemetry.emittedBytes(), separate->telemetry.emittedBytes());
+
+    // The second song's layout points its subroutine at the copy the first song uploaded.
+    const auto* firstLayout = sharedProject.songAddressLayout(sharedProject.songs()[0].songId());
+    const auto* secondLayout = sharedProject.songAddressLayout(sharedProject.songs()[1].songId());
+    ASSERT_NE(firstLayout, nullptr);
+    ASSERT_NE(secondLayout, nullptr);
+    ASSERT_FALSE(secondLayout->subroutineAddrById.empty());
+    for (const auto& [id, addr] : secondLayout->subroutineAddrById) {
+        const bool sharesFirstSongCopy =
+            std::ranges::any_of(firstLayout->subroutineAddrById, [addr](const auto& entry) { return entry.second == addr; });
+        EXPECT_TRUE(sharesFirstSongCopy) << "subroutine " << id;
+    }
+}
+
+TEST(NspcCompileUserUploadTest, BuildUserContentUploadReportsTelemetryMatchingChunks) {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    markAllUserProvided(project);
+
+    auto upload = buildUserContentUpload(project);
+    ASSERT_TRUE(upload.has_value()) << upload.error();
+
+    uint32_t chunkBytes = 0;
+    for (const auto& chunk : upload->chunks) {
+        chunkBytes += static_cast<uint32_t>(chunk.bytes.size());
+    }
+    const NspcBuildTelemetry& telemetry = upload->telemetry;
+    EXPECT_EQ(telemetry.emittedBytes(), chunkBytes);
+    EXPECT_EQ(telemetry.songIndexBytes, 4u);
+    EXPECT_GT(telemetry.sampleDataBytes, 0u);
+    EXPECT_EQ(telemetry.songsOptimized, 2u);
+    EXPECT_GT(telemetry.freeBytes, 0u);
+    EXPECT_GE(telemetry.totalMilliseconds, 0.0);
+
+    const std::string json = buildTelemetryToJson(telemetry);
+    EXPECT_NE(json.find("\"stageMs\""), std::string::npos);
+    EXPECT_NE(json.find("\"fragmentation\""), std::string::npos);
+}
+
 }  // namespace
 }  // namespace ntrak::nspc
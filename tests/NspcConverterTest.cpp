@@ -67,5 +67,23 @@ TEST(NspcConverterTest, PortSongNeverAllocatesSampleDataIntoEngineTablesAfterDel
     EXPECT_TRUE(foundUserSample);
 }
 
+TEST(NspcConverterTest, PortedSongIsNewerThanItsSourceEverywhere) {
+    NspcProject source = test_helpers::buildProjectWithTwoSongsTwoAssets(baseConfig());
+    NspcProject target = test_helpers::buildProjectWithTwoSongsTwoAssets(baseConfig());
+    const NspcSong& sourceSong = source.songs()[0];
+
+    SongPortRequest request{};
+    request.sourceSongIndex = 0;
+    request.targetSongIndex = -1;
+    const SongPortResult result = portSong(source, target, request);
+    ASSERT_TRUE(result.success) << result.error;
+
+    const NspcSong& ported = target.songs().back();
+    EXPECT_GT(ported.sequenceRevision(), sourceSong.sequenceRevision());
+    EXPECT_GT(ported.patternsRevision(), sourceSong.patternsRevision());
+    EXPECT_GT(ported.tracksRevision(), sourceSong.tracksRevision());
+    EXPECT_GT(ported.subroutinesRevision(), sourceSong.subroutinesRevision());
+}
+
 }  // namespace
 }  // namespace ntrak::nspc
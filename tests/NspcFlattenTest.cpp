@@ -1,4 +1,5 @@
 #include "ntrak/nspc/NspcFlatten.hpp"
+#include "ntrak/nspc/NspcOptimizerCache.hpp"
 #include "ntrak/nspc/NspcProject.hpp"
 #include "NspcTestHelpers.hpp"
 
@@ -6,6 +7,7 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
 namespace ntrak::nspc {
 namespace {
@@ -65,6 +67,37 @@ std::optional<std::uint8_t> findTempoOnChannel(const NspcFlatPattern& pattern, i
     return std::nullopt;
 }
 
+NspcEventEntry entry(NspcEventId id, NspcEvent event) {
+    return NspcEventEntry{.id = id, .event = std::move(event), .originalAddr = std::nullopt};
+}
+
+// Track 0 calls subroutine 0 twice; subroutine 0 plays a note and calls subroutine 1 once.
+NspcSong buildNestedCallSong() {
+    NspcSong song;
+    song.subroutines().push_back(NspcSubroutine{
+        .id = 0,
+        .events = {entry(10, Note{.pitch = 1}),
+                   entry(11, Vcmd{VcmdSubroutineCall{.subroutineId = 1, .originalAddr = 0x3100, .count = 1}}),
+                   entry(12, End{})},
+        .originalAddr = 0x3000,
+    });
+    song.subroutines().push_back(NspcSubroutine{
+        .id = 1,
+        .events = {entry(20, Note{.pitch = 2}), entry(21, End{})},
+        .originalAddr = 0x3100,
+    });
+    song.tracks().push_back(NspcTrack{
+        .id = 0,
+        .events = {entry(1, Duration{.ticks = 4}),
+                   entry(2, Vcmd{VcmdSubroutineCall{.subroutineId = 0, .originalAddr = 0x3000, .count = 2}}),
+                   entry(3, End{})},
+        .originalAddr = 0x2000,
+    });
+    song.patterns().push_back(NspcPattern{.id = 0, .channelTrackIds = std::array<int, 8>{0, -1, -1, -1, -1, -1, -1, -1},
+                                          .trackTableAddr = 0x1000});
+    return song;
+}
+
 }  // namespace
 
 TEST(NspcFlattenTest, CanDisableEarliestTrackEndClipping) {
@@ -91,4 +124,124 @@ TEST(NspcFlattenTest, CanDisableEarliestTrackEndClipping) {
     EXPECT_EQ(*tempo, 0x44u);
 }
 
+TEST(NspcFlattenTest, SharesCallStackFramesAndReferencesSongEvents) {
+    const NspcSong song = buildNestedCallSong();
+    const auto flat = flattenPatternById(song, 0);
+    ASSERT_TRUE(flat.has_value());
+    const auto& events = flat->channels[0].events;
+
+    // One frame per subroutine invocation rather than one stack copy per event.
+    EXPECT_EQ(events.frames().size(), 4u);
+    ASSERT_EQ(events.size(), 13u);
+    EXPECT_EQ(&events[0].event, &song.tracks()[0].events[0].event);
+    EXPECT_TRUE(events[0].subroutineStack.empty());
+
+    std::vector<uint32_t> nestedNoteTicks;
+    for (const auto& event : events) {
+        if (!std::holds_alternative<Note>(event.event) || std::get<Note>(event.event).pitch != 2) {
+            continue;
+        }
+        nestedNoteTicks.push_back(event.tick);
+        ASSERT_EQ(event.subroutineStack.size(), 2u);
+        EXPECT_EQ(event.subroutineStack[0].subroutineId, 0);
+        EXPECT_EQ(event.subroutineStack.back().subroutineId, 1);
+        EXPECT_EQ(event.subroutineStack.back().callEvent.eventId, 11u);
+        const auto frames = event.subroutineStack.frames();
+        ASSERT_EQ(frames.size(), 2u);
+        EXPECT_EQ(frames[0].callEvent.eventId, 2u);
+        EXPECT_EQ(frames[0].iteration, static_cast<uint8_t>(nestedNoteTicks.size() - 1));
+    }
+    EXPECT_EQ(nestedNoteTicks, (std::vector<uint32_t>{4, 12}));
+    EXPECT_EQ(flat->totalTicks, 16u);
+}
+
+TEST(NspcFlattenTest, CacheReflattensOnlyChangedChannels) {
+    NspcProject project = buildFlattenClipProject();
+    NspcSong song = project.songs().front();
+    const auto& pattern = song.patterns().front();
+    ASSERT_TRUE(pattern.channelTrackIds.has_value());
+    const int tempoTrackId = pattern.channelTrackIds.value()[6];
+    const NspcFlattenOptions options{.clipToEarliestTrackEnd = false};
+
+    NspcFlatPatternCache cache;
+    const NspcFlatPattern* first = cache.flatten(song, pattern.id, options, 0);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(cache.flattenedChannelCount(), 8u);
+    const uint64_t generation = cache.generation();
+
+    // Same revision: nothing is flattened again.
+    EXPECT_EQ(cache.flatten(song, pattern.id, options, 0), first);
+    EXPECT_EQ(cache.flattenedChannelCount(), 8u);
+    EXPECT_EQ(cache.generation(), generation);
+
+    // A new revision with an unchanged song re-checks but keeps every channel.
+    EXPECT_NE(cache.flatten(song, pattern.id, options, 1), nullptr);
+    EXPECT_EQ(cache.flattenedChannelCount(), 8u);
+    EXPECT_EQ(cache.generation(), generation);
+
+    for (auto& track : song.tracks()) {
+        if (track.id != tempoTrackId) {
+            continue;
+        }
+        for (auto& entry : track.events) {
+            if (auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
+                vcmd->vcmd = VcmdTempo{.tempo = 0x55};
+            }
+        }
+    }
+    const NspcFlatPattern* edited = cache.flatten(song, pattern.id, options, 2);
+    ASSERT_NE(edited, nullptr);
+    EXPECT_EQ(cache.flattenedChannelCount(), 9u);
+    EXPECT_NE(cache.generation(), generation);
+    EXPECT_EQ(findTempoOnChannel(*edited, 6), std::optional<std::uint8_t>(0x55));
+
+    const auto fresh = flattenPatternById(song, pattern.id, options);
+    ASSERT_TRUE(fresh.has_value());
+    EXPECT_EQ(edited->totalTicks, fresh->totalTicks);
+    for (size_t channel = 0; channel < fresh->channels.size(); ++channel) {
+        const auto& cached = edited->channels[channel];
+        const auto& expected = fresh->channels[channel];
+        ASSERT_EQ(cached.events.size(), expected.events.size()) << "channel " << channel;
+        EXPECT_EQ(cached.totalTicks, expected.totalTicks) << "channel " << channel;
+        for (size_t i = 0; i < expected.events.size(); ++i) {
+            EXPECT_EQ(cached.events[i].tick, expected.events[i].tick);
+            EXPECT_TRUE(cached.events[i].event == expected.events[i].event);
+            EXPECT_EQ(cached.events[i].source.eventId, expected.events[i].source.eventId);
+        }
+    }
+}
+
+TEST(NspcFlattenTest, CacheSeesSongChangesMadeOutsideTheHistory) {
+    NspcProject project = buildFlattenClipProject();
+    NspcSong song = project.songs().front();
+    const int patternId = song.patterns().front().id;
+    const NspcFlattenOptions options{.clipToEarliestTrackEnd = false};
+
+    NspcFlatPatternCache cache;
+    const NspcFlatPattern* first = cache.flatten(song, patternId, options, song.patternContentRevision(patternId));
+    ASSERT_NE(first, nullptr);
+    ASSERT_EQ(findTempoOnChannel(*first, 6), std::optional<std::uint8_t>(0x44));
+
+    // An optimizer cache hit rewrites the song's events directly, like a build before it writes the song back.
+    NspcSong optimized = song;
+    for (auto& track : optimized.tracks()) {
+        for (auto& entry : track.events) {
+            if (auto* vcmd = std::get_if<Vcmd>(&entry.event)) {
+                vcmd->vcmd = VcmdTempo{.tempo = 0x55};
+            }
+        }
+    }
+    const NspcRevision beforeApply = song.patternContentRevision(patternId);
+    ASSERT_TRUE(applyOptimizerCacheEntry(song, makeOptimizerCacheEntry(optimized, NspcOptimizerStats{})));
+    EXPECT_GT(song.patternContentRevision(patternId), beforeApply);
+    const NspcFlatPattern* applied = cache.flatten(song, patternId, options, song.patternContentRevision(patternId));
+    ASSERT_NE(applied, nullptr);
+    EXPECT_EQ(findTempoOnChannel(*applied, 6), std::optional<std::uint8_t>(0x55));
+
+    // Flattening subroutines on load rewrites every track.
+    const NspcRevision beforeFlatten = song.patternContentRevision(patternId);
+    song.flattenSubroutines();
+    EXPECT_GT(song.patternContentRevision(patternId), beforeFlatten);
+}
+
 }  // namespace ntrak::nspc
@@ -1,3 +1,4 @@
+#include "ntrak/nspc/NspcCompile.hpp"
 #include "ntrak/nspc/NspcOptimize.hpp"
 
 #include <gtest/gtest.h>
@@ -5,6 +6,7 @@
 #include <algorithm>
 #include <array>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace ntrak::nspc {
@@ -114,6 +116,174 @@ TEST(NspcOptimizeTest, OptimizerExtractsSubroutinesForRepeatedMotifs) {
     EXPECT_TRUE(hasAnyTrackSubroutineCall(song));
 }
 
+TEST(NspcOptimizeTest, OptimizerInternsEqualEventsToOneToken) {
+    NspcSong song = buildOptimizerFixtureSong();
+    // Inst, the motif's five distinct events, track 1's Duration/Note/Duration/Tie lead-ins, and End.
+    EXPECT_EQ(optimizeSongSubroutines(song).distinctTokens, 12);
+
+    NspcSong canonical = buildOptimizerFixtureSong();
+    NspcEventId nextId = 10000;
+    auto& events = canonical.tracks()[0].events;
+    // Zero ticks encode as one tick, so both durations share a single new token.
+    events.insert(events.begin(), makeEntry(nextId, Duration{.ticks = 0, .quantization = std::nullopt, .velocity = std::nullopt}));
+    events.insert(events.begin(), makeEntry(nextId, Duration{.ticks = 1, .quantization = std::nullopt, .velocity = std::nullopt}));
+    EXPECT_EQ(optimizeSongSubroutines(canonical).distinctTokens, 13);
+}
+
+TEST(NspcOptimizeTest, OptimizerReportsAutomatonMemoryAndShrinksLongSongs) {
+    NspcSong song = buildOptimizerFixtureSong();
+    NspcEventId nextId = 10000;
+    const auto motif = appendMotif(nextId);
+    auto& events = song.tracks()[0].events;
+    events.pop_back();  // End
+    for (uint8_t pitch = 0; pitch < 0x40; ++pitch) {
+        events.push_back(makeEntry(nextId, Note{.pitch = pitch}));
+        appendEvents(events, motif, nextId);
+    }
+    events.push_back(makeEntry(nextId, End{}));
+
+    const NspcOptimizerStats stats = optimizeSongSubroutines(song);
+    EXPECT_GT(stats.peakAutomatonBytes, 0u);
+    EXPECT_LT(stats.bytesAfter, stats.bytesBefore);
+    EXPECT_TRUE(hasAnyTrackSubroutineCall(song));
+}
+
+TEST(NspcOptimizeTest, IncrementalModeMatchesGreedyWithFewerAutomatonBuilds) {
+    NspcSong greedySong = buildOptimizerFixtureSong();
+    NspcEventId nextId = 10000;
+    auto& events = greedySong.tracks()[1].events;
+    events.pop_back();  // End
+    for (uint8_t pitch = 0; pitch < 0x20; ++pitch) {
+        const auto motif = appendMotif(nextId);
+        events.push_back(makeEntry(nextId, Note{.pitch = static_cast<uint8_t>(pitch & 0x07)}));
+        appendEvents(events, motif, nextId);
+        events.push_back(makeEntry(nextId, Note{.pitch = static_cast<uint8_t>(0x10 + (pitch & 0x03))}));
+    }
+    events.push_back(makeEntry(nextId, End{}));
+    NspcSong incrementalSong = greedySong;
+    NspcSong tolerantSong = greedySong;
+
+    const NspcOptimizerStats greedy = optimizeSongSubroutines(greedySong);
+    const NspcOptimizerStats incremental =
+        optimizeSongSubroutines(incrementalSong, NspcOptimizerOptions{.incremental = true});
+
+    EXPECT_EQ(incremental.bytesBefore, greedy.bytesBefore);
+    EXPECT_EQ(incremental.bytesAfter, greedy.bytesAfter);
+    EXPECT_EQ(incremental.subroutinesCreated, greedy.subroutinesCreated);
+    EXPECT_GT(greedy.subroutinesCreated, 1);
+    EXPECT_LT(incremental.automatonBuilds, greedy.automatonBuilds);
+
+    const NspcOptimizerStats tolerant = optimizeSongSubroutines(
+        tolerantSong, NspcOptimizerOptions{.incremental = true, .incrementalTolerancePercent = 10});
+    EXPECT_LE(tolerant.bytesAfter, greedy.bytesAfter + greedy.bytesAfter / 10);
+}
+
+TEST(NspcOptimizeTest, CandidateSelectionDoesNotDependOnThreadCount) {
+    NspcSong source = buildOptimizerFixtureSong();
+    NspcEventId nextId = 10000;
+    auto& events = source.tracks()[0].events;
+    events.pop_back();  // End
+    for (uint8_t pitch = 0; pitch < 0x30; ++pitch) {
+        events.push_back(makeEntry(nextId, Note{.pitch = static_cast<uint8_t>(pitch % 5)}));
+        appendEvents(events, appendMotif(nextId), nextId);
+    }
+    events.push_back(makeEntry(nextId, End{}));
+
+    for (const bool selectBest : {false, true}) {
+        SCOPED_TRACE(selectBest ? "best real savings" : "first profitable");
+        NspcSong serial = source;
+        NspcSong threaded = source;
+        const NspcOptimizerStats serialStats = optimizeSongSubroutines(
+            serial, NspcOptimizerOptions{.selectBestRealSavings = selectBest, .maxWorkerThreads = 1});
+        const NspcOptimizerStats threadedStats = optimizeSongSubroutines(
+            threaded, NspcOptimizerOptions{.selectBestRealSavings = selectBest, .maxWorkerThreads = 4});
+
+        EXPECT_EQ(serialStats.bytesAfter, threadedStats.bytesAfter);
+        ASSERT_EQ(serial.subroutines().size(), threaded.subroutines().size());
+        EXPECT_GT(serial.subroutines().size(), 0u);
+        const NspcEngineConfig engine{};
+        std::vector<std::string> warnings;
+        for (size_t i = 0; i < serial.subroutines().size(); ++i) {
+            const auto a = encodeEventStreamForEngine(serial.subroutines()[i].events, {}, warnings, engine);
+            const auto b = encodeEventStreamForEngine(threaded.subroutines()[i].events, {}, warnings, engine);
+            ASSERT_TRUE(a.has_value() && b.has_value());
+            EXPECT_EQ(*a, *b);
+        }
+    }
+}
+
+TEST(NspcOptimizeTest, BeamSearchNeverReturnsLargerSongThanGreedy) {
+    NspcSong source = buildOptimizerFixtureSong();
+    NspcEventId nextId = 10000;
+    auto& events = source.tracks()[1].events;
+    events.pop_back();  // End
+    for (uint8_t pitch = 0; pitch < 0x18; ++pitch) {
+        events.push_back(makeEntry(nextId, Note{.pitch = static_cast<uint8_t>(pitch % 3)}));
+        appendEvents(events, appendMotif(nextId), nextId);
+        events.push_back(makeEntry(nextId, Note{.pitch = static_cast<uint8_t>(0x20 + pitch % 4)}));
+    }
+    events.push_back(makeEntry(nextId, End{}));
+
+    NspcSong greedySong = source;
+    const NspcOptimizerStats greedy = optimizeSongSubroutines(greedySong);
+
+    NspcSong searchedSong = source;
+    const NspcOptimizerStats searched =
+        optimizeSongSubroutines(searchedSong, NspcOptimizerOptions{.searchBudgetMilliseconds = 2000, .beamWidth = 2});
+    EXPECT_EQ(searched.greedyBytesAfter, greedy.bytesAfter);
+    EXPECT_LE(searched.bytesAfter, greedy.bytesAfter);
+    EXPECT_GT(searched.searchDepth, 0);
+    EXPECT_EQ(static_cast<int>(searchedSong.subroutines().size()), searched.subroutinesCreated);
+    EXPECT_EQ(greedy.greedyBytesAfter, 0u);
+}
+
+TEST(NspcOptimizeTest, SharedOptimizerExtractsPhrasesRepeatedAcrossSongs) {
+    // Each song plays the motif only twice, but four times between them.
+    NspcSong first = buildOptimizerFixtureSong();
+    first.tracks().pop_back();
+    NspcSong second = buildOptimizerFixtureSong();
+    second.tracks().erase(second.tracks().begin());
+    first.tracks()[0].events.erase(first.tracks()[0].events.begin() + 1, first.tracks()[0].events.begin() + 7);
+
+    NspcSong* const songs[] = {&first, &second};
+    const NspcSharedOptimizerStats stats = optimizeSharedSubroutines(songs);
+
+    ASSERT_EQ(stats.songs.size(), 2u);
+    EXPECT_GT(stats.sharedSubroutines, 0);
+    EXPECT_GT(stats.sharedSubroutineBytes, 0u);
+    EXPECT_LT(stats.bytesAfter, stats.bytesBefore);
+    for (size_t i = 0; i < 2; ++i) {
+        const NspcSong& song = *songs[i];
+        EXPECT_GT(stats.songs[i].sharedSubroutinesUsed, 0);
+        EXPECT_TRUE(hasAnyTrackSubroutineCall(song));
+        for (const auto& track : song.tracks()) {
+            for (const auto& entry : track.events) {
+                const auto* vcmd = std::get_if<Vcmd>(&entry.event);
+                if (const auto* call = vcmd ? std::get_if<VcmdSubroutineCall>(&vcmd->vcmd) : nullptr) {
+                    ASSERT_GE(call->subroutineId, 0);
+                    ASSERT_LT(call->subroutineId, static_cast<int>(song.subroutines().size()));
+                    EXPECT_EQ(song.subroutines()[static_cast<size_t>(call->subroutineId)].id, call->subroutineId);
+                }
+            }
+        }
+    }
+}
+
+TEST(NspcOptimizeTest, PresetsOnlyTouchTheirOwnFields) {
+    NspcOptimizerOptions options{.incremental = true, .maxWorkerThreads = 2};
+    applyOptimizerPreset(options, NspcOptimizerPreset::Relaxed);
+    EXPECT_FALSE(options.allowSingleIterationCalls);
+    EXPECT_EQ(options.maxOptimizeIterations, 64);
+    applyOptimizerPreset(options, NspcOptimizerPreset::AggressivePlus);
+    EXPECT_EQ(options.maxOptimizeIterations, 512);
+    EXPECT_GT(options.searchBudgetMilliseconds, 0);
+    applyOptimizerPreset(options, NspcOptimizerPreset::Aggressive);
+    EXPECT_EQ(options.searchBudgetMilliseconds, 0);
+    EXPECT_TRUE(options.incremental);
+    EXPECT_EQ(options.maxWorkerThreads, 2u);
+    EXPECT_EQ(optimizerPresetName(NspcOptimizerPreset::Balanced), "Balanced");
+}
+
 TEST(NspcOptimizeTest, OptimizerAvoidsCallImmediatelyAfterDuration) {
     NspcSong song;
     NspcEventId nextId = 1;
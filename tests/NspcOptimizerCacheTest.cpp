@@ -0,0 +1,129 @@
+#include "ntrak/nspc/NspcCompile.hpp"
+#include "ntrak/nspc/NspcOptimizerCache.hpp"
+#include "ntrak/nspc/NspcProject.hpp"
+
+#include "NspcTestHelpers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+using test_helpers::buildProjectWithTwoSongsTwoAssets;
+using test_helpers::fillWithRepeatedPhrase;
+
+NspcEngineConfig baseConfig() {
+    NspcEngineConfig config{};
+    config.name = "Optimizer cache test";
+    config.entryPoint = 0x1234;
+    config.sampleHeaders = 0x0200;
+    config.instrumentHeaders = 0x0300;
+    config.songIndexPointers = 0x0400;
+    config.instrumentEntryBytes = 6;
+    return config;
+}
+
+NspcProject buildProjectWithRepeatedPhrase() {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    EXPECT_TRUE(project.setSongContentOrigin(0, NspcContentOrigin::UserProvided));
+    fillWithRepeatedPhrase(project.songs()[0]);
+    return project;
+}
+
+TEST(NspcOptimizerCacheTest, KeyIgnoresEventIdsButNotContentOrOptions) {
+    NspcSong song;
+    fillWithRepeatedPhrase(song);
+    const NspcEngineConfig engine = baseConfig();
+    const auto key = optimizerCacheKey(song, {}, engine);
+    ASSERT_TRUE(key.has_value());
+
+    NspcSong renumbered = song;
+    for (auto& entry : renumbered.tracks()[0].events) {
+        entry.id += 1000;
+    }
+    EXPECT_EQ(optimizerCacheKey(renumbered, {}, engine), key);
+
+    NspcSong edited = song;
+    edited.tracks()[0].events[1].event = Note{.pitch = 0x20};
+    EXPECT_NE(optimizerCacheKey(edited, {}, engine), key);
+
+    EXPECT_NE(optimizerCacheKey(song, NspcOptimizerOptions{.maxOptimizeIterations = 3}, engine), key);
+    EXPECT_EQ(optimizerCacheKey(song, NspcOptimizerOptions{.maxWorkerThreads = 3}, engine), key);
+
+    NspcEngineConfig otherEngine = engine;
+    otherEngine.name = "Other engine";
+    EXPECT_NE(optimizerCacheKey(song, {}, otherEngine), key);
+}
+
+TEST(NspcOptimizerCacheTest, RebuildingUnchangedSongHitsCacheWithIdenticalOutput) {
+    NspcProject project = buildProjectWithRepeatedPhrase();
+    NspcBuildOptions options{};
+    options.optimizeSubroutines = true;
+
+    auto first = buildSongScopedUpload(project, 0, options);
+    ASSERT_TRUE(first.has_value()) << first.error();
+    EXPECT_EQ(first->upload.telemetry.cacheMisses, 1u);
+    EXPECT_EQ(first->upload.telemetry.cacheHits, 0u);
+    EXPECT_GT(first->upload.telemetry.subroutinesCreated, 0u);
+    EXPECT_EQ(project.optimizerCache().size(), 1u);
+
+    // A snapshot copy shares the cache, like the builds the editor runs on a background thread.
+    NspcProject snapshot = project;
+    auto second = buildSongScopedUpload(snapshot, 0, options);
+    ASSERT_TRUE(second.has_value()) << second.error();
+    EXPECT_EQ(second->upload.telemetry.cacheHits, 1u);
+    EXPECT_EQ(second->upload.telemetry.cacheMisses, 0u);
+    EXPECT_EQ(second->upload.telemetry.subroutinesCreated, first->upload.telemetry.subroutinesCreated);
+    EXPECT_EQ(second->upload.telemetry.optimizerBytesSaved, first->upload.telemetry.optimizerBytesSaved);
+    ASSERT_EQ(second->upload.chunks.size(), first->upload.chunks.size());
+    for (size_t i = 0; i < first->upload.chunks.size(); ++i) {
+        EXPECT_EQ(second->upload.chunks[i].address, first->upload.chunks[i].address);
+        EXPECT_EQ(second->upload.chunks[i].bytes, first->upload.chunks[i].bytes);
+    }
+
+    options.useOptimizerCache = false;
+    auto uncached = buildSongScopedUpload(project, 0, options);
+    ASSERT_TRUE(uncached.has_value()) << uncached.error();
+    EXPECT_EQ(uncached->upload.telemetry.cacheHits, 0u);
+    EXPECT_EQ(uncached->upload.telemetry.cacheMisses, 0u);
+}
+
+TEST(NspcOptimizerCacheTest, EvictsOldestEntryBeyondCapacity) {
+    NspcOptimizerCache cache;
+    NspcOptimizerCacheKey key;
+    for (key.hash = 0; key.hash <= NspcOptimizerCache::kMaxEntries; ++key.hash) {
+        cache.store(key, NspcOptimizerCacheEntry{});
+    }
+    EXPECT_EQ(cache.size(), NspcOptimizerCache::kMaxEntries);
+    key.hash = 0;
+    EXPECT_FALSE(cache.find(key).has_value());
+    key.hash = NspcOptimizerCache::kMaxEntries;
+    EXPECT_TRUE(cache.find(key).has_value());
+    EXPECT_EQ(cache.entries().front().first, 1u);
+}
+
+// Entries are found by hash but must match the full key input, so a colliding hash is a miss.
+TEST(NspcOptimizerCacheTest, HashCollisionIsAMiss) {
+    NspcOptimizerCache cache;
+    NspcOptimizerCacheKey key;
+    key.hash = 7;
+    key.input = {1, 2, 3};
+    NspcOptimizerCacheEntry entry;
+    entry.stats.iterations = 4;
+    cache.store(key, std::move(entry));
+
+    const auto hit = cache.find(key);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->stats.iterations, 4);
+    EXPECT_EQ(hit->keyInput, key.input);
+
+    key.input.back() = 4;
+    EXPECT_FALSE(cache.find(key).has_value());
+}
+
+}  // namespace
+}  // namespace ntrak::nspc
@@ -0,0 +1,111 @@
+#include "ntrak/nspc/NspcPackedEvents.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+constexpr VcmdParamBytes kParamPattern = {0x12, 0x34, 0x56, 0x78};
+
+std::vector<NspcEventEntry> buildMixedEvents() {
+    std::vector<NspcEventEntry> entries;
+    NspcEventId nextId = 100;
+    auto add = [&](NspcEvent event, std::optional<uint16_t> originalAddr = std::nullopt) {
+        entries.push_back(NspcEventEntry{.id = nextId++, .event = std::move(event), .originalAddr = originalAddr});
+    };
+
+    add(std::monostate{});
+    add(Duration{.ticks = 0x18, .quantization = std::nullopt, .velocity = std::nullopt}, 0x2000);
+    add(Duration{.ticks = 0x30, .quantization = 0x7, .velocity = std::nullopt});
+    add(Duration{.ticks = 0x01, .quantization = 0x2, .velocity = 0xF});
+    add(Note{.pitch = 0x47});
+    add(Tie{});
+    add(Rest{});
+    add(Percussion{.index = 3});
+    add(Subroutine{.id = 12, .originalAddr = 0x3456});
+    add(Vcmd{});
+    add(Vcmd{VcmdExtension{.id = 0xFF, .params = {1, 2, 3, 0}, .paramCount = 3}});
+    add(Vcmd{VcmdSubroutineCall{.subroutineId = 5, .originalAddr = 0x3412, .count = 4}});
+    add(Vcmd{VcmdSubroutineCall{.subroutineId = -1, .originalAddr = 0x1234, .count = 1}});
+    for (uint32_t id = kFirstVcmdId; id <= 0xFF; ++id) {
+        if (id == VcmdSubroutineCall::id) {
+            continue;
+        }
+        if (const auto vcmd = decodeVcmd(static_cast<uint8_t>(id), kParamPattern.data())) {
+            add(*vcmd, static_cast<uint16_t>(0x4000 + id));
+        }
+    }
+    // Ids that do not continue the previous run.
+    nextId = 7;
+    add(End{});
+    nextId = 3;
+    add(End{});
+    return entries;
+}
+
+}  // namespace
+
+TEST(NspcPackedEventsTest, RoundTripsEveryEventKind) {
+    const auto entries = buildMixedEvents();
+    const auto packed = NspcPackedEventList::pack(entries);
+    ASSERT_TRUE(packed.has_value()) << packed.error();
+    ASSERT_EQ(packed->size(), entries.size());
+    EXPECT_EQ(packed->unpack(), entries);
+
+    size_t index = 0;
+    for (const auto& entry : *packed) {
+        ASSERT_LT(index, entries.size());
+        EXPECT_EQ(entry, entries[index]) << "event " << index;
+        ++index;
+    }
+    EXPECT_EQ(index, entries.size());
+}
+
+TEST(NspcPackedEventsTest, IndexesAcrossCheckpointsAndIdRuns) {
+    std::vector<NspcEventEntry> entries;
+    for (NspcEventId base = 0; base < 3000; base += 1000) {
+        for (auto entry : buildMixedEvents()) {
+            entry.id += base;
+            entries.push_back(std::move(entry));
+        }
+    }
+    ASSERT_GT(entries.size(), 2 * NspcPackedEventList::kCheckpointInterval);
+    const auto packed = NspcPackedEventList::pack(entries);
+    ASSERT_TRUE(packed.has_value());
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ((*packed)[i], entries[i]) << "event " << i;
+        EXPECT_EQ(packed->id(i), entries[i].id);
+        EXPECT_EQ(packed->indexOf(entries[i].id), std::optional<size_t>(i));
+    }
+    EXPECT_FALSE(packed->indexOf(99).has_value());
+}
+
+TEST(NspcPackedEventsTest, TypicalTrackIsSeveralTimesSmaller) {
+    std::vector<NspcEventEntry> entries;
+    NspcEventId nextId = 1;
+    for (int i = 0; i < 1000; ++i) {
+        entries.push_back(NspcEventEntry{.id = nextId++, .event = Vcmd{VcmdInst{.instrumentIndex = 2}}});
+        entries.push_back(NspcEventEntry{.id = nextId++, .event = Duration{.ticks = 8}});
+        entries.push_back(NspcEventEntry{.id = nextId++, .event = Note{.pitch = static_cast<uint8_t>(i % 0x48)}});
+    }
+    const auto packed = NspcPackedEventList::pack(entries);
+    ASSERT_TRUE(packed.has_value());
+    EXPECT_LT(packed->memoryBytes() * 8, entries.size() * sizeof(NspcEventEntry));
+    EXPECT_EQ(packed->unpack(), entries);
+}
+
+TEST(NspcPackedEventsTest, EmptyListPacks) {
+    const auto packed = NspcPackedEventList::pack({});
+    ASSERT_TRUE(packed.has_value());
+    EXPECT_TRUE(packed->empty());
+    EXPECT_EQ(packed->begin(), packed->end());
+    EXPECT_TRUE(packed->unpack().empty());
+}
+
+}  // namespace ntrak::nspc
@@ -1,6 +1,7 @@
 #include "ntrak/nspc/NspcCompile.hpp"
 #include "ntrak/nspc/NspcProject.hpp"
 #include "ntrak/nspc/NspcProjectFile.hpp"
+#include "ntrak/nspc/NspcUsageIndex.hpp"
 #include "NspcTestHelpers.hpp"
 
 #include <gtest/gtest.h>
@@ -13,9 +14,12 @@
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <optional>
 #include <span>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -597,6 +601,269 @@ TEST(NspcProjectFileTest, MarkedUserInstrumentAndSampleAreSavedWithBase64BrrData
     EXPECT_EQ(loadResult->samples[0].data, project.samples()[0].data);
 }
 
+TEST(NspcProjectFileTest, OptimizerCacheIsSavedOnRequestAndRestoredByOverlay) {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    ASSERT_TRUE(project.setSongContentOrigin(0, NspcContentOrigin::UserProvided));
+    test_helpers::fillWithRepeatedPhrase(project.songs()[0]);
+    NspcBuildOptions options{};
+    options.optimizeSubroutines = true;
+    ASSERT_TRUE(buildSongScopedUpload(project, 0, options).has_value());
+    ASSERT_EQ(project.optimizerCache().size(), 1u);
+
+    const auto path = uniqueTempPath("project-ir-optimizer-cache", "ntrakproj");
+    const auto cleanup = [&]() { std::error_code ec; std::filesystem::remove(path, ec); };
+    cleanup();
+
+    ASSERT_TRUE(saveProjectIrFile(project, path).has_value());
+    auto withoutCache = loadProjectIrFile(path);
+    ASSERT_TRUE(withoutCache.has_value()) << withoutCache.error();
+    EXPECT_TRUE(withoutCache->optimizerCache.empty());
+
+    ASSERT_TRUE(saveProjectIrFile(project, path, std::nullopt, true).has_value());
+    auto loaded = loadProjectIrFile(path);
+    cleanup();
+    ASSERT_TRUE(loaded.has_value()) << loaded.error();
+    ASSERT_EQ(loaded->optimizerCache.size(), 1u);
+
+    NspcProject reopened = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    ASSERT_TRUE(applyProjectIrOverlay(reopened, *loaded).has_value());
+    EXPECT_EQ(reopened.optimizerCache().size(), 1u);
+    auto rebuilt = buildSongScopedUpload(reopened, 0, options);
+    ASSERT_TRUE(rebuilt.has_value()) << rebuilt.error();
+    EXPECT_EQ(rebuilt->upload.telemetry.cacheHits, 1u);
+    EXPECT_EQ(rebuilt->upload.telemetry.cacheMisses, 0u);
+}
+
+TEST(NspcProjectFileTest, BinaryContainerConvertsLosslesslyToAndFromJson) {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    ASSERT_TRUE(project.setSongContentOrigin(0, NspcContentOrigin::UserProvided));
+    ASSERT_TRUE(project.setInstrumentContentOrigin(0, NspcContentOrigin::UserProvided));
+    ASSERT_TRUE(project.setSampleContentOrigin(0, NspcContentOrigin::UserProvided));
+    test_helpers::fillWithRepeatedPhrase(project.songs()[0]);
+    NspcBuildOptions options{};
+    options.optimizeSubroutines = true;
+    ASSERT_TRUE(buildSongScopedUpload(project, 0, options).has_value());
+
+    const auto jsonPath = uniqueTempPath("project-ir-convert", "ntrakproj");
+    const auto binaryPath = uniqueTempPath("project-ir-convert", "ntrakbin");
+    const auto directBinaryPath = uniqueTempPath("project-ir-convert-direct", "ntrakbin");
+    const auto roundTripPath = uniqueTempPath("project-ir-convert-back", "ntrakproj");
+    const auto cleanup = [&]() {
+        std::error_code ec;
+        for (const auto& path : {jsonPath, binaryPath, directBinaryPath, roundTripPath}) {
+            std::filesystem::remove(path, ec);
+        }
+    };
+    cleanup();
+    const auto readBytes = [](const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    const std::filesystem::path baseSpcPath = std::filesystem::temp_directory_path() / "base.spc";
+
+    ASSERT_TRUE(saveProjectIrFile(project, jsonPath, baseSpcPath, true).has_value());
+    auto fromJson = loadProjectIrFile(jsonPath);
+    ASSERT_TRUE(fromJson.has_value()) << fromJson.error();
+    ASSERT_TRUE(saveProjectIrData(*fromJson, binaryPath, NspcProjectFileFormat::Binary).has_value());
+    ASSERT_TRUE(
+        saveProjectIrFile(project, directBinaryPath, baseSpcPath, true, NspcProjectFileFormat::Binary).has_value());
+
+    // BRR data is stored raw rather than base64-encoded
+    const auto binaryBytes = readBytes(binaryPath);
+    EXPECT_EQ(detectProjectFileFormat(binaryBytes), NspcProjectFileFormat::Binary);
+    EXPECT_EQ(detectProjectFileFormat(readBytes(jsonPath)), NspcProjectFileFormat::Json);
+    const auto& sampleData = project.samples()[0].data;
+    ASSERT_FALSE(sampleData.empty());
+    EXPECT_NE(std::search(binaryBytes.begin(), binaryBytes.end(), sampleData.begin(), sampleData.end()),
+              binaryBytes.end());
+    EXPECT_EQ(readBytes(directBinaryPath), binaryBytes);
+
+    auto fromBinary = loadProjectIrFile(binaryPath);
+    ASSERT_TRUE(fromBinary.has_value()) << fromBinary.error();
+    EXPECT_EQ(fromBinary->optimizerCache.size(), 1u);
+    ASSERT_TRUE(saveProjectIrData(*fromBinary, roundTripPath, NspcProjectFileFormat::Json).has_value());
+
+    const auto original = json::parse(readBytes(jsonPath));
+    const auto roundTripped = json::parse(readBytes(roundTripPath));
+    EXPECT_EQ(roundTripped, original);
+
+    // Every truncation is reported as an error, never read past the end
+    for (size_t size = 0; size < binaryBytes.size(); size += 7) {
+        EXPECT_FALSE(parseProjectIr(std::span(binaryBytes).first(size)).has_value()) << "size " << size;
+    }
+    cleanup();
+}
+
+// Saves go through a sibling temp file, so one that cannot be written leaves the previous save untouched
+TEST(NspcProjectFileTest, FailedSaveLeavesExistingFileIntact) {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    ASSERT_TRUE(project.setSongContentOrigin(0, NspcContentOrigin::UserProvided));
+
+    const auto path = uniqueTempPath("project-ir-failed-save", "ntrakbin");
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    const auto cleanup = [&]() {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::remove_all(tempPath, ec);
+    };
+    cleanup();
+    const auto readBytes = [](const std::filesystem::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    ASSERT_TRUE(saveProjectIrFile(project, path, std::nullopt, false, NspcProjectFileFormat::Binary).has_value());
+    EXPECT_FALSE(std::filesystem::exists(tempPath));
+    const auto savedBytes = readBytes(path);
+    ASSERT_FALSE(savedBytes.empty());
+
+    // A directory in the temp file's place makes the next save fail before it can touch the target
+    ASSERT_TRUE(std::filesystem::create_directories(tempPath / "blocker"));
+    ASSERT_TRUE(project.setSongContentOrigin(1, NspcContentOrigin::UserProvided));
+    EXPECT_FALSE(saveProjectIrFile(project, path, std::nullopt, false, NspcProjectFileFormat::Binary).has_value());
+    EXPECT_EQ(readBytes(path), savedBytes);
+    EXPECT_TRUE(std::filesystem::exists(tempPath / "blocker"));
+    cleanup();
+}
+
+// Opening a project leaves song events encoded through overlaying and ARAM accounting; the first access
+// decodes them to what an eager load reads.
+TEST(NspcProjectFileTest, DeferredSongEventsDecodeOnFirstAccess) {
+    NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
+    ASSERT_TRUE(project.setSongContentOrigin(0, NspcContentOrigin::UserProvided));
+    ASSERT_TRUE(project.setSongContentOrigin(1, NspcContentOrigin::UserProvided));
+    test_helpers::fillWithRepeatedPhrase(project.songs()[0]);
+    test_helpers::fillWithRepeatedPhrase(project.songs()[1], 4);
+    NspcTrack secondTrack = project.songs()[1].tracks()[0];
+    secondTrack.id = 1;
+    for (auto& entry : secondTrack.events) {
+        entry.id += 2000;
+    }
+    project.songs()[1].tracks().push_back(std::move(secondTrack));
+    const int instrumentId = project.instruments().front().id;
+    auto& phrase = project.songs()[1].tracks()[0].events;
+    phrase.insert(phrase.begin() + 2,
+                  NspcEventEntry{.id = 1000,
+                                 .event = Vcmd{VcmdInst{.instrumentIndex = static_cast<uint8_t>(instrumentId)}}});
+    const NspcProject base = project;
+
+    const auto jsonPath = uniqueTempPath("project-ir-deferred", "ntrakproj");
+    const auto binaryPath = uniqueTempPath("project-ir-deferred", "ntrakbin");
+    const auto resavedPath = uniqueTempPath("project-ir-deferred-resaved", "ntrakproj");
+    const auto eagerResavedPath = uniqueTempPath("project-ir-deferred-eager", "ntrakproj");
+    const auto cleanup = [&]() {
+        std::error_code ec;
+        for (const auto& path : {jsonPath, binaryPath, resavedPath, eagerResavedPath}) {
+            std::filesystem::remove(path, ec);
+        }
+    };
+    cleanup();
+    const auto readBytes = [](const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    ASSERT_TRUE(saveProjectIrFile(project, jsonPath).has_value());
+    ASSERT_TRUE(saveProjectIrFile(project, binaryPath, std::nullopt, false, NspcProjectFileFormat::Binary));
+
+    for (const auto& path : {jsonPath, binaryPath}) {
+        SCOPED_TRACE(path.string());
+        auto eager = loadProjectIrFile(path, {.deferSongEvents = false});
+        auto deferred = loadProjectIrFile(path);
+        ASSERT_TRUE(eager.has_value()) << eager.error();
+        ASSERT_TRUE(deferred.has_value()) << deferred.error();
+        ASSERT_EQ(deferred->songs.size(), 2u);
+        for (const auto& song : eager->songs) {
+            EXPECT_EQ(song.deferredBody(), nullptr);
+        }
+
+        NspcProject eagerProject = base;
+        NspcProject deferredProject = base;
+        ASSERT_TRUE(applyProjectIrOverlay(eagerProject, *eager).has_value());
+        ASSERT_TRUE(applyProjectIrOverlay(deferredProject, *deferred).has_value());
+        NspcUsageIndex eagerIndex;
+        NspcUsageIndex deferredIndex;
+        eagerIndex.rebuild(eagerProject);
+        deferredIndex.rebuild(deferredProject);
+
+        std::vector<std::shared_ptr<NspcDeferredSongBody>> bodies;
+        for (const auto& song : deferredProject.songs()) {
+            ASSERT_NE(song.deferredBody(), nullptr);
+            EXPECT_FALSE(song.deferredBody()->isDecoded());
+            bodies.push_back(song.deferredBody());
+        }
+        const auto& eagerUsage = eagerProject.aramUsage();
+        const auto& deferredUsage = deferredProject.aramUsage();
+        EXPECT_EQ(deferredUsage.freeBytes, eagerUsage.freeBytes);
+        EXPECT_EQ(deferredUsage.trackBytes, eagerUsage.trackBytes);
+        EXPECT_EQ(deferredUsage.subroutineBytes, eagerUsage.subroutineBytes);
+        EXPECT_EQ(deferredUsage.regions.size(), eagerUsage.regions.size());
+        for (const auto& body : bodies) {
+            EXPECT_FALSE(body->isDecoded());
+        }
+
+        // A song-scoped query decodes that song only
+        EXPECT_EQ(deferredIndex.usedValues(NspcUsageIndex::Kind::Instrument, 1),
+                  eagerIndex.usedValues(NspcUsageIndex::Kind::Instrument, 1));
+        EXPECT_FALSE(bodies[0]->isDecoded());
+        EXPECT_TRUE(bodies[1]->isDecoded());
+
+        deferredProject.prefetchSong(0);
+        (void)bodies[0]->get();
+        EXPECT_TRUE(bodies[0]->isDecoded());
+        EXPECT_EQ(deferredIndex.useCount(NspcUsageIndex::Kind::Instrument, instrumentId),
+                  eagerIndex.useCount(NspcUsageIndex::Kind::Instrument, instrumentId));
+        const auto deferredUses = deferredIndex.uses(NspcUsageIndex::Kind::Instrument, instrumentId);
+        const auto eagerUses = eagerIndex.uses(NspcUsageIndex::Kind::Instrument, instrumentId);
+        ASSERT_EQ(eagerUses.size(), 1u);
+        ASSERT_EQ(deferredUses.size(), eagerUses.size());
+        for (size_t i = 0; i < eagerUses.size(); ++i) {
+            EXPECT_EQ(deferredUses[i].songId, eagerUses[i].songId);
+            EXPECT_EQ(deferredUses[i].event.eventIndex, eagerUses[i].event.eventIndex);
+            EXPECT_EQ(deferredUses[i].event.eventId, eagerUses[i].event.eventId);
+        }
+
+        // Editing takes the decoded body over; the loaded events match the eager load's
+        deferredProject.songs()[1].tracks();
+        EXPECT_EQ(deferredProject.songs()[1].deferredBody(), nullptr);
+        ASSERT_TRUE(saveProjectIrFile(deferredProject, resavedPath).has_value());
+        ASSERT_TRUE(saveProjectIrFile(eagerProject, eagerResavedPath).has_value());
+        EXPECT_EQ(readBytes(resavedPath), readBytes(eagerResavedPath));
+    }
+
+    // Malformed event bytes fail an eager load. A deferred one reports them on decode, leaves that list empty
+    // and saves its bytes back unchanged, even after the song is edited.
+    auto root = json::parse(readBytes(jsonPath));
+    root["songs"][1]["tracks"][0]["eventsData"] = "AAAA";
+    {
+        std::ofstream out(jsonPath, std::ios::binary | std::ios::trunc);
+        out << root.dump();
+    }
+    EXPECT_FALSE(loadProjectIrFile(jsonPath, {.deferSongEvents = false}).has_value());
+    auto deferred = loadProjectIrFile(jsonPath);
+    ASSERT_TRUE(deferred.has_value()) << deferred.error();
+    NspcSong& broken = deferred->songs[1];
+    ASSERT_NE(broken.deferredBody(), nullptr);
+    EXPECT_TRUE(broken.eventsError().empty());
+    ASSERT_GE(std::as_const(broken).tracks().size(), 2u);
+    EXPECT_FALSE(broken.eventsError().empty());
+    EXPECT_TRUE(broken.tracks()[0].events.empty());
+    EXPECT_FALSE(broken.tracks()[1].events.empty());
+    ASSERT_EQ(broken.undecodedEvents().size(), 1u);
+    EXPECT_FALSE(broken.eventsError().empty());
+    broken.setSongName("Edited");
+
+    NspcProject resavedProject = base;
+    ASSERT_TRUE(applyProjectIrOverlay(resavedProject, *deferred).has_value());
+    ASSERT_TRUE(saveProjectIrFile(resavedProject, resavedPath).has_value());
+    const auto resaved = json::parse(readBytes(resavedPath));
+    cleanup();
+    EXPECT_EQ(resaved["songs"][1]["songName"], "Edited");
+    EXPECT_EQ(resaved["songs"][1]["tracks"][0]["eventsData"], "AAAA");
+    EXPECT_EQ(resaved["songs"][1]["tracks"][0]["encodedBytes"], root["songs"][1]["tracks"][0]["encodedBytes"]);
+    EXPECT_EQ(resaved["songs"][1]["tracks"][1], root["songs"][1]["tracks"][1]);
+}
+
 TEST(NspcProjectFileTest, SaveProjectIrUsesPackedTrackEventEncoding) {
     NspcProject project = buildProjectWithTwoSongsTwoAssets(baseConfig());
 
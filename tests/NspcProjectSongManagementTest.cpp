@@ -6,6 +6,7 @@
 #include <array>
 #include <cstdint>
 #include <optional>
+#include <utility>
 #include <variant>
 
 namespace ntrak::nspc {
@@ -127,4 +128,23 @@ TEST(NspcProjectSongManagementTest, RemoveSongReindexesSongsAndLayouts) {
     EXPECT_FALSE(project.duplicateSong(5).has_value());
 }
 
+TEST(NspcProjectSongManagementTest, ProjectCopiesShareStorageUntilEdited) {
+    NspcProject project = buildTwoSongProject();
+    NspcProject snapshot = project;
+
+    const auto* originalAram = std::as_const(project).aram().all().data();
+    EXPECT_EQ(std::as_const(snapshot).aram().all().data(), originalAram);
+    EXPECT_EQ(&std::as_const(snapshot).songs()[0].tracks(), &std::as_const(project).songs()[0].tracks());
+
+    const uint8_t originalByte = std::as_const(project).aram().all()[0x0500];
+    snapshot.aram().all()[0x0500] = static_cast<uint8_t>(originalByte ^ 0xFFu);
+    snapshot.songs()[0].tracks().push_back(NspcTrack{.id = 42, .events = {}, .originalAddr = 0});
+
+    EXPECT_EQ(std::as_const(project).aram().all().data(), originalAram);
+    EXPECT_EQ(std::as_const(project).aram().all()[0x0500], originalByte);
+    EXPECT_TRUE(std::as_const(project).songs()[0].tracks().empty());
+    EXPECT_EQ(std::as_const(snapshot).songs()[0].tracks().size(), 1u);
+    EXPECT_EQ(&std::as_const(snapshot).songs()[1].tracks(), &std::as_const(project).songs()[1].tracks());
+}
+
 }  // namespace ntrak::nspc
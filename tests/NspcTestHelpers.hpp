@@ -21,6 +21,29 @@ inline void writeBrrBlock(std::array<std::uint8_t, 0x10000>& aram, std::uint16_t
     }
 }
 
+/// Replaces a song's tracks with one track that plays the same twelve-note phrase `repeats` times,
+/// so the subroutine optimizer has something to extract.
+inline void fillWithRepeatedPhrase(NspcSong& song, int repeats = 2) {
+    NspcEventId nextId = 1;
+    NspcTrack track{};
+    track.id = 0;
+    for (int repeat = 0; repeat < repeats; ++repeat) {
+        for (std::uint8_t pitch = 0; pitch < 12; ++pitch) {
+            track.events.push_back(NspcEventEntry{
+                .id = nextId++,
+                .event = Duration{.ticks = static_cast<std::uint8_t>(4 + pitch), .quantization = 7, .velocity = 15}});
+            track.events.push_back(NspcEventEntry{.id = nextId++, .event = Note{.pitch = pitch}});
+        }
+    }
+    track.events.push_back(NspcEventEntry{.id = nextId++, .event = End{}});
+    song.tracks() = {std::move(track)};
+    song.subroutines().clear();
+    if (song.patterns().empty()) {
+        song.patterns().push_back(NspcPattern{.id = 0});
+    }
+    song.patterns()[0].channelTrackIds = {0, -1, -1, -1, -1, -1, -1, -1};
+}
+
 inline NspcProject buildProjectWithTwoSongsTwoAssets(NspcEngineConfig config) {
     std::array<std::uint8_t, 0x10000> aram{};
 
@@ -0,0 +1,174 @@
+#include "ntrak/nspc/NspcCommand.hpp"
+#include "ntrak/nspc/NspcCommandHistory.hpp"
+#include "ntrak/nspc/NspcUsageIndex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+using Kind = NspcUsageIndex::Kind;
+
+NspcEventEntry entry(NspcEventId id, NspcEvent event) {
+    return NspcEventEntry{.id = id, .event = std::move(event), .originalAddr = std::nullopt};
+}
+
+// Track 0 sets instrument 5 (with the high bit set), a percussion base of 0x10 and calls subroutine 0; the
+// subroutine sets instrument 7 and plays percussion against the default base.
+NspcSong buildUsageSong() {
+    NspcSong song;
+    song.setSongId(3);
+    song.tracks().push_back(NspcTrack{
+        .id = 0,
+        .events = {entry(1, Vcmd{VcmdInst{.instrumentIndex = 0x85}}), entry(2, Duration{.ticks = 4}),
+                   entry(3, Note{.pitch = 24}), entry(4, Vcmd{VcmdPercussionBaseInstrument{.index = 0x10}}),
+                   entry(5, Percussion{.index = 2}),
+                   entry(6, Vcmd{VcmdSubroutineCall{.subroutineId = 0, .originalAddr = 0x3000, .count = 2}}),
+                   entry(7, End{})},
+        .originalAddr = 0x1000,
+    });
+    song.tracks().push_back(NspcTrack{
+        .id = 1,
+        .events = {entry(8, Duration{.ticks = 2}), entry(9, Note{.pitch = 12}), entry(10, Note{.pitch = 14}),
+                   entry(11, End{})},
+        .originalAddr = 0x1100,
+    });
+    song.subroutines().push_back(NspcSubroutine{
+        .id = 0,
+        .events = {entry(20, Vcmd{VcmdInst{.instrumentIndex = 7}}), entry(21, Percussion{.index = 1}),
+                   entry(22, Vcmd{VcmdInst{.instrumentIndex = 5}}), entry(23, End{})},
+        .originalAddr = 0x3000,
+    });
+    song.patterns().push_back(NspcPattern{.id = 0, .channelTrackIds = std::array<int, 8>{0, 1, -1, -1, -1, -1, -1, -1},
+                                          .trackTableAddr = 0x2000});
+    return song;
+}
+
+std::unique_ptr<NspcCommand> makeRandomCommand(std::mt19937& rng) {
+    const NspcEditorLocation location{
+        .patternId = 0,
+        .channel = static_cast<int>(rng() % 4),
+        .row = static_cast<uint32_t>(rng() % 24),
+    };
+    const auto value = static_cast<uint8_t>(rng() % 0x10);
+    switch (rng() % 5) {
+    case 0:
+        return std::make_unique<SetRowEventCommand>(location, Note{.pitch = value});
+    case 1:
+        return std::make_unique<SetRowEventCommand>(location, Percussion{.index = value});
+    case 2:
+        return std::make_unique<DeleteRowEventCommand>(location);
+    case 3:
+        return std::make_unique<SetInstrumentCommand>(location, (rng() % 3) != 0 ? std::optional<uint8_t>(value)
+                                                                                 : std::nullopt);
+    default:
+        return std::make_unique<SetEffectsCommand>(
+            location, std::vector<Vcmd>{Vcmd{VcmdPercussionBaseInstrument{.index = value}}});
+    }
+}
+
+void expectSameIndex(const NspcUsageIndex& actual, const NspcSong& song) {
+    NspcUsageIndex fresh;
+    fresh.rebuildSong(song);
+    for (const Kind kind : {Kind::Instrument, Kind::Subroutine, Kind::Vcmd}) {
+        ASSERT_EQ(actual.usedValues(kind, song.songId()), fresh.usedValues(kind, song.songId()));
+        for (const int value : fresh.usedValues(kind, song.songId())) {
+            const auto expected = fresh.uses(kind, value);
+            const auto uses = actual.uses(kind, value);
+            ASSERT_EQ(uses.size(), expected.size()) << "value " << value;
+            EXPECT_EQ(actual.useCount(kind, value), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(uses[i].songId, expected[i].songId);
+                EXPECT_EQ(uses[i].event.owner, expected[i].event.owner);
+                EXPECT_EQ(uses[i].event.ownerId, expected[i].event.ownerId);
+                EXPECT_EQ(uses[i].event.eventIndex, expected[i].event.eventIndex);
+                EXPECT_EQ(uses[i].event.eventId, expected[i].event.eventId);
+            }
+        }
+    }
+}
+
+// Replaces the song's subroutines wholesale; keeps the default collectChanges, so the index rescans the song.
+class ReplaceSubroutinesCommand final : public NspcCommand {
+public:
+    explicit ReplaceSubroutinesCommand(std::vector<NspcSubroutine> subroutines)
+        : subroutines_(std::move(subroutines)) {}
+
+    bool execute(NspcSong& song) override {
+        std::swap(song.subroutines(), subroutines_);
+        return true;
+    }
+    bool undo(NspcSong& song) override { return execute(song); }
+    [[nodiscard]] std::string description() const override { return "Replace Subroutines"; }
+
+private:
+    std::vector<NspcSubroutine> subroutines_;
+};
+
+}  // namespace
+
+TEST(NspcUsageIndexTest, IndexesInstrumentsPercussionSubroutinesAndVcmds) {
+    const NspcSong song = buildUsageSong();
+    NspcUsageIndex index;
+    index.rebuildSong(song);
+
+    EXPECT_EQ(index.usedValues(Kind::Instrument, 3), (std::vector<int>{0x01, 0x05, 0x07, 0x12}));
+    const auto instrument5 = index.uses(Kind::Instrument, 5);
+    ASSERT_EQ(instrument5.size(), 2u);
+    EXPECT_EQ(instrument5[0].songId, 3);
+    EXPECT_EQ(instrument5[0].event.owner, NspcEventOwner::Track);
+    EXPECT_EQ(instrument5[0].event.eventIndex, 0u);
+    EXPECT_EQ(instrument5[0].event.eventId, 1u);
+    EXPECT_EQ(instrument5[1].event.owner, NspcEventOwner::Subroutine);
+    EXPECT_EQ(instrument5[1].event.eventId, 22u);
+
+    const auto subroutineCalls = index.uses(Kind::Subroutine, 0, 3);
+    ASSERT_EQ(subroutineCalls.size(), 1u);
+    EXPECT_EQ(subroutineCalls[0].event.eventId, 6u);
+    EXPECT_EQ(index.useCount(Kind::Vcmd, VcmdInst::id), 3u);
+    EXPECT_TRUE(index.uses(Kind::Instrument, 5, 4).empty());
+    EXPECT_FALSE(index.isUsed(Kind::Instrument, 0x10));
+
+    index.removeSong(3);
+    EXPECT_FALSE(index.isUsed(Kind::Instrument, 5));
+    EXPECT_TRUE(index.usedValues(Kind::Vcmd, 3).empty());
+}
+
+// Every execute, undo and redo through the history must leave the index equal to a fresh rebuild.
+TEST(NspcUsageIndexTest, HistoryKeepsIndexCurrentThroughEditsUndoAndRedo) {
+    std::mt19937 rng(46);
+    NspcSong song = buildUsageSong();
+    NspcUsageIndex index;
+    index.rebuildSong(song);
+    NspcCommandHistory history;
+    (void)history.subscribe(
+        [&](const NspcSong& changedSong, const NspcSongChanges& changes) { index.updateSong(changedSong, changes); });
+
+    for (int step = 0; step < 200; ++step) {
+        const auto roll = rng() % 10;
+        if (roll < 6) {
+            (void)history.execute(song, makeRandomCommand(rng));
+        } else if (roll < 8) {
+            (void)history.undo(song);
+        } else {
+            (void)history.redo(song);
+        }
+        ASSERT_NO_FATAL_FAILURE(expectSameIndex(index, song)) << "step " << step;
+    }
+
+    history.beginGroup("Grouped");
+    (void)history.execute(song, makeRandomCommand(rng));
+    (void)history.execute(song, std::make_unique<ReplaceSubroutinesCommand>(std::vector<NspcSubroutine>{}));
+    history.endGroup();
+    EXPECT_FALSE(index.isUsed(Kind::Instrument, 7));
+    ASSERT_NO_FATAL_FAILURE(expectSameIndex(index, song));
+    (void)history.undo(song);
+    ASSERT_NO_FATAL_FAILURE(expectSameIndex(index, song));
+}
+
+}  // namespace ntrak::nspc
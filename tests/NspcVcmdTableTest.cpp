@@ -0,0 +1,85 @@
+#include "ntrak/nspc/NspcCompile.hpp"
+#include "ntrak/nspc/NspcVcmdTable.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ntrak::nspc {
+namespace {
+
+constexpr VcmdParamBytes kParamPattern = {0x12, 0x34, 0x56, 0x78};
+
+TEST(NspcVcmdTableTest, EveryBuiltInIdRoundTripsThroughTheEncoder) {
+    const NspcEngineConfig engine{};
+    const std::unordered_map<int, uint16_t> subroutineAddrById = {{-1, 0x3412}};
+
+    for (int rawId = kFirstVcmdId; rawId <= 0xFF; ++rawId) {
+        const auto id = static_cast<uint8_t>(rawId);
+        SCOPED_TRACE(std::format("VCMD ${:02X}", id));
+
+        const auto decoded = decodeVcmd(id, kParamPattern.data());
+        ASSERT_TRUE(decoded.has_value());
+        EXPECT_EQ(vcmdCommandId(*decoded), id);
+
+        const uint8_t paramCount = vcmdParamByteCount(id);
+        EXPECT_EQ(vcmdEncodedSize(*decoded), 1u + paramCount);
+
+        VcmdParamBytes written{};
+        ASSERT_EQ(writeVcmdParams(*decoded, written), paramCount);
+        for (uint8_t i = 0; i < paramCount; ++i) {
+            EXPECT_EQ(written[i], kParamPattern[i]);
+        }
+
+        std::vector<std::string> warnings;
+        const std::vector<NspcEventEntry> events = {NspcEventEntry{.id = 1, .event = *decoded}};
+        const auto encoded = encodeEventStreamForEngine(events, subroutineAddrById, warnings, engine);
+        ASSERT_TRUE(encoded.has_value()) << encoded.error();
+        std::vector<uint8_t> expected = {id};
+        expected.insert(expected.end(), kParamPattern.begin(), kParamPattern.begin() + paramCount);
+        EXPECT_EQ(*encoded, expected);
+        EXPECT_TRUE(warnings.empty());
+    }
+}
+
+TEST(NspcVcmdTableTest, ExtensionSizeComesFromItsParamCount) {
+    const Vcmd extension{VcmdExtension{.id = 0xE0, .params = {1, 2, 0, 0}, .paramCount = 2}};
+    EXPECT_EQ(vcmdEncodedSize(extension), 3u);
+    EXPECT_EQ(vcmdEncodedSize(Vcmd{}), 0u);
+}
+
+TEST(NspcVcmdTableTest, ConstructVcmdSkipsIdsWithDedicatedHandling) {
+    for (const uint8_t id : {VcmdInst::id, VcmdVolume::id, VcmdSubroutineCall::id, VcmdNOP::id, VcmdUnused::id}) {
+        EXPECT_FALSE(constructVcmd(id, kParamPattern.data()).has_value()) << std::format("${:02X}", id);
+    }
+
+    const auto echo = constructVcmd(VcmdEchoParams::id, kParamPattern.data());
+    ASSERT_TRUE(echo.has_value());
+    const auto* params = std::get_if<VcmdEchoParams>(&echo->vcmd);
+    ASSERT_NE(params, nullptr);
+    EXPECT_EQ(params->delay, 0x12);
+    EXPECT_EQ(params->feedback, 0x34);
+    EXPECT_EQ(params->firIndex, 0x56);
+
+    const auto transpose = constructVcmd(VcmdFineTune::id, std::array<uint8_t, 1>{0xFE}.data());
+    ASSERT_TRUE(transpose.has_value());
+    EXPECT_EQ(std::get<VcmdFineTune>(transpose->vcmd).semitones, -2);
+}
+
+TEST(NspcVcmdTableTest, NamesAndParamCountsComeFromTheStructs) {
+    EXPECT_STREQ(vcmdNameForId(VcmdTempo::id), "Tmp");
+    EXPECT_STREQ(vcmdNameForId(VcmdUnused::id), "Unu");
+    EXPECT_EQ(vcmdNameForId(0xC0), nullptr);
+    EXPECT_EQ(vcmdParamByteCount(0xC0), 0);
+    EXPECT_EQ(vcmdParamByteCount(VcmdNOP::id), 2);
+    EXPECT_EQ(vcmdParamByteCount(VcmdPitchSlideToNote::id), 3);
+    EXPECT_EQ(vcmdParamByteCount(VcmdFastForwardOn::id), 0);
+}
+
+}  // namespace
+}  // namespace ntrak::nspc